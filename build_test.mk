@@ -49,6 +49,13 @@ endif
 include common_features.mk
 include $(TMK_PATH)/common.mk
 include $(QUANTUM_PATH)/serial_link/tests/rules.mk
+include $(QUANTUM_PATH)/visualizer/tests/rules.mk
+include $(QUANTUM_PATH)/audio/tests/rules.mk
+include $(QUANTUM_PATH)/tests/rules.mk
+include $(TMK_PATH)/common/tests/rules.mk
+include $(TMK_PATH)/common/chibios/tests/rules.mk
+include $(TMK_PATH)/protocol/chibios/tests/rules.mk
+include $(TMK_PATH)/protocol/tests/rules.mk
 ifneq ($(filter $(FULL_TESTS),$(TEST)),)
 include build_full_test.mk
 endif
@@ -37,6 +37,7 @@ ifeq ($(strip $(AUDIO_ENABLE)), yes)
     SRC += $(QUANTUM_DIR)/audio/audio.c
     SRC += $(QUANTUM_DIR)/audio/voices.c
     SRC += $(QUANTUM_DIR)/audio/luts.c
+    SRC += $(QUANTUM_DIR)/audio/audio_engine.c
 endif
 
 ifeq ($(strip $(MIDI_ENABLE)), yes)
@@ -56,7 +57,10 @@ endif
 
 ifeq ($(strip $(STENO_ENABLE)), yes)
     OPT_DEFS += -DSTENO_ENABLE
+    # ChibiOS has no virtual serial port, only the HID mode works there
+    ifneq ($(PLATFORM),CHIBIOS)
 	VIRTSER_ENABLE := yes
+    endif
 	SRC += $(QUANTUM_DIR)/process_keycode/process_steno.c
 endif
 
@@ -24,6 +24,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "debug.h"
 #include "ps2.h"
 #include "matrix.h"
+#include "keyboard.h"
+#include "converter_decoders.h"
 
 #define print_matrix_row(row)  print_bin_reverse8(matrix_get_row(row))
 #define print_matrix_header()  print("\nr/c 01234567\n")
@@ -31,10 +33,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define ROW_SHIFTER ((uint8_t)1)
 
 
-static void matrix_make(uint8_t code);
-static void matrix_break(uint8_t code);
-
-
 /*
  * Matrix Array usage:
  * 'Scan Code Set 3' is assigned into 17x8 cell matrix.
@@ -46,10 +44,11 @@ static void matrix_break(uint8_t code);
  *  ;|         |
  * 17|         |
  *   +---------+
+ *
+ * The scan codes are decoded by the converter engine, which sends the key
+ * events right away, all the queued ones in each scan.
  */
-static uint8_t matrix[MATRIX_ROWS];
-#define ROW(code)      (code>>3)
-#define COL(code)      (code&0x07)
+static converter_t converter;
 
 
 __attribute__ ((weak))
@@ -66,7 +65,7 @@ void matrix_init(void)
     ps2_host_init();
 
     // initialize matrix state: all keys off
-    for (uint8_t i=0; i < MATRIX_ROWS; i++) matrix[i] = 0x00;
+    converter_init(&converter, &converter_ps2_set3, keyboard_key_event);
 
     matrix_init_user();
     return;
@@ -83,11 +82,10 @@ uint8_t matrix_scan(void)
         KBD_ID1,
         CONFIG,
         READY,
-        F0,
     } state = RESET;
 
-    uint8_t code;
-    if ((code = ps2_host_recv())) {
+    uint8_t code = 0;
+    if (state != READY && (code = ps2_host_recv())) {
         debug("r"); debug_hex(code); debug(" ");
     }
 
@@ -128,36 +126,7 @@ uint8_t matrix_scan(void)
             }
             break;
         case READY:
-            switch (code) {
-                case 0x00:
-                    break;
-                case 0xF0:
-                    state = F0;
-                    debug(" ");
-                    break;
-                default:    // normal key make
-                    if (code < 0x88) {
-                        matrix_make(code);
-                    } else {
-                        debug("unexpected scan code at READY: "); debug_hex(code); debug("\n");
-                    }
-                    state = READY;
-                    debug("\n");
-            }
-            break;
-        case F0:    // Break code
-            switch (code) {
-                case 0x00:
-                    break;
-                default:
-                    if (code < 0x88) {
-                        matrix_break(code);
-                    } else {
-                        debug("unexpected scan code at F0: "); debug_hex(code); debug("\n");
-                    }
-                    state = READY;
-                    debug("\n");
-            }
+            converter_task(&converter, ps2_host_recv2);
             break;
     }
     return 1;
@@ -166,23 +135,7 @@ uint8_t matrix_scan(void)
 inline
 uint8_t matrix_get_row(uint8_t row)
 {
-    return matrix[row];
-}
-
-inline
-static void matrix_make(uint8_t code)
-{
-    if (!matrix_is_on(ROW(code), COL(code))) {
-        matrix[ROW(code)] |= 1<<COL(code);
-    }
-}
-
-inline
-static void matrix_break(uint8_t code)
-{
-    if (matrix_is_on(ROW(code), COL(code))) {
-        matrix[ROW(code)] &= ~(1<<COL(code));
-    }
+    return converter_get_row(&converter, row);
 }
 
 bool matrix_is_on(uint8_t row, uint8_t col)
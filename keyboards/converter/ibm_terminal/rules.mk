@@ -63,6 +63,7 @@ UNICODEMAP_ENABLE = yes
 BLUETOOTH_ENABLE = no       # Enable Bluetooth with the Adafruit EZ-Key HID
 RGBLIGHT_ENABLE = no        # Enable WS2812 RGB underlight.  Do not enable this with audio at the same time.
 PS2_USE_USART = yes
+CONVERTER_ENGINE_ENABLE = yes
 API_SYSEX_ENABLE = n
 CUSTOM_MATRIX = yes
 
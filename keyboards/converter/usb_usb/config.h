@@ -40,7 +40,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define DIODE_DIRECTION CUSTOM_MATRIX
 
 /* key combination for command */
-#define IS_COMMAND() (keyboard_report->mods == (MOD_BIT(KC_LSHIFT) | MOD_BIT(KC_RSHIFT))) 
+#define IS_COMMAND() (keyboard_report->mods == (MOD_BIT(KC_LSHIFT) | MOD_BIT(KC_RSHIFT)))
+
+/* read the keyboards in report protocol, so that NKRO keyboards aren't
+ * limited to six keys, see report_keyboard.h */
+//#define USB_USB_REPORT_PROTOCOL
 
 /*
  * Feature disable options
@@ -24,6 +24,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "hid.h"
 #include "hidboot.h"
 #include "parser.h"
+#include "report_keyboard.h"
+#include "hid_kbd.h"
 
 #include "keycode.h"
 #include "util.h"
@@ -52,17 +54,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *   : |                |
  *   : |                |
  *  16 +----------------+
+ *
+ * Modifiers are codes 0xE0-0xE7, so hid_kbd_state_t is the matrix, two
+ * bytes per row.
  */
 #define ROW_MASK 0xF0
 #define COL_MASK 0x0F
 #define CODE(row, col)  (((row) << 4) | (col))
 #define ROW(code)       (((code) & ROW_MASK) >> 4)
 #define COL(code)       ((code) & COL_MASK)
-#define ROW_BITS(code)  (1 << COL(code))
 
 
 // Integrated key state of all keyboards
-static report_keyboard_t keyboard_report;
+static hid_kbd_state_t key_state;
 
 static bool matrix_is_mod = false;
 
@@ -73,10 +77,17 @@ static bool matrix_is_mod = false;
 USB usb_host;
 USBHub hub1(&usb_host);
 USBHub hub2(&usb_host);
+#ifdef USB_USB_REPORT_PROTOCOL
+HIDReportKeyboard kbd1(&usb_host);
+HIDReportKeyboard kbd2(&usb_host);
+HIDReportKeyboard kbd3(&usb_host);
+HIDReportKeyboard kbd4(&usb_host);
+#else
 HIDBoot<HID_PROTOCOL_KEYBOARD>    kbd1(&usb_host);
 HIDBoot<HID_PROTOCOL_KEYBOARD>    kbd2(&usb_host);
 HIDBoot<HID_PROTOCOL_KEYBOARD>    kbd3(&usb_host);
 HIDBoot<HID_PROTOCOL_KEYBOARD>    kbd4(&usb_host);
+#endif
 KBDReportParser kbd_parser1;
 KBDReportParser kbd_parser2;
 KBDReportParser kbd_parser3;
@@ -91,62 +102,25 @@ extern "C"
     void matrix_init(void) {
         // USB Host Shield setup
         usb_host.Init();
+#ifdef USB_USB_REPORT_PROTOCOL
+        kbd1.SetKeyboardParser(&kbd_parser1);
+        kbd2.SetKeyboardParser(&kbd_parser2);
+        kbd3.SetKeyboardParser(&kbd_parser3);
+        kbd4.SetKeyboardParser(&kbd_parser4);
+#else
         kbd1.SetReportParser(0, (HIDReportParser*)&kbd_parser1);
         kbd2.SetReportParser(0, (HIDReportParser*)&kbd_parser2);
         kbd3.SetReportParser(0, (HIDReportParser*)&kbd_parser3);
         kbd4.SetReportParser(0, (HIDReportParser*)&kbd_parser4);
+#endif
     }
 
-    static void or_report(report_keyboard_t report) {
-        // integrate reports into keyboard_report
-        keyboard_report.mods |= report.mods;
-        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-            if (IS_ANY(report.keys[i])) {
-                for (uint8_t j = 0; j < KEYBOARD_REPORT_KEYS; j++) {
-                    if (! keyboard_report.keys[j]) {
-                        keyboard_report.keys[j] = report.keys[i];
-                        break;
-                    }
-                }
-            }
-        }
+    static void key_event(uint8_t code, bool pressed) {
+        dprintf("key: %02X %s\n", code, pressed ? "down" : "up");
+        keyboard_key_event(ROW(code), COL(code), pressed);
     }
 
     uint8_t matrix_scan(void) {
-        static uint16_t last_time_stamp1 = 0;
-        static uint16_t last_time_stamp2 = 0;
-        static uint16_t last_time_stamp3 = 0;
-        static uint16_t last_time_stamp4 = 0;
-
-        // check report came from keyboards
-        if (kbd_parser1.time_stamp != last_time_stamp1 ||
-            kbd_parser2.time_stamp != last_time_stamp2 ||
-            kbd_parser3.time_stamp != last_time_stamp3 ||
-            kbd_parser4.time_stamp != last_time_stamp4) {
-
-            last_time_stamp1 = kbd_parser1.time_stamp;
-            last_time_stamp2 = kbd_parser2.time_stamp;
-            last_time_stamp3 = kbd_parser3.time_stamp;
-            last_time_stamp4 = kbd_parser4.time_stamp;
-
-            // clear and integrate all reports
-            keyboard_report = {};
-            or_report(kbd_parser1.report);
-            or_report(kbd_parser2.report);
-            or_report(kbd_parser3.report);
-            or_report(kbd_parser4.report);
-
-            matrix_is_mod = true;
-
-            dprintf("state:  %02X %02X", keyboard_report.mods, keyboard_report.reserved);
-            for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-                dprintf(" %02X", keyboard_report.keys[i]);
-            }
-            dprint("\r\n");
-        } else {
-            matrix_is_mod = false;
-        }
-
         uint16_t timer;
         timer = timer_read();
         usb_host.Task();
@@ -155,6 +129,16 @@ extern "C"
             dprintf("host.Task: %d\n", timer);
         }
 
+        // The reports that just came in are turned into key events right
+        // away, all of them in this scan, instead of leaving the changes for
+        // keyboard_task to find one per call.
+        hid_kbd_state_t state = {};
+        hid_kbd_merge(&state, &kbd_parser1.state);
+        hid_kbd_merge(&state, &kbd_parser2.state);
+        hid_kbd_merge(&state, &kbd_parser3.state);
+        hid_kbd_merge(&state, &kbd_parser4.state);
+        matrix_is_mod = hid_kbd_diff(&key_state, &state, key_event);
+
         static uint8_t usb_state = 0;
         if (usb_state != usb_host.getUsbTaskState()) {
             usb_state = usb_host.getUsbTaskState();
@@ -175,45 +159,18 @@ extern "C"
 
     bool matrix_is_on(uint8_t row, uint8_t col) {
         uint8_t code = CODE(row, col);
-
-        if (IS_MOD(code)) {
-            if (keyboard_report.mods & ROW_BITS(code)) {
-                return true;
-            }
-        }
-        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-            if (keyboard_report.keys[i] == code) {
-                return true;
-            }
-        }
-        return false;
+        return key_state.bits[code >> 3] & (1 << (code & 7));
     }
 
     matrix_row_t matrix_get_row(uint8_t row) {
-        uint16_t row_bits = 0;
-
-        if (IS_MOD(CODE(row, 0)) && keyboard_report.mods) {
-            row_bits |= keyboard_report.mods;
-        }
-
-        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-            if (IS_ANY(keyboard_report.keys[i])) {
-                if (row == ROW(keyboard_report.keys[i])) {
-                    row_bits |= ROW_BITS(keyboard_report.keys[i]);
-                }
-            }
-        }
-        return row_bits;
+        return key_state.bits[row * 2] | (key_state.bits[row * 2 + 1] << 8);
     }
 
     uint8_t matrix_key_count(void) {
         uint8_t count = 0;
 
-        count += bitpop(keyboard_report.mods);
-        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-            if (IS_ANY(keyboard_report.keys[i])) {
-                count++;
-            }
+        for (uint8_t i = 0; i < sizeof(key_state.bits); i++) {
+            count += bitpop(key_state.bits[i]);
         }
         return count;
     }
@@ -26,8 +26,10 @@
 #include "wait.h"
 
 #include "eeconfig.h"
+#include "audio_engine.h"
 
-#define CPU_PRESCALER 8
+// More than ten octaves below 55 Hz, so never a note
+#define NO_PITCH INT16_MIN
 
 // -----------------------------------------------------------------------------
 // Timer Abstractions
@@ -76,28 +78,37 @@
 
 int voices = 0;
 int voice_place = 0;
-float frequency = 0;
-float frequency_alt = 0;
+int16_t current_pitch = NO_PITCH;
+int16_t current_pitch_alt = NO_PITCH;
 int volume = 0;
 long position = 0;
 
 float frequencies[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+int16_t pitches[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 int volumes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 bool sliding = false;
 
-float place = 0;
+uint32_t place = 0;
 
 uint8_t * sample;
 uint16_t sample_length = 0;
 
 bool     playing_notes = false;
 bool     playing_note = false;
-float    note_frequency = 0;
-float    note_length = 0;
+int16_t  note_pitch = NO_PITCH;
+uint32_t note_ticks = 0;
+uint32_t note_elapsed = 0;
+uint16_t note_periods = 0;
 uint8_t  note_tempo = TEMPO_DEFAULT;
-float    note_timbre = TIMBRE_DEFAULT;
+uint8_t  note_timbre = AUDIO_TIMBRE(TIMBRE_DEFAULT);
 uint16_t note_position = 0;
 float (* notes_pointer)[][2];
+// Compact songs are read in the interrupt, and need no floats
+bool     notes_compact = false;
+audio_song_t compact_song;
+audio_song_note_t compact_note;
+audio_song_note_t compact_next;
+uint32_t compact_tick_length;
 uint16_t notes_count;
 bool     notes_repeat;
 bool     note_resting = false;
@@ -106,12 +117,22 @@ uint8_t current_note = 0;
 uint8_t rest_counter = 0;
 
 #ifdef VIBRATO_ENABLE
-float vibrato_counter = 0;
 float vibrato_strength = .5;
 float vibrato_rate = 0.125;
+audio_vibrato_t vibrato = {
+    .position = 0,
+    .rate = 0.125 * 256,
+    #ifdef VIBRATO_STRENGTH_ENABLE
+    .strength = .5 * 64,
+    #else
+    .strength = 64,
+    #endif
+};
 #endif
 
 float polyphony_rate = 0;
+// How long each voice plays before the next one, in timer ticks
+uint32_t polyphony_ticks = 0;
 
 static bool audio_initialized = false;
 
@@ -215,13 +236,14 @@ void stop_all_notes()
 
     playing_notes = false;
     playing_note = false;
-    frequency = 0;
-    frequency_alt = 0;
+    current_pitch = NO_PITCH;
+    current_pitch_alt = NO_PITCH;
     volume = 0;
 
     for (uint8_t i = 0; i < 8; i++)
     {
         frequencies[i] = 0;
+        pitches[i] = 0;
         volumes[i] = 0;
     }
 }
@@ -237,10 +259,13 @@ void stop_note(float freq)
         for (int i = 7; i >= 0; i--) {
             if (frequencies[i] == freq) {
                 frequencies[i] = 0;
+                pitches[i] = 0;
                 volumes[i] = 0;
                 for (int j = i; (j < 7); j++) {
                     frequencies[j] = frequencies[j+1];
                     frequencies[j+1] = 0;
+                    pitches[j] = pitches[j+1];
+                    pitches[j+1] = 0;
                     volumes[j] = volumes[j+1];
                     volumes[j+1] = 0;
                 }
@@ -262,206 +287,218 @@ void stop_note(float freq)
                 DISABLE_AUDIO_COUNTER_1_ISR;
                 DISABLE_AUDIO_COUNTER_1_OUTPUT;
             #endif
-            frequency = 0;
-            frequency_alt = 0;
+            current_pitch = NO_PITCH;
+            current_pitch_alt = NO_PITCH;
             volume = 0;
             playing_note = false;
         }
     }
 }
 
-#ifdef VIBRATO_ENABLE
+// The interrupts only use integers, floats are converted when a note
+// starts, see audio_engine.h
 
-float mod(float a, int b)
+static int16_t frequency_to_pitch(float freq)
 {
-    float r = fmod(a, b);
-    return r < 0 ? r + b : r;
+    float period = ((float)AUDIO_TIMER_HZ) / freq;
+    if (period > AUDIO_MAX_PERIOD) {
+        period = AUDIO_MAX_PERIOD;
+    }
+    return audio_period_to_pitch(period);
 }
 
-float vibrato(float average_freq) {
-    #ifdef VIBRATO_STRENGTH_ENABLE
-        float vibrated_freq = average_freq * pow(vibrato_lut[(int)vibrato_counter], vibrato_strength);
-    #else
-        float vibrated_freq = average_freq * vibrato_lut[(int)vibrato_counter];
+static void set_note_pitch(int16_t pitch, uint32_t ticks, uint16_t periods)
+{
+    note_pitch = pitch;
+    note_ticks = ticks;
+    note_periods = periods;
+    note_elapsed = 0;
+}
+
+static void set_note(float freq, float length)
+{
+    uint16_t periods = length;
+    if (periods < length) {
+        periods++;
+    }
+    set_note_pitch((freq > 0) ? frequency_to_pitch(freq) : NO_PITCH, length * 0xFFFF, periods);
+}
+
+static void set_compact_note(void)
+{
+    uint16_t tempo_duration = compact_note.duration * note_tempo;
+    set_note_pitch(
+        (compact_note.note == AUDIO_SONG_REST) ? NO_PITCH : audio_note_to_pitch(compact_note.note),
+        compact_note.duration * compact_tick_length,
+        (tempo_duration + 399) / 400);
+}
+
+static inline int16_t glide_to(int16_t pitch, int16_t target, uint16_t period)
+{
+    if (glissando && pitch != NO_PITCH) {
+        return audio_glide(pitch, target, period);
+    }
+    return target;
+}
+
+static inline int16_t vibrato_pitch(int16_t pitch, uint16_t period)
+{
+    #ifdef VIBRATO_ENABLE
+        if (vibrato.strength > 0) {
+            return pitch + audio_vibrato(&vibrato, period);
+        }
     #endif
-    vibrato_counter = mod((vibrato_counter + vibrato_rate * (1.0 + 440.0/average_freq)), VIBRATO_LUT_LENGTH);
-    return vibrated_freq;
+    return pitch;
 }
 
-#endif
+static inline uint16_t envelope_period(int16_t pitch)
+{
+    if (envelope_index < 65535) {
+        envelope_index++;
+    }
+    return audio_pitch_to_period(voice_envelope(pitch));
+}
+
+static inline void next_polyphony_voice(uint16_t period)
+{
+    if (voices > 1) {
+        voice_place %= voices;
+        place += period;
+        if (place > polyphony_ticks) {
+            voice_place = (voice_place + 1) % voices;
+            place = 0;
+        }
+    }
+}
+
+static inline bool end_of_note(uint16_t period)
+{
+    note_position++;
+    if (period > 0 && !note_resting) {
+        note_elapsed += period;
+        return note_elapsed + period >= note_ticks;
+    }
+    return note_position >= note_periods;
+}
+
+// Returns false at the end of a song that doesn't repeat
+static bool next_compact_note(void)
+{
+    if (!note_resting) {
+        if (!audio_song_next(&compact_song, &compact_next)) {
+            if (!notes_repeat) {
+                return false;
+            }
+            audio_song_start(&compact_song, compact_song.data, compact_song.size);
+            if (!audio_song_next(&compact_song, &compact_next)) {
+                return false;
+            }
+        }
+        note_resting = true;
+        if (compact_note.note == compact_next.note) {
+            set_note_pitch(NO_PITCH, 0xFFFF, 1);
+        } else {
+            set_note_pitch(note_pitch, 0xFFFF, 1);
+        }
+    } else {
+        note_resting = false;
+        envelope_index = 0;
+        compact_note = compact_next;
+        set_compact_note();
+    }
+
+    note_position = 0;
+    return true;
+}
+
+static bool next_note(void)
+{
+    if (notes_compact) {
+        return next_compact_note();
+    }
+
+    current_note++;
+    if (current_note >= notes_count) {
+        if (notes_repeat) {
+            current_note = 0;
+        } else {
+            return false;
+        }
+    }
+
+    if (!note_resting) {
+        note_resting = true;
+        current_note--;
+        if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
+            set_note(0, 1);
+        } else {
+            set_note((*notes_pointer)[current_note][0], 1);
+        }
+    } else {
+        note_resting = false;
+        envelope_index = 0;
+        set_note((*notes_pointer)[current_note][0], ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100));
+    }
+
+    note_position = 0;
+    return true;
+}
 
 #ifdef C6_AUDIO
 ISR(TIMER3_COMPA_vect)
 {
-    float freq;
+    int16_t pitch;
+    uint16_t period;
 
     if (playing_note) {
         if (voices > 0) {
 
             #ifdef B5_AUDIO
-            float freq_alt = 0;
                 if (voices > 1) {
-                    if (polyphony_rate == 0) {
-                        if (glissando) {
-                            if (frequency_alt != 0 && frequency_alt < frequencies[voices - 2] && frequency_alt < frequencies[voices - 2] * pow(2, -440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, 440/frequency_alt/12/2);
-                            } else if (frequency_alt != 0 && frequency_alt > frequencies[voices - 2] && frequency_alt > frequencies[voices - 2] * pow(2, 440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, -440/frequency_alt/12/2);
-                            } else {
-                                frequency_alt = frequencies[voices - 2];
-                            }
-                        } else {
-                            frequency_alt = frequencies[voices - 2];
-                        }
-
-                        #ifdef VIBRATO_ENABLE
-                            if (vibrato_strength > 0) {
-                                freq_alt = vibrato(frequency_alt);
-                            } else {
-                                freq_alt = frequency_alt;
-                            }
-                        #else
-                            freq_alt = frequency_alt;
-                        #endif
-                    }
-
-                    if (envelope_index < 65535) {
+                    if (polyphony_ticks == 0) {
+                        current_pitch_alt = glide_to(current_pitch_alt, pitches[voices - 2], TIMER_1_PERIOD);
+                        pitch = vibrato_pitch(current_pitch_alt, TIMER_1_PERIOD);
+
+                        period = envelope_period(pitch);
+                        TIMER_1_PERIOD = period;
+                        TIMER_1_DUTY_CYCLE = audio_duty_cycle(period, note_timbre);
+                    } else if (envelope_index < 65535) {
                         envelope_index++;
                     }
-
-                    freq_alt = voice_envelope(freq_alt);
-
-                    if (freq_alt < 30.517578125) {
-                        freq_alt = 30.52;
-                    }
-
-                    TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq_alt * CPU_PRESCALER));
-                    TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq_alt * CPU_PRESCALER)) * note_timbre);
                 }
             #endif
 
-            if (polyphony_rate > 0) {
-                if (voices > 1) {
-                    voice_place %= voices;
-                    if (place++ > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
-                        voice_place = (voice_place + 1) % voices;
-                        place = 0.0;
-                    }
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequencies[voice_place]);
-                    } else {
-                        freq = frequencies[voice_place];
-                    }
-                #else
-                    freq = frequencies[voice_place];
-                #endif
+            if (polyphony_ticks > 0) {
+                next_polyphony_voice(TIMER_3_PERIOD);
+                pitch = vibrato_pitch(pitches[voice_place], TIMER_3_PERIOD);
             } else {
-                if (glissando) {
-                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, 440/frequency/12/2);
-                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, -440/frequency/12/2);
-                    } else {
-                        frequency = frequencies[voices - 1];
-                    }
-                } else {
-                    frequency = frequencies[voices - 1];
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequency);
-                    } else {
-                        freq = frequency;
-                    }
-                #else
-                    freq = frequency;
-                #endif
-            }
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-
-            freq = voice_envelope(freq);
-
-            if (freq < 30.517578125) {
-                freq = 30.52;
+                current_pitch = glide_to(current_pitch, pitches[voices - 1], TIMER_3_PERIOD);
+                pitch = vibrato_pitch(current_pitch, TIMER_3_PERIOD);
             }
 
-            TIMER_3_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_3_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+            period = envelope_period(pitch);
+            TIMER_3_PERIOD = period;
+            TIMER_3_DUTY_CYCLE = audio_duty_cycle(period, note_timbre);
         }
     }
 
     if (playing_notes) {
-        if (note_frequency > 0) {
-            #ifdef VIBRATO_ENABLE
-                if (vibrato_strength > 0) {
-                    freq = vibrato(note_frequency);
-                } else {
-                    freq = note_frequency;
-                }
-            #else
-                    freq = note_frequency;
-            #endif
+        if (note_pitch != NO_PITCH) {
+            pitch = vibrato_pitch(note_pitch, TIMER_3_PERIOD);
 
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-            freq = voice_envelope(freq);
-
-            TIMER_3_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_3_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+            period = envelope_period(pitch);
+            TIMER_3_PERIOD = period;
+            TIMER_3_DUTY_CYCLE = audio_duty_cycle(period, note_timbre);
         } else {
             TIMER_3_PERIOD = 0;
             TIMER_3_DUTY_CYCLE = 0;
         }
 
-        note_position++;
-        bool end_of_note = false;
-        if (TIMER_3_PERIOD > 0) {
-            if (!note_resting) 
-                end_of_note = (note_position >= (note_length / TIMER_3_PERIOD * 0xFFFF - 1));
-            else
-                end_of_note = (note_position >= (note_length));
-        } else {
-            end_of_note = (note_position >= (note_length));
-        }
-
-        if (end_of_note) {
-            current_note++;
-            if (current_note >= notes_count) {
-                if (notes_repeat) {
-                    current_note = 0;
-                } else {
-                    DISABLE_AUDIO_COUNTER_3_ISR;
-                    DISABLE_AUDIO_COUNTER_3_OUTPUT;
-                    playing_notes = false;
-                    return;
-                }
-            }
-            if (!note_resting) {
-                note_resting = true;
-                current_note--;
-                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
-                    note_frequency = 0;
-                    note_length = 1;
-                } else {
-                    note_frequency = (*notes_pointer)[current_note][0];
-                    note_length = 1;
-                }
-            } else {
-                note_resting = false;
-                envelope_index = 0;
-                note_frequency = (*notes_pointer)[current_note][0];
-                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-            }
-
-            note_position = 0;
+        if (end_of_note(TIMER_3_PERIOD) && !next_note()) {
+            DISABLE_AUDIO_COUNTER_3_ISR;
+            DISABLE_AUDIO_COUNTER_3_OUTPUT;
+            playing_notes = false;
+            return;
         }
     }
 
@@ -476,132 +513,42 @@ ISR(TIMER3_COMPA_vect)
 ISR(TIMER1_COMPA_vect)
 {
     #if defined(B5_AUDIO) && !defined(C6_AUDIO)
-    float freq = 0;
+    int16_t pitch;
+    uint16_t period;
 
     if (playing_note) {
         if (voices > 0) {
-            if (polyphony_rate > 0) {
-                if (voices > 1) {
-                    voice_place %= voices;
-                    if (place++ > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
-                        voice_place = (voice_place + 1) % voices;
-                        place = 0.0;
-                    }
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequencies[voice_place]);
-                    } else {
-                        freq = frequencies[voice_place];
-                    }
-                #else
-                    freq = frequencies[voice_place];
-                #endif
+            if (polyphony_ticks > 0) {
+                next_polyphony_voice(TIMER_1_PERIOD);
+                pitch = vibrato_pitch(pitches[voice_place], TIMER_1_PERIOD);
             } else {
-                if (glissando) {
-                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, 440/frequency/12/2);
-                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, -440/frequency/12/2);
-                    } else {
-                        frequency = frequencies[voices - 1];
-                    }
-                } else {
-                    frequency = frequencies[voices - 1];
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequency);
-                    } else {
-                        freq = frequency;
-                    }
-                #else
-                    freq = frequency;
-                #endif
+                current_pitch = glide_to(current_pitch, pitches[voices - 1], TIMER_1_PERIOD);
+                pitch = vibrato_pitch(current_pitch, TIMER_1_PERIOD);
             }
 
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-
-            freq = voice_envelope(freq);
-
-            if (freq < 30.517578125) {
-                freq = 30.52;
-            }
-
-            TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+            period = envelope_period(pitch);
+            TIMER_1_PERIOD = period;
+            TIMER_1_DUTY_CYCLE = audio_duty_cycle(period, note_timbre);
         }
     }
 
     if (playing_notes) {
-        if (note_frequency > 0) {
-            #ifdef VIBRATO_ENABLE
-                if (vibrato_strength > 0) {
-                    freq = vibrato(note_frequency);
-                } else {
-                    freq = note_frequency;
-                }
-            #else
-                    freq = note_frequency;
-            #endif
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-            freq = voice_envelope(freq);
+        if (note_pitch != NO_PITCH) {
+            pitch = vibrato_pitch(note_pitch, TIMER_1_PERIOD);
 
-            TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+            period = envelope_period(pitch);
+            TIMER_1_PERIOD = period;
+            TIMER_1_DUTY_CYCLE = audio_duty_cycle(period, note_timbre);
         } else {
             TIMER_1_PERIOD = 0;
             TIMER_1_DUTY_CYCLE = 0;
         }
 
-        note_position++;
-        bool end_of_note = false;
-        if (TIMER_1_PERIOD > 0) {
-            if (!note_resting) 
-                end_of_note = (note_position >= (note_length / TIMER_1_PERIOD * 0xFFFF - 1));
-            else
-                end_of_note = (note_position >= (note_length));
-        } else {
-            end_of_note = (note_position >= (note_length));
-        }
-
-        if (end_of_note) {
-            current_note++;
-            if (current_note >= notes_count) {
-                if (notes_repeat) {
-                    current_note = 0;
-                } else {
-                    DISABLE_AUDIO_COUNTER_1_ISR;
-                    DISABLE_AUDIO_COUNTER_1_OUTPUT;
-                    playing_notes = false;
-                    return;
-                }
-            }
-            if (!note_resting) {
-                note_resting = true;
-                current_note--;
-                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
-                    note_frequency = 0;
-                    note_length = 1;
-                } else {
-                    note_frequency = (*notes_pointer)[current_note][0];
-                    note_length = 1;
-                }
-            } else {
-                note_resting = false;
-                envelope_index = 0;
-                note_frequency = (*notes_pointer)[current_note][0];
-                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-            }
-
-            note_position = 0;
+        if (end_of_note(TIMER_1_PERIOD) && !next_note()) {
+            DISABLE_AUDIO_COUNTER_1_ISR;
+            DISABLE_AUDIO_COUNTER_1_OUTPUT;
+            playing_notes = false;
+            return;
         }
     }
 
@@ -639,6 +586,7 @@ void play_note(float freq, int vol) {
 
         if (freq > 0) {
             frequencies[voices] = freq;
+            pitches[voices] = frequency_to_pitch(freq);
             volumes[voices] = vol;
             voices++;
         }
@@ -684,6 +632,7 @@ void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat)
 
         playing_notes = true;
 
+        notes_compact = false;
         notes_pointer = np;
         notes_count = n_count;
         notes_repeat = n_repeat;
@@ -691,8 +640,61 @@ void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat)
         place = 0;
         current_note = 0;
 
-        note_frequency = (*notes_pointer)[current_note][0];
-        note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
+        set_note((*notes_pointer)[current_note][0], ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100));
+        note_position = 0;
+
+
+        #ifdef C6_AUDIO
+            ENABLE_AUDIO_COUNTER_3_ISR;
+            ENABLE_AUDIO_COUNTER_3_OUTPUT;
+        #endif
+        #ifdef B5_AUDIO
+            #ifndef C6_AUDIO
+            ENABLE_AUDIO_COUNTER_1_ISR;
+            ENABLE_AUDIO_COUNTER_1_OUTPUT;
+            #endif
+        #endif
+    }
+
+}
+
+void play_compact_notes(const uint8_t *song, uint16_t size, bool repeat)
+{
+
+    if (!audio_initialized) {
+        audio_init();
+    }
+
+    if (audio_config.enable) {
+
+        #ifdef C6_AUDIO
+            DISABLE_AUDIO_COUNTER_3_ISR;
+        #endif
+        #ifdef B5_AUDIO
+            DISABLE_AUDIO_COUNTER_1_ISR;
+        #endif
+
+        // Cancel note if a note is playing
+        if (playing_note)
+            stop_all_notes();
+
+        audio_song_start(&compact_song, song, size);
+        if (!audio_song_next(&compact_song, &compact_note)) {
+            playing_notes = false;
+            return;
+        }
+
+        playing_notes = true;
+
+        notes_compact = true;
+        notes_repeat = repeat;
+        note_resting = false;
+
+        place = 0;
+
+        // The tempo is only converted once for the whole song
+        compact_tick_length = audio_song_tick_length(note_tempo);
+        set_compact_note();
         note_position = 0;
 
 
@@ -746,28 +748,30 @@ void audio_off(void) {
 
 void set_vibrato_rate(float rate) {
     vibrato_rate = rate;
+    vibrato.rate = rate * 256;
 }
 
 void increase_vibrato_rate(float change) {
-    vibrato_rate *= change;
+    set_vibrato_rate(vibrato_rate * change);
 }
 
 void decrease_vibrato_rate(float change) {
-    vibrato_rate /= change;
+    set_vibrato_rate(vibrato_rate / change);
 }
 
 #ifdef VIBRATO_STRENGTH_ENABLE
 
 void set_vibrato_strength(float strength) {
     vibrato_strength = strength;
+    vibrato.strength = (strength >= 255.0 / 64) ? 255 : strength * 64;
 }
 
 void increase_vibrato_strength(float change) {
-    vibrato_strength *= change;
+    set_vibrato_strength(vibrato_strength * change);
 }
 
 void decrease_vibrato_strength(float change) {
-    vibrato_strength /= change;
+    set_vibrato_strength(vibrato_strength / change);
 }
 
 #endif  /* VIBRATO_STRENGTH_ENABLE */
@@ -778,28 +782,33 @@ void decrease_vibrato_strength(float change) {
 
 void set_polyphony_rate(float rate) {
     polyphony_rate = rate;
+    if (rate > 0) {
+        polyphony_ticks = ((float)AUDIO_TIMER_HZ) / (rate * AUDIO_CPU_PRESCALER);
+    } else {
+        polyphony_ticks = 0;
+    }
 }
 
 void enable_polyphony() {
-    polyphony_rate = 5;
+    set_polyphony_rate(5);
 }
 
 void disable_polyphony() {
-    polyphony_rate = 0;
+    set_polyphony_rate(0);
 }
 
 void increase_polyphony_rate(float change) {
-    polyphony_rate *= change;
+    set_polyphony_rate(polyphony_rate * change);
 }
 
 void decrease_polyphony_rate(float change) {
-    polyphony_rate /= change;
+    set_polyphony_rate(polyphony_rate / change);
 }
 
 // Timbre function
 
 void set_timbre(float timbre) {
-    note_timbre = timbre;
+    note_timbre = AUDIO_TIMBRE(timbre);
 }
 
 // Tempo functions
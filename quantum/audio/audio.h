@@ -87,6 +87,8 @@ void play_note(float freq, int vol);
 void stop_note(float freq);
 void stop_all_notes(void);
 void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat);
+// Plays a compact song from PROGMEM, see audio_engine.h
+void play_compact_notes(const uint8_t *song, uint16_t size, bool repeat);
 
 #define SCALE (int8_t []){ 0 + (12*0), 2 + (12*0), 4 + (12*0), 5 + (12*0), 7 + (12*0), 9 + (12*0), 11 + (12*0), \
                            0 + (12*1), 2 + (12*1), 4 + (12*1), 5 + (12*1), 7 + (12*1), 9 + (12*1), 11 + (12*1), \
@@ -102,6 +104,8 @@ void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat);
 	_Pragma ("message \"'PLAY_NOTE_ARRAY' macro is deprecated\"")
 #define PLAY_SONG(note_array) play_notes(&note_array, NOTE_ARRAY_SIZE((note_array)), false)
 #define PLAY_LOOP(note_array) play_notes(&note_array, NOTE_ARRAY_SIZE((note_array)), true)
+#define PLAY_COMPACT_SONG(song) play_compact_notes(song, sizeof(song), false)
+#define PLAY_COMPACT_LOOP(song) play_compact_notes(song, sizeof(song), true)
 
 bool is_playing_notes(void);
 
@@ -0,0 +1,178 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "audio_engine.h"
+#include "luts.h"
+
+#define LUT_TIMER_HZ 2000000UL
+#define LUT_LAST (FREQUENCY_LUT_LENGTH - 1)
+#define LUT_OCTAVE 48
+
+// Converts between the periods of frequency_lut and the timer
+#if AUDIO_TIMER_HZ == LUT_TIMER_HZ
+#   define FROM_LUT(p) (p)
+#   define TO_LUT(p) (p)
+#elif AUDIO_TIMER_HZ == LUT_TIMER_HZ / 2
+#   define FROM_LUT(p) ((p) >> 1)
+#   define TO_LUT(p) ((p) << 1)
+#else
+#   define FROM_LUT(p) ((uint32_t)(p) * (AUDIO_TIMER_HZ / 1000) / (LUT_TIMER_HZ / 1000))
+#   define TO_LUT(p) ((uint32_t)(p) * (LUT_TIMER_HZ / 1000) / (AUDIO_TIMER_HZ / 1000))
+#endif
+
+// Constants of the form x / f, as multipliers of the period in 1/2^shift
+#define PERIOD_FACTOR(x, shift) ((uint32_t)(((uint64_t)(x) << (shift)) / AUDIO_TIMER_HZ))
+
+// 220 semitones, in pitch steps
+#define GLIDE_FACTOR PERIOD_FACTOR(220UL * AUDIO_PITCH_SEMITONE, 16)
+// 440 Hz, the vibrato goes 440/f faster than its rate
+#define VIBRATO_FACTOR PERIOD_FACTOR(440, 20)
+// 880 Hz, with 8 fractional bits
+#define ENVELOPE_FACTOR PERIOD_FACTOR(880UL * 256, 16)
+
+static uint16_t lut(uint16_t index) {
+    return pgm_read_word(&frequency_lut[index]);
+}
+
+uint16_t audio_pitch_to_period(int16_t pitch) {
+    int8_t octaves = 0;
+
+    // Outside of the table, an octave is half or twice the period
+    while (pitch < 0) {
+        pitch += AUDIO_PITCH_OCTAVE;
+        octaves--;
+    }
+    while (pitch >= LUT_LAST * AUDIO_PITCH_FRACTION) {
+        pitch -= AUDIO_PITCH_OCTAVE;
+        octaves++;
+    }
+
+    uint16_t index = pitch / AUDIO_PITCH_FRACTION;
+    uint8_t fraction = pitch % AUDIO_PITCH_FRACTION;
+    uint16_t a = lut(index);
+    uint16_t b = lut(index + 1);
+    uint32_t period = a - (((uint32_t)(a - b) * fraction) / AUDIO_PITCH_FRACTION);
+
+    period = FROM_LUT(period);
+    if (octaves < 0) {
+        period <<= -octaves;
+        if (period > AUDIO_MAX_PERIOD) {
+            period = AUDIO_MAX_PERIOD;
+        }
+    } else {
+        period >>= octaves;
+    }
+    return period ? period : 1;
+}
+
+int16_t audio_period_to_pitch(uint16_t period) {
+    uint32_t p = TO_LUT(period);
+    int16_t pitch = 0;
+
+    if (p == 0) {
+        p = 1;
+    }
+    while (p > lut(0)) {
+        p >>= 1;
+        pitch -= AUDIO_PITCH_OCTAVE;
+    }
+    // The first octave has the longest periods, so the most precision
+    while (p < lut(LUT_OCTAVE)) {
+        p <<= 1;
+        pitch += AUDIO_PITCH_OCTAVE;
+    }
+
+    // The periods go down, find the last entry that is still >= p
+    uint16_t lo = 0;
+    uint16_t hi = LUT_OCTAVE;
+    while (hi - lo > 1) {
+        uint16_t mid = (lo + hi) / 2;
+        if (lut(mid) >= p) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    uint16_t a = lut(lo);
+    uint16_t b = lut(lo + 1);
+    uint8_t fraction = ((a - p) * AUDIO_PITCH_FRACTION + (a - b) / 2) / (a - b);
+    return pitch + lo * AUDIO_PITCH_FRACTION + fraction;
+}
+
+int16_t audio_glide(int16_t pitch, int16_t target, uint16_t period) {
+    int16_t step = ((uint32_t)period * GLIDE_FACTOR) >> 16;
+    if (step == 0) {
+        step = 1;
+    }
+    if (pitch < target - step) {
+        return pitch + step;
+    }
+    if (pitch > target + step) {
+        return pitch - step;
+    }
+    return target;
+}
+
+int16_t audio_vibrato(audio_vibrato_t *vibrato, uint16_t period) {
+    int8_t offset = pgm_read_byte(&vibrato_pitch_lut[vibrato->position >> 8]);
+
+    uint32_t faster = ((((uint32_t)vibrato->rate * period) >> 4) * VIBRATO_FACTOR) >> 16;
+    uint32_t position = vibrato->position + vibrato->rate + faster;
+    while (position >= VIBRATO_LUT_LENGTH * 256) {
+        position -= VIBRATO_LUT_LENGTH * 256;
+    }
+    vibrato->position = position;
+
+    return (offset * vibrato->strength) / 64;
+}
+
+uint16_t audio_compensated_index(uint16_t envelope_index, uint16_t period) {
+    uint32_t ratio = ((uint32_t)period * ENVELOPE_FACTOR) >> 16;
+    uint32_t index = ((uint32_t)envelope_index * ratio) >> 8;
+    return index > 0xFFFF ? 0xFFFF : index;
+}
+
+void audio_song_start(audio_song_t *song, const uint8_t *data, uint16_t size) {
+    song->data = data;
+    song->size = size;
+    song->position = 0;
+    song->repeats = 0;
+}
+
+bool audio_song_next(audio_song_t *song, audio_song_note_t *note) {
+    while (song->repeats == 0) {
+        if (song->position + 2 > song->size) {
+            return false;
+        }
+        uint8_t first = pgm_read_byte(&song->data[song->position]);
+        uint8_t second = pgm_read_byte(&song->data[song->position + 1]);
+        song->position += 2;
+        if (first != AUDIO_SONG_REPEAT) {
+            song->last.note = first;
+            song->last.duration = second;
+            *note = song->last;
+            return true;
+        }
+        // A repeat at the start has nothing to repeat
+        if (song->position > 2) {
+            song->repeats = second;
+        }
+    }
+    song->repeats--;
+    *note = song->last;
+    return true;
+}
@@ -0,0 +1,117 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef AUDIO_ENGINE_H
+#define AUDIO_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Integer math for the audio interrupts, which run once per period of the
+// note being played. A note is kept as a pitch, on the logarithmic scale
+// of frequency_lut, so glissando and vibrato are additions, and a pitch
+// becomes a timer period with one table lookup.
+
+#define AUDIO_CPU_PRESCALER 8
+#define AUDIO_TIMER_HZ (F_CPU / AUDIO_CPU_PRESCALER)
+
+// The longest period of the 16 bit timers, about 30.5 Hz at 16 MHz
+#define AUDIO_MAX_PERIOD 0xFFFF
+
+// Pitches are in 1/64 of the quarter semitone steps of frequency_lut, and
+// 0 is its first entry, 55 Hz
+#define AUDIO_PITCH_FRACTION 64
+#define AUDIO_PITCH_SEMITONE (4 * AUDIO_PITCH_FRACTION)
+#define AUDIO_PITCH_OCTAVE (12 * AUDIO_PITCH_SEMITONE)
+
+// Timbres (duty cycles) are in 1/256
+#define AUDIO_TIMBRE(t) ((t) >= 1 ? 255 : (uint8_t)((t) * 256))
+
+uint16_t audio_pitch_to_period(int16_t pitch);
+
+// Only for new notes, it does a division and a binary search
+int16_t audio_period_to_pitch(uint16_t period);
+
+// Moves pitch one period's step towards target. The step is the one of
+// the floating point glissando, 220/f semitones, which is about 220
+// semitones a second at any frequency.
+int16_t audio_glide(int16_t pitch, int16_t target, uint16_t period);
+
+typedef struct {
+    // in 1/256 of a vibrato_lut entry
+    uint16_t position;
+    // position change per period at low frequencies, in 1/256 of an entry
+    uint16_t rate;
+    // in 1/64, 64 is the depth of vibrato_lut
+    uint8_t strength;
+} audio_vibrato_t;
+
+// Returns the pitch offset of the vibrato, and moves it on by one period
+int16_t audio_vibrato(audio_vibrato_t *vibrato, uint16_t period);
+
+// The envelope index of the voices, scaled to 880 Hz like the envelopes
+// of the voices expect, envelope_index * 880 / f
+uint16_t audio_compensated_index(uint16_t envelope_index, uint16_t period);
+
+static inline uint16_t audio_duty_cycle(uint16_t period, uint8_t timbre) {
+    return ((uint32_t)period * timbre) >> 8;
+}
+
+// Compact songs are pairs of bytes in PROGMEM, a MIDI note number (or
+// AUDIO_SONG_REST) and a duration, in the units of the float songs, so 64
+// is a whole note. AUDIO_SONG_REPEAT, n plays the previous pair n more
+// times. util/song_compiler.c turns float songs into this.
+#define AUDIO_SONG_REST 0x80
+#define AUDIO_SONG_REPEAT 0x81
+
+typedef struct {
+    uint8_t note;
+    uint8_t duration;
+} audio_song_note_t;
+
+typedef struct {
+    const uint8_t *data;
+    uint16_t size;
+    uint16_t position;
+    audio_song_note_t last;
+    uint8_t repeats;
+} audio_song_t;
+
+void audio_song_start(audio_song_t *song, const uint8_t *data, uint16_t size);
+// Returns false at the end of the song
+bool audio_song_next(audio_song_t *song, audio_song_note_t *note);
+
+// MIDI note 33 is A1, 55 Hz
+static inline int16_t audio_note_to_pitch(uint8_t note) {
+    return ((int16_t)note - 33) * AUDIO_PITCH_SEMITONE;
+}
+
+// The timer ticks of one duration unit, the float songs are
+// (duration / 4) * (tempo / 100) * 0xFFFF ticks long
+static inline uint32_t audio_song_tick_length(uint8_t tempo) {
+    return (uint32_t)0xFFFF * tempo / 400;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AUDIO_ENGINE_H */
@@ -86,7 +86,7 @@ bool     playing_note = false;
 float    note_frequency = 0;
 float    note_length = 0;
 uint8_t  note_tempo = TEMPO_DEFAULT;
-float    note_timbre = TIMBRE_DEFAULT;
+uint8_t  note_timbre = AUDIO_TIMBRE(TIMBRE_DEFAULT);
 uint16_t note_position = 0;
 float (* notes_pointer)[][2];
 uint16_t notes_count;
@@ -104,6 +104,8 @@ float vibrato_rate = 0.125;
 #endif
 
 float polyphony_rate = 0;
+// Only set by the voices, this player uses polyphony_rate
+uint32_t polyphony_ticks = 0;
 
 static bool audio_initialized = false;
 
@@ -246,6 +248,17 @@ float vibrato(float average_freq) {
 
 #endif
 
+// The voices work on pitches, see audio_engine.h
+static float envelope_frequency(float freq)
+{
+    float period = ((float)F_CPU) / (freq * CPU_PRESCALER);
+    if (period > AUDIO_MAX_PERIOD) {
+        period = AUDIO_MAX_PERIOD;
+    }
+    int16_t pitch = voice_envelope(audio_period_to_pitch(period));
+    return ((float)F_CPU) / (audio_pitch_to_period(pitch) * CPU_PRESCALER);
+}
+
 ISR(TIMER3_COMPA_vect)
 {
     if (playing_note) {
@@ -340,12 +353,12 @@ ISR(TIMER3_COMPA_vect)
                 if (envelope_index < 65535) {
                     envelope_index++;
                 }
-                freq = voice_envelope(freq);
+                freq = envelope_frequency(freq);
 
                 if (freq < 30.517578125)
                     freq = 30.52;
                 NOTE_PERIOD = (int)(((double)F_CPU) / (freq * CPU_PRESCALER)); // Set max to the period
-                NOTE_DUTY_CYCLE = (int)((((double)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre); // Set compare to half the period
+                NOTE_DUTY_CYCLE = (int)((((double)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre / 256); // Set compare to half the period
             }
         #endif
     }
@@ -386,10 +399,10 @@ ISR(TIMER3_COMPA_vect)
                 if (envelope_index < 65535) {
                     envelope_index++;
                 }
-                freq = voice_envelope(freq);
+                freq = envelope_frequency(freq);
 
                 NOTE_PERIOD = (int)(((double)F_CPU) / (freq * CPU_PRESCALER)); // Set max to the period
-                NOTE_DUTY_CYCLE = (int)((((double)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre); // Set compare to half the period
+                NOTE_DUTY_CYCLE = (int)((((double)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre / 256); // Set compare to half the period
             } else {
                 NOTE_PERIOD = 0;
                 NOTE_DUTY_CYCLE = 0;
@@ -621,7 +634,7 @@ void decrease_polyphony_rate(float change) {
 // Timbre function
 
 void set_timbre(float timbre) {
-    note_timbre = timbre;
+    note_timbre = AUDIO_TIMBRE(timbre);
 }
 
 // Tempo functions
@@ -14,9 +14,6 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <avr/pgmspace.h>
 #include "luts.h"
 
 const float vibrato_lut[VIBRATO_LUT_LENGTH] =
@@ -43,7 +40,13 @@ const float vibrato_lut[VIBRATO_LUT_LENGTH] =
 	1.0000000000000,
 };
 
-const uint16_t frequency_lut[FREQUENCY_LUT_LENGTH] =
+const int8_t vibrato_pitch_lut[VIBRATO_LUT_LENGTH] PROGMEM =
+{
+	10, 19, 26, 30, 32, 30, 26, 19, 10, 0,
+	-10, -19, -26, -30, -32, -30, -26, -19, -10, 0,
+};
+
+const uint16_t frequency_lut[FREQUENCY_LUT_LENGTH] PROGMEM =
 {
 	0x8E0B,
 	0x8C02,
@@ -14,9 +14,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <avr/pgmspace.h>
+#include <stdint.h>
+#include "progmem.h"
 
 #ifndef LUTS_H
 #define LUTS_H
@@ -26,6 +25,12 @@
 #define FREQUENCY_LUT_LENGTH 349
 
 extern const float vibrato_lut[VIBRATO_LUT_LENGTH];
+
+// vibrato_lut as pitch offsets, see audio_engine.h, in PROGMEM
+extern const int8_t vibrato_pitch_lut[VIBRATO_LUT_LENGTH];
+
+// Timer 1 and 3 periods at 2 MHz (16 MHz with the /8 prescaler), from
+// 55 Hz upwards in quarter semitones, in PROGMEM
 extern const uint16_t frequency_lut[FREQUENCY_LUT_LENGTH];
 
 #endif /* LUTS_H */
@@ -0,0 +1,77 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <math.h>
+#include "song_compiler.h"
+#include "audio_engine.h"
+
+// A pair repeated this many times is shorter as a run
+#define MIN_REPEATS 2
+#define MAX_REPEATS 255
+
+int16_t song_frequency_to_note(float frequency) {
+    if (frequency == 0) {
+        return AUDIO_SONG_REST;
+    }
+    if (!(frequency > 0)) {
+        return -1;
+    }
+    long note = lround(69 + 12 * log2(frequency / 440.0));
+    if (note < 0 || note >= AUDIO_SONG_REST) {
+        return -1;
+    }
+    return note;
+}
+
+static bool put(uint8_t *out, uint16_t size, int32_t *length, uint8_t first, uint8_t second) {
+    if (*length + 2 > size) {
+        return false;
+    }
+    out[(*length)++] = first;
+    out[(*length)++] = second;
+    return true;
+}
+
+int32_t song_compile(const float (*notes)[2], uint16_t count, uint8_t *out, uint16_t size) {
+    int32_t length = 0;
+    uint16_t i = 0;
+    while (i < count) {
+        int16_t note = song_frequency_to_note(notes[i][0]);
+        float duration = notes[i][1];
+        if (note < 0 || duration < 1 || duration > 255 || duration != floorf(duration)) {
+            return -1;
+        }
+        if (!put(out, size, &length, note, duration)) {
+            return -1;
+        }
+
+        uint16_t repeats = 0;
+        while (i + 1 + repeats < count && repeats < MAX_REPEATS &&
+               notes[i + 1 + repeats][0] == notes[i][0] &&
+               notes[i + 1 + repeats][1] == notes[i][1]) {
+            repeats++;
+        }
+        if (repeats >= MIN_REPEATS) {
+            if (!put(out, size, &length, AUDIO_SONG_REPEAT, repeats)) {
+                return -1;
+            }
+            i += repeats;
+        }
+        i++;
+    }
+    return length;
+}
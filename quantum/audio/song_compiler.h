@@ -0,0 +1,42 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SONG_COMPILER_H
+#define SONG_COMPILER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Turns float songs into compact songs, see audio_engine.h. This runs on
+// the host, from util/song_compiler.c, it's not part of the firmware.
+
+// Returns the nearest MIDI note, AUDIO_SONG_REST for 0 Hz, or -1 if the
+// frequency is not a note that the compact songs can store
+int16_t song_frequency_to_note(float frequency);
+
+// Returns the size of the compact song, or -1 if a note can't be stored,
+// or it doesn't fit in size bytes
+int32_t song_compile(const float (*notes)[2], uint16_t count, uint8_t *out, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SONG_COMPILER_H */
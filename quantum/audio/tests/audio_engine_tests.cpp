@@ -0,0 +1,266 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <cmath>
+#include <vector>
+extern "C" {
+#include "audio_engine.h"
+#include "luts.h"
+}
+
+// The floating point audio interrupt this replaces, as a reference
+
+static const double timer_hz = F_CPU / 8.0;
+
+static double ref_period(double frequency) {
+    return timer_hz / frequency;
+}
+
+static double ref_glide(double frequency, double target) {
+    if (frequency < target && frequency < target * pow(2, -440 / target / 12 / 2)) {
+        return frequency * pow(2, 440 / frequency / 12 / 2);
+    } else if (frequency > target && frequency > target * pow(2, 440 / target / 12 / 2)) {
+        return frequency * pow(2, -440 / frequency / 12 / 2);
+    }
+    return target;
+}
+
+struct RefVibrato {
+    double counter = 0;
+    double rate = 0.125;
+
+    double operator()(double frequency) {
+        double vibrated = frequency * vibrato_lut[(int)counter];
+        counter = fmod(counter + rate * (1.0 + 440.0 / frequency), VIBRATO_LUT_LENGTH);
+        return vibrated;
+    }
+};
+
+static double pitch_to_frequency(double pitch) {
+    return 55.0 * pow(2, pitch / AUDIO_PITCH_OCTAVE);
+}
+
+static double frequency_to_pitch(double frequency) {
+    return log2(frequency / 55.0) * AUDIO_PITCH_OCTAVE;
+}
+
+static int16_t pitch_of(double frequency) {
+    return audio_period_to_pitch(ref_period(frequency) + 0.5);
+}
+
+TEST(AudioEngine, PitchToPeriodMatchesTheFrequency) {
+    for (int pitch = -AUDIO_PITCH_OCTAVE; pitch < 24000; pitch += 37) {
+        double expected = ref_period(pitch_to_frequency(pitch));
+        if (expected > AUDIO_MAX_PERIOD) {
+            continue;
+        }
+        EXPECT_NEAR(audio_pitch_to_period(pitch), expected, std::max(1.0, expected * 0.0005)) << "pitch " << pitch;
+    }
+}
+
+TEST(AudioEngine, PitchToPeriodIsClampedToTheTimer) {
+    EXPECT_EQ(AUDIO_MAX_PERIOD, audio_pitch_to_period(-3 * AUDIO_PITCH_OCTAVE));
+    EXPECT_EQ(AUDIO_MAX_PERIOD, audio_pitch_to_period(INT16_MIN + 1));
+    EXPECT_GE(audio_pitch_to_period(INT16_MAX), 1);
+}
+
+TEST(AudioEngine, PitchToPeriodIsMonotonic) {
+    uint16_t last = audio_pitch_to_period(-2 * AUDIO_PITCH_OCTAVE);
+    for (int pitch = -2 * AUDIO_PITCH_OCTAVE + 1; pitch < 24000; pitch++) {
+        uint16_t period = audio_pitch_to_period(pitch);
+        ASSERT_LE(period, last) << "pitch " << pitch;
+        last = period;
+    }
+}
+
+TEST(AudioEngine, PeriodToPitchRoundTrips) {
+    for (uint32_t period = 50; period <= AUDIO_MAX_PERIOD; period += 7) {
+        int16_t pitch = audio_period_to_pitch(period);
+        EXPECT_NEAR(pitch, frequency_to_pitch(timer_hz / period), 1.0) << "period " << period;
+        EXPECT_NEAR(audio_pitch_to_period(pitch), period, std::max(1.0, period * 0.0005)) << "period " << period;
+    }
+}
+
+TEST(AudioEngine, GlideFollowsTheFloatingPointGlissando) {
+    const double from[] = {220, 440, 110, 1760, 3520};
+    const double to[] = {440, 220, 1760, 110, 1000};
+    for (int n = 0; n < 5; n++) {
+        // The pitch of the floating point glissando at each interrupt
+        std::vector<std::pair<double, double>> ref;
+        double frequency = from[n];
+        double ref_time = 0;
+        while (frequency != to[n]) {
+            ref.push_back({ref_time, frequency_to_pitch(frequency)});
+            ref_time += 1 / frequency;
+            frequency = ref_glide(frequency, to[n]);
+        }
+        ref.push_back({ref_time, frequency_to_pitch(to[n])});
+
+        int16_t pitch = pitch_of(from[n]);
+        int16_t target = pitch_of(to[n]);
+        double time = 0;
+        size_t r = 0;
+        while (pitch != target) {
+            while (r + 1 < ref.size() && ref[r + 1].first <= time) {
+                r++;
+            }
+            // Both move at about 220 semitones a second, give or take a step
+            double step = r + 1 < ref.size() ? fabs(ref[r + 1].second - ref[r].second) : 0;
+            ASSERT_NEAR(pitch, ref[r].second, step + AUDIO_PITCH_SEMITONE / 2) << from[n] << " to " << to[n] << " at " << time;
+            uint16_t period = audio_pitch_to_period(pitch);
+            time += period / timer_hz;
+            pitch = audio_glide(pitch, target, period);
+        }
+        EXPECT_NEAR(time, ref_time, ref_time * 0.05) << from[n] << " to " << to[n];
+    }
+}
+
+TEST(AudioEngine, GlideSnapsToTheTarget) {
+    EXPECT_EQ(1000, audio_glide(999, 1000, 1000));
+    EXPECT_EQ(1000, audio_glide(1001, 1000, 1000));
+    EXPECT_EQ(1000, audio_glide(1000, 1000, AUDIO_MAX_PERIOD));
+    EXPECT_LT(audio_glide(0, 1000, 1), 1000);
+    EXPECT_GT(audio_glide(0, 1000, 1), 0);
+}
+
+TEST(AudioEngine, VibratoPitchLutMatchesTheFloatLut) {
+    for (int i = 0; i < VIBRATO_LUT_LENGTH; i++) {
+        EXPECT_NEAR((int8_t)pgm_read_byte(&vibrato_pitch_lut[i]), frequency_to_pitch(55.0 * vibrato_lut[i]), 0.5) << i;
+    }
+}
+
+TEST(AudioEngine, VibratoFollowsTheFloatingPointVibrato) {
+    const double frequencies[] = {110, 440, 1760};
+    for (double frequency : frequencies) {
+        RefVibrato ref;
+        audio_vibrato_t vibrato = {0, 32, 64};
+        int16_t pitch = pitch_of(frequency);
+        uint16_t period = audio_pitch_to_period(pitch);
+        int ref_cycles = 0;
+        int cycles = 0;
+        double last_ref = 0;
+        int16_t last = 0;
+        const int steps = 20000;
+        for (int i = 0; i < steps; i++) {
+            double ref_offset = frequency_to_pitch(ref(frequency)) - frequency_to_pitch(frequency);
+            int16_t offset = audio_vibrato(&vibrato, period);
+            ASSERT_LE(abs(offset), 32);
+            if (last_ref <= 0 && ref_offset > 0) {
+                ref_cycles++;
+            }
+            if (last <= 0 && offset > 0) {
+                cycles++;
+            }
+            last_ref = ref_offset;
+            last = offset;
+        }
+        EXPECT_NEAR(cycles, ref_cycles, ref_cycles * 0.02 + 1) << frequency;
+    }
+}
+
+TEST(AudioEngine, VibratoStrengthScalesTheOffset) {
+    audio_vibrato_t full = {4 * 256, 0, 64};
+    audio_vibrato_t half = {4 * 256, 0, 32};
+    audio_vibrato_t none = {4 * 256, 0, 0};
+    EXPECT_EQ(32, audio_vibrato(&full, 1000));
+    EXPECT_EQ(16, audio_vibrato(&half, 1000));
+    EXPECT_EQ(0, audio_vibrato(&none, 1000));
+}
+
+TEST(AudioEngine, CompensatedIndexMatchesTheFloatingPointIndex) {
+    const double frequencies[] = {40, 110, 440, 880, 1760, 5000};
+    for (double frequency : frequencies) {
+        uint16_t period = ref_period(frequency) + 0.5;
+        for (uint16_t index = 0; index < 2000; index += 13) {
+            double expected = index * (880.0 / frequency);
+            EXPECT_NEAR(audio_compensated_index(index, period), expected, expected * 0.01 + 1);
+        }
+    }
+    EXPECT_EQ(0xFFFF, audio_compensated_index(0xFFFF, AUDIO_MAX_PERIOD));
+}
+
+TEST(AudioEngine, DutyCycleMatchesTheTimbre) {
+    const double timbres[] = {0.125, 0.25, 0.5, 0.75};
+    for (double timbre : timbres) {
+        for (uint16_t period = 100; period < 60000; period += 997) {
+            EXPECT_NEAR(audio_duty_cycle(period, AUDIO_TIMBRE(timbre)), period * timbre, 1);
+        }
+    }
+    EXPECT_EQ(255, AUDIO_TIMBRE(1.0));
+}
+
+// Renders a song like the interrupt in audio.c does, as the periods of
+// each interrupt
+
+struct Note {
+    double frequency;
+    double length;
+};
+
+static std::vector<std::vector<double>> render_float(const std::vector<Note>& song) {
+    std::vector<std::vector<double>> out;
+    for (const Note& note : song) {
+        std::vector<double> periods;
+        double length = note.length / 4;
+        for (uint16_t position = 1;; position++) {
+            uint16_t period = ref_period(note.frequency);
+            periods.push_back(period);
+            if (position >= length / period * 0xFFFF - 1) {
+                break;
+            }
+        }
+        out.push_back(periods);
+    }
+    return out;
+}
+
+static std::vector<std::vector<double>> render_fixed(const std::vector<Note>& song) {
+    std::vector<std::vector<double>> out;
+    for (const Note& note : song) {
+        std::vector<double> periods;
+        int16_t pitch = pitch_of(note.frequency);
+        uint32_t ticks = note.length / 4 * 0xFFFF;
+        uint32_t elapsed = 0;
+        for (;;) {
+            uint16_t period = audio_pitch_to_period(pitch);
+            periods.push_back(period);
+            elapsed += period;
+            if (elapsed + period >= ticks) {
+                break;
+            }
+        }
+        out.push_back(periods);
+    }
+    return out;
+}
+
+TEST(AudioEngine, RendersSongsLikeTheFloatingPointInterrupt) {
+    const std::vector<Note> song = {
+        {261.63, 8}, {293.66, 8}, {329.63, 16}, {349.23, 4}, {392.00, 32},
+        {440.00, 8}, {493.88, 8}, {523.25, 64}, {65.41, 16}, {2093.00, 16},
+    };
+    auto expected = render_float(song);
+    auto actual = render_fixed(song);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t n = 0; n < song.size(); n++) {
+        EXPECT_NEAR(actual[n].size(), expected[n].size(), 1) << "note " << n;
+        for (size_t i = 0; i < std::min(actual[n].size(), expected[n].size()); i++) {
+            ASSERT_NEAR(actual[n][i], expected[n][i], std::max(1.0, expected[n][i] * 0.0003)) << "note " << n;
+        }
+    }
+}
@@ -0,0 +1,14 @@
+audio_engine_SRC :=\
+	$(QUANTUM_PATH)/audio/tests/audio_engine_tests.cpp \
+	$(QUANTUM_PATH)/audio/audio_engine.c \
+	$(QUANTUM_PATH)/audio/luts.c
+audio_engine_INC := $(QUANTUM_PATH)/audio
+audio_engine_DEFS := -DF_CPU=16000000
+
+audio_song_SRC :=\
+	$(QUANTUM_PATH)/audio/tests/song_tests.cpp \
+	$(QUANTUM_PATH)/audio/song_compiler.c \
+	$(QUANTUM_PATH)/audio/audio_engine.c \
+	$(QUANTUM_PATH)/audio/luts.c
+audio_song_INC := $(QUANTUM_PATH)/audio
+audio_song_DEFS := -DF_CPU=16000000
@@ -0,0 +1,208 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+extern "C" {
+#include "audio_engine.h"
+#include "song_compiler.h"
+}
+#include "song_list.h"
+
+struct FloatSong {
+    const char* name;
+    std::vector<std::array<float, 2>> notes;
+};
+
+#define FLOAT_SONG(name) {#name, SONG(name)}
+
+static const std::vector<FloatSong> songs = {
+    FLOAT_SONG(ODE_TO_JOY), FLOAT_SONG(ROCK_A_BYE_BABY), FLOAT_SONG(CLOSE_ENCOUNTERS_5_NOTE),
+    FLOAT_SONG(DOE_A_DEER), FLOAT_SONG(IN_LIKE_FLINT), FLOAT_SONG(STARTUP_SOUND),
+    FLOAT_SONG(GOODBYE_SOUND), FLOAT_SONG(PLANCK_SOUND), FLOAT_SONG(PREONIC_SOUND),
+    FLOAT_SONG(QWERTY_SOUND), FLOAT_SONG(COLEMAK_SOUND), FLOAT_SONG(DVORAK_SOUND),
+    FLOAT_SONG(PLOVER_SOUND), FLOAT_SONG(PLOVER_GOODBYE_SOUND), FLOAT_SONG(MUSIC_ON_SOUND),
+    FLOAT_SONG(AUDIO_ON_SOUND), FLOAT_SONG(AUDIO_OFF_SOUND), FLOAT_SONG(MUSIC_OFF_SOUND),
+    FLOAT_SONG(VOICE_CHANGE_SOUND), FLOAT_SONG(CHROMATIC_SOUND), FLOAT_SONG(MAJOR_SOUND),
+    FLOAT_SONG(GUITAR_SOUND), FLOAT_SONG(VIOLIN_SOUND), FLOAT_SONG(CAPS_LOCK_ON_SOUND),
+    FLOAT_SONG(CAPS_LOCK_OFF_SOUND), FLOAT_SONG(SCROLL_LOCK_ON_SOUND), FLOAT_SONG(SCROLL_LOCK_OFF_SOUND),
+    FLOAT_SONG(NUM_LOCK_ON_SOUND), FLOAT_SONG(NUM_LOCK_OFF_SOUND), FLOAT_SONG(AG_NORM_SOUND),
+    FLOAT_SONG(AG_SWAP_SOUND), FLOAT_SONG(UNICODE_WINDOWS), FLOAT_SONG(UNICODE_LINUX),
+    FLOAT_SONG(COIN_SOUND), FLOAT_SONG(ONE_UP_SOUND), FLOAT_SONG(SONIC_RING),
+    FLOAT_SONG(ZELDA_PUZZLE), FLOAT_SONG(TERMINAL_SOUND),
+};
+
+static std::vector<uint8_t> compile(const std::vector<std::array<float, 2>>& notes) {
+    std::vector<uint8_t> out(notes.size() * 2);
+    int32_t size = song_compile(reinterpret_cast<const float (*)[2]>(notes.data()), notes.size(), out.data(), out.size());
+    EXPECT_GE(size, 0);
+    out.resize(std::max(size, 0));
+    return out;
+}
+
+static std::vector<audio_song_note_t> play(const std::vector<uint8_t>& data) {
+    std::vector<audio_song_note_t> notes;
+    audio_song_t song;
+    audio_song_note_t note;
+    audio_song_start(&song, data.data(), data.size());
+    while (audio_song_next(&song, &note)) {
+        notes.push_back(note);
+    }
+    return notes;
+}
+
+TEST(AudioSong, FrequenciesBecomeMidiNotes) {
+    EXPECT_EQ(69, song_frequency_to_note(NOTE_A4));
+    EXPECT_EQ(60, song_frequency_to_note(NOTE_C4));
+    EXPECT_EQ(61, song_frequency_to_note(NOTE_CS4));
+    EXPECT_EQ(35, song_frequency_to_note(NOTE_B1));
+    EXPECT_EQ(119, song_frequency_to_note(NOTE_B8));
+    EXPECT_EQ(AUDIO_SONG_REST, song_frequency_to_note(NOTE_REST));
+    EXPECT_EQ(-1, song_frequency_to_note(20000));
+    EXPECT_EQ(-1, song_frequency_to_note(-1));
+}
+
+TEST(AudioSong, MidiNotesBecomeTheirPitch) {
+    EXPECT_EQ(0, audio_note_to_pitch(33));
+    EXPECT_EQ(2 * AUDIO_PITCH_OCTAVE, audio_note_to_pitch(57));
+    EXPECT_EQ(-AUDIO_PITCH_SEMITONE, audio_note_to_pitch(32));
+}
+
+TEST(AudioSong, CompilesAllTheSongsToAQuarterOfTheFlash) {
+    size_t float_bytes = 0;
+    size_t compact_bytes = 0;
+    for (const FloatSong& song : songs) {
+        std::vector<uint8_t> compact = compile(song.notes);
+        std::vector<audio_song_note_t> played = play(compact);
+        ASSERT_EQ(song.notes.size(), played.size()) << song.name;
+        for (size_t i = 0; i < played.size(); i++) {
+            EXPECT_EQ(song.notes[i][1], played[i].duration) << song.name << " note " << i;
+            if (song.notes[i][0] == 0) {
+                EXPECT_EQ(AUDIO_SONG_REST, played[i].note) << song.name << " note " << i;
+            } else {
+                double semitones = 69 + 12 * log2(song.notes[i][0] / 440.0);
+                EXPECT_NEAR(played[i].note, semitones, 0.05) << song.name << " note " << i;
+            }
+        }
+        EXPECT_LE(compact.size() * 4, song.notes.size() * sizeof(song.notes[0])) << song.name;
+        float_bytes += song.notes.size() * sizeof(song.notes[0]);
+        compact_bytes += compact.size();
+    }
+    std::cout << "[          ] " << float_bytes << " bytes of float songs, " << compact_bytes << " bytes compact" << std::endl;
+}
+
+TEST(AudioSong, RepeatedNotesAreRunLengthEncoded) {
+    std::vector<std::array<float, 2>> notes = {
+        {NOTE_C4, 8}, {NOTE_C4, 8}, {NOTE_C4, 8}, {NOTE_C4, 8}, {NOTE_D4, 8}, {NOTE_D4, 8}, {NOTE_E4, 16},
+    };
+    std::vector<uint8_t> compact = compile(notes);
+    EXPECT_EQ((std::vector<uint8_t>{60, 8, AUDIO_SONG_REPEAT, 3, 62, 8, 62, 8, 64, 16}), compact);
+    std::vector<audio_song_note_t> played = play(compact);
+    ASSERT_EQ(notes.size(), played.size());
+    for (size_t i = 0; i < played.size(); i++) {
+        EXPECT_EQ(song_frequency_to_note(notes[i][0]), played[i].note);
+        EXPECT_EQ(notes[i][1], played[i].duration);
+    }
+}
+
+TEST(AudioSong, LongRunsAreSplit) {
+    std::vector<std::array<float, 2>> notes(600, {NOTE_A4, 4});
+    std::vector<uint8_t> compact = compile(notes);
+    EXPECT_EQ(12u, compact.size());
+    EXPECT_EQ(600u, play(compact).size());
+}
+
+TEST(AudioSong, IgnoresARepeatWithNothingToRepeatAndAHalfPair) {
+    std::vector<uint8_t> compact = {AUDIO_SONG_REPEAT, 3, 60, 8, AUDIO_SONG_REPEAT, 0, 62, 8, 64};
+    std::vector<audio_song_note_t> played = play(compact);
+    ASSERT_EQ(2u, played.size());
+    EXPECT_EQ(60, played[0].note);
+    EXPECT_EQ(62, played[1].note);
+}
+
+TEST(AudioSong, RejectsNotesThatDontFit) {
+    uint8_t out[16];
+    const float fraction[][2] = {{NOTE_A4, 2.5}};
+    const float too_long[][2] = {{NOTE_A4, 256}};
+    const float too_high[][2] = {{20000, 16}};
+    const float fits[][2] = {{NOTE_A4, 16}, {NOTE_B4, 16}};
+    EXPECT_EQ(-1, song_compile(fraction, 1, out, sizeof(out)));
+    EXPECT_EQ(-1, song_compile(too_long, 1, out, sizeof(out)));
+    EXPECT_EQ(-1, song_compile(too_high, 1, out, sizeof(out)));
+    EXPECT_EQ(-1, song_compile(fits, 2, out, 3));
+    EXPECT_EQ(4, song_compile(fits, 2, out, sizeof(out)));
+}
+
+TEST(AudioSong, TempoIsConvertedOnceForTheSong) {
+    const uint8_t tempos[] = {10, 50, 100, 200, 255};
+    for (uint8_t tempo : tempos) {
+        uint32_t tick_length = audio_song_tick_length(tempo);
+        for (uint16_t duration = 1; duration < 256; duration++) {
+            double expected = (duration / 4.0) * (tempo / 100.0) * 0xFFFF;
+            EXPECT_NEAR(duration * tick_length, expected, duration) << (int)tempo;
+        }
+    }
+}
+
+// What the interrupt does for each note, the float songs convert the
+// frequency and the length, the compact ones read two bytes
+
+static volatile uint32_t sink;
+
+template<typename F>
+static double ns_per_note(size_t notes, F f) {
+    const int rounds = 2000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (rounds * notes);
+}
+
+TEST(AudioSong, MeasuresTheCostOfStartingANote) {
+    std::vector<std::array<float, 2>> all;
+    for (const FloatSong& song : songs) {
+        all.insert(all.end(), song.notes.begin(), song.notes.end());
+    }
+    std::vector<uint8_t> compact = compile(all);
+    const uint8_t tempo = TEMPO_DEFAULT;
+
+    double float_ns = ns_per_note(all.size(), [&]() {
+        for (const auto& note : all) {
+            float period = ((float)AUDIO_TIMER_HZ) / note[0];
+            int16_t pitch = audio_period_to_pitch(period > AUDIO_MAX_PERIOD ? AUDIO_MAX_PERIOD : period);
+            float length = (note[1] / 4) * (((float)tempo) / 100);
+            sink = pitch + (uint32_t)(length * 0xFFFF);
+        }
+    });
+    uint32_t tick_length = audio_song_tick_length(tempo);
+    double compact_ns = ns_per_note(all.size(), [&]() {
+        audio_song_t song;
+        audio_song_note_t note;
+        audio_song_start(&song, compact.data(), compact.size());
+        while (audio_song_next(&song, &note)) {
+            sink = audio_note_to_pitch(note.note) + note.duration * tick_length;
+        }
+    });
+    std::cout << "[          ] " << float_ns << " ns per float note, " << compact_ns << " ns per compact note" << std::endl;
+    std::cout << "[          ] " << sizeof(all[0]) << " bytes read per float note, 2 per compact note" << std::endl;
+}
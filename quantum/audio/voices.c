@@ -19,8 +19,8 @@
 
 // these are imported from audio.c
 extern uint16_t envelope_index;
-extern float note_timbre;
-extern float polyphony_rate;
+extern uint8_t note_timbre;
+extern uint32_t polyphony_ticks;
 extern bool glissando;
 
 voice_type voice = default_voice;
@@ -37,45 +37,67 @@ void voice_deiterate() {
     voice = (voice - 1 + number_of_voices) % number_of_voices;
 }
 
-float voice_envelope(float frequency) {
+#ifdef AUDIO_VOICES
+
+// The drum ranges, as pitches (see audio_engine.h)
+#define PITCH_60HZ    386
+#define PITCH_80HZ    1661
+#define PITCH_100HZ   2650
+#define PITCH_160HZ   (PITCH_80HZ + AUDIO_PITCH_OCTAVE)
+#define PITCH_320HZ   (PITCH_80HZ + 2 * AUDIO_PITCH_OCTAVE)
+#define PITCH_640HZ   (PITCH_80HZ + 3 * AUDIO_PITCH_OCTAVE)
+#define PITCH_1000HZ  12855
+#define PITCH_1280HZ  (PITCH_80HZ + 4 * AUDIO_PITCH_OCTAVE)
+#define PITCH_2000HZ  (PITCH_1000HZ + AUDIO_PITCH_OCTAVE)
+#define PITCH_3000HZ  17724
+#define PITCH_5000HZ  19988
+
+static int16_t random_pitch(int16_t low, int16_t high) {
+    return low + rand() % (high - low);
+}
+
+#endif
+
+int16_t voice_envelope(int16_t pitch) {
     // envelope_index ranges from 0 to 0xFFFF, which is preserved at 880.0 Hz
-    __attribute__ ((unused))
-    uint16_t compensated_index = (uint16_t)((float)envelope_index * (880.0 / frequency));
+    #ifdef AUDIO_VOICES
+    uint16_t compensated_index = audio_compensated_index(envelope_index, audio_pitch_to_period(pitch));
+    #endif
 
     switch (voice) {
         case default_voice:
             glissando = false;
-            note_timbre = TIMBRE_50;
-            polyphony_rate = 0;
+            note_timbre = AUDIO_TIMBRE(TIMBRE_50);
+            polyphony_ticks = 0;
 	        break;
 
     #ifdef AUDIO_VOICES
 
         case something:
             glissando = false;
-            polyphony_rate = 0;
+            polyphony_ticks = 0;
             switch (compensated_index) {
                 case 0 ... 9:
-                    note_timbre = TIMBRE_12;
+                    note_timbre = AUDIO_TIMBRE(TIMBRE_12);
                     break;
 
                 case 10 ... 19:
-                    note_timbre = TIMBRE_25;
+                    note_timbre = AUDIO_TIMBRE(TIMBRE_25);
                     break;
 
                 case 20 ... 200:
-                    note_timbre = .125 + .125;
+                    note_timbre = AUDIO_TIMBRE(.125 + .125);
                     break;
 
                 default:
-                    note_timbre = .125;
+                    note_timbre = AUDIO_TIMBRE(.125);
                     break;
             }
             break;
 
         case drums:
             glissando = false;
-            polyphony_rate = 0;
+            polyphony_ticks = 0;
                 // switch (compensated_index) {
                 //     case 0 ... 10:
                 //         note_timbre = 0.5;
@@ -89,67 +111,67 @@ float voice_envelope(float frequency) {
                 // }
                 // frequency = (rand() % (int)(frequency * 1.2 - frequency)) + (frequency * 0.8);
 
-            if (frequency < 80.0) {
+            if (pitch < PITCH_80HZ) {
 
-            } else if (frequency < 160.0) {
+            } else if (pitch < PITCH_160HZ) {
 
                 // Bass drum: 60 - 100 Hz
-                frequency = (rand() % (int)(40)) + 60;
+                pitch = random_pitch(PITCH_60HZ, PITCH_100HZ);
                 switch (envelope_index) {
                     case 0 ... 10:
-                        note_timbre = 0.5;
+                        note_timbre = AUDIO_TIMBRE(0.5);
                         break;
                     case 11 ... 20:
-                        note_timbre = 0.5 * (21 - envelope_index) / 10;
+                        note_timbre = AUDIO_TIMBRE(0.5) * (21 - envelope_index) / 10;
                         break;
                     default:
                         note_timbre = 0;
                         break;
                 }
 
-            } else if (frequency < 320.0) {
+            } else if (pitch < PITCH_320HZ) {
 
 
                 // Snare drum: 1 - 2 KHz
-                frequency = (rand() % (int)(1000)) + 1000;
+                pitch = random_pitch(PITCH_1000HZ, PITCH_2000HZ);
                 switch (envelope_index) {
                     case 0 ... 5:
-                        note_timbre = 0.5;
+                        note_timbre = AUDIO_TIMBRE(0.5);
                         break;
                     case 6 ... 20:
-                        note_timbre = 0.5 * (21 - envelope_index) / 15;
+                        note_timbre = AUDIO_TIMBRE(0.5) * (21 - envelope_index) / 15;
                         break;
                     default:
                         note_timbre = 0;
                         break;
                 }
 
-            } else if (frequency < 640.0) {
+            } else if (pitch < PITCH_640HZ) {
 
                 // Closed Hi-hat: 3 - 5 KHz
-                frequency = (rand() % (int)(2000)) + 3000;
+                pitch = random_pitch(PITCH_3000HZ, PITCH_5000HZ);
                 switch (envelope_index) {
                     case 0 ... 15:
-                        note_timbre = 0.5;
+                        note_timbre = AUDIO_TIMBRE(0.5);
                         break;
                     case 16 ... 20:
-                        note_timbre = 0.5 * (21 - envelope_index) / 5;
+                        note_timbre = AUDIO_TIMBRE(0.5) * (21 - envelope_index) / 5;
                         break;
                     default:
                         note_timbre = 0;
                         break;
                 }
 
-            } else if (frequency < 1280.0) {
+            } else if (pitch < PITCH_1280HZ) {
 
                 // Open Hi-hat: 3 - 5 KHz
-                frequency = (rand() % (int)(2000)) + 3000;
+                pitch = random_pitch(PITCH_3000HZ, PITCH_5000HZ);
                 switch (envelope_index) {
                     case 0 ... 35:
-                        note_timbre = 0.5;
+                        note_timbre = AUDIO_TIMBRE(0.5);
                         break;
                     case 36 ... 50:
-                        note_timbre = 0.5 * (51 - envelope_index) / 15;
+                        note_timbre = AUDIO_TIMBRE(0.5) * (51 - envelope_index) / 15;
                         break;
                     default:
                         note_timbre = 0;
@@ -160,20 +182,20 @@ float voice_envelope(float frequency) {
             break;
         case butts_fader:
             glissando = true;
-            polyphony_rate = 0;
+            polyphony_ticks = 0;
             switch (compensated_index) {
                 case 0 ... 9:
-                    frequency = frequency / 4;
-                    note_timbre = TIMBRE_12;
+                    pitch = pitch - 2 * AUDIO_PITCH_OCTAVE;
+                    note_timbre = AUDIO_TIMBRE(TIMBRE_12);
 	                break;
 
                 case 10 ... 19:
-                    frequency = frequency / 2;
-                    note_timbre = TIMBRE_12;
+                    pitch = pitch - AUDIO_PITCH_OCTAVE;
+                    note_timbre = AUDIO_TIMBRE(TIMBRE_12);
 	                break;
 
                 case 20 ... 200:
-                    note_timbre = .125 - pow(((float)compensated_index - 20) / (200 - 20), 2)*.125;
+                    note_timbre = AUDIO_TIMBRE(.125) - AUDIO_TIMBRE(.125) * (uint32_t)(compensated_index - 20) * (compensated_index - 20) / ((200 - 20) * (200 - 20));
 	                break;
 
                 default:
@@ -183,7 +205,7 @@ float voice_envelope(float frequency) {
     	    break;
 
         // case octave_crunch:
-        //     polyphony_rate = 0;
+        //     polyphony_ticks = 0;
         //     switch (compensated_index) {
         //         case 0 ... 9:
         //         case 20 ... 24:
@@ -208,7 +230,7 @@ float voice_envelope(float frequency) {
         case duty_osc:
             // This slows the loop down a substantial amount, so higher notes may freeze
             glissando = true;
-            polyphony_rate = 0;
+            polyphony_ticks = 0;
             switch (compensated_index) {
                 default:
                     #define OCS_SPEED 10
@@ -216,36 +238,36 @@ float voice_envelope(float frequency) {
                     // sine wave is slow
                     // note_timbre = (sin((float)compensated_index/10000*OCS_SPEED) * OCS_AMP / 2) + .5;
                     // triangle wave is a bit faster
-                    note_timbre = (float)abs((compensated_index*OCS_SPEED % 3000) - 1500) * ( OCS_AMP / 1500 ) + (1 - OCS_AMP) / 2;
+                    note_timbre = (uint32_t)labs((int32_t)((uint32_t)compensated_index*OCS_SPEED % 3000) - 1500) * AUDIO_TIMBRE(OCS_AMP) / 1500 + AUDIO_TIMBRE((1 - OCS_AMP) / 2);
                 	break;
             }
 	        break;
 
         case duty_octave_down:
             glissando = true;
-            polyphony_rate = 0;
-            note_timbre = (envelope_index % 2) * .125 + .375 * 2;
+            polyphony_ticks = 0;
+            note_timbre = (envelope_index % 2) * AUDIO_TIMBRE(.125) + AUDIO_TIMBRE(.375 * 2);
             if ((envelope_index % 4) == 0)
-                note_timbre = 0.5;
+                note_timbre = AUDIO_TIMBRE(0.5);
             if ((envelope_index % 8) == 0)
                 note_timbre = 0;
             break;
         case delayed_vibrato:
             glissando = true;
-            polyphony_rate = 0;
-            note_timbre = TIMBRE_50;
+            polyphony_ticks = 0;
+            note_timbre = AUDIO_TIMBRE(TIMBRE_50);
             #define VOICE_VIBRATO_DELAY 150
             #define VOICE_VIBRATO_SPEED 50
             switch (compensated_index) {
                 case 0 ... VOICE_VIBRATO_DELAY:
                     break;
                 default:
-                    frequency = frequency * vibrato_lut[(int)fmod((((float)compensated_index - (VOICE_VIBRATO_DELAY + 1))/1000*VOICE_VIBRATO_SPEED), VIBRATO_LUT_LENGTH)];
+                    pitch = pitch + (int8_t)pgm_read_byte(&vibrato_pitch_lut[((uint32_t)(compensated_index - (VOICE_VIBRATO_DELAY + 1)) * VOICE_VIBRATO_SPEED / 1000) % VIBRATO_LUT_LENGTH]);
                     break;
             }
             break;
         // case delayed_vibrato_octave:
-        //     polyphony_rate = 0;
+        //     polyphony_ticks = 0;
         //     if ((envelope_index % 2) == 1) {
         //         note_timbre = 0.55;
         //     } else {
@@ -292,5 +314,5 @@ float voice_envelope(float frequency) {
    			break;
     }
 
-    return frequency;
+    return pitch;
 }
@@ -18,11 +18,13 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include "luts.h"
+#include "audio_engine.h"
 
 #ifndef VOICES_H
 #define VOICES_H
 
-float voice_envelope(float frequency);
+// Takes and returns a pitch, see audio_engine.h
+int16_t voice_envelope(int16_t pitch);
 
 typedef enum {
     default_voice,
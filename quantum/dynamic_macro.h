@@ -18,13 +18,21 @@
 #ifndef DYNAMIC_MACROS_H
 #define DYNAMIC_MACROS_H
 
+#include <stddef.h>
+#include <string.h>
 #include "action_layer.h"
+#include "timer.h"
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+#include "eeprom.h"
+#endif
 
 #ifndef DYNAMIC_MACRO_SIZE
-/* May be overridden with a custom value. Be aware that the effective
- * macro length is half of this value: each keypress is recorded twice
- * because of the down-event and up-event. This is not a bug, it's the
- * intended behavior.
+/* May be overridden with a custom value. This used to be the number of
+ * recorded key events, and the buffer still takes the same amount of
+ * RAM: DYNAMIC_MACRO_SIZE * sizeof(keyrecord_t) bytes, unless
+ * DYNAMIC_MACRO_BYTES is set directly. Events are compressed to 2-4
+ * bytes each, so that buffer holds more than twice as many events as
+ * it used to.
  *
  * Usually it should be fine to set the macro size to at least 256 but
  * there have been reports of it being too much in some users' cases,
@@ -33,6 +41,39 @@
 #define DYNAMIC_MACRO_SIZE 128
 #endif
 
+#ifndef DYNAMIC_MACRO_BYTES
+#define DYNAMIC_MACRO_BYTES (DYNAMIC_MACRO_SIZE * sizeof(keyrecord_t))
+#endif
+
+/* The number of macros, they all share the same buffer. */
+#ifndef DYNAMIC_MACRO_SLOTS
+#define DYNAMIC_MACRO_SLOTS 2
+#endif
+
+#if DYNAMIC_MACRO_SLOTS < 2 || DYNAMIC_MACRO_SLOTS > 15
+#error "DYNAMIC_MACRO_SLOTS must be between 2 and 15"
+#endif
+
+/* The longest pause between two events that is reproduced during the
+ * playback, in ms. With the default of 0 the macros are played back as
+ * fast as possible, one event per matrix scan, and the pauses aren't
+ * recorded at all.
+ */
+#ifndef DYNAMIC_MACRO_MAX_DELAY
+#define DYNAMIC_MACRO_MAX_DELAY 0
+#endif
+
+#if DYNAMIC_MACRO_MAX_DELAY > 65535
+#error "DYNAMIC_MACRO_MAX_DELAY must be at most 65535"
+#endif
+
+/* Real key events happening during the playback are processed after
+ * it. If more of them than this happen, the playback is stopped.
+ */
+#ifndef DYNAMIC_MACRO_PENDING_EVENTS
+#define DYNAMIC_MACRO_PENDING_EVENTS 4
+#endif
+
 /* DYNAMIC_MACRO_RANGE must be set as the last element of user's
  * "planck_keycodes" enum prior to including this header. This allows
  * us to 'extend' it.
@@ -43,8 +84,64 @@ enum dynamic_macro_keycodes {
     DYN_REC_STOP,
     DYN_MACRO_PLAY1,
     DYN_MACRO_PLAY2,
+    /* Slots 3 and up, use DYN_REC_START(n) and DYN_MACRO_PLAY(n) */
+    DYN_REC_START_EXTRA,
+    DYN_MACRO_PLAY_EXTRA = DYN_REC_START_EXTRA + DYNAMIC_MACRO_SLOTS - 2,
 };
 
+#define DYN_REC_START(n) \
+    ((n) == 1 ? DYN_REC_START1 : (n) == 2 ? DYN_REC_START2 : DYN_REC_START_EXTRA + (n) - 3)
+#define DYN_MACRO_PLAY(n) \
+    ((n) == 1 ? DYN_MACRO_PLAY1 : (n) == 2 ? DYN_MACRO_PLAY2 : DYN_MACRO_PLAY_EXTRA + (n) - 3)
+
+/* Recorded events are encoded as:
+ *
+ * - A varint of the time since the previous event, shifted left by
+ *   one, with the pressed state in the lowest bit. Only the first byte
+ *   is needed when DYNAMIC_MACRO_MAX_DELAY is 0.
+ * - The key, row * MATRIX_COLS + col, with the highest bit set when
+ *   the tap state follows. One byte on matrices of up to 128 keys, two
+ *   bytes, big endian, on bigger ones.
+ * - The tap state, only when it's not zero.
+ */
+#if MATRIX_ROWS * MATRIX_COLS <= 128
+#define DYNAMIC_MACRO_KEY_BYTES 1
+#define DYNAMIC_MACRO_TAP_FLAG 0x80
+#else
+#define DYNAMIC_MACRO_KEY_BYTES 2
+#define DYNAMIC_MACRO_TAP_FLAG 0x8000
+#endif
+#define DYNAMIC_MACRO_MAX_EVENT_SIZE (3 + DYNAMIC_MACRO_KEY_BYTES + 1)
+
+/* The macros are stored back to back in the buffer, in the order they
+ * were recorded. A new recording of a slot first removes the old macro
+ * and moves the ones after it, and then appends to the end.
+ */
+typedef struct {
+    uint16_t offset[DYNAMIC_MACRO_SLOTS];
+    uint16_t length[DYNAMIC_MACRO_SLOTS];
+    uint8_t data[DYNAMIC_MACRO_BYTES];
+} dynamic_macro_storage_t;
+
+static dynamic_macro_storage_t dynamic_macro_storage;
+
+/* The slot being recorded or played, 0 when there's none. */
+static uint8_t dynamic_macro_recording = 0;
+static uint8_t dynamic_macro_playing = 0;
+
+/* Recording state: where the trailing key-down events start, and the
+ * time of the last event. */
+static uint16_t dynamic_macro_trim_length;
+static uint16_t dynamic_macro_last_time;
+
+/* Playback state */
+static uint16_t dynamic_macro_play_pos;
+static uint16_t dynamic_macro_play_time;
+static uint32_t dynamic_macro_saved_layer_state;
+static bool dynamic_macro_playing_event = false;
+static keyrecord_t dynamic_macro_pending[DYNAMIC_MACRO_PENDING_EVENTS];
+static uint8_t dynamic_macro_pending_count = 0;
+
 /* Blink the LEDs to notify the user about some event. */
 void dynamic_macro_led_blink(void)
 {
@@ -55,23 +152,200 @@ void dynamic_macro_led_blink(void)
 #endif
 }
 
-/* Convenience macros used for retrieving the debug info. All of them
- * need a `direction` variable accessible at the call site.
+/* The number of bytes used by all macros. */
+uint16_t dynamic_macro_used_bytes(void)
+{
+    uint16_t used = 0;
+    for (uint8_t i = 0; i < DYNAMIC_MACRO_SLOTS; i++) {
+        used += dynamic_macro_storage.length[i];
+    }
+    return used;
+}
+
+/* The length in bytes of the macro in a slot, numbered from 1. */
+uint16_t dynamic_macro_length(uint8_t slot)
+{
+    return dynamic_macro_storage.length[slot - 1];
+}
+
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+/* The EEPROM holds the magic number, the slot table and the used part
+ * of the buffer. The magic number changes with the encoding. */
+#define DYNAMIC_MACRO_EEPROM_MAGIC \
+    (0xD700 | DYNAMIC_MACRO_KEY_BYTES << 4 | DYNAMIC_MACRO_SLOTS)
+#define DYNAMIC_MACRO_EEPROM_TABLE (DYNAMIC_MACRO_EEPROM_ADDR + 2)
+#define DYNAMIC_MACRO_EEPROM_DATA \
+    (DYNAMIC_MACRO_EEPROM_TABLE + offsetof(dynamic_macro_storage_t, data))
+
+/* The size of the EEPROM, or of its emulation on ARM, see
+ * tmk_core/common/chibios/eeprom.c. Only the Teensy 3.x and LC emulate
+ * it in flash, other ARM chips keep it in RAM, and lose it on a restart. */
+#if defined(__AVR__)
+#define DYNAMIC_MACRO_EEPROM_SIZE (E2END + 1)
+#elif defined(PROTOCOL_CHIBIOS)
+#include "hal.h"
+#if defined(K20x)
+#define DYNAMIC_MACRO_EEPROM_SIZE 32
+#elif defined(KL2x)
+#include "eeprom_log.h"
+#define DYNAMIC_MACRO_EEPROM_SIZE EEPROM_LOG_SIZE
+#else
+#error "DYNAMIC_MACRO_EEPROM_ADDR: this chip has no persistent EEPROM emulation"
+#endif
+#else
+/* The host tests, see tmk_core/common/test/eeprom.c */
+#define DYNAMIC_MACRO_EEPROM_SIZE 1024
+#endif
+
+_Static_assert(DYNAMIC_MACRO_EEPROM_DATA + DYNAMIC_MACRO_BYTES <= DYNAMIC_MACRO_EEPROM_SIZE,
+    "The dynamic macros don't fit in the EEPROM, "
+    "lower DYNAMIC_MACRO_EEPROM_ADDR or DYNAMIC_MACRO_BYTES");
+
+static bool dynamic_macro_loaded = false;
+
+/* Read the macros saved by an earlier session. */
+void dynamic_macro_load(void)
+{
+    dynamic_macro_loaded = true;
+    if (eeprom_read_word((uint16_t *)DYNAMIC_MACRO_EEPROM_ADDR) != DYNAMIC_MACRO_EEPROM_MAGIC) {
+        return;
+    }
+    dynamic_macro_storage_t *s = &dynamic_macro_storage;
+    eeprom_read_block(s, (void *)DYNAMIC_MACRO_EEPROM_TABLE, offsetof(dynamic_macro_storage_t, data));
+    uint16_t used = 0;
+    for (uint8_t i = 0; i < DYNAMIC_MACRO_SLOTS; i++) {
+        if (s->offset[i] + s->length[i] > DYNAMIC_MACRO_BYTES) {
+            used = DYNAMIC_MACRO_BYTES + 1;
+            break;
+        }
+        used += s->length[i];
+    }
+    if (used > DYNAMIC_MACRO_BYTES) {
+        dprintln("dynamic macro: ignoring invalid saved macros");
+        memset(s, 0, sizeof(*s));
+        return;
+    }
+    eeprom_read_block(s->data, (void *)DYNAMIC_MACRO_EEPROM_DATA, used);
+}
+
+/* Save the macros, only the changed bytes are written. */
+void dynamic_macro_save(void)
+{
+    eeprom_update_word((uint16_t *)DYNAMIC_MACRO_EEPROM_ADDR, DYNAMIC_MACRO_EEPROM_MAGIC);
+    eeprom_update_block(&dynamic_macro_storage, (void *)DYNAMIC_MACRO_EEPROM_TABLE,
+        offsetof(dynamic_macro_storage_t, data));
+    eeprom_update_block(dynamic_macro_storage.data, (void *)DYNAMIC_MACRO_EEPROM_DATA,
+        dynamic_macro_used_bytes());
+}
+#endif
+
+/**
+ * Encode a key event.
+ *
+ * @param[out] out   At least DYNAMIC_MACRO_MAX_EVENT_SIZE bytes.
+ * @param[in]  record The event.
+ * @param[in]  delay The time since the previous event.
+ * @return The size of the encoded event.
  */
-#define DYNAMIC_MACRO_CURRENT_SLOT() (direction > 0 ? 1 : 2)
-#define DYNAMIC_MACRO_CURRENT_LENGTH(BEGIN, POINTER) \
-    ((int)(direction * ((POINTER) - (BEGIN))))
-#define DYNAMIC_MACRO_CURRENT_CAPACITY(BEGIN, END2) \
-    ((int)(direction * ((END2) - (BEGIN)) + 1))
+uint8_t dynamic_macro_encode(uint8_t *out, keyrecord_t *record, uint16_t delay)
+{
+    uint8_t size = 0;
+    uint32_t value = (uint32_t)delay << 1 | record->event.pressed;
+    do {
+        out[size] = value & 0x7F;
+        value >>= 7;
+        if (value) {
+            out[size] |= 0x80;
+        }
+        size++;
+    } while (value);
+
+    uint16_t key = record->event.key.row * MATRIX_COLS + record->event.key.col;
+    uint8_t tap = 0;
+#ifndef NO_ACTION_TAPPING
+    memcpy(&tap, &record->tap, 1);
+#endif
+    if (tap) {
+        key |= DYNAMIC_MACRO_TAP_FLAG;
+    }
+#if DYNAMIC_MACRO_KEY_BYTES == 2
+    out[size++] = key >> 8;
+#endif
+    out[size++] = key & 0xFF;
+    if (tap) {
+        out[size++] = tap;
+    }
+    return size;
+}
+
+/**
+ * Decode a key event.
+ *
+ * @param[in]  data   The encoded event.
+ * @param[out] record The event, without the time.
+ * @param[out] delay  The time since the previous event.
+ * @return The size of the encoded event.
+ */
+uint8_t dynamic_macro_decode(const uint8_t *data, keyrecord_t *record, uint16_t *delay)
+{
+    uint8_t size = 0;
+    uint32_t value = 0;
+    uint8_t shift = 0;
+    do {
+        value |= (uint32_t)(data[size] & 0x7F) << shift;
+        shift += 7;
+    } while (data[size++] & 0x80);
+    *delay = value >> 1;
+
+    memset(record, 0, sizeof(*record));
+    record->event.pressed = value & 1;
+    uint16_t key = data[size++];
+#if DYNAMIC_MACRO_KEY_BYTES == 2
+    key = key << 8 | data[size++];
+#endif
+    if (key & DYNAMIC_MACRO_TAP_FLAG) {
+#ifndef NO_ACTION_TAPPING
+        memcpy(&record->tap, &data[size], 1);
+#endif
+        size++;
+        key &= ~DYNAMIC_MACRO_TAP_FLAG;
+    }
+    record->event.key.row = key / MATRIX_COLS;
+    record->event.key.col = key % MATRIX_COLS;
+    return size;
+}
+
+/* Remove the macro in a slot, numbered from 0, and move the macros
+ * stored after it to close the gap. The slot is left empty at the end
+ * of the used space, ready to be recorded.
+ */
+void dynamic_macro_free(uint8_t slot)
+{
+    dynamic_macro_storage_t *s = &dynamic_macro_storage;
+    uint16_t offset = s->offset[slot];
+    uint16_t length = s->length[slot];
+    uint16_t used = dynamic_macro_used_bytes();
+
+    memmove(s->data + offset, s->data + offset + length, used - offset - length);
+    for (uint8_t i = 0; i < DYNAMIC_MACRO_SLOTS; i++) {
+        if (s->offset[i] > offset) {
+            s->offset[i] -= length;
+        }
+    }
+    s->offset[slot] = used - length;
+    s->length[slot] = 0;
+}
+
+/* Convenience macro used for retrieving the debug info. */
+#define DYNAMIC_MACRO_CURRENT_CAPACITY(SLOT) \
+    ((int)(DYNAMIC_MACRO_BYTES - dynamic_macro_used_bytes() + dynamic_macro_length(SLOT)))
 
 /**
  * Start recording of the dynamic macro.
  *
- * @param[out] macro_pointer The new macro buffer iterator.
- * @param[in]  macro_buffer  The macro buffer used to initialize macro_pointer.
+ * @param[in] slot The slot to record, numbered from 1.
  */
-void dynamic_macro_record_start(
-    keyrecord_t **macro_pointer, keyrecord_t *macro_buffer)
+void dynamic_macro_record_start(uint8_t slot)
 {
     dprintln("dynamic macro recording: started");
 
@@ -79,102 +353,179 @@ void dynamic_macro_record_start(
 
     clear_keyboard();
     layer_clear();
-    *macro_pointer = macro_buffer;
+    dynamic_macro_free(slot - 1);
+    dynamic_macro_trim_length = 0;
+    dynamic_macro_recording = slot;
 }
 
 /**
- * Play the dynamic macro.
+ * Start playing the dynamic macro, it's played by dynamic_macro_task().
  *
- * @param macro_buffer[in] The beginning of the macro buffer being played.
- * @param macro_end[in]    The element after the last macro buffer element.
- * @param direction[in]    Either +1 or -1, which way to iterate the buffer.
+ * @param[in] slot The slot to play, numbered from 1.
  */
-void dynamic_macro_play(
-    keyrecord_t *macro_buffer, keyrecord_t *macro_end, int8_t direction)
+void dynamic_macro_play(uint8_t slot)
 {
-    dprintf("dynamic macro: slot %d playback\n", DYNAMIC_MACRO_CURRENT_SLOT());
+    dprintf("dynamic macro: slot %d playback\n", slot);
 
-    uint32_t saved_layer_state = layer_state;
+    dynamic_macro_saved_layer_state = layer_state;
 
     clear_keyboard();
     layer_clear();
 
-    while (macro_buffer != macro_end) {
-        process_record(macro_buffer);
-        macro_buffer += direction;
-    }
+    dynamic_macro_play_pos = 0;
+    dynamic_macro_play_time = timer_read();
+    dynamic_macro_playing = slot;
+}
 
+/* End the playback, and process the key events that happened during
+ * it. */
+void dynamic_macro_play_end(void)
+{
     clear_keyboard();
 
-    layer_state = saved_layer_state;
+    layer_state = dynamic_macro_saved_layer_state;
+    dynamic_macro_playing = 0;
+
+    for (uint8_t i = 0; i < dynamic_macro_pending_count; i++) {
+        process_record(&dynamic_macro_pending[i]);
+    }
+    dynamic_macro_pending_count = 0;
+}
+
+/* Play the next event of the macro, if it's time for it. Called from
+ * the matrix scan.
+ */
+void dynamic_macro_task(void)
+{
+    if (!dynamic_macro_playing) {
+        return;
+    }
+
+    uint8_t slot = dynamic_macro_playing - 1;
+    if (dynamic_macro_play_pos == dynamic_macro_storage.length[slot]) {
+        dynamic_macro_play_end();
+        return;
+    }
+
+    keyrecord_t record;
+    uint16_t delay;
+    uint8_t size = dynamic_macro_decode(
+        dynamic_macro_storage.data + dynamic_macro_storage.offset[slot] + dynamic_macro_play_pos,
+        &record, &delay);
+    if (timer_elapsed(dynamic_macro_play_time) < delay) {
+        return;
+    }
+
+    dynamic_macro_play_time = timer_read();
+    dynamic_macro_play_pos += size;
+    record.event.time = dynamic_macro_play_time | 1;
+    dynamic_macro_playing_event = true;
+    process_record(&record);
+    dynamic_macro_playing_event = false;
 }
 
 /**
  * Record a single key in a dynamic macro.
  *
- * @param macro_buffer[in] The start of the used macro buffer.
- * @param macro_pointer[in,out] The current buffer position.
- * @param macro2_end[in] The end of the other macro.
- * @param direction[in]  Either +1 or -1, which way to iterate the buffer.
- * @param record[in]     The current keypress.
+ * @param record[in] The current keypress.
  */
-void dynamic_macro_record_key(
-    keyrecord_t *macro_buffer,
-    keyrecord_t **macro_pointer,
-    keyrecord_t *macro2_end,
-    int8_t direction,
-    keyrecord_t *record)
+void dynamic_macro_record_key(keyrecord_t *record)
 {
+    uint8_t slot = dynamic_macro_recording - 1;
+    dynamic_macro_storage_t *s = &dynamic_macro_storage;
+
     /* If we've just started recording, ignore all the key releases. */
-    if (!record->event.pressed && *macro_pointer == macro_buffer) {
+    if (!record->event.pressed && s->length[slot] == 0) {
         dprintln("dynamic macro: ignoring a leading key-up event");
         return;
     }
 
-    /* The other end of the other macro is the last buffer element it
-     * is safe to use before overwriting the other macro.
-     */
-    if (*macro_pointer - direction != macro2_end) {
-        **macro_pointer = *record;
-        *macro_pointer += direction;
+    uint16_t delay = 0;
+#if DYNAMIC_MACRO_MAX_DELAY > 0
+    if (s->length[slot] != 0) {
+        delay = TIMER_DIFF_16(record->event.time, dynamic_macro_last_time);
+        if (delay > DYNAMIC_MACRO_MAX_DELAY) {
+            delay = DYNAMIC_MACRO_MAX_DELAY;
+        }
+    }
+#endif
+    dynamic_macro_last_time = record->event.time;
+
+    /* The macro being recorded is always the last one in the buffer. */
+    uint8_t event[DYNAMIC_MACRO_MAX_EVENT_SIZE];
+    uint8_t size = dynamic_macro_encode(event, record, delay);
+    if (dynamic_macro_used_bytes() + size <= DYNAMIC_MACRO_BYTES) {
+        memcpy(s->data + s->offset[slot] + s->length[slot], event, size);
+        s->length[slot] += size;
+        if (!record->event.pressed) {
+            dynamic_macro_trim_length = s->length[slot];
+        }
     } else {
         dynamic_macro_led_blink();
     }
 
     dprintf(
         "dynamic macro: slot %d length: %d/%d\n",
-        DYNAMIC_MACRO_CURRENT_SLOT(),
-        DYNAMIC_MACRO_CURRENT_LENGTH(macro_buffer, *macro_pointer),
-        DYNAMIC_MACRO_CURRENT_CAPACITY(macro_buffer, macro2_end));
+        dynamic_macro_recording,
+        (int)s->length[slot],
+        DYNAMIC_MACRO_CURRENT_CAPACITY(dynamic_macro_recording));
 }
 
 /**
- * End recording of the dynamic macro. Essentially just update the
- * pointer to the end of the macro.
+ * End recording of the dynamic macro.
  */
-void dynamic_macro_record_end(
-    keyrecord_t *macro_buffer,
-    keyrecord_t *macro_pointer,
-    int8_t direction,
-    keyrecord_t **macro_end)
+void dynamic_macro_record_end(void)
 {
+    uint8_t slot = dynamic_macro_recording - 1;
+
     dynamic_macro_led_blink();
 
     /* Do not save the keys being held when stopping the recording,
      * i.e. the keys used to access the layer DYN_REC_STOP is on.
      */
-    while (macro_pointer != macro_buffer &&
-           (macro_pointer - direction)->event.pressed) {
-        dprintln("dynamic macro: trimming a trailing key-down event");
-        macro_pointer -= direction;
+    if (dynamic_macro_storage.length[slot] != dynamic_macro_trim_length) {
+        dprintln("dynamic macro: trimming the trailing key-down events");
+        dynamic_macro_storage.length[slot] = dynamic_macro_trim_length;
     }
 
     dprintf(
         "dynamic macro: slot %d saved, length: %d\n",
-        DYNAMIC_MACRO_CURRENT_SLOT(),
-        DYNAMIC_MACRO_CURRENT_LENGTH(macro_buffer, macro_pointer));
+        dynamic_macro_recording,
+        (int)dynamic_macro_storage.length[slot]);
+
+    dynamic_macro_recording = 0;
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+    dynamic_macro_save();
+#endif
+}
+
+/* The slot of a record or play keycode, numbered from 1, or 0. */
+uint8_t dynamic_macro_record_slot(uint16_t keycode)
+{
+    switch (keycode) {
+    case DYN_REC_START1:
+        return 1;
+    case DYN_REC_START2:
+        return 2;
+    }
+    if (keycode >= DYN_REC_START_EXTRA && keycode < DYN_MACRO_PLAY_EXTRA) {
+        return keycode - DYN_REC_START_EXTRA + 3;
+    }
+    return 0;
+}
 
-    *macro_end = macro_pointer;
+uint8_t dynamic_macro_play_slot(uint16_t keycode)
+{
+    switch (keycode) {
+    case DYN_MACRO_PLAY1:
+        return 1;
+    case DYN_MACRO_PLAY2:
+        return 2;
+    }
+    if (keycode >= DYN_MACRO_PLAY_EXTRA && keycode < DYN_MACRO_PLAY_EXTRA + DYNAMIC_MACRO_SLOTS - 2) {
+        return keycode - DYN_MACRO_PLAY_EXTRA + 3;
+    }
+    return 0;
 }
 
 /* Handle the key events related to the dynamic macros. Should be
@@ -189,115 +540,64 @@ void dynamic_macro_record_end(
  */
 bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
 {
-    /* Both macros use the same buffer but read/write on different
-     * ends of it.
-     *
-     * Macro1 is written left-to-right starting from the beginning of
-     * the buffer.
-     *
-     * Macro2 is written right-to-left starting from the end of the
-     * buffer.
-     *
-     * &macro_buffer   macro_end
-     *  v                   v
-     * +------------------------------------------------------------+
-     * |>>>>>> MACRO1 >>>>>>      <<<<<<<<<<<<< MACRO2 <<<<<<<<<<<<<|
-     * +------------------------------------------------------------+
-     *                           ^                                 ^
-     *                         r_macro_end                  r_macro_buffer
-     *
-     * During the recording when one macro encounters the end of the
-     * other macro, the recording is stopped. Apart from this, there
-     * are no arbitrary limits for the macros' length in relation to
-     * each other: for example one can either have two medium sized
-     * macros or one long macro and one short macro. Or even one empty
-     * and one using the whole buffer.
-     */
-    static keyrecord_t macro_buffer[DYNAMIC_MACRO_SIZE];
-
-    /* Pointer to the first buffer element after the first macro.
-     * Initially points to the very beginning of the buffer since the
-     * macro is empty. */
-    static keyrecord_t *macro_end = macro_buffer;
-
-    /* The other end of the macro buffer. Serves as the beginning of
-     * the second macro. */
-    static keyrecord_t *const r_macro_buffer = macro_buffer + DYNAMIC_MACRO_SIZE - 1;
-
-    /* Like macro_end but for the second macro. */
-    static keyrecord_t *r_macro_end = r_macro_buffer;
-
-    /* A persistent pointer to the current macro position (iterator)
-     * used during the recording. */
-    static keyrecord_t *macro_pointer = NULL;
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+    if (!dynamic_macro_loaded) {
+        dynamic_macro_load();
+    }
+#endif
 
-    /* 0   - no macro is being recorded right now
-     * 1,2 - either macro 1 or 2 is being recorded */
-    static uint8_t macro_id = 0;
+    if (dynamic_macro_playing) {
+        /* The events of the macro itself are processed normally. */
+        if (dynamic_macro_playing_event) {
+            return true;
+        }
+        /* DYN_REC_STOP stops the playback, other keys wait for it. */
+        if (keycode == DYN_REC_STOP ||
+            dynamic_macro_pending_count == DYNAMIC_MACRO_PENDING_EVENTS) {
+            dprintln("dynamic macro: playback stopped");
+            dynamic_macro_play_end();
+            return keycode != DYN_REC_STOP;
+        }
+        dynamic_macro_pending[dynamic_macro_pending_count++] = *record;
+        return false;
+    }
 
-    if (macro_id == 0) {
+    uint8_t slot;
+    if (dynamic_macro_recording == 0) {
         /* No macro recording in progress. */
         if (!record->event.pressed) {
-            switch (keycode) {
-            case DYN_REC_START1:
-                dynamic_macro_record_start(&macro_pointer, macro_buffer);
-                macro_id = 1;
-                return false;
-            case DYN_REC_START2:
-                dynamic_macro_record_start(&macro_pointer, r_macro_buffer);
-                macro_id = 2;
+            if ((slot = dynamic_macro_record_slot(keycode))) {
+                dynamic_macro_record_start(slot);
                 return false;
-            case DYN_MACRO_PLAY1:
-                dynamic_macro_play(macro_buffer, macro_end, +1);
-                return false;
-            case DYN_MACRO_PLAY2:
-                dynamic_macro_play(r_macro_buffer, r_macro_end, -1);
+            }
+            if ((slot = dynamic_macro_play_slot(keycode))) {
+                dynamic_macro_play(slot);
                 return false;
             }
         }
     } else {
         /* A macro is being recorded right now. */
-        switch (keycode) {
-        case DYN_REC_STOP:
+        if (keycode == DYN_REC_STOP) {
             /* Stop the macro recording. */
             if (record->event.pressed) { /* Ignore the initial release
                                           * just after the recoding
                                           * starts. */
-                switch (macro_id) {
-                case 1:
-                    dynamic_macro_record_end(macro_buffer, macro_pointer, +1, &macro_end);
-                    break;
-                case 2:
-                    dynamic_macro_record_end(r_macro_buffer, macro_pointer, -1, &r_macro_end);
-                    break;
-                }
-                macro_id = 0;
+                dynamic_macro_record_end();
             }
             return false;
-        case DYN_MACRO_PLAY1:
-        case DYN_MACRO_PLAY2:
+        }
+        if (dynamic_macro_play_slot(keycode)) {
             dprintln("dynamic macro: ignoring macro play key while recording");
             return false;
-        default:
-            /* Store the key in the macro buffer and process it normally. */
-            switch (macro_id) {
-            case 1:
-                dynamic_macro_record_key(macro_buffer, &macro_pointer, r_macro_end, +1, record);
-                break;
-            case 2:
-                dynamic_macro_record_key(r_macro_buffer, &macro_pointer, macro_end, -1, record);
-                break;
-            }
-            return true;
-            break;
         }
+        /* Store the key in the macro buffer and process it normally. */
+        dynamic_macro_record_key(record);
+        return true;
     }
 
     return true;
 }
 
-#undef DYNAMIC_MACRO_CURRENT_SLOT
-#undef DYNAMIC_MACRO_CURRENT_LENGTH
 #undef DYNAMIC_MACRO_CURRENT_CAPACITY
 
 #endif
@@ -25,6 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util.h"
 #include "matrix.h"
 #include "timer.h"
+#include "matrix_gather.h"
 
 
 /* Set 0 if debouncing isn't needed */
@@ -274,6 +275,11 @@ uint8_t matrix_key_count(void)
 
 #if (DIODE_DIRECTION == COL2ROW)
 
+static inline uint8_t read_port(uint8_t port)
+{
+    return _SFR_IO8(port);
+}
+
 static void init_cols(void)
 {
     for(uint8_t x = 0; x < MATRIX_COLS; x++) {
@@ -288,23 +294,14 @@ static bool read_cols_on_row(matrix_row_t current_matrix[], uint8_t current_row)
     // Store last value of row prior to reading
     matrix_row_t last_row_value = current_matrix[current_row];
 
-    // Clear data in matrix row
-    current_matrix[current_row] = 0;
-
     // Select row and wait for row selecton to stabilize
     select_row(current_row);
     wait_us(30);
 
-    // For each col...
-    for(uint8_t col_index = 0; col_index < MATRIX_COLS; col_index++) {
-
-        // Select the col pin to read (active low)
-        uint8_t pin = col_pins[col_index];
-        uint8_t pin_state = (_SFR_IO8(pin >> 4) & _BV(pin & 0xF));
-
-        // Populate the matrix row with the state of the col pin
-        current_matrix[current_row] |=  pin_state ? 0 : (ROW_SHIFTER << col_index);
-    }
+    // Read the col pins (active low), one read per port, see matrix_gather.h
+    matrix_row_t cols;
+    MATRIX_GATHER(col_pins, MATRIX_COLS, read_port, cols);
+    current_matrix[current_row] = cols;
 
     // Unselect row
     unselect_row(current_row);
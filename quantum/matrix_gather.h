@@ -0,0 +1,145 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+// Reads all the column pins of a row with one read per GPIO port
+//
+//     MATRIX_GATHER(pins, count, read, result)
+//
+// pins are the count column pins, in the format of config_common.h, the
+// port in the high nibble and the bit in the low nibble. read(port) reads
+// the input register of a port, _SFR_IO8(port) on AVR. The pins are active
+// low, so result gets a 1 for the columns whose pin reads 0.
+//
+// The macro expands to straight-line code for up to 32 columns: every port
+// that has a column pin is read once, and every run of columns on
+// consecutive bits of a port is moved into result with one mask and one
+// shift. pins has to be a static const array, so that the compiler can work
+// out the ports, masks and shifts, and drop the code for unused ports and
+// columns, which leaves only the reads, masks and shifts.
+#include <stdint.h>
+
+#define MATRIX_GATHER_PIN(pins, count, n)   ((pins)[(unsigned)(n) < (unsigned)(count) ? (n) : 0])
+#define MATRIX_GATHER_PORT(pins, count, n)  (MATRIX_GATHER_PIN(pins, count, n) >> 4)
+#define MATRIX_GATHER_BIT(pins, count, n)   (MATRIX_GATHER_PIN(pins, count, n) & 0xF)
+
+// column n is on the port of column n - 1, on the next bit
+#define MATRIX_GATHER_NEXT(pins, count, n) ((n) > 0 && (n) < (count) && \
+    MATRIX_GATHER_PORT(pins, count, n) == MATRIX_GATHER_PORT(pins, count, (n) - 1) && \
+    MATRIX_GATHER_BIT(pins, count, n) == MATRIX_GATHER_BIT(pins, count, (n) - 1) + 1)
+
+// the length of the run that starts at column n, at most the 8 bits of a port
+#define MATRIX_GATHER_RUN(pins, count, n) (1 + \
+    (MATRIX_GATHER_NEXT(pins, count, (n) + 1) ? 1 + \
+    (MATRIX_GATHER_NEXT(pins, count, (n) + 2) ? 1 + \
+    (MATRIX_GATHER_NEXT(pins, count, (n) + 3) ? 1 + \
+    (MATRIX_GATHER_NEXT(pins, count, (n) + 4) ? 1 + \
+    (MATRIX_GATHER_NEXT(pins, count, (n) + 5) ? 1 + \
+    (MATRIX_GATHER_NEXT(pins, count, (n) + 6) ? 1 + \
+    (MATRIX_GATHER_NEXT(pins, count, (n) + 7) ? 1 + \
+    0 : 0) : 0) : 0) : 0) : 0) : 0) : 0))
+
+#define MATRIX_GATHER_MASK(pins, count, n) \
+    ((uint8_t)(((1 << MATRIX_GATHER_RUN(pins, count, n)) - 1) << MATRIX_GATHER_BIT(pins, count, n)))
+
+// the shift is a constant, and is never negative in the branch that is used
+#define MATRIX_GATHER_SHIFT(type, value, shift) ((shift) >= 0 ? \
+    (type)((type)(value) << ((shift) >= 0 ? (shift) : 0)) : \
+    (type)((value) >> ((shift) < 0 ? -(shift) : 0)))
+
+#define MATRIX_GATHER_COL(pins, count, values, result, n) \
+    if ((n) < (count) && !MATRIX_GATHER_NEXT(pins, count, n)) { \
+        result |= MATRIX_GATHER_SHIFT(__typeof__(result), \
+            (values)[MATRIX_GATHER_PORT(pins, count, n)] & MATRIX_GATHER_MASK(pins, count, n), \
+            (int8_t)(n) - (int8_t)MATRIX_GATHER_BIT(pins, count, n)); \
+    }
+
+#define MATRIX_GATHER_ON(pins, count, port, n) ((n) < (count) && MATRIX_GATHER_PORT(pins, count, n) == (port))
+
+#define MATRIX_GATHER_USES(pins, count, port) ( \
+    MATRIX_GATHER_ON(pins, count, port, 0) || MATRIX_GATHER_ON(pins, count, port, 1) || \
+    MATRIX_GATHER_ON(pins, count, port, 2) || MATRIX_GATHER_ON(pins, count, port, 3) || \
+    MATRIX_GATHER_ON(pins, count, port, 4) || MATRIX_GATHER_ON(pins, count, port, 5) || \
+    MATRIX_GATHER_ON(pins, count, port, 6) || MATRIX_GATHER_ON(pins, count, port, 7) || \
+    MATRIX_GATHER_ON(pins, count, port, 8) || MATRIX_GATHER_ON(pins, count, port, 9) || \
+    MATRIX_GATHER_ON(pins, count, port, 10) || MATRIX_GATHER_ON(pins, count, port, 11) || \
+    MATRIX_GATHER_ON(pins, count, port, 12) || MATRIX_GATHER_ON(pins, count, port, 13) || \
+    MATRIX_GATHER_ON(pins, count, port, 14) || MATRIX_GATHER_ON(pins, count, port, 15) || \
+    MATRIX_GATHER_ON(pins, count, port, 16) || MATRIX_GATHER_ON(pins, count, port, 17) || \
+    MATRIX_GATHER_ON(pins, count, port, 18) || MATRIX_GATHER_ON(pins, count, port, 19) || \
+    MATRIX_GATHER_ON(pins, count, port, 20) || MATRIX_GATHER_ON(pins, count, port, 21) || \
+    MATRIX_GATHER_ON(pins, count, port, 22) || MATRIX_GATHER_ON(pins, count, port, 23) || \
+    MATRIX_GATHER_ON(pins, count, port, 24) || MATRIX_GATHER_ON(pins, count, port, 25) || \
+    MATRIX_GATHER_ON(pins, count, port, 26) || MATRIX_GATHER_ON(pins, count, port, 27) || \
+    MATRIX_GATHER_ON(pins, count, port, 28) || MATRIX_GATHER_ON(pins, count, port, 29) || \
+    MATRIX_GATHER_ON(pins, count, port, 30) || MATRIX_GATHER_ON(pins, count, port, 31))
+
+#define MATRIX_GATHER_READ(pins, count, read, values, port) \
+    if (MATRIX_GATHER_USES(pins, count, port)) { \
+        (values)[port] = ~read(port); \
+    }
+
+#define MATRIX_GATHER(pins, count, read, result) do { \
+    uint8_t matrix_gather_values_[16]; \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0x0) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0x1) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0x2) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0x3) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0x4) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0x5) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0x6) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0x7) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0x8) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0x9) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0xA) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0xB) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0xC) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0xD) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0xE) \
+    MATRIX_GATHER_READ(pins, count, read, matrix_gather_values_, 0xF) \
+    result = 0; \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 0) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 1) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 2) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 3) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 4) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 5) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 6) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 7) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 8) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 9) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 10) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 11) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 12) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 13) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 14) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 15) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 16) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 17) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 18) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 19) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 20) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 21) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 22) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 23) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 24) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 25) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 26) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 27) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 28) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 29) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 30) \
+    MATRIX_GATHER_COL(pins, count, matrix_gather_values_, result, 31) \
+} while (0)
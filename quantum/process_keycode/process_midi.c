@@ -17,22 +17,43 @@
 
 #ifdef MIDI_ENABLE
 #include "midi.h"
+#include "midi_output.h"
+
+#if defined(MIDI_BASIC) || defined(MIDI_ADVANCED)
+
+// The notes that are on, so that only those are turned off again
+static midi_note_set_t held_notes;
+
+static void release_held_notes(uint8_t channel)
+{
+    uint8_t note;
+    while ((note = midi_note_set_pop(&held_notes)) != MIDI_NOTE_NONE)
+    {
+        midi_send_noteoff(&midi_device, channel, note, 0);
+    }
+}
+
+#endif
 
 #ifdef MIDI_BASIC
 
 void process_midi_basic_noteon(uint8_t note) 
 {
-    midi_send_noteon(&midi_device, 0, note, 128);
+    midi_send_noteon(&midi_device, 0, note, 127);
+    midi_note_set_add(&held_notes, note);
 }
 
 void process_midi_basic_noteoff(uint8_t note)
 {
-    midi_send_noteoff(&midi_device, 0, note, 0);
+    if (midi_note_set_remove(&held_notes, note))
+    {
+        midi_send_noteoff(&midi_device, 0, note, 0);
+    }
 }
 
 void process_midi_all_notes_off(void)
 {
-    midi_send_cc(&midi_device, 0, 0x7B, 0);
+    release_held_notes(0);
 }
 
 #endif // MIDI_BASIC
@@ -49,7 +70,9 @@ static uint16_t midi_modulation_timer;
 
 inline uint8_t compute_velocity(uint8_t setting)
 {
-    return (setting + 1) * (128 / (MIDI_VELOCITY_MAX - MIDI_VELOCITY_MIN + 1));
+    // the highest setting would be 128, which is out of range
+    uint8_t velocity = (setting + 1) * (128 / (MIDI_VELOCITY_MAX - MIDI_VELOCITY_MIN + 1));
+    return velocity > 127 ? 127 : velocity;
 }
 
 void midi_init(void)
@@ -64,6 +87,7 @@ void midi_init(void)
     {
         tone_status[i] = MIDI_INVALID_NOTE;
     }
+    midi_note_set_clear(&held_notes);
 
     midi_modulation = 0;
     midi_modulation_step = 0;
@@ -112,10 +136,12 @@ bool process_midi(uint16_t keycode, keyrecord_t *record)
                 midi_send_noteon(&midi_device, channel, note, velocity);
                 dprintf("midi noteon channel:%d note:%d velocity:%d\n", channel, note, velocity);
                 tone_status[tone] = note;
+                midi_note_set_add(&held_notes, note);
             }
             else {
                 uint8_t note = tone_status[tone];
-                if (note != MIDI_INVALID_NOTE)
+                // the note may have been turned off by MI_ALLOFF already
+                if (note != MIDI_INVALID_NOTE && midi_note_set_remove(&held_notes, note))
                 {
                     midi_send_noteoff(&midi_device, channel, note, velocity);
                     dprintf("midi noteoff channel:%d note:%d velocity:%d\n", channel, note, velocity);
@@ -201,6 +227,7 @@ bool process_midi(uint16_t keycode, keyrecord_t *record)
             return false;
         case MI_ALLOFF:
             if (record->event.pressed) {
+                release_held_notes(midi_config.channel);
                 midi_send_cc(&midi_device, midi_config.channel, 0x7B, 0);
                 dprintf("midi all notes off\n");
             }
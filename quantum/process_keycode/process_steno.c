@@ -17,7 +17,12 @@
 #include "quantum_keycodes.h"
 #include "eeprom.h"
 #include "keymap_steno.h"
+#ifdef VIRTSER_ENABLE
 #include "virtser.h"
+#endif
+#ifdef STENO_HID_ENABLE
+#include "steno_hid.h"
+#endif
 
 // TxBolt Codes
 #define TXB_NUL 0
@@ -57,9 +62,23 @@
 #define GEMINI_STATE_SIZE 6
 #define MAX_STATE_SIZE GEMINI_STATE_SIZE
 
-uint8_t state[MAX_STATE_SIZE] = {0};
-uint8_t pressed = 0;
-steno_mode_t mode;
+#if (STENO_QUEUE_SIZE & (STENO_QUEUE_SIZE - 1)) != 0
+#error "STENO_QUEUE_SIZE must be a power of two"
+#endif
+
+// The stroke in progress, and the keys of it that are still held
+static steno_stroke_t stroke;
+static uint8_t pressed = 0;
+// Whether keys have been added to the stroke since it was last queued
+static bool stroke_dirty = false;
+static steno_mode_t mode;
+static steno_chord_end_t chord_end = STENO_ALL_UP;
+
+// Complete strokes waiting to be sent by steno_task
+static steno_stroke_t queue[STENO_QUEUE_SIZE];
+static uint8_t queue_head;
+static uint8_t queue_tail;
+static uint16_t queue_dropped;
 
 uint8_t boltmap[64] = {
   TXB_NUL, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM,
@@ -71,52 +90,179 @@ uint8_t boltmap[64] = {
 };
 
 void steno_clear_state(void) {
-  __builtin_memset(state, 0, sizeof(state));
+  __builtin_memset(&stroke, 0, sizeof(stroke));
+  stroke_dirty = false;
+}
+
+// Bolt and GeminiPR need the virtual serial port
+static bool mode_supported(steno_mode_t m) {
+  switch (m) {
+#ifdef VIRTSER_ENABLE
+    case STENO_MODE_BOLT:
+    case STENO_MODE_GEMINI:
+      return true;
+#endif
+#ifdef STENO_HID_ENABLE
+    case STENO_MODE_HID:
+      return true;
+#endif
+    default:
+      return false;
+  }
 }
 
 void steno_init() {
   if (!eeconfig_is_enabled()) {
     eeconfig_init();
   }
-  mode = eeprom_read_byte(EECONFIG_STENOMODE);
+  mode = eeconfig_read_byte(EECONFIG_STENOMODE);
+  if (!mode_supported(mode)) {
+#ifdef VIRTSER_ENABLE
+    mode = STENO_MODE_BOLT;
+#else
+    mode = STENO_MODE_HID;
+#endif
+  }
 }
 
 void steno_set_mode(steno_mode_t new_mode) {
+  if (!mode_supported(new_mode)) {
+    return;
+  }
   steno_clear_state();
   mode = new_mode;
-  eeprom_update_byte(EECONFIG_STENOMODE, mode);
+  eeconfig_update_byte(EECONFIG_STENOMODE, mode);
+}
+
+void steno_set_chord_end(steno_chord_end_t new_chord_end) {
+  chord_end = new_chord_end;
+}
+
+uint8_t steno_queued_strokes(void) {
+  return (uint8_t)(queue_head - queue_tail);
+}
+
+uint16_t steno_dropped_strokes(void) {
+  return queue_dropped;
+}
+
+__attribute__((weak))
+void steno_stroke_user(const steno_stroke_t *stroke) {
+}
+
+static void queue_stroke(uint16_t time) {
+  stroke.end = time;
+  steno_stroke_user(&stroke);
+  if (steno_queued_strokes() < STENO_QUEUE_SIZE) {
+    queue[queue_head & (STENO_QUEUE_SIZE - 1)] = stroke;
+    queue_head++;
+  } else {
+    queue_dropped++;
+  }
+  steno_clear_state();
 }
 
-void send_steno_state(uint8_t size, bool send_empty) {
+#ifdef VIRTSER_ENABLE
+static void send_steno_state(const uint8_t *state, uint8_t size, bool send_empty) {
   for (uint8_t i = 0; i < size; ++i) {
     if (state[i] || send_empty) {
       virtser_send(state[i]);
     }
   }
-  steno_clear_state();
-}
-
-bool update_state_bolt(uint8_t key) {
-  uint8_t boltcode = boltmap[key];
-  state[TXB_GET_GROUP(boltcode)] |= boltcode;
-  return false;
 }
 
-bool send_state_bolt(void) {
-  send_steno_state(BOLT_STATE_SIZE, false);
+static void send_stroke_bolt(const steno_stroke_t *stroke) {
+  uint8_t state[BOLT_STATE_SIZE] = {0};
+  for (uint8_t key = 0; key <= STN__MAX - STN__MIN; key++) {
+    if (stroke->keys[key / 8] & (1 << (key % 8))) {
+      uint8_t boltcode = boltmap[key];
+      state[TXB_GET_GROUP(boltcode)] |= boltcode;
+    }
+  }
+  send_steno_state(state, BOLT_STATE_SIZE, false);
   virtser_send(0); // terminating byte
-  return false;
 }
+#endif
 
-bool update_state_gemini(uint8_t key) {
-  state[key / 7] |= 1 << (6 - (key % 7));
-  return false;
+#ifdef STENO_HID_ENABLE
+// The Plover HID key of each steno keycode
+static const uint8_t hidmap[STN__MAX - STN__MIN + 1] = {
+  STENO_HID_X1, STENO_HID_N1, STENO_HID_N1 + 1, STENO_HID_N1 + 2, STENO_HID_N1 + 3, STENO_HID_N1 + 4, STENO_HID_N1 + 5,
+  STENO_HID_S1, STENO_HID_S2, STENO_HID_TL, STENO_HID_KL, STENO_HID_PL, STENO_HID_WL, STENO_HID_HL,
+  STENO_HID_RL, STENO_HID_A, STENO_HID_O, STENO_HID_ST1, STENO_HID_ST2, STENO_HID_RES1, STENO_HID_RES2,
+  STENO_HID_PWR, STENO_HID_ST3, STENO_HID_ST4, STENO_HID_E, STENO_HID_U, STENO_HID_FR, STENO_HID_RR,
+  STENO_HID_PR, STENO_HID_BR, STENO_HID_LR, STENO_HID_GR, STENO_HID_TR, STENO_HID_SR, STENO_HID_DR,
+  STENO_HID_N1 + 6, STENO_HID_N1 + 7, STENO_HID_N1 + 8, STENO_HID_N1 + 9, STENO_HID_N1 + 10, STENO_HID_NC, STENO_HID_ZR
+};
+
+// Whether the keys of the stroke have been sent, and the all up report
+// that ends it for the host is still to be sent
+static bool hid_keys_sent;
+
+static bool send_stroke_hid(const steno_stroke_t *stroke) {
+  uint8_t report[STENO_HID_REPORT_SIZE];
+  if (!hid_keys_sent) {
+    steno_hid_clear(report);
+    for (uint8_t key = 0; key <= STN__MAX - STN__MIN; key++) {
+      if (stroke->keys[key / 8] & (1 << (key % 8))) {
+        steno_hid_set_key(report, hidmap[key]);
+      }
+    }
+    if (!steno_hid_try_send(report)) {
+      return false;
+    }
+    hid_keys_sent = true;
+  }
+  steno_hid_clear(report);
+  if (!steno_hid_try_send(report)) {
+    return false;
+  }
+  hid_keys_sent = false;
+  return true;
 }
+#endif
 
-bool send_state_gemini(void) {
+#ifdef VIRTSER_ENABLE
+static void send_stroke_gemini(const steno_stroke_t *stroke) {
+  uint8_t state[GEMINI_STATE_SIZE] = {0};
+  for (uint8_t key = 0; key <= STN__MAX - STN__MIN; key++) {
+    if (stroke->keys[key / 8] & (1 << (key % 8))) {
+      state[key / 7] |= 1 << (6 - (key % 7));
+    }
+  }
   state[0] |= 0x80; // Indicate start of packet
-  send_steno_state(GEMINI_STATE_SIZE, true);
-  return false;
+  send_steno_state(state, GEMINI_STATE_SIZE, true);
+}
+#endif
+
+// Sends one queued stroke per call, so that a burst of strokes doesn't
+// hold up the scanning
+void steno_task(void) {
+  if (queue_head == queue_tail) {
+    return;
+  }
+  const steno_stroke_t *next = &queue[queue_tail & (STENO_QUEUE_SIZE - 1)];
+  switch(mode) {
+#ifdef VIRTSER_ENABLE
+    case STENO_MODE_BOLT:
+      send_stroke_bolt(next);
+      break;
+    case STENO_MODE_GEMINI:
+      send_stroke_gemini(next);
+      break;
+#endif
+#ifdef STENO_HID_ENABLE
+    case STENO_MODE_HID:
+      if (!send_stroke_hid(next)) {
+        // The endpoint is busy, try again on the next scan
+        return;
+      }
+      break;
+#endif
+    default:
+      break;
+  }
+  queue_tail++;
 }
 
 bool process_steno(uint16_t keycode, keyrecord_t *record) {
@@ -133,33 +279,32 @@ bool process_steno(uint16_t keycode, keyrecord_t *record) {
       }
       return false;
 
+#ifdef STENO_HID_ENABLE
+    case QK_STENO_HID:
+      if (IS_PRESSED(record->event)) {
+        steno_set_mode(STENO_MODE_HID);
+      }
+      return false;
+#endif
+
     case STN__MIN...STN__MAX:
       if (IS_PRESSED(record->event)) {
         uint8_t key = keycode - QK_STENO;
-        ++pressed;
-        switch(mode) {
-          case STENO_MODE_BOLT:
-            return update_state_bolt(key);
-          case STENO_MODE_GEMINI:
-            return update_state_gemini(key);
-          default:
-            return false;
+        if (!stroke_dirty) {
+          stroke.start = record->event.time;
         }
+        stroke.keys[key / 8] |= 1 << (key % 8);
+        stroke_dirty = true;
+        ++pressed;
       } else {
-        --pressed;
-        if (pressed <= 0) {
-          pressed = 0;
-          switch(mode) {
-            case STENO_MODE_BOLT:
-              return send_state_bolt();
-            case STENO_MODE_GEMINI:
-              return send_state_gemini();
-            default:
-              return false;
-          }
+        if (pressed > 0) {
+          --pressed;
+        }
+        if (stroke_dirty && (pressed == 0 || chord_end == STENO_FIRST_UP)) {
+          queue_stroke(record->event.time);
         }
       }
-
+      return false;
   }
   return true;
 }
@@ -18,14 +18,44 @@
 
 #include "quantum.h"
 
-#if defined(STENO_ENABLE) && !defined(VIRTSER_ENABLE)
-  #error "must have virtser enabled to use steno"
+#if defined(STENO_ENABLE) && !defined(VIRTSER_ENABLE) && !defined(STENO_HID_ENABLE)
+  #error "must have virtser or steno HID enabled to use steno"
 #endif
 
-typedef enum { STENO_MODE_BOLT, STENO_MODE_GEMINI } steno_mode_t;
+#ifndef STENO_QUEUE_SIZE
+#define STENO_QUEUE_SIZE 8
+#endif
+
+typedef enum { STENO_MODE_BOLT, STENO_MODE_GEMINI, STENO_MODE_HID } steno_mode_t;
+
+// When a stroke is complete: when all of its keys have been released, or
+// as soon as any of them is
+typedef enum { STENO_ALL_UP, STENO_FIRST_UP } steno_chord_end_t;
+
+typedef struct {
+  // A bit for each key, in steno keycode order
+  uint8_t keys[6];
+  // The times of the first press and of the release ending the stroke
+  uint16_t start;
+  uint16_t end;
+} steno_stroke_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 bool process_steno(uint16_t keycode, keyrecord_t *record);
 void steno_init(void);
 void steno_set_mode(steno_mode_t mode);
+void steno_set_chord_end(steno_chord_end_t chord_end);
+void steno_task(void);
+uint8_t steno_queued_strokes(void);
+uint16_t steno_dropped_strokes(void);
+// Called when a stroke is complete, before it is queued
+void steno_stroke_user(const steno_stroke_t *stroke);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
\ No newline at end of file
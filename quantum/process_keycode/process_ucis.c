@@ -15,44 +15,131 @@
  */
 
 #include "process_ucis.h"
+#include <string.h>
 
 qk_ucis_state_t qk_ucis_state;
 
+// The symbols matching the typed prefix are ucis_symbol_table[match_lo]
+// to ucis_symbol_table[match_hi - 1], when the table is sorted
+static uint16_t match_lo;
+static uint16_t match_hi;
+static uint16_t table_size;
+static bool table_sorted;
+
+static void init_table(void) {
+  if (table_size) {
+    return;
+  }
+  table_sorted = true;
+  while (ucis_symbol_table[table_size].symbol) {
+    if (table_size &&
+        strcmp(ucis_symbol_table[table_size - 1].symbol, ucis_symbol_table[table_size].symbol) > 0) {
+      table_sorted = false;
+    }
+    table_size++;
+  }
+}
+
+static char keycode_to_char(uint16_t keycode) {
+  if (keycode == KC_0)
+    return '0';
+  if (KC_1 <= keycode && keycode <= KC_9)
+    return keycode - KC_1 + '1';
+  if (KC_A <= keycode && keycode <= KC_Z)
+    return keycode - KC_A + 'a';
+  // Can't be in a symbol
+  return 0xFF;
+}
+
+// Narrows the match range to the symbols having the character c at
+// position pos, all of them share the characters before it
+static void narrow(uint8_t pos, char c) {
+  uint16_t lo = match_lo;
+  uint16_t hi = match_hi;
+  while (lo < hi) {
+    uint16_t mid = lo + (hi - lo) / 2;
+    if ((uint8_t)ucis_symbol_table[mid].symbol[pos] < (uint8_t)c)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  match_lo = lo;
+  hi = match_hi;
+  while (lo < hi) {
+    uint16_t mid = lo + (hi - lo) / 2;
+    if ((uint8_t)ucis_symbol_table[mid].symbol[pos] <= (uint8_t)c)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  match_hi = lo;
+}
+
+static void narrow_all(void) {
+  match_lo = 0;
+  match_hi = table_size;
+  if (table_sorted) {
+    for (uint8_t i = 0; i < qk_ucis_state.count; i++) {
+      narrow(i, keycode_to_char(qk_ucis_state.codes[i]));
+    }
+  }
+}
+
+static bool is_uni_prefix(const char *seq) {
+  for (uint8_t i = 0; i < qk_ucis_state.count; i++) {
+    if (seq[i] != keycode_to_char(qk_ucis_state.codes[i]))
+      return false;
+  }
+  return true;
+}
+
+uint16_t qk_ucis_match_count(void) {
+  if (table_sorted) {
+    return match_hi - match_lo;
+  }
+  uint16_t matches = 0;
+  for (uint16_t i = 0; i < table_size; i++) {
+    if (is_uni_prefix(ucis_symbol_table[i].symbol))
+      matches++;
+  }
+  return matches;
+}
+
+const qk_ucis_symbol_t *qk_ucis_match(void) {
+  // An exact match sorts before the longer symbols with the same prefix
+  uint16_t end = table_size;
+  if (table_sorted) {
+    end = match_lo < match_hi ? match_lo + 1 : match_lo;
+  }
+  for (uint16_t i = match_lo; i < end; i++) {
+    const qk_ucis_symbol_t *symbol = &ucis_symbol_table[i];
+    if (is_uni_prefix(symbol->symbol) && !symbol->symbol[qk_ucis_state.count])
+      return symbol;
+  }
+  return NULL;
+}
+
 void qk_ucis_start(void) {
+  init_table();
   qk_ucis_state.count = 0;
   qk_ucis_state.in_progress = true;
+  narrow_all();
 
   qk_ucis_start_user();
 }
 
 __attribute__((weak))
 void qk_ucis_start_user(void) {
-  unicode_input_start();
-  register_hex(0x2328);
-  unicode_input_finish();
+  register_unicode(0x2328);
 }
 
-static bool is_uni_seq(char *seq) {
-  uint8_t i;
-
-  for (i = 0; seq[i]; i++) {
-    uint16_t code;
-    if (('1' <= seq[i]) && (seq[i] <= '0'))
-      code = seq[i] - '1' + KC_1;
-    else
-      code = seq[i] - 'a' + KC_A;
-
-    if (i > qk_ucis_state.count || qk_ucis_state.codes[i] != code)
-      return false;
-  }
-
-  return (qk_ucis_state.codes[i] == KC_ENT ||
-          qk_ucis_state.codes[i] == KC_SPC);
+__attribute__((weak))
+void qk_ucis_matches_user(uint16_t matches) {
 }
 
 __attribute__((weak))
 void qk_ucis_symbol_fallback (void) {
-  for (uint8_t i = 0; i < qk_ucis_state.count - 1; i++) {
+  for (uint8_t i = 0; i < qk_ucis_state.count; i++) {
     uint8_t code = qk_ucis_state.codes[i];
     register_code(code);
     unregister_code(code);
@@ -61,31 +148,27 @@ void qk_ucis_symbol_fallback (void) {
 }
 
 void register_ucis(const char *hex) {
+  uint32_t code_point = 0;
+  uint8_t digits = 0;
   for(int i = 0; hex[i]; i++) {
-    uint8_t kc = 0;
     char c = hex[i];
 
     switch (c) {
-    case '0':
-      kc = KC_0;
-      break;
-    case '1' ... '9':
-      kc = c - '1' + KC_1;
+    case '0' ... '9':
+      code_point = (code_point << 4) | (c - '0');
+      digits++;
       break;
     case 'a' ... 'f':
-      kc = c - 'a' + KC_A;
+      code_point = (code_point << 4) | (c - 'a' + 0xA);
+      digits++;
       break;
     case 'A' ... 'F':
-      kc = c - 'A' + KC_A;
+      code_point = (code_point << 4) | (c - 'A' + 0xA);
+      digits++;
       break;
     }
-
-    if (kc) {
-      register_code (kc);
-      unregister_code (kc);
-      wait_ms (UNICODE_TYPE_DELAY);
-    }
   }
+  register_hex_digits(code_point, digits);
 }
 
 bool process_ucis (uint16_t keycode, keyrecord_t *record) {
@@ -102,48 +185,44 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
   if (!record->event.pressed)
     return true;
 
-  qk_ucis_state.codes[qk_ucis_state.count] = keycode;
-  qk_ucis_state.count++;
-
   if (keycode == KC_BSPC) {
-    if (qk_ucis_state.count >= 2) {
-      qk_ucis_state.count -= 2;
+    if (qk_ucis_state.count >= 1) {
+      qk_ucis_state.count--;
+      narrow_all();
+      qk_ucis_matches_user(qk_ucis_match_count());
       return true;
     } else {
-      qk_ucis_state.count--;
       return false;
     }
   }
 
   if (keycode == KC_ENT || keycode == KC_SPC || keycode == KC_ESC) {
-    bool symbol_found = false;
-
-    for (i = qk_ucis_state.count; i > 0; i--) {
+    // The terminator has been typed too
+    for (i = qk_ucis_state.count + 1; i > 0; i--) {
       register_code (KC_BSPC);
       unregister_code (KC_BSPC);
       wait_ms(UNICODE_TYPE_DELAY);
     }
+    qk_ucis_state.in_progress = false;
 
     if (keycode == KC_ESC) {
-      qk_ucis_state.in_progress = false;
       return false;
     }
 
-    unicode_input_start();
-    for (i = 0; ucis_symbol_table[i].symbol; i++) {
-      if (is_uni_seq (ucis_symbol_table[i].symbol)) {
-        symbol_found = true;
-        register_ucis(ucis_symbol_table[i].code + 2);
-        break;
-      }
-    }
-    if (!symbol_found) {
+    const qk_ucis_symbol_t *symbol = qk_ucis_match();
+    if (symbol) {
+      register_unicode(symbol->code);
+    } else {
       qk_ucis_symbol_fallback();
     }
-    unicode_input_finish();
-
-    qk_ucis_state.in_progress = false;
     return false;
   }
+
+  qk_ucis_state.codes[qk_ucis_state.count] = keycode;
+  qk_ucis_state.count++;
+  if (table_sorted) {
+    narrow(qk_ucis_state.count - 1, keycode_to_char(keycode));
+  }
+  qk_ucis_matches_user(qk_ucis_match_count());
   return true;
 }
@@ -26,7 +26,7 @@
 
 typedef struct {
   char *symbol;
-  char *code;
+  uint32_t code;
 } qk_ucis_symbol_t;
 
 typedef struct {
@@ -35,17 +35,34 @@ typedef struct {
   bool in_progress:1;
 } qk_ucis_state_t;
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 extern qk_ucis_state_t qk_ucis_state;
 
-#define UCIS_TABLE(...) {__VA_ARGS__, {NULL, NULL}}
-#define UCIS_SYM(name, code) {name, #code}
+#define UCIS_TABLE(...) {__VA_ARGS__, {NULL, 0}}
+#define UCIS_SYM(name, code) {name, code}
 
+// The table should be sorted by the symbols, which makes looking them up
+// take a binary search per typed character. Unsorted tables are searched
+// entry by entry.
 extern const qk_ucis_symbol_t ucis_symbol_table[];
 
 void qk_ucis_start(void);
 void qk_ucis_start_user(void);
 void qk_ucis_symbol_fallback (void);
 void register_ucis(const char *hex);
+// The number of symbols starting with what has been typed so far
+uint16_t qk_ucis_match_count(void);
+// The symbol that has been typed so far, or NULL if there isn't one
+const qk_ucis_symbol_t *qk_ucis_match(void);
+// Called after every key typed during the input, for completion feedback
+void qk_ucis_matches_user(uint16_t matches);
 bool process_ucis (uint16_t keycode, keyrecord_t *record);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -18,87 +18,113 @@
 #include "eeprom.h"
 
 static uint8_t input_mode;
-uint8_t mods;
 
 void set_unicode_input_mode(uint8_t os_target)
 {
   input_mode = os_target;
-  eeprom_update_byte(EECONFIG_UNICODEMODE, os_target);
+  eeconfig_update_byte(EECONFIG_UNICODEMODE, os_target);
 }
 
 uint8_t get_unicode_input_mode(void) {
   return input_mode;
 }
 
-__attribute__((weak))
-void unicode_input_start (void) {
-  // save current mods
-  mods = keyboard_report->mods;
-
-  // unregister all mods to start from clean state
-  if (mods & MOD_BIT(KC_LSFT)) unregister_code(KC_LSFT);
-  if (mods & MOD_BIT(KC_RSFT)) unregister_code(KC_RSFT);
-  if (mods & MOD_BIT(KC_LCTL)) unregister_code(KC_LCTL);
-  if (mods & MOD_BIT(KC_RCTL)) unregister_code(KC_RCTL);
-  if (mods & MOD_BIT(KC_LALT)) unregister_code(KC_LALT);
-  if (mods & MOD_BIT(KC_RALT)) unregister_code(KC_RALT);
-  if (mods & MOD_BIT(KC_LGUI)) unregister_code(KC_LGUI);
-  if (mods & MOD_BIT(KC_RGUI)) unregister_code(KC_RGUI);
+// Mods held before the unicode input, restored at the end
+static uint8_t saved_mods;
+static uint8_t saved_weak_mods;
+
+// Releases all mods, in one report, the next report of the input mode
+// replaces them
+static void save_mods(void) {
+  saved_mods = get_mods();
+  saved_weak_mods = get_weak_mods();
+  clear_mods();
+  clear_weak_mods();
+}
 
+// Only sends a report if the input left something unsent, or there are
+// mods to bring back
+static void restore_mods(bool unsent) {
+  set_mods(saved_mods);
+  set_weak_mods(saved_weak_mods);
+  if (unsent || saved_mods || saved_weak_mods) {
+    send_keyboard_report();
+  }
+}
+
+static void tap_key(uint8_t code) {
+  add_key(code);
+  send_keyboard_report();
+  del_key(code);
+  send_keyboard_report();
+}
+
+// Enters the input mode for one codepoint, mods are already released
+static void begin_codepoint(void) {
   switch(input_mode) {
   case UC_OSX:
-    register_code(KC_LALT);
+    add_mods(MOD_BIT(KC_LALT));
+    send_keyboard_report();
     break;
   case UC_OSX_RALT:
-    register_code(KC_RALT);
+    add_mods(MOD_BIT(KC_RALT));
+    send_keyboard_report();
     break;
   case UC_LNX:
-    register_code(KC_LCTL);
-    register_code(KC_LSFT);
-    register_code(KC_U);
-    unregister_code(KC_U);
-    unregister_code(KC_LSFT);
-    unregister_code(KC_LCTL);
+    add_mods(MOD_BIT(KC_LCTL) | MOD_BIT(KC_LSFT));
+    send_keyboard_report();
+    add_key(KC_U);
+    send_keyboard_report();
+    del_key(KC_U);
+    del_mods(MOD_BIT(KC_LCTL) | MOD_BIT(KC_LSFT));
+    send_keyboard_report();
     break;
   case UC_WIN:
-    register_code(KC_LALT);
-    register_code(KC_PPLS);
-    unregister_code(KC_PPLS);
+    add_mods(MOD_BIT(KC_LALT));
+    send_keyboard_report();
+    tap_key(KC_PPLS);
     break;
   case UC_WINC:
-    register_code(KC_RALT);
-    unregister_code(KC_RALT);
-    register_code(KC_U);
-    unregister_code(KC_U);
+    add_mods(MOD_BIT(KC_RALT));
+    send_keyboard_report();
+    del_mods(MOD_BIT(KC_RALT));
+    send_keyboard_report();
+    tap_key(KC_U);
+    break;
   }
-  wait_ms(UNICODE_TYPE_DELAY);
 }
 
-__attribute__((weak))
-void unicode_input_finish (void) {
+// Commits the codepoint, and leaves the input mode, the last change is
+// left to be sent together with the restored mods, returns true if there
+// is such a change
+static bool end_codepoint(void) {
   switch(input_mode) {
     case UC_OSX:
     case UC_WIN:
-      unregister_code(KC_LALT);
-      break;
+      del_mods(MOD_BIT(KC_LALT));
+      return true;
     case UC_OSX_RALT:
-      unregister_code(KC_RALT);
-      break;
+      del_mods(MOD_BIT(KC_RALT));
+      return true;
     case UC_LNX:
-      register_code(KC_SPC);
-      unregister_code(KC_SPC);
-      break;
+      add_key(KC_SPC);
+      send_keyboard_report();
+      del_key(KC_SPC);
+      return true;
   }
+  return false;
+}
+
+__attribute__((weak))
+void unicode_input_start (void) {
+  save_mods();
+  begin_codepoint();
+  wait_ms(UNICODE_TYPE_DELAY);
+}
 
-  // reregister previously set mods
-  if (mods & MOD_BIT(KC_LSFT)) register_code(KC_LSFT);
-  if (mods & MOD_BIT(KC_RSFT)) register_code(KC_RSFT);
-  if (mods & MOD_BIT(KC_LCTL)) register_code(KC_LCTL);
-  if (mods & MOD_BIT(KC_RCTL)) register_code(KC_RCTL);
-  if (mods & MOD_BIT(KC_LALT)) register_code(KC_LALT);
-  if (mods & MOD_BIT(KC_RALT)) register_code(KC_RALT);
-  if (mods & MOD_BIT(KC_LGUI)) register_code(KC_LGUI);
-  if (mods & MOD_BIT(KC_RGUI)) register_code(KC_RGUI);
+__attribute__((weak))
+void unicode_input_finish (void) {
+  restore_mods(end_codepoint());
 }
 
 __attribute__((weak))
@@ -113,10 +139,161 @@ uint16_t hex_to_keycode(uint8_t hex)
   }
 }
 
+// Types the hex digits without releasing a digit before the next one,
+// unless they are the same key, which halves the number of reports
+void register_hex_digits(uint32_t hex, uint8_t min_digits) {
+  uint8_t digits = 8;
+  while (digits > min_digits && !(hex >> ((digits - 1) * 4) & 0xF)) {
+    digits--;
+  }
+  uint16_t held = KC_NO;
+  for (int8_t i = digits - 1; i >= 0; i--) {
+    uint16_t code = hex_to_keycode((hex >> (i * 4)) & 0xF);
+    if (code > 0xFF) {
+      // Not a basic keycode, can't be coalesced
+      if (held != KC_NO) {
+        del_key(held);
+        held = KC_NO;
+      }
+      register_code16(code);
+      unregister_code16(code);
+      continue;
+    }
+    if (held != KC_NO) {
+      del_key(held);
+      if (held == code) {
+        send_keyboard_report();
+      }
+    }
+    add_key(code);
+    send_keyboard_report();
+    held = code;
+  }
+  if (held != KC_NO) {
+    del_key(held);
+    send_keyboard_report();
+  }
+}
+
 void register_hex(uint16_t hex) {
-  for(int i = 3; i >= 0; i--) {
-    uint8_t digit = ((hex >> (i*4)) & 0xF);
-    register_code(hex_to_keycode(digit));
-    unregister_code(hex_to_keycode(digit));
+  register_hex_digits(hex, 4);
+}
+
+static bool input_mode_is_osx(void) {
+  return input_mode == UC_OSX || input_mode == UC_OSX_RALT;
+}
+
+// Whether the current input mode can type the codepoint
+static bool codepoint_supported(uint32_t code_point) {
+  switch (input_mode) {
+  case UC_OSX:
+  case UC_OSX_RALT:
+    return code_point <= 0x10FFFF;
+  case UC_LNX:
+    return code_point <= 0xFFFFF;
+  }
+  return true;
+}
+
+// The codepoint as the OS wants it typed, it must be supported
+static void register_codepoint_digits(uint32_t code_point) {
+  if (input_mode_is_osx() && code_point > 0xFFFF) {
+    // UTF-16 surrogate pair
+    code_point -= 0x10000;
+    register_hex_digits(0xD800 + (code_point >> 10), 4);
+    register_hex_digits(0xDC00 + (code_point & 0x3FF), 4);
+    return;
+  }
+  register_hex_digits(code_point, 4);
+}
+
+// Nothing is typed for a codepoint that isn't supported
+bool register_unicode(uint32_t code_point) {
+  if (!codepoint_supported(code_point)) {
+    return false;
+  }
+  unicode_input_start();
+  register_codepoint_digits(code_point);
+  unicode_input_finish();
+  return true;
+}
+
+// The state of a string of codepoints, the mods are saved and the input
+// mode entered only once for the whole string
+static bool in_string;
+
+static void string_begin(void) {
+  save_mods();
+  in_string = false;
+}
+
+// Codepoints that aren't supported are skipped
+static void string_codepoint(uint32_t code_point) {
+  if (!codepoint_supported(code_point)) {
+    return;
+  }
+  // Hex input on macOS takes any number of characters while Option is held
+  if (!in_string || !input_mode_is_osx()) {
+    if (in_string && end_codepoint()) {
+      send_keyboard_report();
+    }
+    begin_codepoint();
+    wait_ms(UNICODE_TYPE_DELAY);
+    in_string = true;
+  }
+  register_codepoint_digits(code_point);
+}
+
+static void string_end(void) {
+  restore_mods(in_string && end_codepoint());
+}
+
+void send_unicode_codepoints(const uint32_t *code_points, uint16_t count) {
+  string_begin();
+  for (uint16_t i = 0; i < count; i++) {
+    string_codepoint(code_points[i]);
+  }
+  string_end();
+}
+
+// Decodes one UTF-8 sequence, invalid ones become U+FFFD
+static const char *decode_utf8(const char *str, uint32_t *code_point) {
+  uint8_t c = *str++;
+  uint8_t continuations;
+  if (c < 0x80) {
+    *code_point = c;
+    return str;
+  } else if ((c & 0xE0) == 0xC0) {
+    *code_point = c & 0x1F;
+    continuations = 1;
+  } else if ((c & 0xF0) == 0xE0) {
+    *code_point = c & 0x0F;
+    continuations = 2;
+  } else if ((c & 0xF8) == 0xF0) {
+    *code_point = c & 0x07;
+    continuations = 3;
+  } else {
+    *code_point = 0xFFFD;
+    return str;
+  }
+  while (continuations--) {
+    c = *str;
+    if ((c & 0xC0) != 0x80) {
+      *code_point = 0xFFFD;
+      return str;
+    }
+    *code_point = (*code_point << 6) | (c & 0x3F);
+    str++;
+  }
+  return str;
+}
+
+void send_unicode_string(const char *str) {
+  string_begin();
+  while (*str) {
+    uint32_t code_point;
+    str = decode_utf8(str, &code_point);
+    string_codepoint(code_point);
   }
+  string_end();
 }
@@ -26,11 +26,29 @@
 __attribute__ ((unused))
 static uint8_t input_mode;
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 void set_unicode_input_mode(uint8_t os_target);
 uint8_t get_unicode_input_mode(void);
 void unicode_input_start(void);
 void unicode_input_finish(void);
 void register_hex(uint16_t hex);
+void register_hex_digits(uint32_t hex, uint8_t min_digits);
+
+// Types a single codepoint, returns false without typing anything if it is
+// out of the range the current input mode supports
+bool register_unicode(uint32_t code_point);
+// Types a whole string, the mods are saved and restored only once, and on
+// macOS the input mode is held for all of the codepoints. Codepoints out of
+// the range of the input mode are skipped.
+void send_unicode_codepoints(const uint32_t *code_points, uint16_t count);
+void send_unicode_string(const char *str);
+
+#ifdef __cplusplus
+}
+#endif
 
 #define UC_OSX 0  // Mac OS X
 #define UC_LNX 1  // Linux
@@ -132,6 +132,7 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
 
 void reset_keyboard(void) {
   clear_keyboard();
+  eeconfig_flush();
 #if defined(AUDIO_ENABLE) || (defined(MIDI_ENABLE) && defined(MIDI_ENABLE_BASIC))
   music_all_notes_off();
   uint16_t timer_start = timer_read();
@@ -737,6 +738,11 @@ void matrix_init_quantum() {
   matrix_init_kb();
 }
 
+// Defined by dynamic_macro.h when a keymap includes it
+__attribute__ ((weak))
+void dynamic_macro_task(void) {
+}
+
 void matrix_scan_quantum() {
   #ifdef AUDIO_ENABLE
     matrix_scan_music();
@@ -750,6 +756,12 @@ void matrix_scan_quantum() {
     matrix_scan_combo();
   #endif
 
+  dynamic_macro_task();
+
+  #ifdef STENO_ENABLE
+    steno_task();
+  #endif
+
   #if defined(BACKLIGHT_ENABLE) && defined(BACKLIGHT_PIN)
     backlight_task();
   #endif
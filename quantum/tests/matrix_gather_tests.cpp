@@ -0,0 +1,150 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <random>
+#include "matrix_gather.h"
+
+// The port input registers, indexed by the high nibble of the pins
+static uint8_t registers[16];
+static int reads[16];
+
+static uint8_t read_port(uint8_t port) {
+    reads[port]++;
+    return registers[port];
+}
+
+// The pin by pin read that the gather replaces
+template <typename T>
+static T read_pin_by_pin(const uint8_t* pins, uint8_t count) {
+    T cols = 0;
+    for (uint8_t col = 0; col < count; col++) {
+        uint8_t pin = pins[col];
+        if (!(registers[pin >> 4] & (1 << (pin & 0xF)))) {
+            cols |= (T)1 << col;
+        }
+    }
+    return cols;
+}
+
+class MatrixGather : public testing::Test {
+public:
+    MatrixGather() : random(1) {
+        memset(reads, 0, sizeof(reads));
+    }
+
+    void randomize() {
+        for (auto& r : registers) {
+            r = random();
+        }
+    }
+
+    template <uint8_t Count>
+    void expect_reads(const uint8_t (&pins)[Count], int times) {
+        for (int port = 0; port < 16; port++) {
+            bool used = false;
+            for (uint8_t pin : pins) {
+                used |= (pin >> 4) == port;
+            }
+            EXPECT_EQ(reads[port], used ? times : 0) << "port " << port;
+        }
+    }
+
+    std::mt19937 random;
+};
+
+// config_common.h pins
+enum : uint8_t {
+    B0 = 0x30, B1, B2, B3, B4, B5, B6, B7,
+    C0 = 0x60, C1, C2, C3, C4, C5, C6, C7,
+    D0 = 0x90, D1, D2, D3, D4, D5, D6, D7,
+    E0 = 0xC0, E1, E2, E3, E4, E5, E6, E7,
+    F0 = 0xF0, F1, F2, F3, F4, F5, F6, F7,
+};
+
+static const uint8_t planck_pins[12] = { F1, F0, B0, C7, F4, F5, F6, F7, D4, D6, B4, D7 };
+static const uint8_t one_port_pins[8] = { B0, B1, B2, B3, B4, B5, B6, B7 };
+static const uint8_t reversed_pins[8] = { D7, D6, D5, D4, D3, D2, D1, D0 };
+static const uint8_t single_pin[1] = { E6 };
+static const uint8_t wide_pins[32] = {
+    F4, F5, F6, F7, B1, B3, B2, B6,
+    C7, C6, D0, D1, D2, D3, D4, D5,
+    D6, D7, B4, B5, E6, E2, C0, C1,
+    C2, C3, C4, C5, F0, F1, B0, B7,
+};
+
+TEST_F(MatrixGather, Planck) {
+    for (int i = 0; i < 1000; i++) {
+        randomize();
+        uint16_t cols;
+        MATRIX_GATHER(planck_pins, 12, read_port, cols);
+        EXPECT_EQ(cols, read_pin_by_pin<uint16_t>(planck_pins, 12));
+    }
+    expect_reads(planck_pins, 1000);
+}
+
+TEST_F(MatrixGather, OnePort) {
+    for (int value = 0; value < 256; value++) {
+        registers[0x3] = value;
+        uint8_t cols;
+        MATRIX_GATHER(one_port_pins, 8, read_port, cols);
+        EXPECT_EQ(cols, (uint8_t)~value);
+    }
+    expect_reads(one_port_pins, 256);
+}
+
+TEST_F(MatrixGather, Reversed) {
+    for (int value = 0; value < 256; value++) {
+        registers[0x9] = value;
+        uint8_t cols;
+        MATRIX_GATHER(reversed_pins, 8, read_port, cols);
+        EXPECT_EQ(cols, read_pin_by_pin<uint8_t>(reversed_pins, 8));
+    }
+    expect_reads(reversed_pins, 256);
+}
+
+TEST_F(MatrixGather, SinglePin) {
+    registers[0xC] = 0xFF;
+    uint8_t cols;
+    MATRIX_GATHER(single_pin, 1, read_port, cols);
+    EXPECT_EQ(cols, 0);
+    registers[0xC] = ~(1 << 6);
+    MATRIX_GATHER(single_pin, 1, read_port, cols);
+    EXPECT_EQ(cols, 1);
+    expect_reads(single_pin, 2);
+}
+
+TEST_F(MatrixGather, ThirtyTwoColumns) {
+    for (int i = 0; i < 1000; i++) {
+        randomize();
+        uint32_t cols;
+        MATRIX_GATHER(wide_pins, 32, read_port, cols);
+        EXPECT_EQ(cols, read_pin_by_pin<uint32_t>(wide_pins, 32));
+    }
+    expect_reads(wide_pins, 1000);
+}
+
+TEST_F(MatrixGather, FewerColumnsThanPins) {
+    // only the first count pins are columns
+    for (int i = 0; i < 100; i++) {
+        randomize();
+        uint16_t cols;
+        MATRIX_GATHER(wide_pins, 10, read_port, cols);
+        EXPECT_EQ(cols, read_pin_by_pin<uint16_t>(wide_pins, 10));
+    }
+    EXPECT_EQ(reads[0x6], 100);
+    EXPECT_EQ(reads[0xC], 0);
+}
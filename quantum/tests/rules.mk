@@ -0,0 +1,2 @@
+matrix_gather_SRC := $(QUANTUM_PATH)/tests/matrix_gather_tests.cpp
+matrix_gather_INC := $(QUANTUM_PATH)
@@ -0,0 +1,58 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QUANTUM_VISUALIZER_EMULATOR_EMULATOR_H_
+#define QUANTUM_VISUALIZER_EMULATOR_EMULATOR_H_
+
+#include "gfx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t frames;
+    // Wall clock time spent by the visualizer thread between waking up and
+    // finishing the flush, in microseconds
+    uint32_t last_update_us;
+    uint32_t max_update_us;
+    uint64_t total_update_us;
+    // Bytes the display drivers would have transferred, see gdispGFlush
+    uint32_t last_flush_bytes;
+    uint32_t total_flush_bytes;
+} emulator_stats_t;
+
+// Advances the simulated time, the visualizer thread runs every update it
+// would have run during that time, and the function returns when it's idle again
+void emulator_advance(systemticks_t ticks);
+// Waits for the visualizer thread to process pending events without
+// advancing the time, call this after visualizer_update and friends
+void emulator_sync(void);
+
+const emulator_stats_t* emulator_get_stats(void);
+void emulator_reset_stats(void);
+
+// Returns the display content in the native LCD format, 1 bit/pixel, left to
+// right, top to bottom, the same format as the LCD resources
+void emulator_get_bitmap(GDisplay* g, uint8_t* buffer);
+// Writes the current display content as a binary PPM image
+bool emulator_write_ppm(GDisplay* g, const char* filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QUANTUM_VISUALIZER_EMULATOR_EMULATOR_H_ */
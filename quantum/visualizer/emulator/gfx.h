@@ -0,0 +1,136 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QUANTUM_VISUALIZER_EMULATOR_GFX_H_
+#define QUANTUM_VISUALIZER_EMULATOR_GFX_H_
+
+// A headless replacement for the subset of uGFX that the visualizer uses
+// The displays are in-memory framebuffers, and the system time is simulated,
+// so that animations can be stepped deterministically from host tests.
+// See emulator.h for the functions used to drive it.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int16_t coord_t;
+typedef uint8_t color_t;
+typedef color_t pixel_t;
+typedef uint32_t systemticks_t;
+typedef uint32_t delaytime_t;
+typedef int threadpriority_t;
+typedef void* threadreturn_t;
+
+#define TIME_INFINITE ((delaytime_t)-1)
+#define NORMAL_PRIORITY 0
+
+// All displays are stored as 8-bit luma, the mono LCD only uses Black and White
+#define Black ((color_t)0)
+#define White ((color_t)255)
+#define LUMA2COLOR(l) ((color_t)(l))
+
+typedef enum {
+    powerOff,
+    powerSleep,
+    powerDeepSleep,
+    powerOn,
+} powermode_t;
+
+typedef enum {
+    GDISP_ROTATE_0 = 0,
+    GDISP_ROTATE_90 = 90,
+    GDISP_ROTATE_180 = 180,
+    GDISP_ROTATE_270 = 270,
+} orientation_t;
+
+typedef enum {
+    EMULATOR_DISPLAY_MONO,
+    EMULATOR_DISPLAY_GRAY,
+} emulator_display_format_t;
+
+typedef struct GDisplay {
+    coord_t width;
+    coord_t height;
+    emulator_display_format_t format;
+    powermode_t power;
+    orientation_t orientation;
+    uint8_t backlight;
+    color_t* framebuffer;
+    // The content as of the last flush, used for counting the transferred bytes
+    color_t* flushed;
+    uint32_t flush_bytes;
+    uint32_t total_flush_bytes;
+} GDisplay;
+
+typedef struct emulator_font_t {
+    const char* name;
+    coord_t width;
+    coord_t height;
+} emulator_font_t;
+typedef const emulator_font_t* font_t;
+
+typedef struct GListener {
+    void* source;
+} GListener;
+typedef void* GSourceHandle;
+typedef GListener GSourceListener;
+
+extern GDisplay* GDISP;
+
+void gfxInit(void);
+systemticks_t gfxSystemTicks(void);
+#define gfxMillisecondsToTicks(ms) ((systemticks_t)(ms))
+
+#define DECLARE_THREAD_STACK(name, size) uint8_t name[size]
+#define DECLARE_THREAD_FUNCTION(fn, arg) threadreturn_t fn(void* arg)
+typedef threadreturn_t (*emulator_thread_func)(void*);
+void gfxThreadCreate(void* stack, size_t size, threadpriority_t prio, emulator_thread_func fn, void* param);
+
+void geventListenerInit(GListener* listener);
+bool geventAttachSource(GListener* listener, GSourceHandle source, unsigned flags);
+GSourceListener* geventGetSourceListener(GSourceHandle source, GSourceListener* last);
+void geventSendEvent(GSourceListener* listener);
+void* geventEventWait(GListener* listener, delaytime_t timeout);
+
+GDisplay* gdispGetDisplay(unsigned display);
+font_t gdispOpenFont(const char* name);
+void gdispCloseFont(font_t font);
+
+void gdispGClear(GDisplay* g, color_t color);
+void gdispGDrawPixel(GDisplay* g, coord_t x, coord_t y, color_t color);
+color_t gdispGGetPixelColor(GDisplay* g, coord_t x, coord_t y);
+void gdispGDrawLine(GDisplay* g, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color);
+void gdispGDrawString(GDisplay* g, coord_t x, coord_t y, const char* str, font_t font, color_t color);
+void gdispGBlitArea(GDisplay* g, coord_t x, coord_t y, coord_t cx, coord_t cy, coord_t srcx, coord_t srcy, coord_t srccx, const pixel_t* buffer);
+void gdispGSetPowerMode(GDisplay* g, powermode_t mode);
+void gdispGSetOrientation(GDisplay* g, orientation_t orientation);
+void gdispGSetBacklight(GDisplay* g, uint8_t percent);
+void gdispGFlush(GDisplay* g);
+
+#define gdispClear(c) gdispGClear(GDISP, c)
+#define gdispDrawPixel(x, y, c) gdispGDrawPixel(GDISP, x, y, c)
+#define gdispDrawString(x, y, str, font, c) gdispGDrawString(GDISP, x, y, str, font, c)
+#define gdispSetPowerMode(m) gdispGSetPowerMode(GDISP, m)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QUANTUM_VISUALIZER_EMULATOR_GFX_H_ */
@@ -0,0 +1,380 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "emulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define MAX_DISPLAYS 2
+
+static GDisplay displays[MAX_DISPLAYS];
+static unsigned num_displays = 0;
+GDisplay* GDISP = NULL;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static systemticks_t current_time = 0;
+static systemticks_t wakeup_time = 0;
+static bool thread_waiting = false;
+static bool event_pending = false;
+static GListener* attached_listener = NULL;
+static void* attached_source = NULL;
+
+static struct timespec update_start;
+static emulator_stats_t stats;
+
+static const emulator_font_t fonts[] = {
+    {.name = "fixed_5x8", .width = 5, .height = 8},
+    {.name = "DejaVuSansBold12", .width = 7, .height = 12},
+};
+
+static void add_display(coord_t width, coord_t height, emulator_display_format_t format) {
+    GDisplay* g = &displays[num_displays++];
+    g->width = width;
+    g->height = height;
+    g->format = format;
+    g->power = powerOn;
+    g->orientation = GDISP_ROTATE_0;
+    g->backlight = 100;
+    g->framebuffer = calloc(width * height, sizeof(color_t));
+    g->flushed = calloc(width * height, sizeof(color_t));
+}
+
+void gfxInit(void) {
+    // The displays are created in the same order as visualizer.mk numbers them
+#ifdef LCD_DISPLAY_NUMBER
+    add_display(LCD_WIDTH, LCD_HEIGHT, EMULATOR_DISPLAY_MONO);
+#endif
+#ifdef LED_DISPLAY_NUMBER
+    add_display(LED_WIDTH, LED_HEIGHT, EMULATOR_DISPLAY_GRAY);
+#endif
+    GDISP = num_displays > 0 ? &displays[0] : NULL;
+}
+
+systemticks_t gfxSystemTicks(void) {
+    pthread_mutex_lock(&mutex);
+    systemticks_t ret = current_time;
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
+
+void gfxThreadCreate(void* stack, size_t size, threadpriority_t prio, emulator_thread_func fn, void* param) {
+    (void)stack;
+    (void)size;
+    (void)prio;
+    pthread_t thread;
+    pthread_create(&thread, NULL, fn, param);
+    pthread_detach(thread);
+}
+
+void geventListenerInit(GListener* listener) {
+    listener->source = NULL;
+}
+
+bool geventAttachSource(GListener* listener, GSourceHandle source, unsigned flags) {
+    (void)flags;
+    pthread_mutex_lock(&mutex);
+    listener->source = source;
+    attached_listener = listener;
+    attached_source = source;
+    pthread_mutex_unlock(&mutex);
+    return true;
+}
+
+GSourceListener* geventGetSourceListener(GSourceHandle source, GSourceListener* last) {
+    if (last != NULL) {
+        return NULL;
+    }
+    pthread_mutex_lock(&mutex);
+    GSourceListener* ret = source == attached_source ? attached_listener : NULL;
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
+
+void geventSendEvent(GSourceListener* listener) {
+    (void)listener;
+    pthread_mutex_lock(&mutex);
+    event_pending = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+static bool thread_idle(void) {
+    return thread_waiting && !event_pending && current_time < wakeup_time;
+}
+
+void* geventEventWait(GListener* listener, delaytime_t timeout) {
+    pthread_mutex_lock(&mutex);
+    if (timeout == TIME_INFINITE || current_time + timeout < current_time) {
+        wakeup_time = TIME_INFINITE;
+    } else {
+        wakeup_time = current_time + timeout;
+    }
+    thread_waiting = true;
+    pthread_cond_broadcast(&cond);
+    while (!event_pending && current_time < wakeup_time) {
+        pthread_cond_wait(&cond, &mutex);
+    }
+    bool had_event = event_pending;
+    event_pending = false;
+    thread_waiting = false;
+    pthread_mutex_unlock(&mutex);
+    clock_gettime(CLOCK_MONOTONIC, &update_start);
+    return had_event ? listener : NULL;
+}
+
+void emulator_sync(void) {
+    pthread_mutex_lock(&mutex);
+    while (!thread_idle()) {
+        pthread_cond_wait(&cond, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void emulator_advance(systemticks_t ticks) {
+    pthread_mutex_lock(&mutex);
+    systemticks_t target = current_time + ticks;
+    for (;;) {
+        while (!thread_idle()) {
+            pthread_cond_wait(&cond, &mutex);
+        }
+        if (current_time == target) {
+            break;
+        }
+        // Jump directly to the next wakeup, nothing happens in between
+        current_time = wakeup_time < target ? wakeup_time : target;
+        pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// Called by the visualizer thread after all displays have been flushed
+void draw_emulator(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint32_t us = (now.tv_sec - update_start.tv_sec) * 1000000 + (now.tv_nsec - update_start.tv_nsec) / 1000;
+    uint32_t flush_bytes = 0;
+    for (unsigned i = 0; i < num_displays; i++) {
+        flush_bytes += displays[i].flush_bytes;
+        displays[i].flush_bytes = 0;
+    }
+    pthread_mutex_lock(&mutex);
+    stats.frames++;
+    stats.last_update_us = us;
+    if (us > stats.max_update_us) {
+        stats.max_update_us = us;
+    }
+    stats.total_update_us += us;
+    stats.last_flush_bytes = flush_bytes;
+    stats.total_flush_bytes += flush_bytes;
+    pthread_mutex_unlock(&mutex);
+}
+
+const emulator_stats_t* emulator_get_stats(void) {
+    return &stats;
+}
+
+void emulator_reset_stats(void) {
+    pthread_mutex_lock(&mutex);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&mutex);
+}
+
+GDisplay* gdispGetDisplay(unsigned display) {
+    return display < num_displays ? &displays[display] : NULL;
+}
+
+font_t gdispOpenFont(const char* name) {
+    for (unsigned i = 0; i < sizeof(fonts) / sizeof(fonts[0]); i++) {
+        if (strcmp(fonts[i].name, name) == 0) {
+            return &fonts[i];
+        }
+    }
+    return &fonts[0];
+}
+
+void gdispCloseFont(font_t font) {
+    (void)font;
+}
+
+static void set_pixel(GDisplay* g, coord_t x, coord_t y, color_t color) {
+    if (g->orientation == GDISP_ROTATE_180) {
+        x = g->width - 1 - x;
+        y = g->height - 1 - y;
+    }
+    if (x < 0 || y < 0 || x >= g->width || y >= g->height) {
+        return;
+    }
+    if (g->format == EMULATOR_DISPLAY_MONO) {
+        color = color != Black ? White : Black;
+    }
+    g->framebuffer[y * g->width + x] = color;
+}
+
+void gdispGClear(GDisplay* g, color_t color) {
+    for (coord_t y = 0; y < g->height; y++) {
+        for (coord_t x = 0; x < g->width; x++) {
+            set_pixel(g, x, y, color);
+        }
+    }
+}
+
+void gdispGDrawPixel(GDisplay* g, coord_t x, coord_t y, color_t color) {
+    set_pixel(g, x, y, color);
+}
+
+color_t gdispGGetPixelColor(GDisplay* g, coord_t x, coord_t y) {
+    if (g->orientation == GDISP_ROTATE_180) {
+        x = g->width - 1 - x;
+        y = g->height - 1 - y;
+    }
+    if (x < 0 || y < 0 || x >= g->width || y >= g->height) {
+        return Black;
+    }
+    return g->framebuffer[y * g->width + x];
+}
+
+void gdispGDrawLine(GDisplay* g, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color) {
+    // Bresenham
+    int dx = abs(x1 - x0);
+    int dy = -abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1;
+    int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    for (;;) {
+        set_pixel(g, x0, y0, color);
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+// The uGFX fonts are not available on the host, so each character is drawn
+// as a box containing the bits of the character code. That's enough for
+// regression testing the layout, but it doesn't look like the real thing.
+void gdispGDrawString(GDisplay* g, coord_t x, coord_t y, const char* str, font_t font, color_t color) {
+    for (; *str; str++, x += font->width + 1) {
+        uint8_t c = *str;
+        if (c == ' ') {
+            continue;
+        }
+        for (coord_t i = 0; i < font->width; i++) {
+            set_pixel(g, x + i, y, color);
+            set_pixel(g, x + i, y + font->height - 1, color);
+        }
+        for (coord_t row = 0; row < 8 && row < font->height - 2; row++) {
+            if (c & (1 << row)) {
+                set_pixel(g, x + font->width / 2, y + 1 + row, color);
+            }
+        }
+    }
+}
+
+void gdispGBlitArea(GDisplay* g, coord_t x, coord_t y, coord_t cx, coord_t cy, coord_t srcx, coord_t srcy, coord_t srccx, const pixel_t* buffer) {
+    for (coord_t i = 0; i < cy; i++) {
+        for (coord_t j = 0; j < cx; j++) {
+            unsigned src = (srcy + i) * srccx + srcx + j;
+            color_t color;
+            if (g->format == EMULATOR_DISPLAY_MONO) {
+                // Same bit order as the ST7565 driver
+                color = (buffer[src / 8] >> (7 - (src % 8))) & 1 ? White : Black;
+            } else {
+                color = buffer[src];
+            }
+            set_pixel(g, x + j, y + i, color);
+        }
+    }
+}
+
+void gdispGSetPowerMode(GDisplay* g, powermode_t mode) {
+    g->power = mode;
+}
+
+void gdispGSetOrientation(GDisplay* g, orientation_t orientation) {
+    g->orientation = orientation;
+}
+
+void gdispGSetBacklight(GDisplay* g, uint8_t percent) {
+    g->backlight = percent;
+}
+
+void gdispGFlush(GDisplay* g) {
+    if (!g) {
+        return;
+    }
+    uint32_t bytes = 0;
+    if (g->format == EMULATOR_DISPLAY_MONO) {
+        // The ST7565 is written in pages of 8 vertical pixels
+        for (coord_t page = 0; page < (g->height + 7) / 8; page++) {
+            for (coord_t x = 0; x < g->width; x++) {
+                for (coord_t y = page * 8; y < page * 8 + 8 && y < g->height; y++) {
+                    if (g->framebuffer[y * g->width + x] != g->flushed[y * g->width + x]) {
+                        bytes++;
+                        break;
+                    }
+                }
+            }
+        }
+    } else {
+        for (int i = 0; i < g->width * g->height; i++) {
+            if (g->framebuffer[i] != g->flushed[i]) {
+                bytes++;
+            }
+        }
+    }
+    memcpy(g->flushed, g->framebuffer, g->width * g->height * sizeof(color_t));
+    g->flush_bytes += bytes;
+    g->total_flush_bytes += bytes;
+}
+
+void emulator_get_bitmap(GDisplay* g, uint8_t* buffer) {
+    unsigned row_size = (g->width + 7) / 8;
+    memset(buffer, 0, row_size * g->height);
+    for (coord_t y = 0; y < g->height; y++) {
+        for (coord_t x = 0; x < g->width; x++) {
+            if (g->framebuffer[y * g->width + x] != Black) {
+                buffer[y * row_size + x / 8] |= 0x80 >> (x % 8);
+            }
+        }
+    }
+}
+
+bool emulator_write_ppm(GDisplay* g, const char* filename) {
+    FILE* f = fopen(filename, "wb");
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", g->width, g->height);
+    for (int i = 0; i < g->width * g->height; i++) {
+        color_t c = g->power == powerOn ? g->framebuffer[i] : Black;
+        uint8_t rgb[3] = {c, c, c};
+        fwrite(rgb, 1, sizeof(rgb), f);
+    }
+    fclose(f);
+    return true;
+}
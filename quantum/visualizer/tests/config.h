@@ -0,0 +1,31 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QUANTUM_VISUALIZER_TESTS_CONFIG_H_
+#define QUANTUM_VISUALIZER_TESTS_CONFIG_H_
+
+// The same displays as the Infinity Ergodox
+#define LCD_WIDTH 128
+#define LCD_HEIGHT 32
+#define LCD_DISPLAY_NUMBER 0
+#define LED_WIDTH 7
+#define LED_HEIGHT 7
+#define LED_DISPLAY_NUMBER 1
+
+#define BACKLIGHT_LEVELS 3
+#define NO_ACTION_ONESHOT
+
+#endif /* QUANTUM_VISUALIZER_TESTS_CONFIG_H_ */
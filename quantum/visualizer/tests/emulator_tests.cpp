@@ -0,0 +1,181 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+#include <cstdio>
+extern "C" {
+#include "visualizer.h"
+#include "visualizer_keyframes.h"
+#include "lcd_keyframes.h"
+#include "lcd_backlight_keyframes.h"
+#include "default_animations.h"
+#include "resources/resources.h"
+#include "emulator.h"
+}
+
+using testing::ElementsAreArray;
+
+// The visualizer thread can only be started once per process, so the tests
+// share it, and run through the lifetime of a keyboard in order
+static uint16_t backlight_r, backlight_g, backlight_b;
+static int user_updates = 0;
+
+static keyframe_animation_t layer_bitmap_animation = {
+    .num_frames = 1,
+    .loop = false,
+    .frame_lengths = {gfxMillisecondsToTicks(0)},
+    .frame_functions = {lcd_keyframe_display_layer_bitmap},
+};
+
+extern "C" {
+uint8_t get_mods(void) {
+    return 0;
+}
+
+void lcd_backlight_hal_init(void) {
+}
+
+void lcd_backlight_hal_color(uint16_t r, uint16_t g, uint16_t b) {
+    backlight_r = r;
+    backlight_g = g;
+    backlight_b = b;
+}
+
+void initialize_user_visualizer(visualizer_state_t* state) {
+    lcd_backlight_brightness(255);
+    state->current_lcd_color = LCD_COLOR(0, 0, 0);
+    state->target_lcd_color = LCD_COLOR(0, 0, 255);
+    start_keyframe_animation(&default_startup_animation);
+}
+
+void update_user_visualizer_state(visualizer_state_t* state, visualizer_keyboard_status_t* prev_status) {
+    (void)state;
+    (void)prev_status;
+    user_updates++;
+    start_keyframe_animation(&layer_bitmap_animation);
+}
+
+void user_visualizer_suspend(visualizer_state_t* state) {
+    state->layer_text = "Suspending...";
+    start_keyframe_animation(&default_suspend_animation);
+}
+
+void user_visualizer_resume(visualizer_state_t* state) {
+    start_keyframe_animation(&default_startup_animation);
+}
+}
+
+class VisualizerEmulator : public ::testing::Test {
+public:
+    static void SetUpTestCase() {
+        visualizer_init();
+        emulator_sync();
+    }
+
+    static std::vector<uint8_t> lcd_bitmap() {
+        std::vector<uint8_t> result((LCD_WIDTH + 7) / 8 * LCD_HEIGHT);
+        emulator_get_bitmap(LCD_DISPLAY, result.data());
+        return result;
+    }
+
+    static uint8_t led_luma() {
+        return gdispGGetPixelColor(LED_DISPLAY, 0, 0);
+    }
+};
+
+TEST_F(VisualizerEmulator, StartupAnimationDrawsTheLogo) {
+    std::vector<uint8_t> expected(resource_lcd_logo, resource_lcd_logo + 512);
+    EXPECT_THAT(lcd_bitmap(), ElementsAreArray(expected));
+    EXPECT_EQ(LCD_DISPLAY->power, powerOn);
+    EXPECT_GT(emulator_get_stats()->total_flush_bytes, 0u);
+}
+
+TEST_F(VisualizerEmulator, StartupAnimationFadesIn) {
+    emulator_reset_stats();
+    emulator_advance(gfxMillisecondsToTicks(2500));
+    uint8_t halfway = led_luma();
+    EXPECT_GT(halfway, 64);
+    EXPECT_LT(halfway, 192);
+    EXPECT_GT(backlight_b + backlight_g + backlight_r, 0);
+    emulator_advance(gfxMillisecondsToTicks(2600));
+    EXPECT_EQ(led_luma(), 255);
+    const emulator_stats_t* stats = emulator_get_stats();
+    // The fade updates every 10 ms
+    EXPECT_GE(stats->frames, 450u);
+    EXPECT_LE(stats->frames, 520u);
+    EXPECT_GT(stats->total_flush_bytes, 0u);
+    printf("Fade in: %u frames, %u bytes flushed, average update %u us, max %u us\n",
+        stats->frames, stats->total_flush_bytes,
+        (unsigned)(stats->total_update_us / stats->frames), stats->max_update_us);
+}
+
+TEST_F(VisualizerEmulator, StatusChangesUpdateTheUserVisualizer) {
+    int updates = user_updates;
+    emulator_reset_stats();
+    visualizer_update(1, 1 | 4, 0, 0);
+    emulator_sync();
+    EXPECT_EQ(user_updates, updates + 1);
+    // The layer bitmap replaces the logo
+    std::vector<uint8_t> logo(resource_lcd_logo, resource_lcd_logo + 512);
+    EXPECT_NE(lcd_bitmap(), logo);
+    EXPECT_GT(emulator_get_stats()->total_flush_bytes, 0u);
+}
+
+TEST_F(VisualizerEmulator, UnchangedStatusDoesNotUpdate) {
+    int updates = user_updates;
+    emulator_reset_stats();
+    visualizer_update(1, 1 | 4, 0, 0);
+    emulator_sync();
+    emulator_advance(gfxMillisecondsToTicks(100));
+    EXPECT_EQ(user_updates, updates);
+    EXPECT_EQ(emulator_get_stats()->total_flush_bytes, 0u);
+}
+
+TEST_F(VisualizerEmulator, SuspendFadesOutAndDisables) {
+    visualizer_suspend();
+    emulator_sync();
+    emulator_advance(gfxMillisecondsToTicks(1100));
+    EXPECT_EQ(led_luma(), 0);
+    EXPECT_EQ(LCD_DISPLAY->power, powerOff);
+    EXPECT_EQ(LED_DISPLAY->power, powerOff);
+}
+
+TEST_F(VisualizerEmulator, ResumeRunsTheStartupAnimation) {
+    visualizer_resume();
+    emulator_sync();
+    emulator_advance(gfxMillisecondsToTicks(10));
+    EXPECT_EQ(LCD_DISPLAY->power, powerOn);
+    std::vector<uint8_t> expected(resource_lcd_logo, resource_lcd_logo + 512);
+    EXPECT_THAT(lcd_bitmap(), ElementsAreArray(expected));
+}
+
+TEST_F(VisualizerEmulator, FramesCanBeDumpedAsPPM) {
+    const char* filename = ".build/visualizer_emulator_lcd.ppm";
+    ASSERT_TRUE(emulator_write_ppm(LCD_DISPLAY, filename));
+    FILE* f = fopen(filename, "rb");
+    ASSERT_NE(f, nullptr);
+    char magic[3] = {};
+    int width = 0, height = 0, max = 0;
+    ASSERT_EQ(fscanf(f, "%2s %d %d %d", magic, &width, &height, &max), 4);
+    fclose(f);
+    EXPECT_STREQ(magic, "P6");
+    EXPECT_EQ(width, LCD_WIDTH);
+    EXPECT_EQ(height, LCD_HEIGHT);
+    EXPECT_EQ(max, 255);
+    remove(filename);
+}
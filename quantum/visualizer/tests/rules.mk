@@ -0,0 +1,24 @@
+visualizer_emulator_SRC :=\
+	$(QUANTUM_PATH)/visualizer/tests/emulator_tests.cpp \
+	$(QUANTUM_PATH)/visualizer/emulator/gfx_emulator.c \
+	$(QUANTUM_PATH)/visualizer/visualizer.c \
+	$(QUANTUM_PATH)/visualizer/visualizer_keyframes.c \
+	$(QUANTUM_PATH)/visualizer/default_animations.c \
+	$(QUANTUM_PATH)/visualizer/lcd_keyframes.c \
+	$(QUANTUM_PATH)/visualizer/lcd_backlight.c \
+	$(QUANTUM_PATH)/visualizer/lcd_backlight_keyframes.c \
+	$(QUANTUM_PATH)/visualizer/led_backlight_keyframes.c \
+	$(QUANTUM_PATH)/visualizer/resources/lcd_logo.c
+# The emulator directory goes first, so that its gfx.h replaces uGFX
+visualizer_emulator_INC :=\
+	$(QUANTUM_PATH)/visualizer/emulator \
+	$(QUANTUM_PATH)/visualizer \
+	$(QUANTUM_PATH)/visualizer/tests \
+	$(TMK_PATH)/common
+visualizer_emulator_DEFS :=\
+	-DEMULATOR \
+	-DVISUALIZER_ENABLE \
+	-DLCD_ENABLE \
+	-DLCD_BACKLIGHT_ENABLE \
+	-DBACKLIGHT_ENABLE
+visualizer_emulator_CONFIG := $(QUANTUM_PATH)/visualizer/tests/config.h
@@ -0,0 +1,310 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+#include "action_tapping.h"
+#include <vector>
+#include <iostream>
+
+extern "C" {
+#include "eeprom.h"
+uint16_t dynamic_macro_length(uint8_t slot);
+uint16_t dynamic_macro_used_bytes(void);
+void dynamic_macro_free(uint8_t slot);
+void dynamic_macro_load(void);
+}
+
+using testing::_;
+using testing::AnyNumber;
+using testing::Invoke;
+using testing::InSequence;
+
+// Matrix positions
+#define KEY_A 0, 0
+#define KEY_B 1, 0
+#define KEY_LSFT 2, 0
+#define KEY_REC1 3, 0
+#define KEY_REC2 4, 0
+#define KEY_STOP 5, 0
+#define KEY_PLAY1 6, 0
+#define KEY_PLAY2 7, 0
+#define KEY_REC3 8, 0
+#define KEY_PLAY3 9, 0
+#define KEY_SFT_T_P 0, 1
+#define KEY_C 1, 1
+
+struct SentReport {
+    std::vector<uint8_t> raw;
+    uint32_t time;
+};
+
+class DynamicMacro : public TestFixture {
+public:
+    DynamicMacro() {
+        for (uint8_t slot = 0; slot < DYNAMIC_MACRO_SLOTS; slot++) {
+            dynamic_macro_free(slot);
+        }
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber())
+            .WillRepeatedly(Invoke([this](report_keyboard_t& report) {
+                reports.push_back({
+                    std::vector<uint8_t>(report.raw, report.raw + KEYBOARD_REPORT_SIZE),
+                    timer_read32()});
+            }));
+    }
+
+    // Leaves a scan without events after the release, so that no two
+    // recorded events get the same time
+    void tap(uint8_t col, uint8_t row, unsigned hold = 2) {
+        press_key(col, row);
+        idle_for(hold);
+        release_key(col, row);
+        idle_for(2);
+    }
+
+
+    void record(uint8_t col, uint8_t row) {
+        tap(col, row);
+        reports.clear();
+    }
+
+    void stop() {
+        press_key(KEY_STOP);
+        run_one_scan_loop();
+        release_key(KEY_STOP);
+        run_one_scan_loop();
+    }
+
+    // Plays a macro, and returns the reports sent by it
+    std::vector<SentReport> play(uint8_t col, uint8_t row) {
+        reports.clear();
+        tap(col, row);
+        idle_for(2000);
+        return reports;
+    }
+
+    // The playback clears the keyboard before and after it
+    static std::vector<SentReport> without_empty_ends(std::vector<SentReport> sent) {
+        std::vector<uint8_t> empty(KEYBOARD_REPORT_SIZE);
+        while (!sent.empty() && sent.front().raw == empty) {
+            sent.erase(sent.begin());
+        }
+        while (!sent.empty() && sent.back().raw == empty) {
+            sent.pop_back();
+        }
+        return sent;
+    }
+
+    static void expect_same(std::vector<SentReport> played, std::vector<SentReport> recorded) {
+        played = without_empty_ends(played);
+        recorded = without_empty_ends(recorded);
+        ASSERT_EQ(played.size(), recorded.size());
+        for (size_t i = 0; i < played.size(); i++) {
+            EXPECT_EQ(played[i].raw, recorded[i].raw) << "report " << i;
+            // Event times are odd, so the pauses can be off by 1 ms
+            EXPECT_NEAR(played[i].time - played[0].time, recorded[i].time - recorded[0].time, 1)
+                << "report " << i;
+        }
+    }
+
+    TestDriver driver;
+    std::vector<SentReport> reports;
+};
+
+TEST_F(DynamicMacro, PlaybackReproducesTheRecordedReports) {
+    record(KEY_REC1);
+    press_key(KEY_LSFT);
+    idle_for(30);
+    tap(KEY_A, 50);
+    idle_for(120);
+    tap(KEY_B, 10);
+    release_key(KEY_LSFT);
+    idle_for(200);
+    tap(KEY_C, 80);
+    std::vector<SentReport> recorded(reports);
+    stop();
+    EXPECT_EQ(recorded.size(), 8);
+
+    expect_same(play(KEY_PLAY1), recorded);
+    // And again, playing doesn't change the macro
+    expect_same(play(KEY_PLAY1), recorded);
+}
+
+TEST_F(DynamicMacro, EventsTakeAFewBytes) {
+    record(KEY_REC2);
+    const int keystrokes = 8;
+    for (int i = 0; i < keystrokes; i++) {
+        if (i % 2) {
+            tap(KEY_A, 20);
+        } else {
+            tap(KEY_B, 20);
+        }
+        idle_for(40);
+    }
+    stop();
+    double bytes_per_keystroke = (double)dynamic_macro_length(2) / keystrokes;
+    std::cout << "dynamic macro: " << bytes_per_keystroke << " bytes per keystroke, "
+        << 2 * sizeof(keyrecord_t) << " bytes uncompressed" << std::endl;
+    // The delay, pressed state and key fit in two bytes for short pauses
+    EXPECT_EQ(dynamic_macro_length(2), keystrokes * 4);
+}
+
+TEST_F(DynamicMacro, PlaybackDoesntBlockTheScan) {
+    record(KEY_REC1);
+    tap(KEY_A);
+    tap(KEY_B);
+    stop();
+    std::vector<SentReport> played = without_empty_ends(play(KEY_PLAY1));
+    // A, its release and B, each in a scan of its own
+    ASSERT_EQ(played.size(), 3);
+    EXPECT_EQ(played[0].raw[2], KC_A);
+    EXPECT_EQ(played[2].raw[2], KC_B);
+    EXPECT_LT(played[0].time, played[1].time);
+    EXPECT_LT(played[1].time, played[2].time);
+}
+
+TEST_F(DynamicMacro, HeldKeysAreTrimmedWhenStopping) {
+    record(KEY_REC1);
+    tap(KEY_A);
+    press_key(KEY_LSFT);
+    run_one_scan_loop();
+    stop();
+    release_key(KEY_LSFT);
+    run_one_scan_loop();
+    // A press and a release
+    EXPECT_EQ(dynamic_macro_length(1), 4);
+}
+
+TEST_F(DynamicMacro, LeadingReleasesAreIgnored) {
+    press_key(KEY_A);
+    run_one_scan_loop();
+    record(KEY_REC1);
+    release_key(KEY_A);
+    run_one_scan_loop();
+    tap(KEY_B);
+    stop();
+    EXPECT_EQ(dynamic_macro_length(1), 4);
+}
+
+TEST_F(DynamicMacro, TapStateIsReplayed) {
+    record(KEY_REC1);
+    tap(KEY_SFT_T_P);
+    idle_for(TAPPING_TERM);
+    std::vector<SentReport> recorded(reports);
+    stop();
+    ASSERT_EQ(recorded.size(), 2);
+    EXPECT_EQ(recorded[0].raw[2], KC_P);
+    expect_same(play(KEY_PLAY1), recorded);
+}
+
+TEST_F(DynamicMacro, RerecordingMovesTheOtherSlots) {
+    record(KEY_REC1);
+    tap(KEY_A);
+    stop();
+    record(KEY_REC2);
+    tap(KEY_B);
+    tap(KEY_B);
+    stop();
+    record(KEY_REC3);
+    tap(KEY_C);
+    std::vector<SentReport> recorded3(reports);
+    stop();
+    EXPECT_EQ(dynamic_macro_used_bytes(), 16);
+
+    // Slot 1 is moved to the end
+    record(KEY_REC1);
+    tap(KEY_A);
+    tap(KEY_C);
+    tap(KEY_A);
+    std::vector<SentReport> recorded1(reports);
+    stop();
+    EXPECT_EQ(dynamic_macro_used_bytes(), 24);
+
+    expect_same(play(KEY_PLAY3), recorded3);
+    expect_same(play(KEY_PLAY1), recorded1);
+    std::vector<SentReport> played2 = without_empty_ends(play(KEY_PLAY2));
+    ASSERT_EQ(played2.size(), 3);
+    EXPECT_EQ(played2[2].raw[2], KC_B);
+}
+
+TEST_F(DynamicMacro, RecordingStopsWhenTheBufferIsFull) {
+    record(KEY_REC2);
+    for (int i = 0; i < 20; i++) {
+        tap(KEY_A);
+    }
+    stop();
+    EXPECT_EQ(dynamic_macro_length(2), DYNAMIC_MACRO_BYTES);
+    // Every other report is empty
+    std::vector<SentReport> played = without_empty_ends(play(KEY_PLAY2));
+    EXPECT_EQ(played.size() + 1, DYNAMIC_MACRO_BYTES / 2);
+}
+
+TEST_F(DynamicMacro, KeysPressedDuringPlaybackWaitForIt) {
+    record(KEY_REC1);
+    tap(KEY_A);
+    idle_for(100);
+    tap(KEY_A);
+    stop();
+    reports.clear();
+    tap(KEY_PLAY1);
+    idle_for(10);
+    press_key(KEY_C);
+    run_one_scan_loop();
+    idle_for(200);
+    release_key(KEY_C);
+    run_one_scan_loop();
+    std::vector<SentReport> sent = without_empty_ends(reports);
+    // A, its release, A, its release and the end of the playback, then C
+    ASSERT_EQ(sent.size(), 6);
+    EXPECT_EQ(sent[2].raw[2], KC_A);
+    EXPECT_EQ(sent[5].raw[2], KC_C);
+    EXPECT_EQ(sent[5].time, sent[4].time);
+}
+
+TEST_F(DynamicMacro, StopEndsThePlayback) {
+    record(KEY_REC1);
+    tap(KEY_A);
+    idle_for(500);
+    tap(KEY_B);
+    stop();
+    reports.clear();
+    tap(KEY_PLAY1);
+    idle_for(10);
+    stop();
+    idle_for(1000);
+    // B is never pressed
+    std::vector<SentReport> sent = without_empty_ends(reports);
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0].raw[2], KC_A);
+}
+
+TEST_F(DynamicMacro, MacrosAreSavedToEeprom) {
+    record(KEY_REC2);
+    tap(KEY_B, 30);
+    idle_for(60);
+    tap(KEY_C, 30);
+    std::vector<SentReport> recorded(reports);
+    stop();
+    EXPECT_EQ(eeprom_read_word((uint16_t*)DYNAMIC_MACRO_EEPROM_ADDR) >> 8, 0xD7);
+
+    // Forget everything, like after a restart
+    for (uint8_t slot = 0; slot < DYNAMIC_MACRO_SLOTS; slot++) {
+        dynamic_macro_free(slot);
+    }
+    EXPECT_EQ(dynamic_macro_used_bytes(), 0);
+    dynamic_macro_load();
+    expect_same(play(KEY_PLAY2), recorded);
+}
@@ -0,0 +1,125 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+extern "C" {
+#include "eeconfig.h"
+#include "eeprom.h"
+#include "suspend.h"
+    uint32_t eeprom_get_write_count(void);
+    uint16_t eeprom_get_write_cycles(const uint8_t *addr);
+    void eeprom_reset_write_count(void);
+}
+
+#include "test_common.hpp"
+
+class EeconfigCache : public TestFixture {
+public:
+    EeconfigCache() {
+        eeconfig_flush();
+        eeprom_reset_write_count();
+        writes_avoided = eeconfig_writes_avoided();
+    }
+
+    TestDriver driver;
+    uint16_t writes_avoided;
+};
+
+TEST_F(EeconfigCache, UpdatesAreNotWrittenImmediately) {
+    for (uint8_t i = 1; i <= 10; i++) {
+        eeconfig_update_default_layer(i);
+        run_one_scan_loop();
+    }
+    EXPECT_EQ(eeprom_get_write_count(), 0);
+    EXPECT_EQ(eeconfig_read_default_layer(), 10);
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_DEFAULT_LAYER), 0);
+}
+
+TEST_F(EeconfigCache, FlushesAfterAQuietPeriod) {
+    eeconfig_update_default_layer(3);
+    idle_for(EECONFIG_FLUSH_DELAY - 1);
+    EXPECT_EQ(eeprom_get_write_count(), 0);
+    idle_for(2);
+    EXPECT_EQ(eeprom_get_write_count(), 1);
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_DEFAULT_LAYER), 3);
+}
+
+TEST_F(EeconfigCache, KeepsPostponingWhileUpdating) {
+    for (int i = 0; i < 50; i++) {
+        eeconfig_update_keymap(i);
+        idle_for(EECONFIG_FLUSH_DELAY / 2);
+    }
+    EXPECT_EQ(eeprom_get_write_count(), 0);
+    idle_for(EECONFIG_FLUSH_DELAY);
+    EXPECT_EQ(eeprom_get_write_cycles(EECONFIG_KEYMAP), 1);
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_KEYMAP), 49);
+}
+
+TEST_F(EeconfigCache, CoalescesDwordSteps) {
+    // Like stepping the rgblight hue, one write per key press
+    uint32_t value = 0;
+    uint32_t prev = eeconfig_read_dword(EECONFIG_RGBLIGHT);
+    uint32_t changed_bytes = 0;
+    int byte_changes = 0;
+    for (int i = 0; i < 100; i++) {
+        value += 0x00000A00;
+        for (int b = 0; b < 32; b += 8) {
+            if (((prev ^ value) >> b) & 0xFF) {
+                byte_changes++;
+                changed_bytes |= 1 << b;
+            }
+        }
+        prev = value;
+        eeconfig_update_dword(EECONFIG_RGBLIGHT, value);
+        idle_for(20);
+    }
+    EXPECT_EQ(eeconfig_read_dword(EECONFIG_RGBLIGHT), value);
+    idle_for(EECONFIG_FLUSH_DELAY);
+    EXPECT_EQ(eeprom_read_dword(EECONFIG_RGBLIGHT), value);
+    EXPECT_LE(eeprom_get_write_count(), 4);
+    // Without the cache, every change of a byte would have been written
+    EXPECT_EQ(eeconfig_writes_avoided() - writes_avoided, byte_changes - __builtin_popcount(changed_bytes));
+}
+
+TEST_F(EeconfigCache, UnchangedValuesAreNotWritten) {
+    uint8_t layer = eeconfig_read_default_layer();
+    eeconfig_update_default_layer(layer);
+    // There was no write to avoid
+    EXPECT_EQ(eeconfig_writes_avoided() - writes_avoided, 0);
+    eeconfig_flush();
+    EXPECT_EQ(eeprom_get_write_count(), 0);
+}
+
+TEST_F(EeconfigCache, FlushWritesImmediately) {
+    eeconfig_update_debug(5);
+    eeconfig_flush();
+    EXPECT_EQ(eeprom_get_write_count(), 1);
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_DEBUG), 5);
+}
+
+TEST_F(EeconfigCache, FlushesOnSuspend) {
+    eeconfig_update_debug(7);
+    suspend_power_down();
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_DEBUG), 7);
+}
+
+TEST_F(EeconfigCache, EnableIsWrittenThrough) {
+    eeconfig_disable();
+    EXPECT_FALSE(eeconfig_is_enabled());
+    EXPECT_EQ(eeprom_read_word(EECONFIG_MAGIC), 0xFFFF);
+    eeconfig_enable();
+    EXPECT_TRUE(eeconfig_is_enabled());
+    EXPECT_EQ(eeprom_read_word(EECONFIG_MAGIC), EECONFIG_MAGIC_NUMBER);
+}
@@ -0,0 +1,213 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include "mousekey.h"
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+using testing::_;
+using testing::Invoke;
+using testing::AnyNumber;
+
+static const uint8_t UP = 0;
+static const uint8_t DOWN = 1;
+static const uint8_t LEFT = 2;
+static const uint8_t RIGHT = 3;
+static const uint8_t WHEEL_UP = 4;
+static const uint8_t ACCEL0 = 6;
+
+class MouseKey : public TestFixture {
+public:
+    MouseKey() {
+        mk_curve = MOUSEKEY_CURVE;
+        EXPECT_CALL(driver, send_mouse_mock(_)).WillRepeatedly(Invoke([this](report_mouse_t& report) {
+            reports.push_back(report);
+        }));
+    }
+
+    ~MouseKey() {
+        clear_all_keys();
+        idle_for(1000);
+        mk_curve = MOUSEKEY_CURVE;
+    }
+
+    int total_x(size_t from = 0) {
+        int sum = 0;
+        for (size_t i = from; i < reports.size(); i++) {
+            sum += reports[i].x;
+        }
+        return sum;
+    }
+
+    int total_y() {
+        int sum = 0;
+        for (auto& r : reports) {
+            sum += r.y;
+        }
+        return sum;
+    }
+
+    // The distance the pointer should move when a direction has been held for
+    // the given time, integrated in floating point
+    static double model_distance(uint8_t curve, unsigned held_ms) {
+        double interval = mk_interval;
+        double v_min = MOUSEKEY_MOVE_DELTA / interval;
+        double v_max = MOUSEKEY_MOVE_DELTA * mk_max_speed / interval;
+        double time_to_max = mk_time_to_max * interval;
+        double distance = MOUSEKEY_MOVE_DELTA;
+        double delay = mk_delay * 10;
+        for (double t = delay; t < held_ms; t += 0.01) {
+            double x = std::min((t - delay) / time_to_max, 1.0);
+            double f;
+            switch (curve) {
+                case MOUSEKEY_CURVE_QUADRATIC: f = x * x; break;
+                case MOUSEKEY_CURVE_EXPONENTIAL: f = (std::pow(2.0, 4.0 * x) - 1.0) / 15.0; break;
+                default: f = x; break;
+            }
+            distance += (v_min + (v_max - v_min) * f) * 0.01;
+        }
+        return distance;
+    }
+
+    int hold(uint8_t col, unsigned ms) {
+        press_key(col, 0);
+        idle_for(ms);
+        release_key(col, 0);
+        run_one_scan_loop();
+        return total_x();
+    }
+
+    TestDriver driver;
+    std::vector<report_mouse_t> reports;
+};
+
+TEST_F(MouseKey, ATapMovesOneStep) {
+    hold(RIGHT, 1);
+    EXPECT_EQ(total_x(), MOUSEKEY_MOVE_DELTA);
+    idle_for(1000);
+    EXPECT_EQ(total_x(), MOUSEKEY_MOVE_DELTA);
+}
+
+TEST_F(MouseKey, NothingMovesDuringTheInitialDelay) {
+    press_key(LEFT, 0);
+    idle_for(mk_delay * 10 - 1);
+    EXPECT_EQ(total_x(), -MOUSEKEY_MOVE_DELTA);
+    idle_for(50);
+    EXPECT_LT(total_x(), -MOUSEKEY_MOVE_DELTA);
+}
+
+TEST_F(MouseKey, ButtonsAreReported) {
+    press_key(5, 0);
+    run_one_scan_loop();
+    ASSERT_FALSE(reports.empty());
+    EXPECT_EQ(reports.back().buttons, MOUSE_BTN1);
+    release_key(5, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(reports.back().buttons, 0);
+}
+
+TEST_F(MouseKey, TrajectoryFollowsTheAccelerationCurve) {
+    const uint8_t curves[] = {
+        MOUSEKEY_CURVE_LINEAR,
+        MOUSEKEY_CURVE_QUADRATIC,
+        MOUSEKEY_CURVE_EXPONENTIAL,
+    };
+    for (uint8_t curve : curves) {
+        reports.clear();
+        mk_curve = curve;
+        unsigned held = mk_delay * 10 + mk_time_to_max * mk_interval + 500;
+        int distance = hold(RIGHT, held);
+        double expected = model_distance(curve, held);
+        EXPECT_NEAR(distance, expected, expected * 0.01 + 2) << "curve " << (int)curve;
+        idle_for(100);
+    }
+}
+
+TEST_F(MouseKey, SteadySpeedHasNoRoundingLoss) {
+    press_key(RIGHT, 0);
+    idle_for(mk_delay * 10 + mk_time_to_max * mk_interval + 10);
+    size_t start = reports.size();
+    idle_for(1000);
+    // The maximum speed is 1 pixel per millisecond
+    double per_ms = (double)MOUSEKEY_MOVE_DELTA * mk_max_speed / mk_interval;
+    EXPECT_NEAR(total_x(start), per_ms * 1000, 1);
+    // And every 1 ms report moves the same amount
+    for (size_t i = start; i < reports.size(); i++) {
+        EXPECT_NEAR(reports[i].x, per_ms, 1);
+    }
+}
+
+TEST_F(MouseKey, SlowSpeedsAccumulateFractions) {
+    press_key(ACCEL0, 0);
+    run_one_scan_loop();
+    press_key(RIGHT, 0);
+    idle_for(mk_delay * 10);
+    int start = total_x();
+    idle_for(1000);
+    // A quarter of the maximum speed, a quarter pixel per millisecond
+    double per_ms = (double)MOUSEKEY_MOVE_DELTA * mk_max_speed / mk_interval / 4;
+    EXPECT_NEAR(total_x() - start, per_ms * 1000, 1);
+}
+
+TEST_F(MouseKey, DiagonalMovementIsScaled) {
+    unsigned held = mk_delay * 10 + mk_time_to_max * mk_interval + 500;
+    int straight = hold(RIGHT, held);
+    idle_for(100);
+    reports.clear();
+    press_key(RIGHT, 0);
+    press_key(DOWN, 0);
+    idle_for(held);
+    release_key(RIGHT, 0);
+    release_key(DOWN, 0);
+    run_one_scan_loop();
+    // The keys are pressed and released one scan apart
+    EXPECT_NEAR(total_x(), total_y(), 1);
+    EXPECT_NEAR(total_x(), straight * 0.7071, straight * 0.01 + 2);
+}
+
+TEST_F(MouseKey, KineticCurveGlidesToAStop) {
+    mk_curve = MOUSEKEY_CURVE_KINETIC;
+    press_key(RIGHT, 0);
+    idle_for(mk_delay * 10 + mk_time_to_max * mk_interval + 100);
+    release_key(RIGHT, 0);
+    run_one_scan_loop();
+    int released_at = total_x();
+    idle_for(MOUSEKEY_KINETIC_STOP_TIME + 50);
+    int glide = total_x() - released_at;
+    // Decelerating linearly from the maximum speed
+    double v_max = (double)MOUSEKEY_MOVE_DELTA * mk_max_speed / mk_interval;
+    EXPECT_NEAR(glide, v_max * MOUSEKEY_KINETIC_STOP_TIME / 2, 5);
+    int stopped_at = total_x();
+    idle_for(100);
+    EXPECT_EQ(total_x(), stopped_at);
+}
+
+TEST_F(MouseKey, WheelUsesTheWheelSpeed) {
+    press_key(WHEEL_UP, 0);
+    idle_for(mk_delay * 10 + mk_wheel_time_to_max * mk_interval + 1000);
+    release_key(WHEEL_UP, 0);
+    run_one_scan_loop();
+    int sum = 0;
+    for (auto& r : reports) {
+        sum += r.v;
+    }
+    double v_max = (double)MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed / mk_interval;
+    // At least the last second at the maximum speed
+    EXPECT_GT(sum, v_max * 1000 - 1);
+    EXPECT_EQ(total_x(), 0);
+}
@@ -0,0 +1,35 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "quantum.h"
+#include "keymap_steno.h"
+
+// The steno keys in keycode order, STN__MIN + col + 14 * row
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        {STN__MIN + 0, STN__MIN + 1, STN__MIN + 2, STN__MIN + 3, STN__MIN + 4, STN__MIN + 5, STN__MIN + 6, STN__MIN + 7, STN__MIN + 8, STN__MIN + 9, STN__MIN + 10, STN__MIN + 11, STN__MIN + 12, STN__MIN + 13},
+        {STN__MIN + 14, STN__MIN + 15, STN__MIN + 16, STN__MIN + 17, STN__MIN + 18, STN__MIN + 19, STN__MIN + 20, STN__MIN + 21, STN__MIN + 22, STN__MIN + 23, STN__MIN + 24, STN__MIN + 25, STN__MIN + 26, STN__MIN + 27},
+        {STN__MIN + 28, STN__MIN + 29, STN__MIN + 30, STN__MIN + 31, STN__MIN + 32, STN__MIN + 33, STN__MIN + 34, STN__MIN + 35, STN__MIN + 36, STN__MIN + 37, STN__MIN + 38, STN__MIN + 39, STN__MIN + 40, STN__MIN + 41},
+    },
+};
+
+const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt) {
+    return MACRO_NONE;
+};
+
+void action_function(keyrecord_t *record, uint8_t id, uint8_t opt) {
+}
@@ -0,0 +1,277 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+#include "keymap_steno.h"
+#include "steno_hid.h"
+#include <vector>
+#include <set>
+#include <cstdlib>
+
+using testing::_;
+using testing::AnyNumber;
+
+typedef std::set<uint8_t> Chord;
+
+struct Stroke {
+    Chord keys;
+    uint16_t start;
+    uint16_t end;
+};
+
+static std::vector<Stroke> strokes;
+static std::vector<uint8_t> serial;
+static std::vector<std::vector<uint8_t>> hid_reports;
+// Simulates a busy endpoint for that many send attempts, once the given
+// number of reports have been sent
+static unsigned hid_busy;
+static size_t hid_busy_after;
+
+extern "C" {
+void steno_stroke_user(const steno_stroke_t *stroke) {
+    Stroke s;
+    for (uint8_t key = 0; key < 48; key++) {
+        if (stroke->keys[key / 8] & (1 << (key % 8))) {
+            s.keys.insert(key);
+        }
+    }
+    s.start = stroke->start;
+    s.end = stroke->end;
+    strokes.push_back(s);
+}
+
+void virtser_send(const uint8_t byte) {
+    serial.push_back(byte);
+}
+
+bool steno_hid_try_send(const uint8_t *report) {
+    if (hid_busy && hid_reports.size() == hid_busy_after) {
+        hid_busy--;
+        return false;
+    }
+    hid_reports.push_back(std::vector<uint8_t>(report, report + STENO_HID_REPORT_SIZE));
+    return true;
+}
+}
+
+class Steno : public TestFixture {
+public:
+    TestDriver driver;
+
+    Steno() {
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+        steno_set_mode(STENO_MODE_GEMINI);
+        steno_set_chord_end(STENO_ALL_UP);
+        strokes.clear();
+        serial.clear();
+        hid_reports.clear();
+        hid_busy = 0;
+        hid_busy_after = 0;
+    }
+
+    static void press(uint8_t key) {
+        press_key(key % MATRIX_COLS, key / MATRIX_COLS);
+    }
+
+    static void release(uint8_t key) {
+        release_key(key % MATRIX_COLS, key / MATRIX_COLS);
+    }
+
+    // Decodes the gemini packets sent so far
+    std::vector<Chord> sent_chords() {
+        std::vector<Chord> chords;
+        EXPECT_EQ(0u, serial.size() % 6);
+        for (size_t i = 0; i + 6 <= serial.size(); i += 6) {
+            EXPECT_EQ(0x80, serial[i] & 0x80);
+            Chord chord;
+            for (uint8_t key = 0; key < 42; key++) {
+                if (serial[i + key / 7] & (1 << (6 - key % 7))) {
+                    chord.insert(key);
+                }
+            }
+            chords.push_back(chord);
+        }
+        return chords;
+    }
+
+    // The strokes sent as HID reports, each has to end with an all up report
+    std::vector<std::string> sent_hid_strokes() {
+        std::vector<std::string> strokes;
+        EXPECT_EQ(0u, hid_reports.size() % 2);
+        for (size_t i = 0; i + 2 <= hid_reports.size(); i += 2) {
+            char text[32];
+            uint8_t length = steno_hid_decode(hid_reports[i].data(), hid_reports[i].size(), text, sizeof(text));
+            strokes.push_back(std::string(text, length));
+            EXPECT_EQ(0, steno_hid_decode(hid_reports[i + 1].data(), hid_reports[i + 1].size(), text, sizeof(text)));
+        }
+        return strokes;
+    }
+
+    void stroke(std::initializer_list<uint8_t> keys) {
+        for (uint8_t key: keys) {
+            press(key - STN__MIN);
+        }
+        idle_for(10);
+        for (uint8_t key: keys) {
+            release(key - STN__MIN);
+        }
+        idle_for(10);
+    }
+};
+
+TEST_F(Steno, AllUpSendsTheStrokeWhenAllKeysAreReleased) {
+    press(1);
+    press(20);
+    idle_for(20);
+    release(1);
+    idle_for(20);
+    EXPECT_EQ(0u, strokes.size());
+    press(30);
+    idle_for(20);
+    release(20);
+    release(30);
+    idle_for(20);
+    ASSERT_EQ(1u, strokes.size());
+    EXPECT_EQ((Chord{1, 20, 30}), strokes[0].keys);
+    EXPECT_EQ((std::vector<Chord>{{1, 20, 30}}), sent_chords());
+}
+
+TEST_F(Steno, FirstUpSendsTheStrokeOnTheFirstRelease) {
+    steno_set_chord_end(STENO_FIRST_UP);
+    press(1);
+    press(20);
+    idle_for(20);
+    release(1);
+    idle_for(20);
+    ASSERT_EQ(1u, strokes.size());
+    EXPECT_EQ((Chord{1, 20}), strokes[0].keys);
+    // Keys still held from the previous stroke aren't repeated
+    press(30);
+    idle_for(20);
+    release(30);
+    idle_for(20);
+    release(20);
+    idle_for(20);
+    ASSERT_EQ(2u, strokes.size());
+    EXPECT_EQ((Chord{30}), strokes[1].keys);
+}
+
+TEST_F(Steno, StrokesHaveTimestamps) {
+    idle_for(5);
+    uint16_t pressed_at = timer_read();
+    press(3);
+    press(4);
+    idle_for(50);
+    uint16_t released_at = timer_read();
+    release(3);
+    release(4);
+    idle_for(10);
+    ASSERT_EQ(1u, strokes.size());
+    // Keys changed in one scan are processed one per scan
+    EXPECT_LE(pressed_at, strokes[0].start);
+    EXPECT_GE(pressed_at + 2, strokes[0].start);
+    EXPECT_LE(released_at, strokes[0].end);
+    EXPECT_GE(released_at + 2, strokes[0].end);
+}
+
+TEST_F(Steno, BoltPacketsAreTerminated) {
+    steno_set_mode(STENO_MODE_BOLT);
+    // S- and -Z
+    press(STN_S1 - STN__MIN);
+    press(STN_ZR - STN__MIN);
+    idle_for(10);
+    release(STN_S1 - STN__MIN);
+    release(STN_ZR - STN__MIN);
+    idle_for(10);
+    EXPECT_EQ((std::vector<uint8_t>{0b00000001, 0b11001000, 0}), serial);
+}
+
+// 300 words per minute at about one and a half strokes per word. The
+// next stroke is pressed in the same scan as the previous one is
+// released, which is the worst case for merging strokes. Keys in both
+// strokes have to be released a scan earlier, to be seen at all.
+TEST_F(Steno, NoMergedOrSplitStrokesAt300Wpm) {
+    const unsigned stroke_count = 300;
+    const unsigned stroke_time = 60 * 1000 / (300 * 3 / 2);
+    std::srand(1);
+    std::vector<Chord> chords;
+    for (unsigned i = 0; i < stroke_count; i++) {
+        Chord chord;
+        unsigned size = 1 + std::rand() % 10;
+        while (chord.size() < size) {
+            chord.insert(std::rand() % 42);
+        }
+        chords.push_back(chord);
+    }
+
+    for (unsigned i = 0; i < stroke_count; i++) {
+        if (i > 0) {
+            for (uint8_t key: chords[i - 1]) {
+                if (chords[i].count(key)) {
+                    release(key);
+                }
+            }
+            run_one_scan_loop();
+            for (uint8_t key: chords[i - 1]) {
+                release(key);
+            }
+        }
+        for (uint8_t key: chords[i]) {
+            press(key);
+        }
+        idle_for(stroke_time);
+    }
+    for (uint8_t key: chords.back()) {
+        release(key);
+    }
+    idle_for(50);
+
+    ASSERT_EQ(stroke_count, strokes.size());
+    for (unsigned i = 0; i < stroke_count; i++) {
+        EXPECT_EQ(chords[i], strokes[i].keys) << "stroke " << i;
+    }
+    EXPECT_EQ(chords, sent_chords());
+    EXPECT_EQ(0, steno_dropped_strokes());
+    EXPECT_EQ(0, steno_queued_strokes());
+}
+
+TEST_F(Steno, HidSendsEachStrokeFollowedByAllUp) {
+    steno_set_mode(STENO_MODE_HID);
+    stroke({STN_S1, STN_TL, STN_KL, STN_PL, STN_WL});
+    stroke({STN_FR, STN_ZR});
+    stroke({STN_N1, STN_ST3, STN_DR});
+    EXPECT_EQ((std::vector<std::string>{"STKPW", "-FZ", "#*D"}), sent_hid_strokes());
+    EXPECT_EQ(0u, serial.size());
+}
+
+TEST_F(Steno, HidRetriesWhileTheEndpointIsBusy) {
+    steno_set_mode(STENO_MODE_HID);
+    hid_busy = 3;
+    stroke({STN_KL, STN_A, STN_TR});
+    EXPECT_EQ((std::vector<std::string>{"KAT"}), sent_hid_strokes());
+    EXPECT_EQ(0, steno_queued_strokes());
+}
+
+TEST_F(Steno, HidRetriesOnlyTheAllUpReport) {
+    steno_set_mode(STENO_MODE_HID);
+    hid_busy = 5;
+    hid_busy_after = 1;
+    stroke({STN_HL, STN_RL, STN_A, STN_O, STN_E, STN_U, STN_BR, STN_GR});
+    idle_for(10);
+    EXPECT_EQ((std::vector<std::string>{"HRAOEUBG"}), sent_hid_strokes());
+    EXPECT_EQ(0, steno_queued_strokes());
+}
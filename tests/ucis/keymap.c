@@ -0,0 +1,53 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "quantum.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        {KC_A, KC_B, KC_C, KC_P, KC_O, KC_1, KC_X, KC_BSPC, KC_ENT, KC_ESC},
+    },
+};
+
+// "a", "ab" and "abc" are prefixes of each other, and "poo" is in the
+// table twice
+const qk_ucis_symbol_t ucis_symbol_table[] = UCIS_TABLE(
+    UCIS_SYM("a", 0x61),
+    UCIS_SYM("ab", 0xAB),
+    UCIS_SYM("abc", 0xABC),
+    UCIS_SYM("abp", 0x1F600),
+    UCIS_SYM("b1", 0xB1),
+    UCIS_SYM("poo", 0x1F4A9),
+    UCIS_SYM("poo", 0x1F4A8),
+    UCIS_SYM("pop", 0x20)
+);
+
+uint16_t matches_reported;
+
+void qk_ucis_matches_user(uint16_t matches) {
+    matches_reported = matches;
+}
+
+void qk_ucis_start_user(void) {
+}
+
+const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt) {
+    return MACRO_NONE;
+};
+
+void action_function(keyrecord_t *record, uint8_t id, uint8_t opt) {
+}
@@ -0,0 +1,161 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+#include <vector>
+
+extern "C" {
+extern uint16_t matches_reported;
+}
+
+using testing::_;
+using testing::AnyNumber;
+using testing::Invoke;
+
+// Matrix positions
+#define KEY_A 0, 0
+#define KEY_B 1, 0
+#define KEY_C 2, 0
+#define KEY_P 3, 0
+#define KEY_O 4, 0
+#define KEY_1 5, 0
+#define KEY_X 6, 0
+#define KEY_BSPC 7, 0
+#define KEY_ENT 8, 0
+#define KEY_ESC 9, 0
+
+class Ucis : public TestFixture {
+public:
+    TestDriver driver;
+
+    Ucis() {
+        set_unicode_input_mode(UC_LNX);
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber())
+            .WillRepeatedly(Invoke([this](report_keyboard_t& report) {
+                for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+                    if (report.keys[i] && !held[report.keys[i]]) {
+                        pressed.push_back(report.keys[i]);
+                    }
+                }
+                std::fill(std::begin(held), std::end(held), false);
+                for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+                    held[report.keys[i]] = true;
+                }
+            }));
+        qk_ucis_start();
+    }
+
+    void tap(uint8_t col, uint8_t row) {
+        press_key(col, row);
+        keyboard_task();
+        release_key(col, row);
+        keyboard_task();
+    }
+
+    bool held[256] = {};
+    // Every key press sent to the host, in order
+    std::vector<uint8_t> pressed;
+};
+
+TEST_F(Ucis, PrefixNarrowsTheMatches) {
+    EXPECT_EQ(8, qk_ucis_match_count());
+    tap(KEY_A);
+    EXPECT_EQ(4, qk_ucis_match_count());
+    EXPECT_EQ(4, matches_reported);
+    tap(KEY_B);
+    EXPECT_EQ(3, qk_ucis_match_count());
+    tap(KEY_C);
+    EXPECT_EQ(1, qk_ucis_match_count());
+    EXPECT_EQ(0xABCu, qk_ucis_match()->code);
+    tap(KEY_X);
+    EXPECT_EQ(0, qk_ucis_match_count());
+    EXPECT_EQ(0, matches_reported);
+    EXPECT_EQ(nullptr, qk_ucis_match());
+}
+
+TEST_F(Ucis, SymbolThatIsAPrefixOfOthersIsFound) {
+    tap(KEY_A);
+    ASSERT_NE(nullptr, qk_ucis_match());
+    EXPECT_EQ(0x61u, qk_ucis_match()->code);
+    tap(KEY_B);
+    ASSERT_NE(nullptr, qk_ucis_match());
+    EXPECT_EQ(0xABu, qk_ucis_match()->code);
+}
+
+TEST_F(Ucis, FirstOfDuplicateSymbolsWins) {
+    tap(KEY_P);
+    tap(KEY_O);
+    EXPECT_EQ(3, qk_ucis_match_count());
+    tap(KEY_O);
+    EXPECT_EQ(2, qk_ucis_match_count());
+    EXPECT_EQ(0x1F4A9u, qk_ucis_match()->code);
+}
+
+TEST_F(Ucis, DigitsMatch) {
+    tap(KEY_B);
+    tap(KEY_1);
+    ASSERT_NE(nullptr, qk_ucis_match());
+    EXPECT_EQ(0xB1u, qk_ucis_match()->code);
+}
+
+TEST_F(Ucis, BackspaceWidensTheMatches) {
+    tap(KEY_A);
+    tap(KEY_B);
+    tap(KEY_X);
+    EXPECT_EQ(0, qk_ucis_match_count());
+    tap(KEY_BSPC);
+    EXPECT_EQ(3, qk_ucis_match_count());
+    EXPECT_EQ(3, matches_reported);
+    tap(KEY_BSPC);
+    tap(KEY_BSPC);
+    EXPECT_EQ(8, qk_ucis_match_count());
+}
+
+TEST_F(Ucis, EnterTypesTheSymbol) {
+    tap(KEY_A);
+    tap(KEY_B);
+    tap(KEY_P);
+    pressed.clear();
+    tap(KEY_ENT);
+    std::vector<uint8_t> expected = {
+        // The typed symbol and the enter are erased
+        KC_BSPC, KC_BSPC, KC_BSPC, KC_BSPC,
+        KC_U, KC_1, KC_F, KC_6, KC_0, KC_0, KC_SPC,
+    };
+    EXPECT_EQ(expected, pressed);
+}
+
+TEST_F(Ucis, UnknownSymbolIsTypedBack) {
+    tap(KEY_A);
+    tap(KEY_X);
+    pressed.clear();
+    tap(KEY_ENT);
+    std::vector<uint8_t> expected = {KC_BSPC, KC_BSPC, KC_BSPC, KC_A, KC_X};
+    EXPECT_EQ(expected, pressed);
+}
+
+TEST_F(Ucis, EscapeCancels) {
+    tap(KEY_A);
+    pressed.clear();
+    tap(KEY_ESC);
+    std::vector<uint8_t> expected = {KC_BSPC, KC_BSPC};
+    EXPECT_EQ(expected, pressed);
+    pressed.clear();
+    tap(KEY_A);
+    expected = {KC_A};
+    EXPECT_EQ(expected, pressed);
+}
@@ -0,0 +1,191 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+using testing::Invoke;
+
+// Matrix positions
+#define KEY_E_ACUTE 0, 0
+#define KEY_SUM 1, 0
+#define KEY_LSFT 2, 0
+#define KEY_STRING 3, 0
+
+class Unicode : public TestFixture {
+public:
+    TestDriver driver;
+
+    void tap(uint8_t col, uint8_t row) {
+        press_key(col, row);
+        keyboard_task();
+        release_key(col, row);
+        keyboard_task();
+    }
+
+    unsigned count_reports(uint8_t mode, uint8_t col, uint8_t row) {
+        set_unicode_input_mode(mode);
+        unsigned count = 0;
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber())
+            .WillRepeatedly(Invoke([&count](report_keyboard_t&) { count++; }));
+        tap(col, row);
+        testing::Mock::VerifyAndClearExpectations(&driver);
+        return count;
+    }
+};
+
+TEST_F(Unicode, OsxHoldsAltAndCoalescesDigits) {
+    set_unicode_input_mode(UC_OSX);
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_E)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_9)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    tap(KEY_E_ACUTE);
+}
+
+TEST_F(Unicode, HeldModsAreReleasedAndRestoredInOneReport) {
+    set_unicode_input_mode(UC_OSX);
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    press_key(KEY_LSFT);
+    keyboard_task();
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_2)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_2)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_1)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_1)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    tap(KEY_SUM);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    release_key(KEY_LSFT);
+    keyboard_task();
+}
+
+TEST_F(Unicode, LinuxTerminatesWithSpace) {
+    set_unicode_input_mode(UC_LNX);
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LCTL, KC_LSFT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LCTL, KC_LSFT, KC_U)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_E)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_9)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_SPC)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    tap(KEY_E_ACUTE);
+}
+
+TEST_F(Unicode, WinComposeDoesNotSendARedundantReport) {
+    set_unicode_input_mode(UC_WINC);
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_RALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_U)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_E)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_9)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    tap(KEY_E_ACUTE);
+}
+
+TEST_F(Unicode, OsxStringStaysInInputModeAndUsesSurrogates) {
+    set_unicode_input_mode(UC_OSX);
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    // U+00E9
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_E)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_9)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    // U+1F600 as D83D DE00
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_D)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_8)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_3)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_D)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_D)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_E)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    tap(KEY_STRING);
+}
+
+TEST_F(Unicode, OutOfRangeCodepointsAreRejected) {
+    set_unicode_input_mode(UC_LNX);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    EXPECT_FALSE(register_unicode(0x100000));
+    EXPECT_TRUE(register_unicode(0xFFFFF));
+    set_unicode_input_mode(UC_OSX);
+    EXPECT_FALSE(register_unicode(0x110000));
+    EXPECT_TRUE(register_unicode(0x10FFFF));
+}
+
+TEST_F(Unicode, OutOfRangeCodepointTypesNothing) {
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    set_unicode_input_mode(UC_LNX);
+    EXPECT_FALSE(register_unicode(0x100000));
+    set_unicode_input_mode(UC_OSX);
+    EXPECT_FALSE(register_unicode(0x110000));
+    const uint32_t code_points[] = {0x110000};
+    send_unicode_codepoints(code_points, 1);
+}
+
+TEST_F(Unicode, StringSkipsOutOfRangeCodepoints) {
+    set_unicode_input_mode(UC_OSX);
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_0)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_E)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT, KC_9)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LALT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    const uint32_t code_points[] = {0x110000, 0x00E9, 0xFFFFFFFF};
+    send_unicode_codepoints(code_points, 3);
+}
+
+TEST_F(Unicode, ReportsPerCodepoint) {
+    // The unbatched implementation sent 10, 16, 12, 12 and 10 reports for
+    // U+00E9 on OSX, Linux, Windows, WinCompose and OSX with right alt
+    EXPECT_EQ(8u, count_reports(UC_OSX, KEY_E_ACUTE));
+    EXPECT_EQ(11u, count_reports(UC_LNX, KEY_E_ACUTE));
+    EXPECT_EQ(10u, count_reports(UC_WIN, KEY_E_ACUTE));
+    EXPECT_EQ(10u, count_reports(UC_WINC, KEY_E_ACUTE));
+    EXPECT_EQ(8u, count_reports(UC_OSX_RALT, KEY_E_ACUTE));
+}
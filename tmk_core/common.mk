@@ -30,6 +30,9 @@ endif
 ifeq ($(PLATFORM),CHIBIOS)
 	TMK_COMMON_SRC += $(PLATFORM_COMMON_DIR)/printf.c
 	TMK_COMMON_SRC += $(PLATFORM_COMMON_DIR)/eeprom.c
+	ifeq ($(MCU_SERIES),KL2x)
+		TMK_COMMON_SRC += $(PLATFORM_COMMON_DIR)/eeprom_log.c
+	endif
 endif
 
 ifeq ($(PLATFORM),TEST)
@@ -61,6 +64,21 @@ ifeq ($(strip $(RAW_ENABLE)), yes)
     TMK_COMMON_DEFS += -DRAW_ENABLE
 endif
 
+ifeq ($(strip $(RAW_TRANSFER_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/raw_transfer.c
+    TMK_COMMON_DEFS += -DRAW_TRANSFER_ENABLE
+endif
+
+ifeq ($(strip $(STENO_HID_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/steno_hid.c
+    TMK_COMMON_DEFS += -DSTENO_HID_ENABLE
+endif
+
+ifeq ($(strip $(TRACE_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/trace.c
+    TMK_COMMON_DEFS += -DTRACE_ENABLE
+endif
+
 ifeq ($(strip $(CONSOLE_ENABLE)), yes)
     TMK_COMMON_DEFS += -DCONSOLE_ENABLE
 else
@@ -77,6 +95,10 @@ ifeq ($(strip $(NKRO_ENABLE)), yes)
     TMK_COMMON_DEFS += -DNKRO_ENABLE
 endif
 
+ifeq ($(strip $(SHARED_EP_ENABLE)), yes)
+    TMK_COMMON_DEFS += -DSHARED_EP_ENABLE
+endif
+
 ifeq ($(strip $(USB_6KRO_ENABLE)), yes)
     TMK_COMMON_DEFS += -DUSB_6KRO_ENABLE
 endif
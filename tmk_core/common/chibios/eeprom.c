@@ -308,57 +308,59 @@ void do_flash_cmd(volatile uint8_t *fstat)
 #elif defined(KL2x) /* chip selection */
 /* Teensy LC (emulated) */
 
+#include <stdbool.h>
+#include "eeprom_log.h"
+
 #define SYMVAL(sym) (uint32_t)(((uint8_t *)&(sym)) - ((uint8_t *)0))
 
 extern uint32_t __eeprom_workarea_start__;
 extern uint32_t __eeprom_workarea_end__;
 
-#define EEPROM_SIZE 128
-
-static uint32_t flashend = 0;
+static bool initialized = false;
 
 void eeprom_initialize(void)
 {
-	const uint16_t *p = (uint16_t *)SYMVAL(__eeprom_workarea_start__);
-
-	do {
-		if (*p++ == 0xFFFF) {
-			flashend = (uint32_t)(p - 2);
-			return;
-		}
-	} while (p < (uint16_t *)SYMVAL(__eeprom_workarea_end__));
-	flashend = (uint32_t)((uint16_t *)SYMVAL(__eeprom_workarea_end__) - 1);
+	eeprom_log_init((const uint16_t *)SYMVAL(__eeprom_workarea_start__),
+		(const uint16_t *)SYMVAL(__eeprom_workarea_end__));
+	initialized = true;
 }
 
 uint8_t eeprom_read_byte(const uint8_t *addr)
 {
 	uint32_t offset = (uint32_t)addr;
-	const uint16_t *p = (uint16_t *)SYMVAL(__eeprom_workarea_start__);
-	const uint16_t *end = (const uint16_t *)((uint32_t)flashend);
-	uint16_t val;
-	uint8_t data=0xFF;
-
-	if (!end) {
-		eeprom_initialize();
-		end = (const uint16_t *)((uint32_t)flashend);
-	}
-	if (offset < EEPROM_SIZE) {
-		while (p <= end) {
-			val = *p++;
-			if ((val & 255) == offset) data = val >> 8;
-		}
-	}
-	return data;
+
+	if (!initialized) eeprom_initialize();
+	if (offset >= EEPROM_LOG_SIZE) return 0xFF;
+	return eeprom_log_read(offset);
+}
+
+/*
+void do_flash_cmd(volatile uint8_t *fstat)
+{
+        *fstat = 0x80;
+        while ((*fstat & 0x80) == 0) ; // wait
 }
+00000000 <do_flash_cmd>:
+   0:	2380      	movs	r3, #128	; 0x80
+   2:	7003      	strb	r3, [r0, #0]
+   4:	7803      	ldrb	r3, [r0, #0]
+   6:	b25b      	sxtb	r3, r3
+   8:	2b00      	cmp	r3, #0
+   a:	dafb      	bge.n	4 <do_flash_cmd+0x4>
+   c:	4770      	bx	lr
+*/
+// The flash can't be read while it's being programmed, so this runs from RAM
+static uint16_t do_flash_cmd[] = {
+	0x2380, 0x7003, 0x7803, 0xb25b, 0x2b00, 0xdafb, 0x4770};
 
-static void flash_write(const uint16_t *code, uint32_t addr, uint32_t data)
+// Each command is a separate, short, IRQ-off window
+static void flash_cmd(uint32_t fccob3)
 {
 	// with great power comes great responsibility....
 	uint32_t stat;
-	*(uint32_t *)&(FTFA->FCCOB3) = 0x06000000 | (addr & 0x00FFFFFC);
-	*(uint32_t *)&(FTFA->FCCOB7) = data;
+	*(uint32_t *)&(FTFA->FCCOB3) = fccob3;
 	__disable_irq();
-	(*((void (*)(volatile uint8_t *))((uint32_t)code | 1)))(&(FTFA->FSTAT));
+	(*((void (*)(volatile uint8_t *))((uint32_t)do_flash_cmd | 1)))(&(FTFA->FSTAT));
 	__enable_irq();
 	stat = FTFA->FSTAT & (FTFA_FSTAT_RDCOLERR|FTFA_FSTAT_ACCERR|FTFA_FSTAT_FPVIOL);
 	if (stat) {
@@ -367,87 +369,35 @@ static void flash_write(const uint16_t *code, uint32_t addr, uint32_t data)
 	MCM->PLACR |= MCM_PLACR_CFCC;
 }
 
-void eeprom_write_byte(uint8_t *addr, uint8_t data)
+void eeprom_log_flash_program(const uint16_t *address, uint16_t value)
 {
-	uint32_t offset = (uint32_t)addr;
-	const uint16_t *p, *end = (const uint16_t *)((uint32_t)flashend);
-	uint32_t i, val, flashaddr;
-	uint16_t do_flash_cmd[] = {
-		0x2380, 0x7003, 0x7803, 0xb25b, 0x2b00, 0xdafb, 0x4770};
-	uint8_t buf[EEPROM_SIZE];
+	uint32_t flashaddr = (uint32_t)address;
+	uint32_t val = value;
 
-	if (offset >= EEPROM_SIZE) return;
-	if (!end) {
-		eeprom_initialize();
-		end = (const uint16_t *)((uint32_t)flashend);
-	}
-	if (++end < (uint16_t *)SYMVAL(__eeprom_workarea_end__)) {
-		val = (data << 8) | offset;
-		flashaddr = (uint32_t)end;
-		flashend = flashaddr;
-		if ((flashaddr & 2) == 0) {
-			val |= 0xFFFF0000;
-		} else {
-			val <<= 16;
-			val |= 0x0000FFFF;
-		}
-		flash_write(do_flash_cmd, flashaddr, val);
+	// Only whole longwords can be programmed, so leave the other half erased
+	if ((flashaddr & 2) == 0) {
+		val |= 0xFFFF0000;
 	} else {
-		for (i=0; i < EEPROM_SIZE; i++) {
-			buf[i] = 0xFF;
-		}
-		val = 0;
-		for (p = (uint16_t *)SYMVAL(__eeprom_workarea_start__); p < (uint16_t *)SYMVAL(__eeprom_workarea_end__); p++) {
-			val = *p;
-			if ((val & 255) < EEPROM_SIZE) {
-				buf[val & 255] = val >> 8;
-			}
-		}
-		buf[offset] = data;
-		for (flashaddr=(uint32_t)(uint16_t *)SYMVAL(__eeprom_workarea_start__); flashaddr < (uint32_t)(uint16_t *)SYMVAL(__eeprom_workarea_end__); flashaddr += 1024) {
-			*(uint32_t *)&(FTFA->FCCOB3) = 0x09000000 | flashaddr;
-			__disable_irq();
-			(*((void (*)(volatile uint8_t *))((uint32_t)do_flash_cmd | 1)))(&(FTFA->FSTAT));
-			__enable_irq();
-			val = FTFA->FSTAT & (FTFA_FSTAT_RDCOLERR|FTFA_FSTAT_ACCERR|FTFA_FSTAT_FPVIOL);;
-			if (val) FTFA->FSTAT = val;
-			MCM->PLACR |= MCM_PLACR_CFCC;
-		}
-		flashaddr=(uint32_t)(uint16_t *)SYMVAL(__eeprom_workarea_start__);
-		for (i=0; i < EEPROM_SIZE; i++) {
-			if (buf[i] == 0xFF) continue;
-			if ((flashaddr & 2) == 0) {
-				val = (buf[i] << 8) | i;
-			} else {
-				val = val | (buf[i] << 24) | (i << 16);
-				flash_write(do_flash_cmd, flashaddr, val);
-			}
-			flashaddr += 2;
-		}
-		flashend = flashaddr;
-		if ((flashaddr & 2)) {
-			val |= 0xFFFF0000;
-			flash_write(do_flash_cmd, flashaddr, val);
-		}
+		val <<= 16;
+		val |= 0x0000FFFF;
 	}
+	*(uint32_t *)&(FTFA->FCCOB7) = val;
+	flash_cmd(0x06000000 | (flashaddr & 0x00FFFFFC));
 }
 
-/*
-void do_flash_cmd(volatile uint8_t *fstat)
+void eeprom_log_flash_erase(const uint16_t *sector)
 {
-        *fstat = 0x80;
-        while ((*fstat & 0x80) == 0) ; // wait
+	flash_cmd(0x09000000 | ((uint32_t)sector & 0x00FFFFFF));
 }
-00000000 <do_flash_cmd>:
-   0:	2380      	movs	r3, #128	; 0x80
-   2:	7003      	strb	r3, [r0, #0]
-   4:	7803      	ldrb	r3, [r0, #0]
-   6:	b25b      	sxtb	r3, r3
-   8:	2b00      	cmp	r3, #0
-   a:	dafb      	bge.n	4 <do_flash_cmd+0x4>
-   c:	4770      	bx	lr
-*/
 
+void eeprom_write_byte(uint8_t *addr, uint8_t data)
+{
+	uint32_t offset = (uint32_t)addr;
+
+	if (!initialized) eeprom_initialize();
+	if (offset >= EEPROM_LOG_SIZE) return;
+	eeprom_log_write(offset, data);
+}
 
 uint16_t eeprom_read_word(const uint16_t *addr)
 {
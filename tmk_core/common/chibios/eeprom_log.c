@@ -0,0 +1,223 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "eeprom_log.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HEADER_MAGIC 0xE5
+#define ERASED 0xFFFF
+
+// The offset byte of a record must never be mistaken for the header magic
+#if EEPROM_LOG_SIZE > HEADER_MAGIC
+#error "EEPROM_LOG_SIZE is too big for the record format"
+#endif
+
+#if EEPROM_LOG_SIZE >= EEPROM_LOG_SECTOR_WORDS
+#error "EEPROM_LOG_SIZE doesn't fit in a sector"
+#endif
+
+static uint8_t shadow[EEPROM_LOG_SIZE];
+
+static const uint16_t* area_start;
+static uint8_t num_sectors;
+static uint8_t active_sector;
+static uint8_t generation;
+// The next free word of the active log, NULL if there's no log yet
+static const uint16_t* write_ptr;
+static const uint16_t* log_end;
+static uint16_t compactions;
+
+static const uint16_t* get_sector(uint8_t sector) {
+    return area_start + (uint32_t)sector * EEPROM_LOG_SECTOR_WORDS;
+}
+
+static void replay(const uint16_t* p, const uint16_t* end) {
+    while (p < end && *p != ERASED) {
+        uint16_t record = *p++;
+        uint8_t offset = record & 0xFF;
+        if (offset < EEPROM_LOG_SIZE) {
+            shadow[offset] = record >> 8;
+        }
+    }
+    write_ptr = p;
+    log_end = end;
+}
+
+// The legacy log is read up to its last record rather than its first erased
+// word, so that it still reads right with a sector erased by the migration
+static void replay_legacy(void) {
+    const uint16_t* end = get_sector(num_sectors);
+    for (const uint16_t* p = area_start; p < end; p++) {
+        if (*p != ERASED) {
+            uint8_t offset = *p & 0xFF;
+            if (offset < EEPROM_LOG_SIZE) {
+                shadow[offset] = *p >> 8;
+            }
+            write_ptr = p + 1;
+        }
+    }
+    log_end = end;
+}
+
+uint8_t eeprom_log_read(uint8_t offset) {
+    if (offset >= EEPROM_LOG_SIZE) {
+        return 0xFF;
+    }
+    return shadow[offset];
+}
+
+static void erase_sector(const uint16_t* sector) {
+    for (const uint16_t* p = sector; p < sector + EEPROM_LOG_SECTOR_WORDS; p++) {
+        if (*p != ERASED) {
+            eeprom_log_flash_erase(sector);
+            return;
+        }
+    }
+}
+
+static void compact(void) {
+    if (num_sectors == 0) {
+        return;
+    }
+    uint8_t target = active_sector + 1;
+    if (target >= num_sectors) {
+        target = 0;
+    }
+    const uint16_t* sector = get_sector(target);
+    const uint16_t* end = sector + EEPROM_LOG_SECTOR_WORDS;
+    erase_sector(sector);
+    const uint16_t* p = sector + 1;
+    for (uint8_t i = 0; i < EEPROM_LOG_SIZE; i++) {
+        if (shadow[i] != 0xFF) {
+            eeprom_log_flash_program(p++, (shadow[i] << 8) | i);
+        }
+    }
+    // The header goes last, until it's there the old sector is still valid
+    generation++;
+    eeprom_log_flash_program(sector, (generation << 8) | HEADER_MAGIC);
+    active_sector = target;
+    write_ptr = p;
+    log_end = end;
+    compactions++;
+}
+
+// Moves the legacy log to the sectored layout, without a point where a power
+// loss loses any data
+static void migrate_legacy(void) {
+    if (num_sectors < 2) {
+        return;
+    }
+    const uint16_t* last_sector = get_sector(num_sectors - 1);
+    if (write_ptr <= last_sector) {
+        // The last sector is free, and the legacy log stays in charge until
+        // the header of the copy is written
+        active_sector = num_sectors - 2;
+        compact();
+        return;
+    }
+
+    // Otherwise the first sectors are freed, by appending the bytes that
+    // are only recorded there to the last sector. Once that's done they can
+    // be erased, in any state, without changing what the log reads as.
+    uint8_t newer[(EEPROM_LOG_SIZE + 7) / 8] = {0};
+    uint8_t copy[(EEPROM_LOG_SIZE + 7) / 8] = {0};
+    uint8_t num_copies = 0;
+    for (const uint16_t* p = last_sector; p < write_ptr; p++) {
+        uint8_t offset = *p & 0xFF;
+        if (*p != ERASED && offset < EEPROM_LOG_SIZE) {
+            newer[offset / 8] |= 1 << (offset % 8);
+        }
+    }
+    for (const uint16_t* p = area_start; p < last_sector; p++) {
+        uint8_t offset = *p & 0xFF;
+        uint8_t bit = 1 << (offset % 8);
+        if (*p != ERASED && offset < EEPROM_LOG_SIZE && !((newer[offset / 8] | copy[offset / 8]) & bit)) {
+            copy[offset / 8] |= bit;
+            num_copies++;
+        }
+    }
+    if (log_end - write_ptr < num_copies) {
+        // There's no room, so the log is only migrated when it's full, by a
+        // compaction which isn't power safe, like the original code
+        return;
+    }
+    for (uint8_t i = 0; i < EEPROM_LOG_SIZE; i++) {
+        if (copy[i / 8] & (1 << (i % 8))) {
+            eeprom_log_flash_program(write_ptr++, (shadow[i] << 8) | i);
+        }
+    }
+    for (uint8_t i = 0; i < num_sectors - 1; i++) {
+        erase_sector(get_sector(i));
+    }
+    // Into sector 0, with generation 0
+    compact();
+}
+
+void eeprom_log_init(const uint16_t* start, const uint16_t* end) {
+    memset(shadow, 0xFF, sizeof(shadow));
+    area_start = start;
+    num_sectors = (end - start) / EEPROM_LOG_SECTOR_WORDS;
+    write_ptr = NULL;
+    compactions = 0;
+    // The first compaction goes to sector 0, with generation 0
+    active_sector = num_sectors - 1;
+    generation = 0xFF;
+
+    bool found = false;
+    for (uint8_t i = 0; i < num_sectors; i++) {
+        uint16_t header = get_sector(i)[0];
+        if ((header & 0xFF) == HEADER_MAGIC) {
+            uint8_t g = header >> 8;
+            if (!found || (int8_t)(g - generation) > 0) {
+                found = true;
+                generation = g;
+                active_sector = i;
+            }
+        }
+    }
+
+    if (found) {
+        const uint16_t* sector = get_sector(active_sector);
+        replay(sector + 1, sector + EEPROM_LOG_SECTOR_WORDS);
+    }
+    else if (num_sectors > 0) {
+        // The legacy layout, one log for the whole work area
+        replay_legacy();
+        if (write_ptr) {
+            migrate_legacy();
+        }
+    }
+}
+
+void eeprom_log_write(uint8_t offset, uint8_t value) {
+    if (offset >= EEPROM_LOG_SIZE || shadow[offset] == value) {
+        return;
+    }
+    shadow[offset] = value;
+    if (write_ptr && write_ptr < log_end) {
+        eeprom_log_flash_program(write_ptr, (value << 8) | offset);
+        write_ptr++;
+    }
+    else {
+        compact();
+    }
+}
+
+uint16_t eeprom_log_get_compactions(void) {
+    return compactions;
+}
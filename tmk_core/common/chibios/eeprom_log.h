@@ -0,0 +1,65 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TMK_CORE_COMMON_CHIBIOS_EEPROM_LOG_H_
+#define TMK_CORE_COMMON_CHIBIOS_EEPROM_LOG_H_
+
+#include <stdint.h>
+
+// Log structured EEPROM emulation on top of flash, used by the Teensy LC
+//
+// The flash work area is split into sectors, only one of which is active at
+// a time. The active sector starts with a header word (generation << 8 | 0xE5)
+// followed by 16-bit records (value << 8 | offset), appended in write order.
+// The current value of every byte is kept in a RAM shadow, built once by
+// eeprom_log_init, so reads never touch the flash.
+//
+// When the active sector is full, the live bytes are copied to the next
+// sector, and its header is programmed last, so that a power loss during
+// the compaction leaves the old sector in charge. The sector is only erased
+// when it's about to be reused, so every compaction costs exactly one erase.
+//
+// The headerless layout written by the original Teensyduino code, a single
+// log spanning the whole work area, is still read, and migrated by
+// eeprom_log_init. If the log has reached the last sector, the bytes only
+// recorded in the sectors before are appended to it first, so that those
+// can be erased. A legacy log without room for that is appended to until
+// it's full, and then compacted the way the original code would.
+
+#ifndef EEPROM_LOG_SIZE
+#define EEPROM_LOG_SIZE 128
+#endif
+
+#ifndef EEPROM_LOG_SECTOR_SIZE
+#define EEPROM_LOG_SECTOR_SIZE 1024
+#endif
+
+#define EEPROM_LOG_SECTOR_WORDS (EEPROM_LOG_SECTOR_SIZE / 2)
+
+// start and end delimit the work area, which should be a whole number of sectors
+void eeprom_log_init(const uint16_t* start, const uint16_t* end);
+uint8_t eeprom_log_read(uint8_t offset);
+void eeprom_log_write(uint8_t offset, uint8_t value);
+// The number of compactions done since eeprom_log_init
+uint16_t eeprom_log_get_compactions(void);
+
+// Implemented by the flash driver
+// Programs a single 16-bit word, the word has to be erased first
+void eeprom_log_flash_program(const uint16_t* address, uint16_t value);
+// Erases a whole sector, setting all words to 0xFFFF
+void eeprom_log_flash_erase(const uint16_t* sector);
+
+#endif /* TMK_CORE_COMMON_CHIBIOS_EEPROM_LOG_H_ */
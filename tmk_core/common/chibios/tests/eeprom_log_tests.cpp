@@ -0,0 +1,305 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <random>
+#include <vector>
+extern "C" {
+#include "eeprom_log.h"
+}
+
+// A simulated flash with two sectors, which can lose power in the middle of
+// any program or erase operation
+static const int num_sectors = 2;
+static uint16_t flash[num_sectors * EEPROM_LOG_SECTOR_WORDS];
+static unsigned int num_programs;
+static unsigned int num_erases;
+// The number of operations that complete before the power is lost, -1 for never
+static int ops_until_power_loss;
+static bool power_lost;
+static std::mt19937 rng;
+
+enum operation_result {
+    COMPLETED,
+    INTERRUPTED,
+    NO_POWER,
+};
+
+static operation_result start_operation(void) {
+    if (power_lost) {
+        return NO_POWER;
+    }
+    if (ops_until_power_loss == 0) {
+        power_lost = true;
+        return INTERRUPTED;
+    }
+    if (ops_until_power_loss > 0) {
+        ops_until_power_loss--;
+    }
+    return COMPLETED;
+}
+
+extern "C" void eeprom_log_flash_program(const uint16_t* address, uint16_t value) {
+    uint16_t* word = flash + (address - flash);
+    ASSERT_GE(word, flash);
+    ASSERT_LT(word, flash + sizeof(flash) / 2);
+    operation_result result = start_operation();
+    if (result == NO_POWER) {
+        return;
+    }
+    ASSERT_EQ(*word, 0xFFFF) << "Programming a word that isn't erased";
+    // An interrupted program might still have made it
+    if (result == COMPLETED || (result == INTERRUPTED && rng() & 1)) {
+        *word = value;
+    }
+    if (result == COMPLETED) {
+        num_programs++;
+    }
+}
+
+extern "C" void eeprom_log_flash_erase(const uint16_t* sector) {
+    uint16_t* start = flash + (sector - flash);
+    ASSERT_EQ((start - flash) % EEPROM_LOG_SECTOR_WORDS, 0);
+    operation_result result = start_operation();
+    if (result == NO_POWER) {
+        return;
+    }
+    // An interrupted erase leaves the sector partially erased
+    for (int i = 0; i < EEPROM_LOG_SECTOR_WORDS; i++) {
+        if (result == COMPLETED || rng() & 1) {
+            start[i] = 0xFFFF;
+        }
+    }
+    if (result == COMPLETED) {
+        num_erases++;
+    }
+}
+
+class EepromLog : public testing::Test {
+public:
+    EepromLog() {
+        memset(flash, 0xFF, sizeof(flash));
+        num_programs = 0;
+        num_erases = 0;
+        ops_until_power_loss = -1;
+        power_lost = false;
+        rng.seed(0);
+        init();
+    }
+
+    void init() {
+        eeprom_log_init(flash, flash + sizeof(flash) / 2);
+    }
+};
+
+TEST_F(EepromLog, ErasedFlashReadsAsFF) {
+    for (int i = 0; i < EEPROM_LOG_SIZE; i++) {
+        EXPECT_EQ(eeprom_log_read(i), 0xFF);
+    }
+}
+
+TEST_F(EepromLog, ReadsBackWrittenValues) {
+    for (int i = 0; i < EEPROM_LOG_SIZE; i++) {
+        eeprom_log_write(i, i * 3);
+    }
+    for (int i = 0; i < EEPROM_LOG_SIZE; i++) {
+        EXPECT_EQ(eeprom_log_read(i), (uint8_t)(i * 3));
+    }
+}
+
+TEST_F(EepromLog, ValuesSurviveAReset) {
+    eeprom_log_write(1, 0x12);
+    eeprom_log_write(7, 0x34);
+    eeprom_log_write(1, 0x56);
+    init();
+    EXPECT_EQ(eeprom_log_read(1), 0x56);
+    EXPECT_EQ(eeprom_log_read(7), 0x34);
+    EXPECT_EQ(eeprom_log_read(0), 0xFF);
+}
+
+TEST_F(EepromLog, WritingAnUnchangedValueDoesNotProgram) {
+    eeprom_log_write(3, 0x42);
+    unsigned int programs = num_programs;
+    eeprom_log_write(3, 0x42);
+    EXPECT_EQ(num_programs, programs);
+}
+
+TEST_F(EepromLog, EachWriteAppendsOneRecord) {
+    eeprom_log_write(0, 1);
+    unsigned int programs = num_programs;
+    for (int i = 0; i < 100; i++) {
+        eeprom_log_write(i % 4, i + 2);
+    }
+    EXPECT_EQ(num_programs, programs + 100);
+}
+
+TEST_F(EepromLog, OutOfRangeOffsetsAreIgnored) {
+    eeprom_log_write(EEPROM_LOG_SIZE, 0x12);
+    EXPECT_EQ(num_programs, 0);
+    EXPECT_EQ(eeprom_log_read(EEPROM_LOG_SIZE), 0xFF);
+}
+
+TEST_F(EepromLog, CompactsIntoTheOtherSectorWithOneErasePerCompaction) {
+    for (int i = 0; i < 10000; i++) {
+        eeprom_log_write(i % 10, i);
+    }
+    // The first write starts the log in sector 0
+    EXPECT_GT(eeprom_log_get_compactions(), 10);
+    EXPECT_EQ(num_erases, eeprom_log_get_compactions() - 2);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(eeprom_log_read(i), (uint8_t)(9990 + i));
+    }
+    init();
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(eeprom_log_read(i), (uint8_t)(9990 + i));
+    }
+}
+
+TEST_F(EepromLog, NewestGenerationWinsAcrossWraparound) {
+    uint16_t* sector1 = flash + EEPROM_LOG_SECTOR_WORDS;
+    flash[0] = 0xFFE5;
+    flash[1] = 0x1100;
+    sector1[0] = 0x00E5;
+    sector1[1] = 0x2200;
+    init();
+    EXPECT_EQ(eeprom_log_read(0), 0x22);
+    flash[0] = 0x01E5;
+    init();
+    EXPECT_EQ(eeprom_log_read(0), 0x11);
+}
+
+// The legacy log, n records without any headers, offset i % 40 in the first
+// sector and i % 20 after it, so that some bytes are only in the first sector
+static std::vector<uint8_t> write_legacy_log(int n) {
+    std::vector<uint8_t> model(EEPROM_LOG_SIZE, 0xFF);
+    for (int i = 0; i < n; i++) {
+        uint8_t offset = i < EEPROM_LOG_SECTOR_WORDS ? i % 40 : i % 20;
+        flash[i] = ((i & 0xFF) << 8) | offset;
+        model[offset] = i;
+    }
+    return model;
+}
+
+TEST_F(EepromLog, ReadsAndMigratesTheLegacyLayout) {
+    std::vector<uint8_t> model = write_legacy_log(sizeof(flash) / 2 - 30);
+    init();
+    for (int i = 0; i < EEPROM_LOG_SIZE; i++) {
+        EXPECT_EQ(eeprom_log_read(i), model[i]);
+    }
+    // The bytes only in the first sector are appended before it's erased
+    EXPECT_EQ(eeprom_log_get_compactions(), 1);
+    EXPECT_EQ(flash[0] & 0xFF, 0xE5);
+    eeprom_log_write(30, 0x42);
+    model[30] = 0x42;
+    init();
+    for (int i = 0; i < EEPROM_LOG_SIZE; i++) {
+        EXPECT_EQ(eeprom_log_read(i), model[i]);
+    }
+}
+
+TEST_F(EepromLog, MigratesALegacyLogInTheFirstSectorToTheLastOne) {
+    std::vector<uint8_t> model = write_legacy_log(300);
+    init();
+    EXPECT_EQ(eeprom_log_get_compactions(), 1);
+    EXPECT_EQ(num_erases, 0);
+    EXPECT_EQ(flash[EEPROM_LOG_SECTOR_WORDS] & 0xFF, 0xE5);
+    init();
+    for (int i = 0; i < EEPROM_LOG_SIZE; i++) {
+        EXPECT_EQ(eeprom_log_read(i), model[i]);
+    }
+}
+
+TEST_F(EepromLog, ALegacyLogWithoutRoomIsAppendedToUntilItIsFull) {
+    std::vector<uint8_t> model = write_legacy_log(sizeof(flash) / 2 - 10);
+    init();
+    EXPECT_EQ(eeprom_log_get_compactions(), 0);
+    for (int i = 0; i < 20; i++) {
+        eeprom_log_write(30, i);
+    }
+    model[30] = 19;
+    EXPECT_EQ(eeprom_log_get_compactions(), 1);
+    EXPECT_EQ(flash[0] & 0xFF, 0xE5);
+    init();
+    for (int i = 0; i < EEPROM_LOG_SIZE; i++) {
+        EXPECT_EQ(eeprom_log_read(i), model[i]);
+    }
+}
+
+TEST_F(EepromLog, SurvivesPowerLossDuringTheLegacyMigration) {
+    const int sizes[] = {300, EEPROM_LOG_SECTOR_WORDS + 100, (int)sizeof(flash) / 2 - 30};
+    for (int n : sizes) {
+        for (int run = 0; run < 500; run++) {
+            memset(flash, 0xFF, sizeof(flash));
+            std::vector<uint8_t> model = write_legacy_log(n);
+            rng.seed(run);
+            power_lost = false;
+            ops_until_power_loss = rng() % 300;
+            // The migration is done by the init, and the writes after it
+            init();
+            int offset = -1;
+            uint8_t value = 0;
+            while (!power_lost) {
+                offset = rng() % 48;
+                value = rng();
+                eeprom_log_write(offset, value);
+                if (!power_lost) {
+                    model[offset] = value;
+                }
+            }
+            ops_until_power_loss = -1;
+            power_lost = false;
+            init();
+            for (int i = 0; i < EEPROM_LOG_SIZE; i++) {
+                uint8_t read = eeprom_log_read(i);
+                if (i == offset && read == value) {
+                    model[i] = value;
+                }
+                ASSERT_EQ(read, model[i]) << "Size " << n << " run " << run << " offset " << i;
+            }
+        }
+    }
+}
+
+TEST_F(EepromLog, SurvivesPowerLossAtAnyPoint) {
+    std::vector<uint8_t> model(EEPROM_LOG_SIZE, 0xFF);
+    for (int run = 0; run < 2000; run++) {
+        rng.seed(run);
+        power_lost = false;
+        // A small range of offsets makes the compactions frequent
+        ops_until_power_loss = rng() % 2000;
+        int offset = 0;
+        uint8_t value = 0;
+        while (!power_lost) {
+            offset = rng() % 16;
+            value = rng();
+            eeprom_log_write(offset, value);
+            if (!power_lost) {
+                model[offset] = value;
+            }
+        }
+        ops_until_power_loss = -1;
+        power_lost = false;
+        init();
+        for (int i = 0; i < EEPROM_LOG_SIZE; i++) {
+            uint8_t read = eeprom_log_read(i);
+            if (i == offset && read == value) {
+                // The interrupted write might have made it
+                model[i] = value;
+            }
+            ASSERT_EQ(read, model[i]) << "Run " << run << " offset " << i;
+        }
+    }
+}
@@ -0,0 +1,4 @@
+eeprom_log_SRC :=\
+	$(TMK_PATH)/common/chibios/tests/eeprom_log_tests.cpp \
+	$(TMK_PATH)/common/chibios/eeprom_log.c
+eeprom_log_INC := $(TMK_PATH)/common/chibios
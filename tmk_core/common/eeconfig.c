@@ -3,57 +3,163 @@
 #include "eeprom.h"
 #include "eeconfig.h"
 
+#ifdef EECONFIG_WRITE_BACK_CACHE
+#include "timer.h"
+
+static uint8_t cache[EECONFIG_SIZE];
+static bool cache_loaded = false;
+static uint16_t dirty = 0;
+static uint16_t last_update = 0;
+static uint16_t writes_avoided = 0;
+
+static void load_cache(void)
+{
+    if (!cache_loaded) {
+        eeprom_read_block(cache, 0, EECONFIG_SIZE);
+        cache_loaded = true;
+    }
+}
+
+uint8_t eeconfig_read_byte(const uint8_t *addr)
+{
+    uintptr_t offset = (uintptr_t)addr;
+    if (offset >= EECONFIG_SIZE) return eeprom_read_byte(addr);
+    load_cache();
+    return cache[offset];
+}
+
+void eeconfig_update_byte(uint8_t *addr, uint8_t val)
+{
+    uintptr_t offset = (uintptr_t)addr;
+    if (offset >= EECONFIG_SIZE) {
+        eeprom_update_byte(addr, val);
+        return;
+    }
+    load_cache();
+    if (cache[offset] != val) {
+        // Only the first change of a clean byte costs a write, the rest are
+        // coalesced into it, unchanged values never cost one
+        if (dirty & (1 << offset)) {
+            writes_avoided++;
+        }
+        cache[offset] = val;
+        dirty |= 1 << offset;
+    }
+    last_update = timer_read();
+}
+
+void eeconfig_flush(void)
+{
+    for (uint8_t i = 0; dirty; i++) {
+        if (dirty & (1 << i)) {
+            eeprom_update_byte((uint8_t *)(uintptr_t)i, cache[i]);
+            dirty &= ~(1 << i);
+        }
+    }
+}
+
+void eeconfig_task(void)
+{
+    if (dirty && timer_elapsed(last_update) >= EECONFIG_FLUSH_DELAY) {
+        eeconfig_flush();
+    }
+}
+
+uint16_t eeconfig_writes_avoided(void)
+{
+    return writes_avoided;
+}
+#else
+uint8_t eeconfig_read_byte(const uint8_t *addr) { return eeprom_read_byte(addr); }
+void eeconfig_update_byte(uint8_t *addr, uint8_t val) { eeprom_update_byte(addr, val); }
+void eeconfig_flush(void) {}
+void eeconfig_task(void) {}
+uint16_t eeconfig_writes_avoided(void) { return 0; }
+#endif
+
+uint16_t eeconfig_read_word(const uint16_t *addr)
+{
+    const uint8_t *p = (const uint8_t *)addr;
+    return eeconfig_read_byte(p) | (eeconfig_read_byte(p+1) << 8);
+}
+
+void eeconfig_update_word(uint16_t *addr, uint16_t val)
+{
+    uint8_t *p = (uint8_t *)addr;
+    eeconfig_update_byte(p++, val);
+    eeconfig_update_byte(p, val >> 8);
+}
+
+uint32_t eeconfig_read_dword(const uint32_t *addr)
+{
+    const uint8_t *p = (const uint8_t *)addr;
+    return eeconfig_read_byte(p) | (eeconfig_read_byte(p+1) << 8)
+        | ((uint32_t)eeconfig_read_byte(p+2) << 16) | ((uint32_t)eeconfig_read_byte(p+3) << 24);
+}
+
+void eeconfig_update_dword(uint32_t *addr, uint32_t val)
+{
+    uint8_t *p = (uint8_t *)addr;
+    eeconfig_update_byte(p++, val);
+    eeconfig_update_byte(p++, val >> 8);
+    eeconfig_update_byte(p++, val >> 16);
+    eeconfig_update_byte(p, val >> 24);
+}
+
 void eeconfig_init(void)
 {
-    eeprom_update_word(EECONFIG_MAGIC,          EECONFIG_MAGIC_NUMBER);
-    eeprom_update_byte(EECONFIG_DEBUG,          0);
-    eeprom_update_byte(EECONFIG_DEFAULT_LAYER,  0);
-    eeprom_update_byte(EECONFIG_KEYMAP,         0);
-    eeprom_update_byte(EECONFIG_MOUSEKEY_ACCEL, 0);
+    eeconfig_update_word(EECONFIG_MAGIC,          EECONFIG_MAGIC_NUMBER);
+    eeconfig_update_byte(EECONFIG_DEBUG,          0);
+    eeconfig_update_byte(EECONFIG_DEFAULT_LAYER,  0);
+    eeconfig_update_byte(EECONFIG_KEYMAP,         0);
+    eeconfig_update_byte(EECONFIG_MOUSEKEY_ACCEL, 0);
 #ifdef BACKLIGHT_ENABLE
-    eeprom_update_byte(EECONFIG_BACKLIGHT,      0);
+    eeconfig_update_byte(EECONFIG_BACKLIGHT,      0);
 #endif
 #ifdef AUDIO_ENABLE
-    eeprom_update_byte(EECONFIG_AUDIO,             0xFF); // On by default
+    eeconfig_update_byte(EECONFIG_AUDIO,             0xFF); // On by default
 #endif
 #ifdef RGBLIGHT_ENABLE
-    eeprom_update_dword(EECONFIG_RGBLIGHT,      0);
+    eeconfig_update_dword(EECONFIG_RGBLIGHT,      0);
 #endif
 #ifdef STENO_ENABLE
-    eeprom_update_byte(EECONFIG_STENOMODE,      0);
+    eeconfig_update_byte(EECONFIG_STENOMODE,      0);
 #endif
+    eeconfig_flush();
 }
 
 void eeconfig_enable(void)
 {
-    eeprom_update_word(EECONFIG_MAGIC, EECONFIG_MAGIC_NUMBER);
+    eeconfig_update_word(EECONFIG_MAGIC, EECONFIG_MAGIC_NUMBER);
+    eeconfig_flush();
 }
 
 void eeconfig_disable(void)
 {
-    eeprom_update_word(EECONFIG_MAGIC, 0xFFFF);
+    eeconfig_update_word(EECONFIG_MAGIC, 0xFFFF);
+    eeconfig_flush();
 }
 
 bool eeconfig_is_enabled(void)
 {
-    return (eeprom_read_word(EECONFIG_MAGIC) == EECONFIG_MAGIC_NUMBER);
+    return (eeconfig_read_word(EECONFIG_MAGIC) == EECONFIG_MAGIC_NUMBER);
 }
 
-uint8_t eeconfig_read_debug(void)      { return eeprom_read_byte(EECONFIG_DEBUG); }
-void eeconfig_update_debug(uint8_t val) { eeprom_update_byte(EECONFIG_DEBUG, val); }
+uint8_t eeconfig_read_debug(void)      { return eeconfig_read_byte(EECONFIG_DEBUG); }
+void eeconfig_update_debug(uint8_t val) { eeconfig_update_byte(EECONFIG_DEBUG, val); }
 
-uint8_t eeconfig_read_default_layer(void)      { return eeprom_read_byte(EECONFIG_DEFAULT_LAYER); }
-void eeconfig_update_default_layer(uint8_t val) { eeprom_update_byte(EECONFIG_DEFAULT_LAYER, val); }
+uint8_t eeconfig_read_default_layer(void)      { return eeconfig_read_byte(EECONFIG_DEFAULT_LAYER); }
+void eeconfig_update_default_layer(uint8_t val) { eeconfig_update_byte(EECONFIG_DEFAULT_LAYER, val); }
 
-uint8_t eeconfig_read_keymap(void)      { return eeprom_read_byte(EECONFIG_KEYMAP); }
-void eeconfig_update_keymap(uint8_t val) { eeprom_update_byte(EECONFIG_KEYMAP, val); }
+uint8_t eeconfig_read_keymap(void)      { return eeconfig_read_byte(EECONFIG_KEYMAP); }
+void eeconfig_update_keymap(uint8_t val) { eeconfig_update_byte(EECONFIG_KEYMAP, val); }
 
 #ifdef BACKLIGHT_ENABLE
-uint8_t eeconfig_read_backlight(void)      { return eeprom_read_byte(EECONFIG_BACKLIGHT); }
-void eeconfig_update_backlight(uint8_t val) { eeprom_update_byte(EECONFIG_BACKLIGHT, val); }
+uint8_t eeconfig_read_backlight(void)      { return eeconfig_read_byte(EECONFIG_BACKLIGHT); }
+void eeconfig_update_backlight(uint8_t val) { eeconfig_update_byte(EECONFIG_BACKLIGHT, val); }
 #endif
 
 #ifdef AUDIO_ENABLE
-uint8_t eeconfig_read_audio(void)      { return eeprom_read_byte(EECONFIG_AUDIO); }
-void eeconfig_update_audio(uint8_t val) { eeprom_update_byte(EECONFIG_AUDIO, val); }
+uint8_t eeconfig_read_audio(void)      { return eeconfig_read_byte(EECONFIG_AUDIO); }
+void eeconfig_update_audio(uint8_t val) { eeconfig_update_byte(EECONFIG_AUDIO, val); }
 #endif
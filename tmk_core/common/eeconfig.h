@@ -37,6 +37,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define EECONFIG_STENOMODE                          (uint8_t *)13
 // EEHANDS for two handed boards
 #define EECONFIG_HANDEDNESS         				(uint8_t *)14
+#define EECONFIG_SIZE                               15
 
 
 /* debug bit */
@@ -83,4 +84,30 @@ uint8_t eeconfig_read_audio(void);
 void eeconfig_update_audio(uint8_t val);
 #endif
 
+/* Generic access to the eeconfig area
+ *
+ * With EECONFIG_WRITE_BACK_CACHE defined, the whole area is cached in RAM.
+ * Updates only mark the bytes dirty, and they are written to the EEPROM
+ * once nothing has been updated for EECONFIG_FLUSH_DELAY ms, on suspend or
+ * when eeconfig_flush is called. The eeconfig area should then only be
+ * accessed through these functions, and not directly through eeprom.h.
+ */
+#ifndef EECONFIG_FLUSH_DELAY
+#define EECONFIG_FLUSH_DELAY 2000
+#endif
+
+uint8_t eeconfig_read_byte(const uint8_t *addr);
+void eeconfig_update_byte(uint8_t *addr, uint8_t val);
+uint16_t eeconfig_read_word(const uint16_t *addr);
+void eeconfig_update_word(uint16_t *addr, uint16_t val);
+uint32_t eeconfig_read_dword(const uint32_t *addr);
+void eeconfig_update_dword(uint32_t *addr, uint32_t val);
+
+// Writes all dirty bytes to the EEPROM
+void eeconfig_flush(void);
+// Flushes after the quiet period, called from keyboard_task
+void eeconfig_task(void);
+// The number of byte changes coalesced into an already pending write
+uint16_t eeconfig_writes_avoided(void);
+
 #endif
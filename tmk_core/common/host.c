@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "host.h"
 #include "util.h"
 #include "debug.h"
+#include "trace.h"
 
 static host_driver_t *driver;
 static uint16_t last_system_report = 0;
@@ -49,11 +50,15 @@ void host_keyboard_send(report_keyboard_t *report)
     (*driver->send_keyboard)(report);
 
     if (debug_keyboard) {
+#ifdef TRACE_ENABLE
+        trace_bytes(TRACE_KEYBOARD_REPORT, report->raw, KEYBOARD_REPORT_SIZE);
+#else
         dprint("keyboard_report: ");
         for (uint8_t i = 0; i < KEYBOARD_REPORT_SIZE; i++) {
             dprintf("%02X ", report->raw[i]);
         }
         dprint("\n");
+#endif
     }
 }
 
@@ -29,6 +29,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util.h"
 #include "sendchar.h"
 #include "eeconfig.h"
+#include "trace.h"
 #include "backlight.h"
 #include "action_layer.h"
 #ifdef BOOTMAGIC_ENABLE
@@ -153,55 +154,107 @@ void keyboard_init(void) {
 #endif
 }
 
-/*
- * Do keyboard routine jobs: scan mantrix, light LEDs, ...
- * This is repeatedly called as fast as possible.
+/* The matrix state whose changes are being processed, and the state that
+ * has been processed so far. All of the changes of one scan are processed,
+ * one per keyboard_task call, before the next scan is looked at, so that
+ * keys changed in the same scan are never interleaved with later changes.
  */
-void keyboard_task(void)
-{
-    static matrix_row_t matrix_prev[MATRIX_ROWS];
-#ifdef MATRIX_HAS_GHOST
-  //  static matrix_row_t matrix_ghost[MATRIX_ROWS];
-#endif
-    static uint8_t led_status = 0;
-    matrix_row_t matrix_row = 0;
-    matrix_row_t matrix_change = 0;
+static matrix_row_t matrix_next[MATRIX_ROWS];
+static matrix_row_t matrix_prev[MATRIX_ROWS];
 
-    matrix_scan();
-    for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
-        matrix_row = matrix_get_row(r);
-        matrix_change = matrix_row ^ matrix_prev[r];
-        if (matrix_change) {
+/* Processes one change of matrix_next, releases before presses, returns
+ * false if there are none left.
+ */
+static bool process_matrix_change(void)
+{
+    for (uint8_t pressed = 0; pressed < 2; pressed++) {
+        for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+            matrix_row_t matrix_row = matrix_next[r];
+            matrix_row_t matrix_change = matrix_row ^ matrix_prev[r];
+            matrix_change &= pressed ? matrix_row : matrix_prev[r];
+            if (!matrix_change) {
+                continue;
+            }
 #ifdef MATRIX_HAS_GHOST
             if (has_ghost_in_row(r, matrix_row)) {
-                /* Keep track of whether ghosted status has changed for
-                 * debugging. But don't update matrix_prev until un-ghosted, or
-                 * the last key would be lost.
+                /* Don't update matrix_prev until un-ghosted, or the last key
+                 * would be lost.
                  */
-                //if (debug_matrix && matrix_ghost[r] != matrix_row) {
-                //    matrix_print();
-                //}
-                //matrix_ghost[r] = matrix_row;
                 continue;
             }
-            //matrix_ghost[r] = matrix_row;
 #endif
-            if (debug_matrix) matrix_print();
             for (uint8_t c = 0; c < MATRIX_COLS; c++) {
                 if (matrix_change & ((matrix_row_t)1<<c)) {
                     action_exec((keyevent_t){
                         .key = (keypos_t){ .row = r, .col = c },
-                        .pressed = (matrix_row & ((matrix_row_t)1<<c)),
+                        .pressed = pressed,
                         .time = (timer_read() | 1) /* time should not be 0 */
                     });
                     // record a processed key
                     matrix_prev[r] ^= ((matrix_row_t)1<<c);
-                    // process a key per task call
-                    goto MATRIX_LOOP_END;
+                    return true;
                 }
             }
         }
     }
+    return false;
+}
+
+/* Processes a key change right away, for matrices that already know what
+ * changed, like protocol converters, so that every change of a scan is
+ * processed in that scan. The key is recorded as processed, so the matrix
+ * isn't checked for it again. Keys out of the matrix are ignored.
+ */
+void keyboard_key_event(uint8_t row, uint8_t col, bool pressed)
+{
+    if (row >= MATRIX_ROWS || col >= MATRIX_COLS) {
+        dprintf("keyboard_key_event: %d,%d is out of the matrix\n", row, col);
+        return;
+    }
+    matrix_row_t bit = (matrix_row_t)1<<col;
+    if (!(matrix_prev[row] & bit) == !pressed) {
+        return;
+    }
+    action_exec((keyevent_t){
+        .key = (keypos_t){ .row = row, .col = col },
+        .pressed = pressed,
+        .time = (timer_read() | 1) /* time should not be 0 */
+    });
+    matrix_prev[row] ^= bit;
+    matrix_next[row] = (matrix_next[row] & ~bit) | (matrix_prev[row] & bit);
+}
+
+/*
+ * Do keyboard routine jobs: scan mantrix, light LEDs, ...
+ * This is repeatedly called as fast as possible.
+ */
+void keyboard_task(void)
+{
+    static uint8_t led_status = 0;
+
+    matrix_scan();
+    // process a key per task call
+    if (process_matrix_change()) {
+        goto MATRIX_LOOP_END;
+    }
+    for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+        matrix_row_t matrix_row = matrix_get_row(r);
+        if (matrix_row != matrix_next[r]) {
+#ifdef TRACE_ENABLE
+#if MATRIX_COLS > 16
+            if (debug_matrix) trace(TRACE_MATRIX_ROW32, r, (uint32_t)matrix_row >> 16, matrix_row & 0xFFFF);
+#else
+            if (debug_matrix) trace(TRACE_MATRIX_ROW, r, matrix_row);
+#endif
+#else
+            if (debug_matrix) matrix_print();
+#endif
+        }
+        matrix_next[r] = matrix_row;
+    }
+    if (process_matrix_change()) {
+        goto MATRIX_LOOP_END;
+    }
     // call with pseudo tick event when no real key event.
     action_exec(TICK);
 
@@ -232,6 +285,14 @@ MATRIX_LOOP_END:
     visualizer_update(default_layer_state, layer_state, visualizer_get_mods(), host_keyboard_leds());
 #endif
 
+#ifdef EECONFIG_WRITE_BACK_CACHE
+    eeconfig_task();
+#endif
+
+#ifdef TRACE_ENABLE
+    trace_task();
+#endif
+
     // update LED
     if (led_status != host_keyboard_leds()) {
         led_status = host_keyboard_leds();
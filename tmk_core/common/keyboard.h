@@ -63,6 +63,8 @@ void keyboard_setup(void);
 void keyboard_init(void);
 /* it runs repeatedly in main loop */
 void keyboard_task(void);
+/* it processes a key change right away, for matrices that know their changes */
+void keyboard_key_event(uint8_t row, uint8_t col, bool pressed);
 /* it runs when host LED status is updated */
 void keyboard_set_leds(uint8_t leds);
 
@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "timer.h"
 #include "print.h"
 #include "debug.h"
+#include "progmem.h"
 #include "mousekey.h"
 
 
@@ -46,13 +47,296 @@ uint8_t mk_interval = MOUSEKEY_INTERVAL;
 uint8_t mk_max_speed = MOUSEKEY_MAX_SPEED;
 /* number of events (count) accelerating to steady speed (0-255) */
 uint8_t mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
-/* ramp used to reach maximum pointer speed (NOT SUPPORTED) */
-//int8_t mk_curve = 0;
+#ifdef MOUSEKEY_SMOOTH
+/* ramp used to reach maximum pointer speed, see MOUSEKEY_CURVE_* */
+uint8_t mk_curve = MOUSEKEY_CURVE;
+#endif
 /* wheel params */
 uint8_t mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
 uint8_t mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
 
 
+#ifdef MOUSEKEY_SMOOTH
+/*
+ * Smooth mouse keys
+ *
+ * Instead of sending a fixed step every mk_interval, the pointer velocity is
+ * computed from the time the keys have been held, and integrated in 1/256
+ * pixel units every MOUSEKEY_REPORT_INTERVAL. The fractional part is carried
+ * over to the next report, so slow speeds and diagonals don't lose movement.
+ *
+ * The speeds are the same as for the classic algorithm, max_speed * delta
+ * per mk_interval, reached after time_to_max intervals.
+ */
+
+#define MOUSEKEY_UP_BIT       (1<<0)
+#define MOUSEKEY_DOWN_BIT     (1<<1)
+#define MOUSEKEY_LEFT_BIT     (1<<2)
+#define MOUSEKEY_RIGHT_BIT    (1<<3)
+#define MOUSEKEY_WH_UP_BIT    (1<<4)
+#define MOUSEKEY_WH_DOWN_BIT  (1<<5)
+#define MOUSEKEY_WH_LEFT_BIT  (1<<6)
+#define MOUSEKEY_WH_RIGHT_BIT (1<<7)
+
+enum { AXIS_X, AXIS_Y, AXIS_V, AXIS_H, NUM_AXES };
+
+static uint8_t mousekey_keys = 0;
+static bool mousekey_moving = false;
+static uint16_t press_timer = 0;
+static uint16_t motion_timer = 0;
+static uint16_t last_timer = 0;
+/* 1/256 pixels (or wheel steps) per millisecond */
+static int32_t velocity[NUM_AXES];
+/* 1/256 pixels not yet reported */
+static int16_t remainder[NUM_AXES];
+/* the velocity when the kinetic glide started */
+static int32_t glide_start[2];
+static uint16_t glide_timer[2];
+
+/* (2**(4x) - 1) / 15 sampled at x = n/16, in 1/256 units */
+static const uint16_t exponential_curve[17] PROGMEM = {
+    0, 3, 7, 12, 17, 24, 31, 40, 51, 64, 79, 98, 119, 145, 176, 213, 256
+};
+
+/* maps the acceleration progress 0-256 to a speed fraction 0-256 */
+static uint16_t apply_curve(uint16_t x)
+{
+    switch (mk_curve) {
+        case MOUSEKEY_CURVE_QUADRATIC:
+            return ((uint32_t)x * x) >> 8;
+        case MOUSEKEY_CURVE_EXPONENTIAL: {
+            uint8_t i = x >> 4;
+            if (i >= 16) return 256;
+            uint16_t a = pgm_read_word(&exponential_curve[i]);
+            uint16_t b = pgm_read_word(&exponential_curve[i + 1]);
+            return a + (((b - a) * (x & 0xF)) >> 4);
+        }
+        case MOUSEKEY_CURVE_LINEAR:
+        case MOUSEKEY_CURVE_KINETIC:
+        default:
+            return x;
+    }
+}
+
+static uint16_t interval(void)
+{
+    return mk_interval ? mk_interval : 1;
+}
+
+static uint32_t max_velocity(bool wheel)
+{
+    if (wheel) {
+        return ((uint32_t)MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed << 8) / interval();
+    }
+    return ((uint32_t)MOUSEKEY_MOVE_DELTA * mk_max_speed << 8) / interval();
+}
+
+static uint32_t target_velocity(bool wheel)
+{
+    uint32_t max = max_velocity(wheel);
+    if (mousekey_accel & (1<<0)) return max / 4;
+    if (mousekey_accel & (1<<1)) return max / 2;
+    if (mousekey_accel & (1<<2)) return max;
+
+    uint32_t min = ((uint32_t)(wheel ? MOUSEKEY_WHEEL_DELTA : MOUSEKEY_MOVE_DELTA) << 8) / interval();
+    if (min > max) min = max;
+    uint32_t time_to_max = (uint32_t)(wheel ? mk_wheel_time_to_max : mk_time_to_max) * interval();
+    uint32_t elapsed = timer_elapsed(motion_timer);
+    uint16_t progress = (elapsed >= time_to_max) ? 256 : (elapsed << 8) / time_to_max;
+    return min + (((max - min) * apply_curve(progress)) >> 8);
+}
+
+static int8_t axis_direction(uint8_t positive, uint8_t negative)
+{
+    return ((mousekey_keys & positive) ? 1 : 0) - ((mousekey_keys & negative) ? 1 : 0);
+}
+
+static void update_velocity(uint8_t axis, int8_t direction, int32_t speed)
+{
+    if (direction) {
+        velocity[axis] = direction * speed;
+        glide_start[axis] = 0;
+    } else if (mk_curve == MOUSEKEY_CURVE_KINETIC && axis <= AXIS_Y && velocity[axis]) {
+        /* glide to a stop instead of stopping immediately */
+        if (!glide_start[axis]) {
+            glide_start[axis] = velocity[axis];
+            glide_timer[axis] = timer_read();
+        }
+        int32_t decel = (max_velocity(false) * timer_elapsed(glide_timer[axis])) / MOUSEKEY_KINETIC_STOP_TIME;
+        if (glide_start[axis] > decel) velocity[axis] = glide_start[axis] - decel;
+        else if (glide_start[axis] < -decel) velocity[axis] = glide_start[axis] + decel;
+        else velocity[axis] = 0;
+    } else {
+        velocity[axis] = 0;
+    }
+}
+
+static int8_t integrate(uint8_t axis, uint16_t elapsed, int8_t max)
+{
+    int32_t distance = remainder[axis] + velocity[axis] * elapsed;
+    /* round towards zero, so that both directions behave the same */
+    int32_t steps = distance / 256;
+    if (steps > max) steps = max;
+    if (steps < -max) steps = -max;
+    distance -= steps * 256;
+    /* movement above the report maximum is dropped, like in the classic mode */
+    if (distance > 255) distance = 255;
+    if (distance < -255) distance = -255;
+    remainder[axis] = distance;
+    return steps;
+}
+
+static void mousekey_stop(void)
+{
+    for (uint8_t i = 0; i < NUM_AXES; i++) {
+        velocity[i] = 0;
+        remainder[i] = 0;
+    }
+    glide_start[AXIS_X] = 0;
+    glide_start[AXIS_Y] = 0;
+    mousekey_moving = false;
+    mousekey_repeat = 0;
+}
+
+void mousekey_task(void)
+{
+    uint16_t elapsed = timer_elapsed(last_timer);
+    if (elapsed < MOUSEKEY_REPORT_INTERVAL)
+        return;
+
+    bool gliding = velocity[AXIS_X] || velocity[AXIS_Y];
+    if (!mousekey_keys && !gliding) {
+        last_timer = timer_read();
+        return;
+    }
+
+    if (!mousekey_moving) {
+        if (timer_elapsed(press_timer) < mk_delay*10) {
+            last_timer = timer_read();
+            return;
+        }
+        mousekey_moving = true;
+        motion_timer = press_timer + mk_delay*10;
+        elapsed = timer_elapsed(motion_timer);
+    }
+    last_timer = timer_read();
+
+    if (mousekey_repeat != UINT8_MAX)
+        mousekey_repeat++;
+
+    int8_t x = axis_direction(MOUSEKEY_RIGHT_BIT, MOUSEKEY_LEFT_BIT);
+    int8_t y = axis_direction(MOUSEKEY_DOWN_BIT, MOUSEKEY_UP_BIT);
+    int8_t v = axis_direction(MOUSEKEY_WH_UP_BIT, MOUSEKEY_WH_DOWN_BIT);
+    int8_t h = axis_direction(MOUSEKEY_WH_RIGHT_BIT, MOUSEKEY_WH_LEFT_BIT);
+
+    int32_t move_speed = (x || y) ? target_velocity(false) : 0;
+    /* diagonal move [1/sqrt(2)] */
+    if (x && y) {
+        move_speed = (move_speed * 181) >> 8;
+    }
+    int32_t wheel_speed = (v || h) ? target_velocity(true) : 0;
+
+    update_velocity(AXIS_X, x, move_speed);
+    update_velocity(AXIS_Y, y, move_speed);
+    update_velocity(AXIS_V, v, wheel_speed);
+    update_velocity(AXIS_H, h, wheel_speed);
+
+    mouse_report.x = integrate(AXIS_X, elapsed, MOUSEKEY_MOVE_MAX);
+    mouse_report.y = integrate(AXIS_Y, elapsed, MOUSEKEY_MOVE_MAX);
+    mouse_report.v = integrate(AXIS_V, elapsed, MOUSEKEY_WHEEL_MAX);
+    mouse_report.h = integrate(AXIS_H, elapsed, MOUSEKEY_WHEEL_MAX);
+
+    if (mouse_report.x || mouse_report.y || mouse_report.v || mouse_report.h)
+        mousekey_send();
+
+    if (!mousekey_keys && !velocity[AXIS_X] && !velocity[AXIS_Y])
+        mousekey_stop();
+}
+
+static void mousekey_direction_on(uint8_t bit)
+{
+    if (!mousekey_keys && !mousekey_moving) {
+        press_timer = timer_read();
+        last_timer = press_timer;
+    }
+    mousekey_keys |= bit;
+    /* the first step is sent immediately, like in the classic mode */
+    if (!mousekey_moving) {
+        if      (bit == MOUSEKEY_UP_BIT)       mouse_report.y = -MOUSEKEY_MOVE_DELTA;
+        else if (bit == MOUSEKEY_DOWN_BIT)     mouse_report.y = MOUSEKEY_MOVE_DELTA;
+        else if (bit == MOUSEKEY_LEFT_BIT)     mouse_report.x = -MOUSEKEY_MOVE_DELTA;
+        else if (bit == MOUSEKEY_RIGHT_BIT)    mouse_report.x = MOUSEKEY_MOVE_DELTA;
+        else if (bit == MOUSEKEY_WH_UP_BIT)    mouse_report.v = MOUSEKEY_WHEEL_DELTA;
+        else if (bit == MOUSEKEY_WH_DOWN_BIT)  mouse_report.v = -MOUSEKEY_WHEEL_DELTA;
+        else if (bit == MOUSEKEY_WH_LEFT_BIT)  mouse_report.h = -MOUSEKEY_WHEEL_DELTA;
+        else if (bit == MOUSEKEY_WH_RIGHT_BIT) mouse_report.h = MOUSEKEY_WHEEL_DELTA;
+    }
+}
+
+void mousekey_on(uint8_t code)
+{
+    if      (code == KC_MS_UP)       mousekey_direction_on(MOUSEKEY_UP_BIT);
+    else if (code == KC_MS_DOWN)     mousekey_direction_on(MOUSEKEY_DOWN_BIT);
+    else if (code == KC_MS_LEFT)     mousekey_direction_on(MOUSEKEY_LEFT_BIT);
+    else if (code == KC_MS_RIGHT)    mousekey_direction_on(MOUSEKEY_RIGHT_BIT);
+    else if (code == KC_MS_WH_UP)    mousekey_direction_on(MOUSEKEY_WH_UP_BIT);
+    else if (code == KC_MS_WH_DOWN)  mousekey_direction_on(MOUSEKEY_WH_DOWN_BIT);
+    else if (code == KC_MS_WH_LEFT)  mousekey_direction_on(MOUSEKEY_WH_LEFT_BIT);
+    else if (code == KC_MS_WH_RIGHT) mousekey_direction_on(MOUSEKEY_WH_RIGHT_BIT);
+    else if (code == KC_MS_BTN1)     mouse_report.buttons |= MOUSE_BTN1;
+    else if (code == KC_MS_BTN2)     mouse_report.buttons |= MOUSE_BTN2;
+    else if (code == KC_MS_BTN3)     mouse_report.buttons |= MOUSE_BTN3;
+    else if (code == KC_MS_BTN4)     mouse_report.buttons |= MOUSE_BTN4;
+    else if (code == KC_MS_BTN5)     mouse_report.buttons |= MOUSE_BTN5;
+    else if (code == KC_MS_ACCEL0)   mousekey_accel |= (1<<0);
+    else if (code == KC_MS_ACCEL1)   mousekey_accel |= (1<<1);
+    else if (code == KC_MS_ACCEL2)   mousekey_accel |= (1<<2);
+}
+
+void mousekey_off(uint8_t code)
+{
+    if      (code == KC_MS_UP)       mousekey_keys &= ~MOUSEKEY_UP_BIT;
+    else if (code == KC_MS_DOWN)     mousekey_keys &= ~MOUSEKEY_DOWN_BIT;
+    else if (code == KC_MS_LEFT)     mousekey_keys &= ~MOUSEKEY_LEFT_BIT;
+    else if (code == KC_MS_RIGHT)    mousekey_keys &= ~MOUSEKEY_RIGHT_BIT;
+    else if (code == KC_MS_WH_UP)    mousekey_keys &= ~MOUSEKEY_WH_UP_BIT;
+    else if (code == KC_MS_WH_DOWN)  mousekey_keys &= ~MOUSEKEY_WH_DOWN_BIT;
+    else if (code == KC_MS_WH_LEFT)  mousekey_keys &= ~MOUSEKEY_WH_LEFT_BIT;
+    else if (code == KC_MS_WH_RIGHT) mousekey_keys &= ~MOUSEKEY_WH_RIGHT_BIT;
+    else if (code == KC_MS_BTN1) mouse_report.buttons &= ~MOUSE_BTN1;
+    else if (code == KC_MS_BTN2) mouse_report.buttons &= ~MOUSE_BTN2;
+    else if (code == KC_MS_BTN3) mouse_report.buttons &= ~MOUSE_BTN3;
+    else if (code == KC_MS_BTN4) mouse_report.buttons &= ~MOUSE_BTN4;
+    else if (code == KC_MS_BTN5) mouse_report.buttons &= ~MOUSE_BTN5;
+    else if (code == KC_MS_ACCEL0) mousekey_accel &= ~(1<<0);
+    else if (code == KC_MS_ACCEL1) mousekey_accel &= ~(1<<1);
+    else if (code == KC_MS_ACCEL2) mousekey_accel &= ~(1<<2);
+
+    if (!mousekey_keys && mk_curve != MOUSEKEY_CURVE_KINETIC)
+        mousekey_stop();
+}
+
+void mousekey_send(void)
+{
+    mousekey_debug();
+    host_mouse_send(&mouse_report);
+    /* the movement is relative, so it's only sent once */
+    mouse_report.x = 0;
+    mouse_report.y = 0;
+    mouse_report.v = 0;
+    mouse_report.h = 0;
+}
+
+void mousekey_clear(void)
+{
+    mouse_report = (report_mouse_t){};
+    mousekey_keys = 0;
+    mousekey_accel = 0;
+    mousekey_stop();
+}
+
+#else
+
 static uint16_t last_timer = 0;
 
 inline int8_t times_inv_sqrt2(int8_t x)
@@ -190,6 +474,8 @@ void mousekey_clear(void)
     mousekey_accel = 0;
 }
 
+#endif
+
 static void mousekey_debug(void)
 {
     if (!debug_mouse) return;
@@ -60,6 +60,27 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MOUSEKEY_WHEEL_TIME_TO_MAX 40
 #endif
 
+/* Smooth mode, define MOUSEKEY_SMOOTH to enable
+ * The movement is accumulated with sub-pixel precision, and a report is sent
+ * every MOUSEKEY_REPORT_INTERVAL milliseconds, which should match the polling
+ * interval of the mouse endpoint. */
+#define MOUSEKEY_CURVE_LINEAR       0
+#define MOUSEKEY_CURVE_QUADRATIC    1
+#define MOUSEKEY_CURVE_EXPONENTIAL  2
+/* linear acceleration, but the pointer glides to a stop when released */
+#define MOUSEKEY_CURVE_KINETIC      3
+
+#ifndef MOUSEKEY_CURVE
+#define MOUSEKEY_CURVE MOUSEKEY_CURVE_LINEAR
+#endif
+#ifndef MOUSEKEY_REPORT_INTERVAL
+#define MOUSEKEY_REPORT_INTERVAL 10
+#endif
+/* milliseconds to glide from the maximum speed to a stop */
+#ifndef MOUSEKEY_KINETIC_STOP_TIME
+#define MOUSEKEY_KINETIC_STOP_TIME 200
+#endif
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -71,6 +92,9 @@ extern uint8_t mk_max_speed;
 extern uint8_t mk_time_to_max;
 extern uint8_t mk_wheel_max_speed;
 extern uint8_t mk_wheel_time_to_max;
+#ifdef MOUSEKEY_SMOOTH
+extern uint8_t mk_curve;
+#endif
 
 
 void mousekey_task(void);
@@ -1,8 +1,14 @@
 #ifndef _RAW_HID_H_
 #define _RAW_HID_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
 void raw_hid_receive( uint8_t *data, uint8_t length );
 
 void raw_hid_send( uint8_t *data, uint8_t length );
 
+// Like raw_hid_send, but returns false when the endpoint is still busy
+bool raw_hid_try_send( const uint8_t *data, uint8_t length );
+
 #endif
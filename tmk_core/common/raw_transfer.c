@@ -0,0 +1,339 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "raw_transfer.h"
+#include "timer.h"
+#include <string.h>
+
+#define TYPE_DATA 1
+#define TYPE_ACK 2
+#define TYPE_NAK 3
+#define TYPE_SYNC 4
+#define TYPE_SYNC_ACK 5
+#define TYPE_MASK 0x7F
+#define FLAG_LAST 0x80
+
+#define REPLY_NONE 0
+
+uint16_t raw_transfer_crc16(uint16_t crc, const uint8_t* data, uint16_t size) {
+    // CRC-16/CCITT, bitwise to keep the flash usage down
+    while (size--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+void raw_transfer_init(raw_transfer_t* transfer, raw_transfer_send_packet_t send_packet,
+        raw_transfer_receive_message_t receive_message) {
+    memset(transfer, 0, sizeof(*transfer));
+    transfer->send_packet = send_packet;
+    transfer->receive_message = receive_message;
+    transfer->state = RAW_TRANSFER_IDLE;
+}
+
+static bool send_control(raw_transfer_t* transfer, uint8_t type, uint8_t id, uint8_t seq) {
+    uint8_t packet[RAW_TRANSFER_PACKET_SIZE] = {type, id, seq, 0};
+    return transfer->send_packet(packet);
+}
+
+// The bytes that are sent, the message followed by its CRC
+static uint8_t stream_byte(raw_transfer_t* transfer, uint16_t index) {
+    if (index < transfer->tx_size) {
+        return transfer->tx_data[index];
+    }
+    return index == transfer->tx_size ? transfer->tx_crc & 0xFF : transfer->tx_crc >> 8;
+}
+
+static void send_data_packets(raw_transfer_t* transfer) {
+    if (transfer->state == RAW_TRANSFER_SENDING && !transfer->tx_synced) {
+        // Nothing is sent before the receiver has started a new session
+        if (!transfer->tx_sync_sent && send_control(transfer, TYPE_SYNC, 0, 0)) {
+            transfer->tx_sync_sent = true;
+        }
+        return;
+    }
+    while (transfer->state == RAW_TRANSFER_SENDING &&
+            transfer->tx_next < transfer->tx_packets &&
+            (uint8_t)(transfer->tx_next - transfer->tx_base) < RAW_TRANSFER_WINDOW) {
+        uint8_t packet[RAW_TRANSFER_PACKET_SIZE] = {};
+        uint16_t start = transfer->tx_next * RAW_TRANSFER_PAYLOAD_SIZE;
+        uint16_t remaining = transfer->tx_size + 2 - start;
+        uint8_t length = remaining > RAW_TRANSFER_PAYLOAD_SIZE ? RAW_TRANSFER_PAYLOAD_SIZE : remaining;
+        bool last = transfer->tx_next == transfer->tx_packets - 1;
+        packet[0] = TYPE_DATA | (last ? FLAG_LAST : 0);
+        packet[1] = transfer->tx_id;
+        packet[2] = transfer->tx_next;
+        packet[3] = length;
+        for (uint8_t i = 0; i < length; i++) {
+            packet[RAW_TRANSFER_HEADER_SIZE + i] = stream_byte(transfer, start + i);
+        }
+        if (!transfer->send_packet(packet)) {
+            break;
+        }
+        transfer->stats.packets_sent++;
+        if (transfer->tx_next < transfer->tx_highest) {
+            transfer->stats.retransmissions++;
+        }
+        transfer->tx_next++;
+        if (transfer->tx_next > transfer->tx_highest) {
+            transfer->tx_highest = transfer->tx_next;
+        }
+    }
+}
+
+bool raw_transfer_send(raw_transfer_t* transfer, const void* data, uint16_t size) {
+    if (transfer->state == RAW_TRANSFER_SENDING || size > RAW_TRANSFER_MAX_MESSAGE_SIZE) {
+        return false;
+    }
+    transfer->tx_data = data;
+    transfer->tx_size = size;
+    transfer->tx_crc = raw_transfer_crc16(0xFFFF, data, size);
+    transfer->tx_id++;
+    transfer->tx_packets = (size + 2 + RAW_TRANSFER_PAYLOAD_SIZE - 1) / RAW_TRANSFER_PAYLOAD_SIZE;
+    transfer->tx_base = 0;
+    transfer->tx_next = 0;
+    transfer->tx_highest = 0;
+    transfer->tx_retries = 0;
+    transfer->tx_timer = timer_read();
+    transfer->state = RAW_TRANSFER_SENDING;
+    send_data_packets(transfer);
+    return true;
+}
+
+static void retry(raw_transfer_t* transfer, uint8_t from) {
+    if (++transfer->tx_retries > RAW_TRANSFER_MAX_RETRIES) {
+        transfer->state = RAW_TRANSFER_FAILED;
+        transfer->stats.failures++;
+        return;
+    }
+    transfer->tx_base = from;
+    transfer->tx_next = from;
+    transfer->tx_sync_sent = false;
+    transfer->tx_timer = timer_read();
+}
+
+void raw_transfer_reset(raw_transfer_t* transfer) {
+    transfer->tx_synced = false;
+    transfer->tx_sync_sent = false;
+    transfer->state = RAW_TRANSFER_IDLE;
+}
+
+static void handle_ack(raw_transfer_t* transfer, uint8_t id, uint8_t seq) {
+    if (transfer->state != RAW_TRANSFER_SENDING || id != transfer->tx_id) {
+        return;
+    }
+    // Anything else is a stale acknowledgement
+    if (seq <= transfer->tx_base || seq > transfer->tx_highest) {
+        return;
+    }
+    transfer->tx_base = seq;
+    if (transfer->tx_next < seq) {
+        transfer->tx_next = seq;
+    }
+    transfer->tx_retries = 0;
+    transfer->tx_timer = timer_read();
+    if (seq == transfer->tx_packets) {
+        transfer->state = RAW_TRANSFER_IDLE;
+        transfer->stats.messages_sent++;
+    }
+}
+
+static void handle_nak(raw_transfer_t* transfer, uint8_t id) {
+    if (transfer->state != RAW_TRANSFER_SENDING || id != transfer->tx_id) {
+        return;
+    }
+    retry(transfer, 0);
+}
+
+static void handle_sync_ack(raw_transfer_t* transfer) {
+    if (transfer->state != RAW_TRANSFER_SENDING || transfer->tx_synced) {
+        return;
+    }
+    transfer->tx_synced = true;
+    transfer->tx_retries = 0;
+    transfer->tx_timer = timer_read();
+}
+
+static void reply(raw_transfer_t* transfer, uint8_t type) {
+    // A rejection or a new session can't be replaced by an acknowledgement,
+    // or the sender would never restart
+    if ((transfer->rx_reply == TYPE_NAK || transfer->rx_reply == TYPE_SYNC_ACK) && type == TYPE_ACK) {
+        return;
+    }
+    transfer->rx_reply = type;
+    if (send_control(transfer, type, transfer->rx_id, transfer->rx_expected)) {
+        transfer->rx_reply = REPLY_NONE;
+    }
+}
+
+static void handle_sync(raw_transfer_t* transfer) {
+    // The other end has restarted, and its message ids with it, so forget the
+    // last message, and start the one being sent to it again
+    transfer->rx_id = 0;
+    transfer->rx_expected = 0;
+    transfer->rx_active = false;
+    if (transfer->state == RAW_TRANSFER_SENDING && transfer->tx_synced) {
+        transfer->tx_base = 0;
+        transfer->tx_next = 0;
+        transfer->tx_timer = timer_read();
+    }
+    reply(transfer, TYPE_SYNC_ACK);
+}
+
+static void handle_data(raw_transfer_t* transfer, const uint8_t* packet) {
+    uint8_t id = packet[1];
+    uint8_t seq = packet[2];
+    uint8_t length = packet[3];
+    if (length > RAW_TRANSFER_PAYLOAD_SIZE) {
+        return;
+    }
+    if (id != transfer->rx_id || (!transfer->rx_active && transfer->rx_expected == 0)) {
+        // Only the first packet can start a message
+        if (seq != 0) {
+            return;
+        }
+        transfer->rx_id = id;
+        transfer->rx_expected = 0;
+        transfer->rx_active = true;
+    }
+    else if (!transfer->rx_active) {
+        // The acknowledgement of the whole message was lost
+        reply(transfer, TYPE_ACK);
+        return;
+    }
+    if (seq != transfer->rx_expected) {
+        reply(transfer, TYPE_ACK);
+        return;
+    }
+
+    uint16_t offset = seq * RAW_TRANSFER_PAYLOAD_SIZE;
+    if (offset + length > sizeof(transfer->rx_buffer)) {
+        transfer->rx_expected = 0;
+        reply(transfer, TYPE_NAK);
+        return;
+    }
+    memcpy(transfer->rx_buffer + offset, packet + RAW_TRANSFER_HEADER_SIZE, length);
+    transfer->rx_expected++;
+
+    if (!(packet[0] & FLAG_LAST)) {
+        if (transfer->rx_expected % (RAW_TRANSFER_WINDOW / 2) == 0) {
+            reply(transfer, TYPE_ACK);
+        }
+        return;
+    }
+
+    uint16_t size = offset + length;
+    uint16_t crc = size >= 2 ? raw_transfer_crc16(0xFFFF, transfer->rx_buffer, size - 2) : 0;
+    if (size < 2 || transfer->rx_buffer[size - 2] != (crc & 0xFF) || transfer->rx_buffer[size - 1] != (crc >> 8)) {
+        transfer->stats.crc_errors++;
+        transfer->rx_expected = 0;
+        reply(transfer, TYPE_NAK);
+        return;
+    }
+    transfer->rx_active = false;
+    transfer->rx_reply = REPLY_NONE;
+    reply(transfer, TYPE_ACK);
+    transfer->stats.messages_received++;
+    if (transfer->receive_message) {
+        transfer->receive_message(transfer->rx_buffer, size - 2);
+    }
+}
+
+void raw_transfer_receive_packet(raw_transfer_t* transfer, const uint8_t* packet, uint8_t length) {
+    if (length < RAW_TRANSFER_PACKET_SIZE) {
+        return;
+    }
+    switch (packet[0] & TYPE_MASK) {
+        case TYPE_DATA:
+            handle_data(transfer, packet);
+            break;
+        case TYPE_ACK:
+            handle_ack(transfer, packet[1], packet[2]);
+            break;
+        case TYPE_NAK:
+            handle_nak(transfer, packet[1]);
+            break;
+        case TYPE_SYNC:
+            handle_sync(transfer);
+            break;
+        case TYPE_SYNC_ACK:
+            handle_sync_ack(transfer);
+            break;
+    }
+    // Keep the window full
+    send_data_packets(transfer);
+}
+
+void raw_transfer_task(raw_transfer_t* transfer) {
+    if (transfer->rx_reply != REPLY_NONE &&
+            send_control(transfer, transfer->rx_reply, transfer->rx_id, transfer->rx_expected)) {
+        transfer->rx_reply = REPLY_NONE;
+    }
+    if (transfer->state == RAW_TRANSFER_SENDING &&
+            timer_elapsed(transfer->tx_timer) > RAW_TRANSFER_TIMEOUT) {
+        retry(transfer, transfer->tx_base);
+    }
+    send_data_packets(transfer);
+}
+
+#ifdef RAW_TRANSFER_ENABLE
+#include "raw_hid.h"
+
+static raw_transfer_t raw_transfer;
+static bool raw_transfer_initialized = false;
+
+__attribute__ ((weak))
+void raw_transfer_receive(const uint8_t* data, uint16_t size) {
+}
+
+static bool send_raw_hid_packet(const uint8_t* packet) {
+    return raw_hid_try_send(packet, RAW_TRANSFER_PACKET_SIZE);
+}
+
+static void init(void) {
+    if (!raw_transfer_initialized) {
+        raw_transfer_init(&raw_transfer, send_raw_hid_packet, raw_transfer_receive);
+        raw_transfer_initialized = true;
+    }
+}
+
+void raw_transfer_hid_receive(const uint8_t* data, uint8_t length) {
+    init();
+    raw_transfer_receive_packet(&raw_transfer, data, length);
+}
+
+bool raw_transfer_send_message(const void* data, uint16_t size) {
+    init();
+    return raw_transfer_send(&raw_transfer, data, size);
+}
+
+void raw_transfer_reset_session(void) {
+    init();
+    raw_transfer_reset(&raw_transfer);
+}
+
+raw_transfer_state_t raw_transfer_get_state(void) {
+    return raw_transfer.state;
+}
+
+void raw_transfer_device_task(void) {
+    init();
+    raw_transfer_task(&raw_transfer);
+}
+#endif
@@ -0,0 +1,156 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TMK_CORE_COMMON_RAW_TRANSFER_H_
+#define TMK_CORE_COMMON_RAW_TRANSFER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Transfers of messages bigger than a raw HID packet, in both directions
+//
+// A message is followed by its CRC-16, and split into packets with a header
+// of four bytes, the type (and the last packet flag), the message id, the
+// sequence number of the packet within the message, and the payload length.
+//
+// The sender keeps up to RAW_TRANSFER_WINDOW packets in flight, and the
+// receiver acknowledges them cumulatively, with the sequence number it
+// expects next, every half window, at the end of the message, and whenever
+// a packet arrives out of order. When nothing is acknowledged for
+// RAW_TRANSFER_TIMEOUT ms, the sender goes back to the first unacknowledged
+// packet. A message with a bad CRC is rejected, and sent again from the
+// start.
+//
+// Message ids only tell messages of the same session apart, and start over
+// when either end restarts. So before its first message, a sender starts a
+// new session with a sync packet, and waits for the receiver to acknowledge
+// it. The receiver then forgets the last message it received, so that a
+// message reusing its id isn't taken for a duplicate.
+//
+// Both ends run the same code, the keyboard through raw_hid_send and
+// raw_hid_receive, and the host tool through its HID library.
+
+#define RAW_TRANSFER_PACKET_SIZE 32
+#define RAW_TRANSFER_HEADER_SIZE 4
+#define RAW_TRANSFER_PAYLOAD_SIZE (RAW_TRANSFER_PACKET_SIZE - RAW_TRANSFER_HEADER_SIZE)
+
+// Packets in flight, the default keeps the endpoint busy with 1 ms polling
+#ifndef RAW_TRANSFER_WINDOW
+#define RAW_TRANSFER_WINDOW 8
+#endif
+
+#ifndef RAW_TRANSFER_MAX_MESSAGE_SIZE
+#define RAW_TRANSFER_MAX_MESSAGE_SIZE 256
+#endif
+
+#ifndef RAW_TRANSFER_TIMEOUT
+#define RAW_TRANSFER_TIMEOUT 20
+#endif
+
+// Consecutive timeouts or rejections before the message is given up
+#ifndef RAW_TRANSFER_MAX_RETRIES
+#define RAW_TRANSFER_MAX_RETRIES 5
+#endif
+
+#if RAW_TRANSFER_WINDOW < 2 || RAW_TRANSFER_WINDOW > 127
+#error "RAW_TRANSFER_WINDOW must be between 2 and 127"
+#endif
+
+#if (RAW_TRANSFER_MAX_MESSAGE_SIZE + 2 + RAW_TRANSFER_PAYLOAD_SIZE - 1) / RAW_TRANSFER_PAYLOAD_SIZE > 255
+#error "RAW_TRANSFER_MAX_MESSAGE_SIZE needs more than 255 packets"
+#endif
+
+// Returns false if the packet can't be sent right now, it's tried again later
+typedef bool (*raw_transfer_send_packet_t)(const uint8_t* packet);
+typedef void (*raw_transfer_receive_message_t)(const uint8_t* data, uint16_t size);
+
+typedef enum {
+    RAW_TRANSFER_IDLE,
+    RAW_TRANSFER_SENDING,
+    RAW_TRANSFER_FAILED,
+} raw_transfer_state_t;
+
+typedef struct {
+    uint16_t messages_sent;
+    uint16_t messages_received;
+    uint16_t packets_sent;
+    uint16_t retransmissions;
+    uint16_t crc_errors;
+    uint16_t failures;
+} raw_transfer_stats_t;
+
+typedef struct {
+    raw_transfer_send_packet_t send_packet;
+    raw_transfer_receive_message_t receive_message;
+    raw_transfer_state_t state;
+
+    // Sender, the message has to stay valid until it's sent
+    const uint8_t* tx_data;
+    uint16_t tx_size;
+    uint16_t tx_crc;
+    uint8_t tx_id;
+    uint8_t tx_packets;
+    // The first packet that hasn't been acknowledged
+    uint8_t tx_base;
+    uint8_t tx_next;
+    // One past the highest packet sent so far
+    uint8_t tx_highest;
+    uint8_t tx_retries;
+    uint16_t tx_timer;
+    // The receiver has acknowledged the start of the session
+    bool tx_synced;
+    bool tx_sync_sent;
+
+    // Receiver
+    uint8_t rx_id;
+    uint8_t rx_expected;
+    bool rx_active;
+    // An acknowledgement or rejection that couldn't be sent yet
+    uint8_t rx_reply;
+    uint16_t rx_size;
+    uint8_t rx_buffer[RAW_TRANSFER_MAX_MESSAGE_SIZE + 2];
+
+    raw_transfer_stats_t stats;
+} raw_transfer_t;
+
+void raw_transfer_init(raw_transfer_t* transfer, raw_transfer_send_packet_t send_packet,
+        raw_transfer_receive_message_t receive_message);
+// Returns false if a message is already being sent, or it's too big
+bool raw_transfer_send(raw_transfer_t* transfer, const void* data, uint16_t size);
+// Packets shorter than RAW_TRANSFER_PACKET_SIZE are ignored
+void raw_transfer_receive_packet(raw_transfer_t* transfer, const uint8_t* packet, uint8_t length);
+// Sends the packets, and handles the timeouts, call it from the main loop
+void raw_transfer_task(raw_transfer_t* transfer);
+// Starts a new session with the next message, and drops the one being sent
+void raw_transfer_reset(raw_transfer_t* transfer);
+
+uint16_t raw_transfer_crc16(uint16_t crc, const uint8_t* data, uint16_t size);
+
+#ifdef RAW_TRANSFER_ENABLE
+// The keyboard's own transfer, on top of raw HID
+bool raw_transfer_send_message(const void* data, uint16_t size);
+raw_transfer_state_t raw_transfer_get_state(void);
+void raw_transfer_reset_session(void);
+// Implemented by the keymap
+void raw_transfer_receive(const uint8_t* data, uint16_t size);
+// Receives the raw HID packets, the default raw_hid_receive calls it, and a
+// keymap that implements raw_hid_receive calls it for the packets that
+// aren't its own
+void raw_transfer_hid_receive(const uint8_t* data, uint8_t length);
+void raw_transfer_device_task(void);
+#endif
+
+#endif /* TMK_CORE_COMMON_RAW_TRANSFER_H_ */
@@ -26,6 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define REPORT_ID_MOUSE     1
 #define REPORT_ID_SYSTEM    2
 #define REPORT_ID_CONSUMER  3
+#define REPORT_ID_NKRO      4
 
 /* mouse buttons */
 #define MOUSE_BTN1 (1<<0)
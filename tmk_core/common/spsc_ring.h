@@ -0,0 +1,247 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TMK_CORE_COMMON_SPSC_RING_H_
+#define TMK_CORE_COMMON_SPSC_RING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A ring buffer for one producer and one consumer, for example an interrupt
+// handler and the main loop, which doesn't have to disable the interrupts
+//
+// head counts the pushed items, and is only written by the producer, tail
+// counts the popped items, and is only written by the consumer. Both are
+// free running, so all the slots can be used, and the number of items is
+// head - tail. The size has to be a power of two, up to 128.
+//
+// C code defines a ring type and its functions with
+//
+//     SPSC_RING_DEFINE(name, type, size)
+//
+// which defines name_t, and name_push, name_push_n, name_front, name_pop,
+// name_pop_n, name_count and name_clear, see below. C++ code can use the
+// SpscRing<T, Size> template instead.
+//
+// The ring also keeps the most items it has held, and the number of items
+// that didn't fit, for tuning the size.
+
+#ifdef __AVR__
+// Byte accesses are atomic and the AVR doesn't reorder memory accesses, it's
+// enough to keep the compiler from moving the buffer accesses around them
+#define spsc_ring_load(p) ({ uint8_t v_ = *(const volatile uint8_t *)(p); __asm__ __volatile__("" ::: "memory"); v_; })
+#define spsc_ring_store(p, v) do { __asm__ __volatile__("" ::: "memory"); *(volatile uint8_t *)(p) = (v); } while (0)
+#else
+#define spsc_ring_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define spsc_ring_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+typedef struct {
+    uint8_t head;
+    uint8_t tail;
+    // Statistics, written by the producer
+    uint8_t high_water;
+    uint8_t dropped;
+} spsc_ring_t;
+
+// Producer side
+static inline uint8_t spsc_ring_space(const spsc_ring_t *ring, uint8_t size) {
+    return size - (uint8_t)(ring->head - spsc_ring_load(&ring->tail));
+}
+
+static inline void spsc_ring_commit_push(spsc_ring_t *ring, uint8_t count) {
+    uint8_t head = ring->head + count;
+    uint8_t used = head - spsc_ring_load(&ring->tail);
+    if (used > ring->high_water) {
+        ring->high_water = used;
+    }
+    spsc_ring_store(&ring->head, head);
+}
+
+static inline void spsc_ring_drop(spsc_ring_t *ring, uint8_t count) {
+    uint8_t dropped = ring->dropped + count;
+    ring->dropped = dropped < count ? 0xFF : dropped;
+}
+
+// Consumer side
+static inline uint8_t spsc_ring_count(const spsc_ring_t *ring) {
+    return spsc_ring_load(&ring->head) - ring->tail;
+}
+
+static inline void spsc_ring_commit_pop(spsc_ring_t *ring, uint8_t count) {
+    spsc_ring_store(&ring->tail, (uint8_t)(ring->tail + count));
+}
+
+#define SPSC_RING_DEFINE(name, type, size) \
+    typedef char name##_size_check[((size) & ((size) - 1)) == 0 && (size) <= 128 ? 1 : -1]; \
+    typedef struct { \
+        spsc_ring_t ring; \
+        type buf[size]; \
+    } name##_t; \
+    /* Adds an item, returns false and counts it as dropped when the ring is full */ \
+    static inline bool name##_push(name##_t *r, type item) { \
+        if (!spsc_ring_space(&r->ring, (size))) { \
+            spsc_ring_drop(&r->ring, 1); \
+            return false; \
+        } \
+        r->buf[r->ring.head & ((size) - 1)] = item; \
+        spsc_ring_commit_push(&r->ring, 1); \
+        return true; \
+    } \
+    /* Adds as many of the items as fit, and returns how many that was */ \
+    static inline uint8_t name##_push_n(name##_t *r, const type *items, uint8_t count) { \
+        uint8_t space = spsc_ring_space(&r->ring, (size)); \
+        if (count > space) { \
+            spsc_ring_drop(&r->ring, count - space); \
+            count = space; \
+        } \
+        uint8_t head = r->ring.head; \
+        for (uint8_t i = 0; i < count; i++) { \
+            r->buf[(uint8_t)(head + i) & ((size) - 1)] = items[i]; \
+        } \
+        spsc_ring_commit_push(&r->ring, count); \
+        return count; \
+    } \
+    /* The oldest item, which stays in the ring, or NULL when it's empty */ \
+    static inline type *name##_front(name##_t *r) { \
+        if (!spsc_ring_count(&r->ring)) { \
+            return 0; \
+        } \
+        return &r->buf[r->ring.tail & ((size) - 1)]; \
+    } \
+    static inline bool name##_pop(name##_t *r, type *item) { \
+        if (!spsc_ring_count(&r->ring)) { \
+            return false; \
+        } \
+        *item = r->buf[r->ring.tail & ((size) - 1)]; \
+        spsc_ring_commit_pop(&r->ring, 1); \
+        return true; \
+    } \
+    /* Takes up to count items, and returns how many it took */ \
+    static inline uint8_t name##_pop_n(name##_t *r, type *items, uint8_t count) { \
+        uint8_t available = spsc_ring_count(&r->ring); \
+        if (count > available) { \
+            count = available; \
+        } \
+        uint8_t tail = r->ring.tail; \
+        for (uint8_t i = 0; i < count; i++) { \
+            items[i] = r->buf[(uint8_t)(tail + i) & ((size) - 1)]; \
+        } \
+        spsc_ring_commit_pop(&r->ring, count); \
+        return count; \
+    } \
+    static inline uint8_t name##_count(name##_t *r) { \
+        return spsc_ring_count(&r->ring); \
+    } \
+    /* Removes all the items, called by the consumer */ \
+    static inline void name##_clear(name##_t *r) { \
+        spsc_ring_store(&r->ring.tail, spsc_ring_load(&r->ring.head)); \
+    }
+
+#ifdef __cplusplus
+
+// The header can be included from an extern "C" block
+extern "C++" {
+
+template <typename T, uint8_t Size>
+class SpscRing {
+  static_assert((Size & (Size - 1)) == 0 && Size <= 128, "SpscRing size must be a power of two up to 128");
+
+ protected:
+  static const uint8_t Mask = Size - 1;
+  spsc_ring_t ring_{};
+  T buf_[Size];
+
+ public:
+  inline bool enqueue(const T &item) {
+    if (!spsc_ring_space(&ring_, Size)) {
+      spsc_ring_drop(&ring_, 1);
+      return false;
+    }
+    buf_[ring_.head & Mask] = item;
+    spsc_ring_commit_push(&ring_, 1);
+    return true;
+  }
+
+  inline uint8_t enqueue(const T *items, uint8_t count) {
+    uint8_t space = spsc_ring_space(&ring_, Size);
+    if (count > space) {
+      spsc_ring_drop(&ring_, count - space);
+      count = space;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      buf_[(uint8_t)(ring_.head + i) & Mask] = items[i];
+    }
+    spsc_ring_commit_push(&ring_, count);
+    return count;
+  }
+
+  inline bool get(T &dest, bool commit = true) {
+    if (!spsc_ring_count(&ring_)) {
+      // No more data
+      return false;
+    }
+    dest = buf_[ring_.tail & Mask];
+    if (commit) {
+      spsc_ring_commit_pop(&ring_, 1);
+    }
+    return true;
+  }
+
+  inline uint8_t get(T *items, uint8_t count) {
+    uint8_t available = spsc_ring_count(&ring_);
+    if (count > available) {
+      count = available;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      items[i] = buf_[(uint8_t)(ring_.tail + i) & Mask];
+    }
+    spsc_ring_commit_pop(&ring_, count);
+    return count;
+  }
+
+  inline bool peek(T &item) {
+    return get(item, false);
+  }
+
+  inline bool empty() const { return spsc_ring_count(&ring_) == 0; }
+
+  inline uint8_t size() const { return spsc_ring_count(&ring_); }
+
+  inline T& front() {
+    return buf_[ring_.tail & Mask];
+  }
+
+  // The most recently enqueued item, only for the producer
+  inline T& back() {
+    return buf_[(uint8_t)(ring_.head - 1) & Mask];
+  }
+
+  inline void clear() {
+    spsc_ring_store(&ring_.tail, spsc_ring_load(&ring_.head));
+  }
+
+  inline uint8_t high_water() const { return ring_.high_water; }
+
+  inline uint8_t dropped() const { return ring_.dropped; }
+};
+
+}
+
+#endif
+
+#endif /* TMK_CORE_COMMON_SPSC_RING_H_ */
@@ -0,0 +1,111 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "steno_hid.h"
+#include <string.h>
+
+void steno_hid_clear(uint8_t *report) {
+    memset(report, 0, STENO_HID_REPORT_SIZE);
+    report[0] = STENO_HID_REPORT_ID;
+}
+
+void steno_hid_set_key(uint8_t *report, uint8_t key) {
+    report[1 + key / 8] |= 0x80 >> (key % 8);
+}
+
+bool steno_hid_get_key(const uint8_t *report, uint8_t key) {
+    return report[1 + key / 8] & (0x80 >> (key % 8));
+}
+
+// The steno order, each letter stands for the keys in the mask
+typedef struct {
+    char letter;
+    uint8_t first;
+    uint8_t last;
+} steno_letter_t;
+
+static const steno_letter_t steno_order[] = {
+    {'#', STENO_HID_N1, STENO_HID_NC},
+    {'S', STENO_HID_S1, STENO_HID_S2},
+    {'T', STENO_HID_TL, STENO_HID_TL},
+    {'K', STENO_HID_KL, STENO_HID_KL},
+    {'P', STENO_HID_PL, STENO_HID_PL},
+    {'W', STENO_HID_WL, STENO_HID_WL},
+    {'H', STENO_HID_HL, STENO_HID_HL},
+    {'R', STENO_HID_RL, STENO_HID_RL},
+    {'A', STENO_HID_A, STENO_HID_A},
+    {'O', STENO_HID_O, STENO_HID_O},
+    {'*', STENO_HID_ST1, STENO_HID_ST2},
+    {'*', STENO_HID_ST3, STENO_HID_ST4},
+    {'E', STENO_HID_E, STENO_HID_E},
+    {'U', STENO_HID_U, STENO_HID_U},
+    {'F', STENO_HID_FR, STENO_HID_FR},
+    {'R', STENO_HID_RR, STENO_HID_RR},
+    {'P', STENO_HID_PR, STENO_HID_PR},
+    {'B', STENO_HID_BR, STENO_HID_BR},
+    {'L', STENO_HID_LR, STENO_HID_LR},
+    {'G', STENO_HID_GR, STENO_HID_GR},
+    {'T', STENO_HID_TR, STENO_HID_TR},
+    {'S', STENO_HID_SR, STENO_HID_SR},
+    {'D', STENO_HID_DR, STENO_HID_DR},
+    {'Z', STENO_HID_ZR, STENO_HID_ZR},
+};
+
+#define FIRST_VOWEL 8
+#define FIRST_RIGHT 14
+
+static bool has_any_key(const uint8_t *report, const steno_letter_t *letter) {
+    for (uint8_t key = letter->first; key <= letter->last; key++) {
+        if (steno_hid_get_key(report, key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t steno_hid_decode(const uint8_t *report, uint8_t size, char *text, uint8_t text_size) {
+    if (size != STENO_HID_REPORT_SIZE || report[0] != STENO_HID_REPORT_ID || text_size == 0) {
+        return 0;
+    }
+    uint8_t length = 0;
+    bool middle = false;
+    for (uint8_t i = 0; i < sizeof(steno_order) / sizeof(steno_order[0]); i++) {
+        const steno_letter_t *letter = &steno_order[i];
+        if (!has_any_key(report, letter)) {
+            continue;
+        }
+        if (i >= FIRST_VOWEL && i < FIRST_RIGHT) {
+            // The two star groups are one key in steno
+            if (letter->letter == '*' && middle && length && text[length - 1] == '*') {
+                continue;
+            }
+            middle = true;
+        }
+        // Right hand keys without a vowel or star are marked with a hyphen
+        if (i >= FIRST_RIGHT && !middle) {
+            if (length + 1 < text_size) {
+                text[length++] = '-';
+            }
+            middle = true;
+        }
+        if (length + 1 < text_size) {
+            text[length++] = letter->letter;
+        }
+    }
+    text[length] = 0;
+    return length;
+}
@@ -0,0 +1,93 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TMK_CORE_COMMON_STENO_HID_H_
+#define TMK_CORE_COMMON_STENO_HID_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Steno strokes as vendor defined HID reports, in the format of the Plover
+// HID machine plugin, so that the host needs no serial port driver
+//
+// A report is the report ID followed by a 64 bit map of the keys, the first
+// key is the highest bit of the first byte.
+
+#define STENO_HID_USAGE_PAGE 0xFF50
+#define STENO_HID_USAGE 0x4C56
+#define STENO_HID_REPORT_ID 0x50
+#define STENO_HID_KEY_COUNT 64
+#define STENO_HID_REPORT_SIZE (1 + STENO_HID_KEY_COUNT / 8)
+
+enum steno_hid_key {
+    STENO_HID_S1,
+    STENO_HID_S2,
+    STENO_HID_TL,
+    STENO_HID_KL,
+    STENO_HID_PL,
+    STENO_HID_WL,
+    STENO_HID_HL,
+    STENO_HID_RL,
+    STENO_HID_A,
+    STENO_HID_O,
+    STENO_HID_ST1,
+    STENO_HID_ST2,
+    STENO_HID_RES1,
+    STENO_HID_RES2,
+    STENO_HID_PWR,
+    STENO_HID_ST3,
+    STENO_HID_ST4,
+    STENO_HID_E,
+    STENO_HID_U,
+    STENO_HID_FR,
+    STENO_HID_RR,
+    STENO_HID_PR,
+    STENO_HID_BR,
+    STENO_HID_LR,
+    STENO_HID_GR,
+    STENO_HID_TR,
+    STENO_HID_SR,
+    STENO_HID_DR,
+    STENO_HID_ZR,
+    // The number bar, #1 to #C
+    STENO_HID_N1,
+    STENO_HID_NC = STENO_HID_N1 + 11,
+    // Extra keys with no steno meaning
+    STENO_HID_X1,
+};
+
+// Starts an empty report
+void steno_hid_clear(uint8_t *report);
+void steno_hid_set_key(uint8_t *report, uint8_t key);
+bool steno_hid_get_key(const uint8_t *report, uint8_t key);
+
+// Writes the stroke of a report in steno order, like "STKPW" or "-FRLG",
+// returns the length of the text, or 0 if the report isn't a stroke
+uint8_t steno_hid_decode(const uint8_t *report, uint8_t size, char *text, uint8_t text_size);
+
+// Implemented by the protocol, returns false when the endpoint is busy
+bool steno_hid_try_send(const uint8_t *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TMK_CORE_COMMON_STENO_HID_H_ */
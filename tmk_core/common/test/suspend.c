@@ -15,3 +15,18 @@
  */
 
 
+
+#include <stdbool.h>
+#include "suspend.h"
+#include "eeconfig.h"
+
+void suspend_power_down(void) {
+    eeconfig_flush();
+}
+
+bool suspend_wakeup_condition(void) {
+    return true;
+}
+
+void suspend_wakeup_init(void) {
+}
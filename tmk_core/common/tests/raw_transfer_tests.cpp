@@ -0,0 +1,303 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <deque>
+#include <vector>
+#include <array>
+#include <functional>
+#include <iostream>
+#include <random>
+extern "C" {
+#include "raw_transfer.h"
+#include "timer.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+typedef std::array<uint8_t, RAW_TRANSFER_PACKET_SIZE> packet_t;
+
+// A loopback link between the host and the keyboard, which, like an
+// interrupt endpoint polled every 1 ms, moves at most one packet per
+// millisecond in each direction, and has room for one packet waiting
+struct Pipe {
+    std::deque<packet_t> packets;
+    unsigned int count = 0;
+    // Decides which packets are lost, and can corrupt them, by packet number
+    std::function<bool(unsigned int, packet_t&)> filter;
+
+    bool send(const uint8_t* packet) {
+        if (packets.size() >= 1) {
+            return false;
+        }
+        packet_t p;
+        std::copy(packet, packet + RAW_TRANSFER_PACKET_SIZE, p.begin());
+        if (!filter || filter(count, p)) {
+            packets.push_back(p);
+        }
+        count++;
+        return true;
+    }
+};
+
+static raw_transfer_t host;
+static raw_transfer_t keyboard;
+static Pipe host_to_keyboard;
+static Pipe keyboard_to_host;
+static std::vector<std::vector<uint8_t>> received_by_keyboard;
+static std::vector<std::vector<uint8_t>> received_by_host;
+
+static bool host_send(const uint8_t* packet) { return host_to_keyboard.send(packet); }
+static bool keyboard_send(const uint8_t* packet) { return keyboard_to_host.send(packet); }
+static void keyboard_receive(const uint8_t* data, uint16_t size) {
+    received_by_keyboard.emplace_back(data, data + size);
+}
+static void host_receive(const uint8_t* data, uint16_t size) {
+    received_by_host.emplace_back(data, data + size);
+}
+
+class RawTransfer : public testing::Test {
+public:
+    RawTransfer() {
+        set_time(0);
+        host_to_keyboard = Pipe();
+        keyboard_to_host = Pipe();
+        received_by_keyboard.clear();
+        received_by_host.clear();
+        raw_transfer_init(&host, host_send, host_receive);
+        raw_transfer_init(&keyboard, keyboard_send, keyboard_receive);
+    }
+
+    // Runs the link for one millisecond
+    void tick() {
+        if (!host_to_keyboard.packets.empty()) {
+            packet_t p = host_to_keyboard.packets.front();
+            host_to_keyboard.packets.pop_front();
+            raw_transfer_receive_packet(&keyboard, p.data(), p.size());
+        }
+        if (!keyboard_to_host.packets.empty()) {
+            packet_t p = keyboard_to_host.packets.front();
+            keyboard_to_host.packets.pop_front();
+            raw_transfer_receive_packet(&host, p.data(), p.size());
+        }
+        raw_transfer_task(&host);
+        raw_transfer_task(&keyboard);
+        advance_time(1);
+    }
+
+    // Returns the number of milliseconds it took
+    unsigned int run_until_idle(raw_transfer_t* sender, unsigned int limit = 10000) {
+        unsigned int ms = 0;
+        while (sender->state == RAW_TRANSFER_SENDING && ms < limit) {
+            tick();
+            ms++;
+        }
+        // Let the last replies through
+        for (int i = 0; i < 5; i++) {
+            tick();
+        }
+        return ms;
+    }
+
+    std::vector<uint8_t> make_message(unsigned int size, unsigned int seed = 1) {
+        std::vector<uint8_t> message(size);
+        for (unsigned int i = 0; i < size; i++) {
+            message[i] = (i * 7 + seed * 13) & 0xFF;
+        }
+        return message;
+    }
+};
+
+TEST_F(RawTransfer, CalculatesTheCcittCrc) {
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    EXPECT_EQ(raw_transfer_crc16(0xFFFF, check, sizeof(check)), 0x29B1);
+}
+
+TEST_F(RawTransfer, SendsAMessageThatFitsInOnePacket) {
+    std::vector<uint8_t> message = make_message(10);
+    EXPECT_TRUE(raw_transfer_send(&host, message.data(), message.size()));
+    run_until_idle(&host);
+    EXPECT_EQ(host.state, RAW_TRANSFER_IDLE);
+    ASSERT_EQ(received_by_keyboard.size(), 1);
+    EXPECT_EQ(received_by_keyboard[0], message);
+    EXPECT_EQ(host.stats.packets_sent, 1);
+}
+
+TEST_F(RawTransfer, SendsAnEmptyMessage) {
+    EXPECT_TRUE(raw_transfer_send(&host, NULL, 0));
+    run_until_idle(&host);
+    ASSERT_EQ(received_by_keyboard.size(), 1);
+    EXPECT_EQ(received_by_keyboard[0].size(), 0);
+}
+
+TEST_F(RawTransfer, ReassemblesTheBiggestMessage) {
+    std::vector<uint8_t> message = make_message(RAW_TRANSFER_MAX_MESSAGE_SIZE);
+    EXPECT_TRUE(raw_transfer_send(&host, message.data(), message.size()));
+    run_until_idle(&host);
+    ASSERT_EQ(received_by_keyboard.size(), 1);
+    EXPECT_EQ(received_by_keyboard[0], message);
+    EXPECT_EQ(host.stats.retransmissions, 0);
+}
+
+TEST_F(RawTransfer, SendsInBothDirectionsAtOnce) {
+    std::vector<uint8_t> upload = make_message(200, 1);
+    std::vector<uint8_t> download = make_message(150, 2);
+    EXPECT_TRUE(raw_transfer_send(&host, upload.data(), upload.size()));
+    EXPECT_TRUE(raw_transfer_send(&keyboard, download.data(), download.size()));
+    run_until_idle(&host);
+    run_until_idle(&keyboard);
+    ASSERT_EQ(received_by_keyboard.size(), 1);
+    EXPECT_EQ(received_by_keyboard[0], upload);
+    ASSERT_EQ(received_by_host.size(), 1);
+    EXPECT_EQ(received_by_host[0], download);
+}
+
+TEST_F(RawTransfer, RejectsMessagesThatAreTooBigOrWhileBusy) {
+    std::vector<uint8_t> message = make_message(RAW_TRANSFER_MAX_MESSAGE_SIZE + 1);
+    EXPECT_FALSE(raw_transfer_send(&host, message.data(), message.size()));
+    EXPECT_TRUE(raw_transfer_send(&host, message.data(), 100));
+    EXPECT_FALSE(raw_transfer_send(&host, message.data(), 100));
+}
+
+TEST_F(RawTransfer, RecoversFromLostPackets) {
+    // A fifth of the packets are lost, in both directions
+    std::mt19937 rng(0);
+    auto lossy = [&rng](unsigned int, packet_t&) { return rng() % 5 != 0; };
+    host_to_keyboard.filter = lossy;
+    keyboard_to_host.filter = lossy;
+    for (unsigned int i = 0; i < 10; i++) {
+        std::vector<uint8_t> message = make_message(25 * i + 7, i);
+        EXPECT_TRUE(raw_transfer_send(&host, message.data(), message.size()));
+        run_until_idle(&host);
+        EXPECT_EQ(host.state, RAW_TRANSFER_IDLE);
+        ASSERT_EQ(received_by_keyboard.size(), i + 1);
+        EXPECT_EQ(received_by_keyboard[i], message);
+    }
+    EXPECT_GT(host.stats.retransmissions, 0);
+}
+
+TEST_F(RawTransfer, ResendsACorruptedMessage) {
+    host_to_keyboard.filter = [](unsigned int n, packet_t& p) {
+        if (n == 2) {
+            p[RAW_TRANSFER_HEADER_SIZE + 5] ^= 0x10;
+        }
+        return true;
+    };
+    std::vector<uint8_t> message = make_message(100);
+    EXPECT_TRUE(raw_transfer_send(&host, message.data(), message.size()));
+    run_until_idle(&host);
+    EXPECT_EQ(keyboard.stats.crc_errors, 1);
+    ASSERT_EQ(received_by_keyboard.size(), 1);
+    EXPECT_EQ(received_by_keyboard[0], message);
+}
+
+TEST_F(RawTransfer, DeliversOnceWhenTheLastAcknowledgementIsLost) {
+    // The first packet from the keyboard acknowledges the sync
+    keyboard_to_host.filter = [](unsigned int n, packet_t&) { return n != 1; };
+    std::vector<uint8_t> message = make_message(20);
+    EXPECT_TRUE(raw_transfer_send(&host, message.data(), message.size()));
+    run_until_idle(&host);
+    EXPECT_EQ(host.state, RAW_TRANSFER_IDLE);
+    EXPECT_EQ(host.stats.retransmissions, 1);
+    EXPECT_EQ(received_by_keyboard.size(), 1);
+}
+
+TEST_F(RawTransfer, ReceivesAMessageIdAgainAfterTheHostRestarts) {
+    std::vector<uint8_t> first = make_message(20, 1);
+    EXPECT_TRUE(raw_transfer_send(&host, first.data(), first.size()));
+    run_until_idle(&host);
+    raw_transfer_init(&host, host_send, host_receive);
+    std::vector<uint8_t> second = make_message(20, 2);
+    EXPECT_TRUE(raw_transfer_send(&host, second.data(), second.size()));
+    run_until_idle(&host);
+    EXPECT_EQ(host.state, RAW_TRANSFER_IDLE);
+    ASSERT_EQ(received_by_keyboard.size(), 2);
+    EXPECT_EQ(received_by_keyboard[1], second);
+}
+
+TEST_F(RawTransfer, ReceivesAMessageIdAgainAfterASessionReset) {
+    std::vector<uint8_t> first = make_message(100, 1);
+    EXPECT_TRUE(raw_transfer_send(&host, first.data(), first.size()));
+    run_until_idle(&host);
+    raw_transfer_reset(&host);
+    host.tx_id = 0;
+    EXPECT_TRUE(raw_transfer_send(&host, first.data(), first.size()));
+    run_until_idle(&host);
+    EXPECT_EQ(received_by_keyboard.size(), 2);
+}
+
+TEST_F(RawTransfer, SendsTheSyncAgainWhenItIsLost) {
+    host_to_keyboard.filter = [](unsigned int n, packet_t&) { return n != 0; };
+    std::vector<uint8_t> message = make_message(20);
+    EXPECT_TRUE(raw_transfer_send(&host, message.data(), message.size()));
+    run_until_idle(&host);
+    EXPECT_EQ(host.state, RAW_TRANSFER_IDLE);
+    ASSERT_EQ(received_by_keyboard.size(), 1);
+    EXPECT_EQ(received_by_keyboard[0], message);
+}
+
+TEST_F(RawTransfer, RestartsItsOwnMessageWhenTheOtherEndRestarts) {
+    std::vector<uint8_t> first = make_message(20, 1);
+    EXPECT_TRUE(raw_transfer_send(&keyboard, first.data(), first.size()));
+    run_until_idle(&keyboard);
+    // The host restarts while the keyboard is halfway through a message
+    std::vector<uint8_t> download = make_message(200, 2);
+    EXPECT_TRUE(raw_transfer_send(&keyboard, download.data(), download.size()));
+    for (int i = 0; i < 3; i++) {
+        tick();
+    }
+    raw_transfer_init(&host, host_send, host_receive);
+    received_by_host.clear();
+    std::vector<uint8_t> upload = make_message(20, 3);
+    EXPECT_TRUE(raw_transfer_send(&host, upload.data(), upload.size()));
+    run_until_idle(&host);
+    run_until_idle(&keyboard);
+    EXPECT_EQ(keyboard.state, RAW_TRANSFER_IDLE);
+    ASSERT_EQ(received_by_host.size(), 1);
+    EXPECT_EQ(received_by_host[0], download);
+}
+
+TEST_F(RawTransfer, GivesUpWhenTheLinkIsDown) {
+    host_to_keyboard.filter = [](unsigned int, packet_t&) { return false; };
+    std::vector<uint8_t> message = make_message(100);
+    EXPECT_TRUE(raw_transfer_send(&host, message.data(), message.size()));
+    run_until_idle(&host);
+    EXPECT_EQ(host.state, RAW_TRANSFER_FAILED);
+    EXPECT_EQ(host.stats.failures, 1);
+    EXPECT_EQ(received_by_keyboard.size(), 0);
+    // A new message can be sent after the failure
+    host_to_keyboard.filter = nullptr;
+    EXPECT_TRUE(raw_transfer_send(&host, message.data(), message.size()));
+    run_until_idle(&host);
+    EXPECT_EQ(received_by_keyboard.size(), 1);
+}
+
+TEST_F(RawTransfer, KeepsTheEndpointBusy) {
+    // One packet per millisecond is the most the endpoint can move
+    const unsigned int messages = 20;
+    std::vector<uint8_t> message = make_message(RAW_TRANSFER_MAX_MESSAGE_SIZE);
+    unsigned int ms = 0;
+    for (unsigned int i = 0; i < messages; i++) {
+        EXPECT_TRUE(raw_transfer_send(&host, message.data(), message.size()));
+        ms += run_until_idle(&host, 10000);
+    }
+    ASSERT_EQ(received_by_keyboard.size(), messages);
+    double bytes_per_second = 1000.0 * messages * message.size() / ms;
+    double max_bytes_per_second = 1000.0 * RAW_TRANSFER_PAYLOAD_SIZE;
+    std::cout << "Raw transfer throughput: " << bytes_per_second << " bytes/s, "
+        << 100.0 * bytes_per_second / max_bytes_per_second << "% of the endpoint" << std::endl;
+    EXPECT_GT(bytes_per_second, 0.85 * max_bytes_per_second);
+}
@@ -0,0 +1,24 @@
+raw_transfer_SRC :=\
+	$(TMK_PATH)/common/tests/raw_transfer_tests.cpp \
+	$(TMK_PATH)/common/raw_transfer.c \
+	$(TMK_PATH)/common/test/timer.c
+raw_transfer_INC := $(TMK_PATH)/common
+
+trace_SRC :=\
+	$(TMK_PATH)/common/tests/trace_tests.cpp \
+	$(TMK_PATH)/common/trace.c
+trace_INC := $(TMK_PATH)/common
+trace_DEFS :=\
+	-DTRACE_ENABLE\
+	-DTRACE_BUFFER_SIZE=32\
+	-include $(TMK_PATH)/common/tests/trace_test_config.h
+
+steno_hid_SRC :=\
+	$(TMK_PATH)/common/tests/steno_hid_tests.cpp \
+	$(TMK_PATH)/common/steno_hid.c
+steno_hid_INC := $(TMK_PATH)/common
+
+spsc_ring_SRC :=\
+	$(TMK_PATH)/common/tests/spsc_ring_tests.cpp \
+	$(TMK_PATH)/common/tests/spsc_ring_c.c
+spsc_ring_INC := $(TMK_PATH)/common
@@ -0,0 +1,37 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// The ring is used from C code as well, this makes sure the header compiles
+// as C, with the flags of the firmware
+
+#include "spsc_ring.h"
+
+SPSC_RING_DEFINE(c_ring, uint8_t, 16)
+
+static c_ring_t ring;
+
+bool c_ring_test_push(uint8_t value) {
+    return c_ring_push(&ring, value);
+}
+
+uint8_t c_ring_test_pop_n(uint8_t *values, uint8_t count) {
+    return c_ring_pop_n(&ring, values, count);
+}
+
+uint8_t c_ring_test_high_water(void) {
+    return ring.ring.high_water;
+}
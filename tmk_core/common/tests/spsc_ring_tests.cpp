@@ -0,0 +1,234 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <thread>
+#include <vector>
+#include "spsc_ring.h"
+
+extern "C" {
+bool c_ring_test_push(uint8_t value);
+uint8_t c_ring_test_pop_n(uint8_t *values, uint8_t count);
+uint8_t c_ring_test_high_water(void);
+}
+
+SPSC_RING_DEFINE(byte_ring, uint8_t, 8)
+SPSC_RING_DEFINE(word_ring, uint32_t, 64)
+
+class SpscRingC : public testing::Test {
+public:
+    SpscRingC() : r() {}
+    byte_ring_t r;
+};
+
+TEST_F(SpscRingC, StartsEmpty) {
+    uint8_t value;
+    EXPECT_EQ(0, byte_ring_count(&r));
+    EXPECT_FALSE(byte_ring_pop(&r, &value));
+    EXPECT_EQ(nullptr, byte_ring_front(&r));
+}
+
+TEST_F(SpscRingC, PopsInOrder) {
+    EXPECT_TRUE(byte_ring_push(&r, 1));
+    EXPECT_TRUE(byte_ring_push(&r, 2));
+    EXPECT_EQ(2, byte_ring_count(&r));
+    EXPECT_EQ(1, *byte_ring_front(&r));
+    uint8_t value;
+    EXPECT_TRUE(byte_ring_pop(&r, &value));
+    EXPECT_EQ(1, value);
+    EXPECT_TRUE(byte_ring_pop(&r, &value));
+    EXPECT_EQ(2, value);
+    EXPECT_FALSE(byte_ring_pop(&r, &value));
+}
+
+TEST_F(SpscRingC, UsesAllTheSlots) {
+    for (uint8_t i = 0; i < 8; i++) {
+        EXPECT_TRUE(byte_ring_push(&r, i));
+    }
+    EXPECT_FALSE(byte_ring_push(&r, 8));
+    EXPECT_EQ(8, byte_ring_count(&r));
+    EXPECT_EQ(1, r.ring.dropped);
+    EXPECT_EQ(8, r.ring.high_water);
+}
+
+TEST_F(SpscRingC, KeepsTheHighWaterMark) {
+    byte_ring_push(&r, 1);
+    byte_ring_push(&r, 2);
+    byte_ring_push(&r, 3);
+    uint8_t values[3];
+    byte_ring_pop_n(&r, values, 3);
+    byte_ring_push(&r, 4);
+    EXPECT_EQ(3, r.ring.high_water);
+    EXPECT_EQ(0, r.ring.dropped);
+}
+
+TEST_F(SpscRingC, WrapsAroundTheIndexes) {
+    uint8_t value;
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(byte_ring_push(&r, i & 0xFF));
+        EXPECT_TRUE(byte_ring_push(&r, (i + 1) & 0xFF));
+        EXPECT_TRUE(byte_ring_pop(&r, &value));
+        EXPECT_EQ(i & 0xFF, value);
+        EXPECT_TRUE(byte_ring_pop(&r, &value));
+        EXPECT_EQ((i + 1) & 0xFF, value);
+    }
+    EXPECT_EQ(0, byte_ring_count(&r));
+}
+
+TEST_F(SpscRingC, PushesAndPopsInBulk) {
+    const uint8_t in[] = {1, 2, 3, 4, 5, 6};
+    uint8_t out[8];
+    EXPECT_EQ(6, byte_ring_push_n(&r, in, 6));
+    EXPECT_EQ(4, byte_ring_pop_n(&r, out, 4));
+    EXPECT_EQ((std::vector<uint8_t>{1, 2, 3, 4}), std::vector<uint8_t>(out, out + 4));
+    // This wraps around the end of the buffer, and fills it
+    EXPECT_EQ(6, byte_ring_push_n(&r, in, 6));
+    EXPECT_EQ(0, byte_ring_push_n(&r, in, 2));
+    EXPECT_EQ(2, r.ring.dropped);
+    EXPECT_EQ(8, byte_ring_pop_n(&r, out, 8));
+    EXPECT_EQ((std::vector<uint8_t>{5, 6, 1, 2, 3, 4, 5, 6}), std::vector<uint8_t>(out, out + 8));
+    EXPECT_EQ(0, byte_ring_pop_n(&r, out, 8));
+}
+
+TEST_F(SpscRingC, Clears) {
+    byte_ring_push(&r, 1);
+    byte_ring_push(&r, 2);
+    byte_ring_clear(&r);
+    EXPECT_EQ(0, byte_ring_count(&r));
+    EXPECT_TRUE(byte_ring_push(&r, 3));
+    EXPECT_EQ(3, *byte_ring_front(&r));
+}
+
+TEST_F(SpscRingC, SaturatesTheDroppedCount) {
+    for (int i = 0; i < 300; i++) {
+        byte_ring_push(&r, 0);
+    }
+    EXPECT_EQ(0xFF, r.ring.dropped);
+}
+
+TEST(SpscRingFromC, Works) {
+    for (uint8_t i = 0; i < 17; i++) {
+        EXPECT_EQ(i < 16, c_ring_test_push(i));
+    }
+    uint8_t values[16];
+    EXPECT_EQ(16, c_ring_test_pop_n(values, 16));
+    EXPECT_EQ(15, values[15]);
+    EXPECT_EQ(16, c_ring_test_high_water());
+}
+
+TEST(SpscRingCpp, WorksLikeTheRingBuffer) {
+    SpscRing<int, 4> ring;
+    EXPECT_TRUE(ring.empty());
+    EXPECT_TRUE(ring.enqueue(1));
+    EXPECT_TRUE(ring.enqueue(2));
+    EXPECT_EQ(2, ring.back());
+    ring.back() = 3;
+    int value;
+    EXPECT_TRUE(ring.peek(value));
+    EXPECT_EQ(1, value);
+    EXPECT_EQ(2, ring.size());
+    EXPECT_TRUE(ring.get(value));
+    EXPECT_EQ(1, value);
+    EXPECT_EQ(3, ring.front());
+    EXPECT_TRUE(ring.get(value));
+    EXPECT_EQ(3, value);
+    EXPECT_FALSE(ring.get(value));
+}
+
+TEST(SpscRingCpp, HasStatistics) {
+    SpscRing<int, 4> ring;
+    const int in[] = {1, 2, 3, 4, 5};
+    EXPECT_EQ(4, ring.enqueue(in, 5));
+    EXPECT_FALSE(ring.enqueue(6));
+    EXPECT_EQ(2, ring.dropped());
+    EXPECT_EQ(4, ring.high_water());
+    int out[4];
+    EXPECT_EQ(4, ring.get(out, 4));
+    EXPECT_EQ(4, out[3]);
+    ring.enqueue(7);
+    ring.clear();
+    EXPECT_TRUE(ring.empty());
+    EXPECT_EQ(4, ring.high_water());
+}
+
+// A producer and a consumer thread pass a counting sequence through a ring,
+// any lost, repeated or reordered item shows up as a gap in the sequence.
+// They yield when the ring is full or empty, so that this runs on one core.
+static const uint32_t stress_items = 2000000;
+
+TEST(SpscRingStress, SingleItemsFromCCode) {
+    static word_ring_t ring;
+    std::thread producer([]() {
+        for (uint32_t i = 0; i < stress_items;) {
+            if (word_ring_push(&ring, i)) {
+                i++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint32_t expected = 0;
+    uint32_t errors = 0;
+    while (expected < stress_items) {
+        uint32_t value;
+        if (word_ring_pop(&ring, &value)) {
+            errors += value != expected;
+            expected = value + 1;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    EXPECT_EQ(0, errors);
+    EXPECT_EQ(0, word_ring_count(&ring));
+    EXPECT_LE(ring.ring.high_water, 64);
+}
+
+TEST(SpscRingStress, BulkFromCpp) {
+    static SpscRing<uint32_t, 128> ring;
+    std::thread producer([]() {
+        uint32_t items[37];
+        uint32_t next = 0;
+        while (next < stress_items) {
+            uint8_t count = 0;
+            for (; count < 37 && next + count < stress_items; count++) {
+                items[count] = next + count;
+            }
+            uint8_t pushed = ring.enqueue(items, count);
+            if (pushed < count) {
+                std::this_thread::yield();
+            }
+            next += pushed;
+        }
+    });
+    uint32_t expected = 0;
+    uint32_t errors = 0;
+    while (expected < stress_items) {
+        uint32_t items[23];
+        uint8_t count = ring.get(items, 23);
+        if (!count) {
+            std::this_thread::yield();
+        }
+        for (uint8_t i = 0; i < count; i++) {
+            errors += items[i] != expected;
+            expected = items[i] + 1;
+        }
+    }
+    producer.join();
+    EXPECT_EQ(0, errors);
+    EXPECT_TRUE(ring.empty());
+}
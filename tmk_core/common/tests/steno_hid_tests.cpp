@@ -0,0 +1,118 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <string>
+#include <cstring>
+#include <initializer_list>
+extern "C" {
+#include "steno_hid.h"
+}
+
+static std::string decode(const uint8_t *report, uint8_t size = STENO_HID_REPORT_SIZE) {
+    char text[32];
+    uint8_t length = steno_hid_decode(report, size, text, sizeof(text));
+    EXPECT_EQ(length, strlen(text));
+    return std::string(text, length);
+}
+
+class StenoHid : public testing::Test {
+public:
+    StenoHid() {
+        steno_hid_clear(report);
+    }
+
+    std::string stroke(std::initializer_list<uint8_t> keys) {
+        steno_hid_clear(report);
+        for (uint8_t key : keys) {
+            steno_hid_set_key(report, key);
+        }
+        return decode(report);
+    }
+
+    uint8_t report[STENO_HID_REPORT_SIZE];
+};
+
+TEST_F(StenoHid, AnEmptyReportHasOnlyTheReportId) {
+    EXPECT_EQ(STENO_HID_REPORT_ID, report[0]);
+    for (int i = 1; i < STENO_HID_REPORT_SIZE; i++) {
+        EXPECT_EQ(0, report[i]);
+    }
+    EXPECT_EQ("", decode(report));
+}
+
+TEST_F(StenoHid, TheFirstKeyIsTheHighestBit) {
+    steno_hid_set_key(report, STENO_HID_S1);
+    steno_hid_set_key(report, STENO_HID_ZR);
+    steno_hid_set_key(report, STENO_HID_X1 + 22);
+    EXPECT_EQ(0x80, report[1]);
+    EXPECT_EQ(0x08, report[4]);
+    EXPECT_EQ(0x01, report[8]);
+    EXPECT_TRUE(steno_hid_get_key(report, STENO_HID_ZR));
+    EXPECT_FALSE(steno_hid_get_key(report, STENO_HID_DR));
+}
+
+TEST_F(StenoHid, DecodesARecordedReport) {
+    // "KAT", as captured from the endpoint
+    const uint8_t recorded[STENO_HID_REPORT_SIZE] = {0x50, 0x10, 0x80, 0x00, 0x40, 0, 0, 0, 0};
+    EXPECT_EQ("KAT", decode(recorded));
+}
+
+TEST_F(StenoHid, DecodesLeftHandChords) {
+    EXPECT_EQ("STKPW", stroke({STENO_HID_S1, STENO_HID_TL, STENO_HID_KL, STENO_HID_PL, STENO_HID_WL}));
+    EXPECT_EQ("HRAOEUBG", stroke({STENO_HID_HL, STENO_HID_RL, STENO_HID_A, STENO_HID_O, STENO_HID_E, STENO_HID_U, STENO_HID_BR, STENO_HID_GR}));
+}
+
+TEST_F(StenoHid, RightHandOnlyChordsStartWithAHyphen) {
+    EXPECT_EQ("-FRPBLGTSDZ", stroke({STENO_HID_FR, STENO_HID_RR, STENO_HID_PR, STENO_HID_BR, STENO_HID_LR,
+        STENO_HID_GR, STENO_HID_TR, STENO_HID_SR, STENO_HID_DR, STENO_HID_ZR}));
+    EXPECT_EQ("S-S", stroke({STENO_HID_S2, STENO_HID_SR}));
+}
+
+TEST_F(StenoHid, TheStarKeysAreOneKey) {
+    EXPECT_EQ("*", stroke({STENO_HID_ST1, STENO_HID_ST2, STENO_HID_ST3, STENO_HID_ST4}));
+    EXPECT_EQ("*", stroke({STENO_HID_ST4}));
+    EXPECT_EQ("O*E", stroke({STENO_HID_O, STENO_HID_ST1, STENO_HID_E}));
+    EXPECT_EQ("*D", stroke({STENO_HID_ST2, STENO_HID_DR}));
+}
+
+TEST_F(StenoHid, AnyNumberKeyIsTheNumberBar) {
+    EXPECT_EQ("#", stroke({STENO_HID_N1}));
+    EXPECT_EQ("#", stroke({STENO_HID_N1 + 3, STENO_HID_NC}));
+    EXPECT_EQ("#S-D", stroke({STENO_HID_N1 + 5, STENO_HID_S1, STENO_HID_DR}));
+}
+
+TEST_F(StenoHid, ExtraKeysAreNotWritten) {
+    EXPECT_EQ("", stroke({STENO_HID_X1}));
+    EXPECT_EQ("T", stroke({STENO_HID_TL, STENO_HID_X1 + 1}));
+}
+
+TEST_F(StenoHid, OtherReportsAreNotDecoded) {
+    steno_hid_set_key(report, STENO_HID_TL);
+    EXPECT_EQ("", decode(report, STENO_HID_REPORT_SIZE - 1));
+    report[0] = 1;
+    EXPECT_EQ("", decode(report));
+}
+
+TEST_F(StenoHid, TheTextIsTruncatedToTheBuffer) {
+    for (uint8_t key = STENO_HID_S1; key <= STENO_HID_ZR; key++) {
+        steno_hid_set_key(report, key);
+    }
+    char text[6];
+    EXPECT_EQ(5, steno_hid_decode(report, sizeof(report), text, sizeof(text)));
+    EXPECT_STREQ("STKPW", text);
+}
@@ -0,0 +1,5 @@
+TEST_LIST +=\
+	raw_transfer\
+	trace\
+	steno_hid\
+	spsc_ring
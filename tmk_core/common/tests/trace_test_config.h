@@ -0,0 +1,24 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Formats for the trace tests, included before everything else like a
+// keymap config.h
+#define TRACE_USER_FORMATS(X) \
+    X(TRACE_TEST_NUMBERS, "%d %5u %04x %X %b %c %%\n") \
+    X(TRACE_TEST_ONE, "one %u\n") \
+    X(TRACE_TEST_TWO, "two %u %u\n") \
+    X(TRACE_TEST_BYTES, "bytes: ")
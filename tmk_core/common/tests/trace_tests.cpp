@@ -0,0 +1,214 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+#include <cstdio>
+extern "C" {
+#include "trace.h"
+}
+
+static std::string output;
+static uint8_t output_room;
+
+extern "C" int8_t sendchar(uint8_t c) {
+    output += (char)c;
+    return 0;
+}
+
+extern "C" uint8_t trace_output_room(void) {
+    return output_room;
+}
+
+static void put_string(char c) {
+    output += c;
+}
+
+static void trace_one(uint16_t value) {
+    trace_args(TRACE_TEST_ONE, 1, &value);
+}
+
+static void flush() {
+    for (int i = 0; i < TRACE_BUFFER_SIZE; i++) {
+        trace_task();
+    }
+}
+
+class Trace : public testing::Test {
+public:
+    Trace() {
+        trace_init();
+        output.clear();
+        output_room = 32;
+    }
+};
+
+TEST_F(Trace, NothingIsOutputWithoutRecords) {
+    trace_task();
+    EXPECT_EQ(output, "");
+}
+
+TEST_F(Trace, FormatsTheArguments) {
+    uint16_t args[] = {(uint16_t)-42, 123, 0xBE, 0xBEEF};
+    trace_args(TRACE_TEST_NUMBERS, 4, args);
+    trace_task();
+    EXPECT_EQ(output, "-42   123 00be BEEF ? ? %\n");
+}
+
+TEST_F(Trace, FormatsBinaryAndCharacters) {
+    uint16_t args[] = {0, 0, 0, 0};
+    trace_args(TRACE_TEST_NUMBERS, 4, args);
+    trace_task();
+    EXPECT_EQ(output, "0     0 0000 0 ? ? %\n");
+    output.clear();
+    uint8_t record[] = {TRACE_TEST_NUMBERS, 12, 0, 0, 0, 0, 0, 0, 0, 0, 5, 0, 'x', 0};
+    EXPECT_EQ(trace_format(record, sizeof(record), put_string), sizeof(record));
+    EXPECT_EQ(output, "0     0 0000 0 101 x %\n");
+}
+
+TEST_F(Trace, ExtraArgumentsAreCutOff) {
+    uint16_t args[TRACE_MAX_ARGS + 2] = {1, 2, 3};
+    trace_args(TRACE_TEST_TWO, TRACE_MAX_ARGS + 2, args);
+    trace_task();
+    EXPECT_EQ(output, "two 1 2\n");
+    // The next record starts where expected
+    trace_one(3);
+    trace_task();
+    EXPECT_EQ(output, "two 1 2\none 3\n");
+}
+
+TEST_F(Trace, FormatsBytes) {
+    uint8_t data[] = {0x01, 0x00, 0xAB, 0xFF};
+    trace_data(TRACE_TEST_BYTES, data, sizeof(data));
+    trace_task();
+    EXPECT_EQ(output, "bytes: 01 00 AB FF \n");
+}
+
+TEST_F(Trace, OutputsOneRecordPerTask) {
+    trace_one(1);
+    trace_one(2);
+    trace_task();
+    EXPECT_EQ(output, "one 1\n");
+    trace_task();
+    EXPECT_EQ(output, "one 1\none 2\n");
+}
+
+TEST_F(Trace, WaitsForTheOutput) {
+    trace_one(1);
+    output_room = 0;
+    trace_task();
+    EXPECT_EQ(output, "");
+    output_room = 32;
+    trace_task();
+    EXPECT_EQ(output, "one 1\n");
+}
+
+TEST_F(Trace, OutputsOnlyWhatFitsAndResumes) {
+    // The record is longer than the room, and fits in the buffer
+    uint8_t data[20];
+    for (uint8_t i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+    trace_data(TRACE_TEST_BYTES, data, sizeof(data));
+    trace_one(1);
+    std::string expected = "bytes: ";
+    for (uint8_t i = 0; i < sizeof(data); i++) {
+        char hex[4];
+        snprintf(hex, sizeof(hex), "%02X ", i);
+        expected += hex;
+    }
+    expected += "\n";
+    output_room = 10;
+    size_t calls = 0;
+    while (output.size() < expected.size() && calls < expected.size()) {
+        size_t before = output.size();
+        trace_task();
+        calls++;
+        EXPECT_LE(output.size() - before, 10);
+    }
+    EXPECT_EQ(calls, (expected.size() + 9) / 10);
+    EXPECT_EQ(output, expected);
+    trace_task();
+    EXPECT_EQ(output, expected + "one 1\n");
+}
+
+TEST_F(Trace, RecordsWrapAroundTheBuffer) {
+    std::string expected;
+    // Records of four bytes move the start of the next one around the buffer
+    for (uint16_t i = 0; i < TRACE_BUFFER_SIZE; i++) {
+        trace_one(i);
+        uint16_t args[] = {i, 1000};
+        trace_args(TRACE_TEST_TWO, 2, args);
+        trace_task();
+        trace_task();
+        expected += "one " + std::to_string(i) + "\n";
+        expected += "two " + std::to_string(i) + " 1000\n";
+    }
+    EXPECT_EQ(output, expected);
+    EXPECT_EQ(trace_get_dropped(), 0);
+}
+
+TEST_F(Trace, ReportsDroppedRecords) {
+    // Each record takes four bytes
+    for (uint16_t i = 0; i < TRACE_BUFFER_SIZE / 4 + 3; i++) {
+        trace_one(i);
+    }
+    EXPECT_EQ(trace_get_dropped(), 3);
+    trace_task();
+    EXPECT_EQ(output, "one 0\n");
+    // Still no room for the report and the record
+    trace_one(100);
+    EXPECT_EQ(trace_get_dropped(), 4);
+    trace_task();
+    trace_one(101);
+    flush();
+    std::string expected;
+    for (uint16_t i = 0; i < TRACE_BUFFER_SIZE / 4; i++) {
+        expected += "one " + std::to_string(i) + "\n";
+    }
+    expected += "trace: 4 records dropped\none 101\n";
+    EXPECT_EQ(output, expected);
+    EXPECT_EQ(trace_get_dropped(), 4);
+}
+
+TEST_F(Trace, DecodesRecords) {
+    std::vector<uint8_t> data = {
+        TRACE_DROPPED, 2, 7, 0,
+        TRACE_MATRIX_ROW, 4, 3, 0, 0x12, 0xAB,
+        TRACE_KEYBOARD_REPORT, 3 | TRACE_RECORD_BYTES, 2, 0, 4,
+    };
+    EXPECT_EQ(trace_decode(data.data(), data.size(), put_string), data.size());
+    EXPECT_EQ(output,
+        "trace: 7 records dropped\n"
+        "matrix row 3: AB12\n"
+        "keyboard_report: 02 00 04 \n");
+}
+
+TEST_F(Trace, DecodingStopsAtABadRecord) {
+    std::vector<uint8_t> data = {
+        TRACE_TEST_ONE, 2, 1, 0,
+        TRACE_NUM_FORMATS, 0,
+    };
+    EXPECT_EQ(trace_decode(data.data(), data.size(), put_string), 4);
+    EXPECT_EQ(output, "one 1\n");
+    output.clear();
+    // The payload is cut off
+    data = {TRACE_TEST_ONE, 2, 1, 0, TRACE_TEST_ONE, 2, 1};
+    EXPECT_EQ(trace_decode(data.data(), data.size(), put_string), 4);
+    EXPECT_EQ(output, "one 1\n");
+}
@@ -0,0 +1,296 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "trace.h"
+#include "progmem.h"
+#include "sendchar.h"
+#include <string.h>
+
+#define TRACE_FORMAT_STRING(id, format) static const char id##_format[] PROGMEM = format;
+TRACE_FORMATS(TRACE_FORMAT_STRING)
+#undef TRACE_FORMAT_STRING
+
+#define TRACE_FORMAT_ENTRY(id, format) id##_format,
+static const char* const trace_formats[] PROGMEM = {
+    TRACE_FORMATS(TRACE_FORMAT_ENTRY)
+};
+#undef TRACE_FORMAT_ENTRY
+
+#ifdef __AVR__
+#define format_string(id) ((const char*)pgm_read_word(&trace_formats[id]))
+#else
+#define format_string(id) (trace_formats[id])
+#endif
+
+#define BUFFER_MASK (TRACE_BUFFER_SIZE - 1)
+#define MAX_PAYLOAD (TRACE_MAX_ARGS * 2 > TRACE_MAX_BYTES ? TRACE_MAX_ARGS * 2 : TRACE_MAX_BYTES)
+#define DROPPED_RECORD_SIZE (TRACE_RECORD_HEADER_SIZE + 2)
+
+// Only the main loop writes and reads the buffer, so the indexes don't need
+// to be protected. They are free running and masked on access.
+static uint8_t buffer[TRACE_BUFFER_SIZE];
+static uint16_t head;
+static uint16_t tail;
+// Dropped records that haven't been reported yet
+static uint16_t unreported;
+static uint16_t dropped;
+// Characters of the record at the tail that earlier calls have output, and
+// the range of them the current call outputs
+static uint16_t output_done;
+static uint16_t output_index;
+static uint16_t output_end;
+
+void trace_init(void) {
+    head = 0;
+    tail = 0;
+    unreported = 0;
+    dropped = 0;
+    output_done = 0;
+}
+
+// One console packet
+__attribute__ ((weak))
+uint8_t trace_output_room(void) {
+    return 32;
+}
+
+uint16_t trace_get_dropped(void) {
+    return dropped;
+}
+
+static void put_byte(uint8_t value) {
+    buffer[head++ & BUFFER_MASK] = value;
+}
+
+static void put_header(uint8_t id, uint8_t size) {
+    put_byte(id);
+    put_byte(size);
+}
+
+// Makes room for a record, and for the report of the records dropped
+// before it, returns false if the record has to be dropped too
+static bool reserve(uint16_t size) {
+    uint16_t free = TRACE_BUFFER_SIZE - (uint16_t)(head - tail);
+    if (unreported) {
+        size += DROPPED_RECORD_SIZE;
+    }
+    if (size > free) {
+        unreported++;
+        dropped++;
+        return false;
+    }
+    if (unreported) {
+        put_header(TRACE_DROPPED, 2);
+        put_byte(unreported & 0xFF);
+        put_byte(unreported >> 8);
+        unreported = 0;
+    }
+    return true;
+}
+
+void trace_args(uint8_t id, uint8_t count, const uint16_t* args) {
+    if (count > TRACE_MAX_ARGS) {
+        count = TRACE_MAX_ARGS;
+    }
+    if (!reserve(TRACE_RECORD_HEADER_SIZE + count * 2)) {
+        return;
+    }
+    put_header(id, count * 2);
+    for (uint8_t i = 0; i < count; i++) {
+        put_byte(args[i] & 0xFF);
+        put_byte(args[i] >> 8);
+    }
+}
+
+void trace_data(uint8_t id, const void* data, uint8_t size) {
+    if (size > TRACE_MAX_BYTES) {
+        size = TRACE_MAX_BYTES;
+    }
+    if (!reserve(TRACE_RECORD_HEADER_SIZE + size)) {
+        return;
+    }
+    put_header(id, size | TRACE_RECORD_BYTES);
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (uint8_t i = 0; i < size; i++) {
+        put_byte(bytes[i]);
+    }
+}
+
+static void put_number(trace_putc_t put, uint16_t value, uint8_t base, bool upper,
+        bool negative, uint8_t width, char pad) {
+    char digits[16];
+    uint8_t count = 0;
+    do {
+        uint8_t digit = value % base;
+        digits[count++] = digit < 10 ? '0' + digit : (upper ? 'A' : 'a') + digit - 10;
+        value /= base;
+    } while (value);
+    if (negative) {
+        if (pad == '0') {
+            put('-');
+        }
+        width = width ? width - 1 : 0;
+    }
+    for (uint8_t i = count; i < width; i++) {
+        put(pad);
+    }
+    if (negative && pad != '0') {
+        put('-');
+    }
+    while (count) {
+        put(digits[--count]);
+    }
+}
+
+uint16_t trace_format(const uint8_t* record, uint16_t size, trace_putc_t put) {
+    if (size < TRACE_RECORD_HEADER_SIZE || record[0] >= TRACE_NUM_FORMATS) {
+        return 0;
+    }
+    uint8_t payload_size = record[1] & TRACE_RECORD_MAX_PAYLOAD;
+    if (size < TRACE_RECORD_HEADER_SIZE + payload_size) {
+        return 0;
+    }
+    const uint8_t* payload = record + TRACE_RECORD_HEADER_SIZE;
+    bool bytes = record[1] & TRACE_RECORD_BYTES;
+    uint8_t arg = 0;
+    const char* format = format_string(record[0]);
+    char c;
+    while ((c = pgm_read_byte(format++))) {
+        if (c != '%') {
+            put(c);
+            continue;
+        }
+        c = pgm_read_byte(format++);
+        char pad = ' ';
+        uint8_t width = 0;
+        if (c == '0') {
+            pad = '0';
+            c = pgm_read_byte(format++);
+        }
+        while (c >= '0' && c <= '9') {
+            width = width * 10 + c - '0';
+            c = pgm_read_byte(format++);
+        }
+        if (c == '%') {
+            put(c);
+            continue;
+        }
+        if (c == 0) {
+            break;
+        }
+        if (bytes || arg + 2 > payload_size) {
+            put('?');
+            continue;
+        }
+        uint16_t value = payload[arg] | (uint16_t)payload[arg + 1] << 8;
+        arg += 2;
+        switch (c) {
+            case 'u':
+                put_number(put, value, 10, false, false, width, pad);
+                break;
+            case 'd': {
+                bool negative = (int16_t)value < 0;
+                put_number(put, negative ? -value : value, 10, false, negative, width, pad);
+                break;
+            }
+            case 'x':
+            case 'X':
+                put_number(put, value, 16, c == 'X', false, width, pad);
+                break;
+            case 'b':
+                put_number(put, value, 2, false, false, width, pad);
+                break;
+            case 'c':
+                put(value);
+                break;
+            default:
+                put('%');
+                put(c);
+                break;
+        }
+    }
+    if (bytes) {
+        for (uint8_t i = 0; i < payload_size; i++) {
+            put_number(put, payload[i], 16, true, false, 2, '0');
+            put(' ');
+        }
+        put('\n');
+    }
+    return TRACE_RECORD_HEADER_SIZE + payload_size;
+}
+
+uint16_t trace_decode(const uint8_t* data, uint16_t size, trace_putc_t put) {
+    uint16_t used = 0;
+    while (used < size) {
+        uint16_t record_size = trace_format(data + used, size - used, put);
+        if (record_size == 0) {
+            break;
+        }
+        used += record_size;
+    }
+    return used;
+}
+
+#ifdef TRACE_BINARY_OUTPUT
+static void format_hex(const uint8_t* record, uint16_t size, trace_putc_t put) {
+    static const char hex[] = "0123456789ABCDEF";
+    put('~');
+    for (uint16_t i = 0; i < size; i++) {
+        put(hex[record[i] >> 4]);
+        put(hex[record[i] & 0xF]);
+    }
+    put('\n');
+}
+#endif
+
+// Skips what was output before, and stops when the room is used up
+static void put_output(char c) {
+    if (output_index >= output_done && output_index < output_end) {
+        sendchar(c);
+    }
+    output_index++;
+}
+
+void trace_task(void) {
+    if (head == tail) {
+        return;
+    }
+    uint8_t room = trace_output_room();
+    if (room == 0) {
+        return;
+    }
+    // The record stays in the buffer until all of it is output, and is
+    // formatted again from the start by every call
+    uint8_t record[TRACE_RECORD_HEADER_SIZE + MAX_PAYLOAD];
+    uint16_t size = TRACE_RECORD_HEADER_SIZE + (buffer[(tail + 1) & BUFFER_MASK] & TRACE_RECORD_MAX_PAYLOAD);
+    for (uint16_t i = 0; i < size; i++) {
+        record[i] = buffer[(tail + i) & BUFFER_MASK];
+    }
+    output_index = 0;
+    output_end = output_done + room;
+#ifdef TRACE_BINARY_OUTPUT
+    format_hex(record, size, put_output);
+#else
+    trace_format(record, size, put_output);
+#endif
+    if (output_index > output_end) {
+        output_done = output_end;
+        return;
+    }
+    output_done = 0;
+    tail += size;
+}
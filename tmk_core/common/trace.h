@@ -0,0 +1,131 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TMK_CORE_COMMON_TRACE_H_
+#define TMK_CORE_COMMON_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Debug output that is cheap to produce
+//
+// A trace call only copies a format id and its arguments into a ring buffer,
+// the formatting is done later by trace_task, at most one record per call,
+// and only as much of it as the console can take without waiting. The rest
+// of a long record is output by the next calls. With TRACE_BINARY_OUTPUT the
+// records are not formatted at all, but sent as hex lines starting with '~',
+// which the trace_decode host tool turns back into text.
+//
+// When the buffer is full the new record is dropped, and the number of
+// dropped records is reported in its place once there's room again.
+//
+// The format strings live in the table below, keymaps can add their own by
+// defining TRACE_USER_FORMATS(X) in config.h, with the same X(id, format)
+// entries. The host tool has to be built with the same table.
+//
+// The formats understand %u, %d, %x, %X, %b and %c, with an optional zero
+// flag and width, and %%. Each argument is 16 bits. Records made with
+// trace_bytes print the format followed by the bytes in hex.
+
+// A record is the format id, the payload size, with TRACE_RECORD_BYTES set
+// for trace_bytes records, and the payload, the arguments are little endian
+#define TRACE_RECORD_HEADER_SIZE 2
+#define TRACE_RECORD_BYTES 0x80
+#define TRACE_RECORD_MAX_PAYLOAD 0x7F
+
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 128
+#endif
+
+#ifndef TRACE_MAX_ARGS
+#define TRACE_MAX_ARGS 4
+#endif
+
+// The longest trace_bytes record, the rest of the data is cut off
+#ifndef TRACE_MAX_BYTES
+#define TRACE_MAX_BYTES 32
+#endif
+
+#if TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)
+#error "TRACE_BUFFER_SIZE must be a power of two"
+#endif
+
+#if TRACE_BUFFER_SIZE < 16 || TRACE_BUFFER_SIZE > 32768
+#error "TRACE_BUFFER_SIZE must be between 16 and 32768"
+#endif
+
+#if TRACE_MAX_ARGS * 2 > TRACE_RECORD_MAX_PAYLOAD || TRACE_MAX_BYTES > TRACE_RECORD_MAX_PAYLOAD
+#error "TRACE_MAX_ARGS and TRACE_MAX_BYTES are limited to 63 and 127"
+#endif
+
+#define TRACE_CORE_FORMATS(X) \
+    X(TRACE_DROPPED, "trace: %u records dropped\n") \
+    X(TRACE_KEYBOARD_REPORT, "keyboard_report: ") \
+    X(TRACE_MATRIX_ROW, "matrix row %u: %04X\n") \
+    X(TRACE_MATRIX_ROW32, "matrix row %u: %04X%04X\n")
+
+#ifndef TRACE_USER_FORMATS
+#define TRACE_USER_FORMATS(X)
+#endif
+
+#define TRACE_FORMATS(X) TRACE_CORE_FORMATS(X) TRACE_USER_FORMATS(X)
+
+#define TRACE_FORMAT_ID(id, format) id,
+enum trace_format_id {
+    TRACE_FORMATS(TRACE_FORMAT_ID)
+    TRACE_NUM_FORMATS
+};
+#undef TRACE_FORMAT_ID
+
+typedef void (*trace_putc_t)(char c);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void trace_init(void);
+void trace_args(uint8_t id, uint8_t count, const uint16_t* args);
+void trace_data(uint8_t id, const void* data, uint8_t size);
+// Outputs at most one record, or the part of it that fits
+void trace_task(void);
+// Called before a record is output, the protocol says how many characters
+// the console endpoint has room for, so that formatting never waits for
+// the host
+uint8_t trace_output_room(void);
+// The number of records dropped since trace_init
+uint16_t trace_get_dropped(void);
+
+// Formats one record, returns its size, or 0 if it isn't valid
+uint16_t trace_format(const uint8_t* record, uint16_t size, trace_putc_t put);
+// Formats a sequence of records, returns the number of bytes used
+uint16_t trace_decode(const uint8_t* data, uint16_t size, trace_putc_t put);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef TRACE_ENABLE
+#define trace(id, ...) trace_args(id, \
+    sizeof((const uint16_t[]){__VA_ARGS__}) / sizeof(uint16_t), \
+    (const uint16_t[]){__VA_ARGS__})
+#define trace_bytes(id, data, size) trace_data(id, data, size)
+#else
+#define trace(id, ...)
+#define trace_bytes(id, data, size)
+#endif
+
+#endif /* TMK_CORE_COMMON_TRACE_H_ */
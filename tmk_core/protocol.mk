@@ -3,6 +3,7 @@ PROTOCOL_DIR = protocol
 
 ifdef PS2_MOUSE_ENABLE
     SRC += $(PROTOCOL_DIR)/ps2_mouse.c
+    SRC += $(PROTOCOL_DIR)/ps2_mouse_packet.c
     OPT_DEFS += -DPS2_MOUSE_ENABLE
     OPT_DEFS += -DMOUSE_ENABLE
 endif
@@ -26,6 +27,12 @@ ifdef PS2_USE_USART
 endif
 
 
+ifdef CONVERTER_ENGINE_ENABLE
+    SRC += $(PROTOCOL_DIR)/converter_engine.c
+    SRC += $(PROTOCOL_DIR)/converter_decoders.c
+endif
+
+
 ifdef SERIAL_MOUSE_MICROSOFT_ENABLE
     SRC += $(PROTOCOL_DIR)/serial_mouse_microsoft.c
     OPT_DEFS += -DSERIAL_MOUSE_ENABLE -DSERIAL_MOUSE_MICROSOFT \
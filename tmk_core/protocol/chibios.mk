@@ -3,6 +3,7 @@ CHIBIOS_DIR = $(PROTOCOL_DIR)/chibios
 
 
 SRC += $(CHIBIOS_DIR)/usb_main.c
+SRC += $(CHIBIOS_DIR)/report_queue.c
 SRC += $(CHIBIOS_DIR)/main.c
 
 VPATH += $(TMK_PATH)/$(PROTOCOL_DIR)
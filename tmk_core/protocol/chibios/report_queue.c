@@ -0,0 +1,98 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "report_queue.h"
+#include <string.h>
+
+/* Keeps the compiler from moving the report copy past the index update */
+#define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+#define INDEX(i) ((i) & (REPORT_QUEUE_SIZE - 1))
+
+void report_queue_init(report_queue_t *queue, uint8_t report_size, report_queue_coalesce_t coalesce) {
+  queue->head = 0;
+  queue->tail = 0;
+  queue->report_size = report_size;
+  queue->coalesce = coalesce;
+  queue->overflows = 0;
+  queue->coalesced = 0;
+}
+
+uint8_t report_queue_count(report_queue_t *queue) {
+  return (uint8_t)(queue->head - queue->tail);
+}
+
+/* Merges the oldest report that can be into the one before it, to make room */
+static bool report_queue_evict(report_queue_t *queue) {
+  uint8_t head = queue->head;
+  for (uint8_t i = queue->tail; (uint8_t)(head - i) > 1; i++) {
+    if (queue->coalesce(queue->reports[INDEX(i)], queue->reports[INDEX(i + 1)], queue->report_size, true)) {
+      for (i++; (uint8_t)(head - i) > 1; i++) {
+        memcpy(queue->reports[INDEX(i)], queue->reports[INDEX(i + 1)], queue->report_size);
+      }
+      queue->head = head - 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool report_queue_push(report_queue_t *queue, const void *report) {
+  uint8_t head = queue->head;
+  if (queue->coalesce && head != queue->tail &&
+      queue->coalesce(queue->reports[INDEX(head - 1)], report, queue->report_size, false)) {
+    queue->coalesced++;
+    return true;
+  }
+  if ((uint8_t)(head - queue->tail) == REPORT_QUEUE_SIZE) {
+    if (!queue->coalesce || !report_queue_evict(queue)) {
+      queue->overflows++;
+      return false;
+    }
+    queue->coalesced++;
+    head = queue->head;
+  }
+  memcpy(queue->reports[INDEX(head)], report, queue->report_size);
+  COMPILER_BARRIER();
+  queue->head = head + 1;
+  return true;
+}
+
+const uint8_t *report_queue_peek(report_queue_t *queue) {
+  uint8_t tail = queue->tail;
+  if (queue->head == tail) {
+    return NULL;
+  }
+  COMPILER_BARRIER();
+  return queue->reports[INDEX(tail)];
+}
+
+void report_queue_pop(report_queue_t *queue) {
+  uint8_t tail = queue->tail;
+  if (queue->head != tail) {
+    COMPILER_BARRIER();
+    queue->tail = tail + 1;
+  }
+}
+
+void report_queue_clear(report_queue_t *queue) {
+  queue->tail = queue->head;
+}
+
+bool report_queue_same(uint8_t *queued, const uint8_t *report, uint8_t size, bool lossy) {
+  (void)lossy;
+  return memcmp(queued, report, size) == 0;
+}
@@ -0,0 +1,92 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _REPORT_QUEUE_H_
+#define _REPORT_QUEUE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* A FIFO of HID reports waiting for an IN endpoint
+ *
+ * There's a single producer, the main loop, which pushes reports, and a
+ * single consumer, the IN complete callback, which copies the oldest report
+ * to the endpoint's buffer and pops it when it starts the next transfer.
+ *
+ * Every push first tries to coalesce the report into the newest queued one,
+ * which only succeeds when nothing is lost, like for mouse motion. When the
+ * queue is full, the oldest report that can be is merged into the one before
+ * it instead, this time losing precision if it has to, like clamped motion,
+ * but never a state change. Otherwise the push fails, and the caller has to
+ * wait, reports are never dropped.
+ *
+ * Push and pop are lock free without a coalescing function. Coalescing
+ * writes to a slot that the consumer can see, so then pushes have to be
+ * done with the consumer locked out.
+ */
+
+/* Number of reports, must be a power of two */
+#ifndef REPORT_QUEUE_SIZE
+#define REPORT_QUEUE_SIZE 8
+#endif
+
+#ifndef REPORT_QUEUE_MAX_REPORT_SIZE
+#define REPORT_QUEUE_MAX_REPORT_SIZE 32
+#endif
+
+#if (REPORT_QUEUE_SIZE & (REPORT_QUEUE_SIZE - 1)) != 0 || REPORT_QUEUE_SIZE < 2 || REPORT_QUEUE_SIZE > 128
+#error "REPORT_QUEUE_SIZE must be a power of two, between 2 and 128"
+#endif
+
+/* Coalesces report into queued, which is queued before it
+ * lossy is set when the queue is full, then precision can be lost, but never
+ * a state change, returns false, without changing queued, if they can't be
+ * combined */
+typedef bool (*report_queue_coalesce_t)(uint8_t *queued, const uint8_t *report, uint8_t size, bool lossy);
+
+typedef struct {
+  /* only written by the producer */
+  volatile uint8_t head;
+  /* only written by the consumer */
+  volatile uint8_t tail;
+  uint8_t report_size;
+  report_queue_coalesce_t coalesce;
+  /* pushes that failed, because the queue was full */
+  uint16_t overflows;
+  /* reports that were coalesced instead of queued */
+  uint16_t coalesced;
+  uint8_t reports[REPORT_QUEUE_SIZE][REPORT_QUEUE_MAX_REPORT_SIZE];
+} report_queue_t;
+
+/* coalesce can be NULL, which queues every report */
+void report_queue_init(report_queue_t *queue, uint8_t report_size, report_queue_coalesce_t coalesce);
+
+uint8_t report_queue_count(report_queue_t *queue);
+
+/* Producer side, returns false if the queue is full */
+bool report_queue_push(report_queue_t *queue, const void *report);
+
+/* Consumer side, returns the oldest report, or NULL if the queue is empty */
+const uint8_t *report_queue_peek(report_queue_t *queue);
+void report_queue_pop(report_queue_t *queue);
+
+/* Consumer side, drops all queued reports, like on a USB reset */
+void report_queue_clear(report_queue_t *queue);
+
+/* Coalescing function for state reports, which only drops repeated reports */
+bool report_queue_same(uint8_t *queued, const uint8_t *report, uint8_t size, bool lossy);
+
+#endif /* _REPORT_QUEUE_H_ */
@@ -0,0 +1,234 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <thread>
+extern "C" {
+#include "report_queue.h"
+}
+
+static bool coalesce_sum(uint8_t *queued, const uint8_t *report, uint8_t size, bool lossy) {
+    for (uint8_t i = 0; i < size; i++) {
+        queued[i] += report[i];
+    }
+    return true;
+}
+
+static bool coalesce_never(uint8_t *queued, const uint8_t *report, uint8_t size, bool lossy) {
+    return false;
+}
+
+// Like a mouse, buttons and movement, which is only clamped when lossy
+static bool coalesce_motion(uint8_t *queued, const uint8_t *report, uint8_t size, bool lossy) {
+    int sum = (int8_t)queued[1] + (int8_t)report[1];
+    if (queued[0] != report[0] || (!lossy && (sum > 127 || sum < -127))) {
+        return false;
+    }
+    queued[1] = sum > 127 ? 127 : (sum < -127 ? -127 : sum);
+    return true;
+}
+
+class ReportQueue : public testing::Test {
+public:
+    ReportQueue() {
+        report_queue_init(&queue, 2, NULL);
+    }
+
+    void push(uint8_t a, uint8_t b) {
+        uint8_t report[2] = {a, b};
+        report_queue_push(&queue, report);
+    }
+
+    void expect_pop(uint8_t a, uint8_t b) {
+        const uint8_t *report = report_queue_peek(&queue);
+        ASSERT_NE(report, nullptr);
+        EXPECT_EQ(report[0], a);
+        EXPECT_EQ(report[1], b);
+        report_queue_pop(&queue);
+    }
+
+    report_queue_t queue;
+};
+
+TEST_F(ReportQueue, StartsEmpty) {
+    EXPECT_EQ(report_queue_count(&queue), 0);
+    EXPECT_EQ(report_queue_peek(&queue), nullptr);
+}
+
+TEST_F(ReportQueue, ReportsComeOutInOrder) {
+    push(1, 2);
+    push(3, 4);
+    push(5, 6);
+    EXPECT_EQ(report_queue_count(&queue), 3);
+    expect_pop(1, 2);
+    expect_pop(3, 4);
+    expect_pop(5, 6);
+    EXPECT_EQ(report_queue_peek(&queue), nullptr);
+}
+
+TEST_F(ReportQueue, PushCopiesTheReport) {
+    uint8_t report[2] = {1, 2};
+    report_queue_push(&queue, report);
+    report[0] = 7;
+    expect_pop(1, 2);
+}
+
+TEST_F(ReportQueue, PopOnAnEmptyQueueDoesNothing) {
+    report_queue_pop(&queue);
+    EXPECT_EQ(report_queue_count(&queue), 0);
+    push(1, 2);
+    expect_pop(1, 2);
+}
+
+TEST_F(ReportQueue, WrapsAroundManyTimes) {
+    for (int i = 0; i < 1000; i++) {
+        push(i, i >> 8);
+        push(i + 1, 0);
+        expect_pop(i, i >> 8);
+        expect_pop(i + 1, 0);
+    }
+    EXPECT_EQ(queue.overflows, 0);
+}
+
+TEST_F(ReportQueue, DropsWhenFullWithoutCoalescing) {
+    for (int i = 0; i < REPORT_QUEUE_SIZE; i++) {
+        push(i, 0);
+    }
+    uint8_t report[2] = {100, 0};
+    EXPECT_FALSE(report_queue_push(&queue, report));
+    EXPECT_EQ(queue.overflows, 1);
+    EXPECT_EQ(queue.coalesced, 0);
+    for (int i = 0; i < REPORT_QUEUE_SIZE; i++) {
+        expect_pop(i, 0);
+    }
+    EXPECT_EQ(report_queue_peek(&queue), nullptr);
+}
+
+TEST_F(ReportQueue, CoalescesIntoTheNewestReport) {
+    report_queue_init(&queue, 2, coalesce_sum);
+    push(1, 1);
+    push(2, 3);
+    push(4, 5);
+    EXPECT_EQ(report_queue_count(&queue), 1);
+    EXPECT_EQ(queue.coalesced, 2);
+    expect_pop(7, 9);
+    EXPECT_EQ(report_queue_peek(&queue), nullptr);
+}
+
+TEST_F(ReportQueue, OnlyRepeatedStateReportsAreCoalesced) {
+    report_queue_init(&queue, 2, report_queue_same);
+    // A tap, pressed and released while the endpoint is busy
+    push(0, 4);
+    push(0, 4);
+    push(0, 0);
+    push(0, 4);
+    EXPECT_EQ(queue.coalesced, 1);
+    expect_pop(0, 4);
+    expect_pop(0, 0);
+    expect_pop(0, 4);
+    EXPECT_EQ(report_queue_peek(&queue), nullptr);
+}
+
+TEST_F(ReportQueue, MotionIsMergedUntilTheButtonsChange) {
+    report_queue_init(&queue, 2, coalesce_motion);
+    push(0, 10);
+    push(0, 20);
+    push(1, 0);
+    push(1, 5);
+    push(0, 0);
+    expect_pop(0, 30);
+    expect_pop(1, 5);
+    expect_pop(0, 0);
+    EXPECT_EQ(report_queue_peek(&queue), nullptr);
+}
+
+TEST_F(ReportQueue, EvictsAnOlderMotionReportWhenFull) {
+    report_queue_init(&queue, 2, coalesce_motion);
+    // Fast motion that doesn't fit in one report, and then button changes
+    push(0, 100);
+    push(0, 100);
+    for (int i = 3; i <= REPORT_QUEUE_SIZE; i++) {
+        push(i & 1, 0);
+    }
+    EXPECT_EQ(report_queue_count(&queue), REPORT_QUEUE_SIZE);
+    uint8_t report[2] = {(REPORT_QUEUE_SIZE + 1) & 1, 0};
+    EXPECT_TRUE(report_queue_push(&queue, report));
+    EXPECT_EQ(queue.overflows, 0);
+    // The motion is clamped, but no button change is lost
+    expect_pop(0, 127);
+    for (int i = 3; i <= REPORT_QUEUE_SIZE + 1; i++) {
+        expect_pop(i & 1, 0);
+    }
+    EXPECT_EQ(report_queue_peek(&queue), nullptr);
+}
+
+TEST_F(ReportQueue, FailsWhenFullOfStateChanges) {
+    report_queue_init(&queue, 2, coalesce_motion);
+    for (int i = 0; i < REPORT_QUEUE_SIZE; i++) {
+        push(i & 1, 1);
+    }
+    uint8_t report[2] = {REPORT_QUEUE_SIZE & 1, 1};
+    EXPECT_FALSE(report_queue_push(&queue, report));
+    EXPECT_EQ(queue.overflows, 1);
+    for (int i = 0; i < REPORT_QUEUE_SIZE; i++) {
+        expect_pop(i & 1, 1);
+    }
+}
+
+TEST_F(ReportQueue, DropsWhenTheReportsCantBeCoalesced) {
+    report_queue_init(&queue, 2, coalesce_never);
+    for (int i = 0; i < REPORT_QUEUE_SIZE; i++) {
+        push(1, 1);
+    }
+    uint8_t report[2] = {2, 2};
+    EXPECT_FALSE(report_queue_push(&queue, report));
+    EXPECT_EQ(queue.overflows, 1);
+    EXPECT_EQ(queue.coalesced, 0);
+}
+
+TEST_F(ReportQueue, ClearEmptiesTheQueue) {
+    push(1, 2);
+    push(3, 4);
+    report_queue_clear(&queue);
+    EXPECT_EQ(report_queue_count(&queue), 0);
+    EXPECT_EQ(report_queue_peek(&queue), nullptr);
+    push(5, 6);
+    expect_pop(5, 6);
+}
+
+TEST_F(ReportQueue, WorksWithConcurrentProducerAndConsumer) {
+    const int num_reports = 100000;
+    std::thread consumer([this]() {
+        for (int i = 0; i < num_reports; i++) {
+            const uint8_t *report;
+            while ((report = report_queue_peek(&queue)) == nullptr) {
+                std::this_thread::yield();
+            }
+            ASSERT_EQ(report[0], (uint8_t)i);
+            ASSERT_EQ(report[1], (uint8_t)(i >> 8));
+            report_queue_pop(&queue);
+        }
+    });
+    for (int i = 0; i < num_reports; i++) {
+        uint8_t report[2] = {(uint8_t)i, (uint8_t)(i >> 8)};
+        while (report_queue_count(&queue) == REPORT_QUEUE_SIZE) {
+            std::this_thread::yield();
+        }
+        EXPECT_TRUE(report_queue_push(&queue, report));
+    }
+    consumer.join();
+    EXPECT_EQ(queue.overflows, 0);
+}
@@ -0,0 +1,4 @@
+report_queue_SRC :=\
+	$(TMK_PATH)/protocol/chibios/tests/report_queue_tests.cpp \
+	$(TMK_PATH)/protocol/chibios/report_queue.c
+report_queue_INC := $(TMK_PATH)/protocol/chibios
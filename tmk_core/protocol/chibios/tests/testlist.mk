@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	report_queue
@@ -15,6 +15,8 @@
  * GPL v2 or later.
  */
 
+#include <string.h>
+
 #include "ch.h"
 #include "hal.h"
 
@@ -28,6 +30,10 @@
 #include "led.h"
 #endif
 
+#ifdef STENO_HID_ENABLE
+#include "steno_hid.h"
+#endif
+
 #ifdef NKRO_ENABLE
   #include "keycode_config.h"
 
@@ -47,6 +53,31 @@ static virtual_timer_t keyboard_idle_timer;
 static void keyboard_idle_timer_cb(void *arg);
 
 report_keyboard_t keyboard_report_sent = {{0}};
+
+/* Reports wait in a queue until their endpoint is free, instead of
+ * suspending the main loop until the previous transfer is done */
+typedef struct {
+  report_queue_t queue;
+  usbep_t ep;
+  /* the number of bytes sent for each report */
+  uint8_t transfer_size;
+  /* the report being transmitted, so that the queue slot can be reused */
+  uint8_t buffer[REPORT_QUEUE_MAX_REPORT_SIZE];
+} report_endpoint_t;
+
+static report_endpoint_t kbd_report_endpoint;
+#ifdef NKRO_ENABLE
+static report_endpoint_t nkro_report_endpoint;
+#endif /* NKRO_ENABLE */
+#ifdef STENO_HID_ENABLE
+static report_endpoint_t steno_report_endpoint;
+#endif /* STENO_HID_ENABLE */
+#ifdef MOUSE_ENABLE
+static report_endpoint_t mouse_report_endpoint;
+#endif /* MOUSE_ENABLE */
+#ifdef EXTRAKEY_ENABLE
+static report_endpoint_t extra_report_endpoint;
+#endif /* EXTRAKEY_ENABLE */
 #ifdef MOUSE_ENABLE
 report_mouse_t mouse_report_blank = {0};
 #endif /* MOUSE_ENABLE */
@@ -192,6 +223,30 @@ static const USBDescriptor nkro_hid_report_descriptor = {
 };
 #endif /* NKRO_ENABLE */
 
+#ifdef STENO_HID_ENABLE
+/* Plover HID, one bit per steno key after the report id */
+static const uint8_t steno_hid_report_desc_data[] = {
+  0x06, STENO_HID_USAGE_PAGE & 0xFF, STENO_HID_USAGE_PAGE >> 8, // Usage Page (Vendor Defined),
+  0x0A, STENO_HID_USAGE & 0xFF, STENO_HID_USAGE >> 8, // Usage (Vendor Defined),
+  0xA1, 0x01,                           // Collection (Application),
+  0x85, STENO_HID_REPORT_ID,            //   Report ID (),
+  0x05, 0x09,                           //   Usage Page (Button),
+  0x19, 0x01,                           //   Usage Minimum (1),
+  0x29, STENO_HID_KEY_COUNT,            //   Usage Maximum (),
+  0x15, 0x00,                           //   Logical Minimum (0),
+  0x25, 0x01,                           //   Logical Maximum (1),
+  0x75, 0x01,                           //   Report Size (1),
+  0x95, STENO_HID_KEY_COUNT,            //   Report Count (),
+  0x81, 0x02,                           //   Input (Data, Variable, Absolute),
+  0xc0                                  // End Collection
+};
+/* wrapper */
+static const USBDescriptor steno_hid_report_descriptor = {
+  sizeof steno_hid_report_desc_data,
+  steno_hid_report_desc_data
+};
+#endif /* STENO_HID_ENABLE */
+
 #ifdef MOUSE_ENABLE
 /* Mouse Protocol 1, HID 1.11 spec, Appendix B, page 59-60, with wheel extension
  * http://www.microchip.com/forums/tm.aspx?high=&m=391435&mpage=1#391521
@@ -352,7 +407,14 @@ static const USBDescriptor extra_hid_report_descriptor = {
 #   define NKRO_HID_DESC_NUM            (EXTRA_HID_DESC_NUM + 0)
 #endif /* NKRO_ENABLE */
 
-#define NUM_INTERFACES                  (NKRO_HID_DESC_NUM + 1)
+#ifdef STENO_HID_ENABLE
+#   define STENO_HID_DESC_NUM           (NKRO_HID_DESC_NUM + 1)
+#   define STENO_HID_DESC_OFFSET        (9 + (9 + 9 + 7) * NKRO_HID_DESC_NUM + 9)
+#else /* STENO_HID_ENABLE */
+#   define STENO_HID_DESC_NUM           (NKRO_HID_DESC_NUM + 0)
+#endif /* STENO_HID_ENABLE */
+
+#define NUM_INTERFACES                  (STENO_HID_DESC_NUM + 1)
 #define CONFIG1_DESC_SIZE               (9 + (9 + 9 + 7) * NUM_INTERFACES)
 
 static const uint8_t hid_configuration_descriptor_data[] = {
@@ -386,7 +448,7 @@ static const uint8_t hid_configuration_descriptor_data[] = {
   USB_DESC_ENDPOINT(KBD_ENDPOINT | 0x80,  // bEndpointAddress
                     0x03,      // bmAttributes (Interrupt)
                     KBD_EPSIZE,// wMaxPacketSize
-                    10),       // bInterval
+                    KEYBOARD_POLLING_BINTERVAL), // bInterval
 
   #ifdef MOUSE_ENABLE
   /* Interface Descriptor (9 bytes) USB spec 9.6.5, page 267-269, Table 9-12 */
@@ -416,7 +478,7 @@ static const uint8_t hid_configuration_descriptor_data[] = {
   USB_DESC_ENDPOINT(MOUSE_ENDPOINT | 0x80,  // bEndpointAddress
                     0x03,      // bmAttributes (Interrupt)
                     MOUSE_EPSIZE,  // wMaxPacketSize
-                    1),        // bInterval
+                    MOUSE_POLLING_BINTERVAL), // bInterval
   #endif /* MOUSE_ENABLE */
 
   #ifdef CONSOLE_ENABLE
@@ -468,7 +530,7 @@ static const uint8_t hid_configuration_descriptor_data[] = {
   USB_DESC_ENDPOINT(EXTRA_ENDPOINT | 0x80,  // bEndpointAddress
                     0x03,      // bmAttributes (Interrupt)
                     EXTRA_EPSIZE, // wMaxPacketSize
-                    10),       // bInterval
+                    EXTRAKEY_POLLING_BINTERVAL), // bInterval
   #endif /* EXTRAKEY_ENABLE */
 
   #ifdef NKRO_ENABLE
@@ -494,8 +556,34 @@ static const uint8_t hid_configuration_descriptor_data[] = {
   USB_DESC_ENDPOINT(NKRO_ENDPOINT | 0x80,  // bEndpointAddress
                     0x03,      // bmAttributes (Interrupt)
                     NKRO_EPSIZE, // wMaxPacketSize
-                    1),       // bInterval
+                    NKRO_POLLING_BINTERVAL), // bInterval
   #endif /* NKRO_ENABLE */
+
+  #ifdef STENO_HID_ENABLE
+  /* Interface Descriptor (9 bytes) USB spec 9.6.5, page 267-269, Table 9-12 */
+  USB_DESC_INTERFACE(STENO_INTERFACE, // bInterfaceNumber
+                     0,        // bAlternateSetting
+                     1,        // bNumEndpoints
+                     0x03,     // bInterfaceClass: HID
+                     0x00,     // bInterfaceSubClass: None
+                     0x00,     // bInterfaceProtocol: None
+                     0),       // iInterface
+
+  /* HID descriptor (9 bytes) HID 1.11 spec, section 6.2.1 */
+  USB_DESC_BYTE(9),            // bLength
+  USB_DESC_BYTE(0x21),         // bDescriptorType (HID class)
+  USB_DESC_BCD(0x0111),        // bcdHID: HID version 1.11
+  USB_DESC_BYTE(0),            // bCountryCode
+  USB_DESC_BYTE(1),            // bNumDescriptors
+  USB_DESC_BYTE(0x22),         // bDescriptorType (report desc)
+  USB_DESC_WORD(sizeof(steno_hid_report_desc_data)), // wDescriptorLength
+
+  /* Endpoint Descriptor (7 bytes) USB spec 9.6.6, page 269-271, Table 9-13 */
+  USB_DESC_ENDPOINT(STENO_ENDPOINT | 0x80,  // bEndpointAddress
+                    0x03,      // bmAttributes (Interrupt)
+                    STENO_EPSIZE, // wMaxPacketSize
+                    STENO_POLLING_BINTERVAL), // bInterval
+  #endif /* STENO_HID_ENABLE */
 };
 
 /* Configuration Descriptor wrapper */
@@ -534,6 +622,12 @@ static const USBDescriptor nkro_hid_descriptor = {
   &hid_configuration_descriptor_data[NKRO_HID_DESC_OFFSET]
 };
 #endif /* NKRO_ENABLE */
+#ifdef STENO_HID_ENABLE
+static const USBDescriptor steno_hid_descriptor = {
+  HID_DESCRIPTOR_SIZE,
+  &hid_configuration_descriptor_data[STENO_HID_DESC_OFFSET]
+};
+#endif /* STENO_HID_ENABLE */
 
 
 /* U.S. English language identifier */
@@ -640,6 +734,10 @@ static const USBDescriptor *usb_get_descriptor_cb(USBDriver *usbp, uint8_t dtype
     case NKRO_INTERFACE:
       return &nkro_hid_descriptor;
 #endif /* NKRO_ENABLE */
+#ifdef STENO_HID_ENABLE
+    case STENO_INTERFACE:
+      return &steno_hid_descriptor;
+#endif /* STENO_HID_ENABLE */
     }
 
   case USB_DESCRIPTOR_HID_REPORT:       /* HID Report Descriptor */
@@ -663,6 +761,10 @@ static const USBDescriptor *usb_get_descriptor_cb(USBDriver *usbp, uint8_t dtype
     case NKRO_INTERFACE:
       return &nkro_hid_report_descriptor;
 #endif /* NKRO_ENABLE */
+#ifdef STENO_HID_ENABLE
+    case STENO_INTERFACE:
+      return &steno_hid_report_descriptor;
+#endif /* STENO_HID_ENABLE */
     }
   }
   return NULL;
@@ -760,17 +862,57 @@ static const USBEndpointConfig nkro_ep_config = {
 };
 #endif /* NKRO_ENABLE */
 
+#ifdef STENO_HID_ENABLE
+/* steno endpoint state structure */
+static USBInEndpointState steno_ep_state;
+
+/* steno endpoint initialization structure (IN) */
+static const USBEndpointConfig steno_ep_config = {
+  USB_EP_MODE_TYPE_INTR,        /* Interrupt EP */
+  NULL,                         /* SETUP packet notification callback */
+  steno_in_cb,                  /* IN notification callback */
+  NULL,                         /* OUT notification callback */
+  STENO_EPSIZE,                 /* IN maximum packet size */
+  0,                            /* OUT maximum packet size */
+  &steno_ep_state,              /* IN Endpoint state */
+  NULL,                         /* OUT endpoint state */
+  2,                            /* IN multiplier */
+  NULL                          /* SETUP buffer (not a SETUP endpoint) */
+};
+#endif /* STENO_HID_ENABLE */
+
 /* ---------------------------------------------------------
  *                  USB driver functions
  * ---------------------------------------------------------
  */
 
+/* drops the reports queued for the previous configuration
+ * called in locked state, from the USB event callback */
+static void report_endpoints_clearI(void) {
+  report_queue_clear(&kbd_report_endpoint.queue);
+#ifdef NKRO_ENABLE
+  report_queue_clear(&nkro_report_endpoint.queue);
+#endif /* NKRO_ENABLE */
+#ifdef STENO_HID_ENABLE
+  report_queue_clear(&steno_report_endpoint.queue);
+#endif /* STENO_HID_ENABLE */
+#ifdef MOUSE_ENABLE
+  report_queue_clear(&mouse_report_endpoint.queue);
+#endif /* MOUSE_ENABLE */
+#ifdef EXTRAKEY_ENABLE
+  report_queue_clear(&extra_report_endpoint.queue);
+#endif /* EXTRAKEY_ENABLE */
+}
+
 /* Handles the USB driver global events
  * TODO: maybe disable some things when connection is lost? */
 static void usb_event_cb(USBDriver *usbp, usbevent_t event) {
   switch(event) {
   case USB_EVENT_RESET:
     //TODO: from ISR! print("[R]");
+    osalSysLockFromISR();
+    report_endpoints_clearI();
+    osalSysUnlockFromISR();
     return;
 
   case USB_EVENT_ADDRESS:
@@ -778,6 +920,7 @@ static void usb_event_cb(USBDriver *usbp, usbevent_t event) {
 
   case USB_EVENT_CONFIGURED:
     osalSysLockFromISR();
+    report_endpoints_clearI();
     /* Enable the endpoints specified into the configuration. */
     usbInitEndpointI(usbp, KBD_ENDPOINT, &kbd_ep_config);
 #ifdef MOUSE_ENABLE
@@ -793,6 +936,9 @@ static void usb_event_cb(USBDriver *usbp, usbevent_t event) {
 #ifdef NKRO_ENABLE
     usbInitEndpointI(usbp, NKRO_ENDPOINT, &nkro_ep_config);
 #endif /* NKRO_ENABLE */
+#ifdef STENO_HID_ENABLE
+    usbInitEndpointI(usbp, STENO_ENDPOINT, &steno_ep_config);
+#endif /* STENO_HID_ENABLE */
     osalSysUnlockFromISR();
     return;
 
@@ -1010,7 +1156,105 @@ static const USBConfig usbcfg = {
 /*
  * Initialize the USB driver
  */
+static void report_endpoint_init(report_endpoint_t *endpoint, usbep_t ep,
+  uint8_t report_size, uint8_t transfer_size, report_queue_coalesce_t coalesce) {
+  report_queue_init(&endpoint->queue, report_size, coalesce);
+  endpoint->ep = ep;
+  endpoint->transfer_size = transfer_size;
+}
+
+/* Starts sending the oldest queued report, if the endpoint is free
+ * called in locked state, from both the main loop and the IN callbacks */
+static void report_endpoint_start_nextI(USBDriver *usbp, report_endpoint_t *endpoint) {
+  const uint8_t *report;
+  if(usbGetDriverStateI(usbp) != USB_ACTIVE || usbGetTransmitStatusI(usbp, endpoint->ep)) {
+    return;
+  }
+  report = report_queue_peek(&endpoint->queue);
+  if(report) {
+    memcpy(endpoint->buffer, report, endpoint->queue.report_size);
+    report_queue_pop(&endpoint->queue);
+    usbStartTransmitI(usbp, endpoint->ep, endpoint->buffer, endpoint->transfer_size);
+  }
+}
+
+/* queues a report, and starts sending it if the endpoint is free
+ * a full queue only holds state changes, so then this waits for the endpoint
+ * to take one, like sending did before the queue
+ * Note: for suspend, need USB_USE_WAIT == TRUE in halconf.h
+ * not callable from ISR or locked state */
+static void report_endpoint_send(report_endpoint_t *endpoint, const void *report) {
+  osalSysLock();
+  while(usbGetDriverStateI(&USB_DRIVER) == USB_ACTIVE) {
+    if(report_queue_push(&endpoint->queue, report)) {
+      report_endpoint_start_nextI(&USB_DRIVER, endpoint);
+      break;
+    }
+    /* a full queue means that the endpoint is busy */
+    osalThreadSuspendS(&(&USB_DRIVER)->epc[endpoint->ep]->in_state->thread);
+  }
+  osalSysUnlock();
+}
+
+report_queue_t *usb_get_report_queue(usbep_t ep) {
+  if(ep == KBD_ENDPOINT) return &kbd_report_endpoint.queue;
+#ifdef NKRO_ENABLE
+  if(ep == NKRO_ENDPOINT) return &nkro_report_endpoint.queue;
+#endif /* NKRO_ENABLE */
+#ifdef STENO_HID_ENABLE
+  if(ep == STENO_ENDPOINT) return &steno_report_endpoint.queue;
+#endif /* STENO_HID_ENABLE */
+#ifdef MOUSE_ENABLE
+  if(ep == MOUSE_ENDPOINT) return &mouse_report_endpoint.queue;
+#endif /* MOUSE_ENABLE */
+#ifdef EXTRAKEY_ENABLE
+  if(ep == EXTRA_ENDPOINT) return &extra_report_endpoint.queue;
+#endif /* EXTRAKEY_ENABLE */
+  return NULL;
+}
+
+#ifdef MOUSE_ENABLE
+static int8_t add_clamped(int8_t a, int8_t b) {
+  int16_t sum = a + b;
+  return sum > 127 ? 127 : (sum < -127 ? -127 : sum);
+}
+
+static bool fits(int8_t a, int8_t b) {
+  return add_clamped(a, b) == a + b;
+}
+
+/* the movement is accumulated, but button changes can't be merged
+ * it's only clamped when the queue is full */
+static bool coalesce_mouse_report(uint8_t *queued, const uint8_t *report, uint8_t size, bool lossy) {
+  report_mouse_t *q = (report_mouse_t *)queued;
+  const report_mouse_t *r = (const report_mouse_t *)report;
+  (void)size;
+  if(q->buttons != r->buttons) return false;
+  if(!lossy && !(fits(q->x, r->x) && fits(q->y, r->y) && fits(q->v, r->v) && fits(q->h, r->h))) return false;
+  q->x = add_clamped(q->x, r->x);
+  q->y = add_clamped(q->y, r->y);
+  q->v = add_clamped(q->v, r->v);
+  q->h = add_clamped(q->h, r->h);
+  return true;
+}
+#endif /* MOUSE_ENABLE */
+
 void init_usb_driver(USBDriver *usbp) {
+  report_endpoint_init(&kbd_report_endpoint, KBD_ENDPOINT, sizeof(report_keyboard_t), KBD_EPSIZE, report_queue_same);
+#ifdef NKRO_ENABLE
+  report_endpoint_init(&nkro_report_endpoint, NKRO_ENDPOINT, sizeof(report_keyboard_t), sizeof(report_keyboard_t), report_queue_same);
+#endif /* NKRO_ENABLE */
+#ifdef STENO_HID_ENABLE
+  /* every stroke has to arrive, so nothing is coalesced */
+  report_endpoint_init(&steno_report_endpoint, STENO_ENDPOINT, STENO_HID_REPORT_SIZE, STENO_HID_REPORT_SIZE, NULL);
+#endif /* STENO_HID_ENABLE */
+#ifdef MOUSE_ENABLE
+  report_endpoint_init(&mouse_report_endpoint, MOUSE_ENDPOINT, sizeof(report_mouse_t), sizeof(report_mouse_t), coalesce_mouse_report);
+#endif /* MOUSE_ENABLE */
+#ifdef EXTRAKEY_ENABLE
+  report_endpoint_init(&extra_report_endpoint, EXTRA_ENDPOINT, sizeof(report_extra_t), sizeof(report_extra_t), report_queue_same);
+#endif /* EXTRAKEY_ENABLE */
+
   /*
    * Activates the USB driver and then the USB bus pull-up on D+.
    * Note, a delay is inserted in order to not have to disconnect the cable
@@ -1056,20 +1300,44 @@ void send_remote_wakeup(USBDriver *usbp) {
 
 /* keyboard IN callback hander (a kbd report has made it IN) */
 void kbd_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
   (void)ep;
+  osalSysLockFromISR();
+  report_endpoint_start_nextI(usbp, &kbd_report_endpoint);
+  osalSysUnlockFromISR();
 }
 
 #ifdef NKRO_ENABLE
 /* nkro IN callback hander (a nkro report has made it IN) */
 void nkro_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
   (void)ep;
+  osalSysLockFromISR();
+  report_endpoint_start_nextI(usbp, &nkro_report_endpoint);
+  osalSysUnlockFromISR();
 }
 #endif /* NKRO_ENABLE */
 
+#ifdef STENO_HID_ENABLE
+/* steno IN callback hander (a steno report has made it IN) */
+void steno_in_cb(USBDriver *usbp, usbep_t ep) {
+  (void)ep;
+  osalSysLockFromISR();
+  report_endpoint_start_nextI(usbp, &steno_report_endpoint);
+  osalSysUnlockFromISR();
+}
+
+/* a full queue leaves the stroke with the caller, to try again later */
+bool steno_hid_try_send(const uint8_t *report) {
+  bool queued = false;
+  osalSysLock();
+  if(usbGetDriverStateI(&USB_DRIVER) == USB_ACTIVE) {
+    queued = report_queue_push(&steno_report_endpoint.queue, report);
+    report_endpoint_start_nextI(&USB_DRIVER, &steno_report_endpoint);
+  }
+  osalSysUnlock();
+  return queued;
+}
+#endif /* STENO_HID_ENABLE */
+
 /* start-of-frame handler
  * TODO: i guess it would be better to re-implement using timers,
  *  so that this is not going to have to be checked every 1ms */
@@ -1114,48 +1382,16 @@ uint8_t keyboard_leds(void) {
   return (uint8_t)(keyboard_led_stats & 0xFF);
 }
 
-/* prepare and start sending a report IN
+/* queue a report, it's sent as soon as the endpoint is free
  * not callable from ISR or locked state */
 void send_keyboard(report_keyboard_t *report) {
-  osalSysLock();
-  if(usbGetDriverStateI(&USB_DRIVER) != USB_ACTIVE) {
-    osalSysUnlock();
-    return;
-  }
-  osalSysUnlock();
-
 #ifdef NKRO_ENABLE
   if(keymap_config.nkro) {  /* NKRO protocol */
-    /* need to wait until the previous packet has made it through */
-    /* can rewrite this using the synchronous API, then would wait
-     * until *after* the packet has been transmitted. I think
-     * this is more efficient */
-    /* busy wait, should be short and not very common */
-    osalSysLock();
-    if(usbGetTransmitStatusI(&USB_DRIVER, NKRO_ENDPOINT)) {
-      /* Need to either suspend, or loop and call unlock/lock during
-       * every iteration - otherwise the system will remain locked,
-       * no interrupts served, so USB not going through as well.
-       * Note: for suspend, need USB_USE_WAIT == TRUE in halconf.h */
-      osalThreadSuspendS(&(&USB_DRIVER)->epc[NKRO_ENDPOINT]->in_state->thread);
-    }
-    usbStartTransmitI(&USB_DRIVER, NKRO_ENDPOINT, (uint8_t *)report, sizeof(report_keyboard_t));
-    osalSysUnlock();
+    report_endpoint_send(&nkro_report_endpoint, report);
   } else
 #endif /* NKRO_ENABLE */
   { /* boot protocol */
-    /* need to wait until the previous packet has made it through */
-    /* busy wait, should be short and not very common */
-    osalSysLock();
-    if(usbGetTransmitStatusI(&USB_DRIVER, KBD_ENDPOINT)) {
-      /* Need to either suspend, or loop and call unlock/lock during
-       * every iteration - otherwise the system will remain locked,
-       * no interrupts served, so USB not going through as well.
-       * Note: for suspend, need USB_USE_WAIT == TRUE in halconf.h */
-      osalThreadSuspendS(&(&USB_DRIVER)->epc[KBD_ENDPOINT]->in_state->thread);
-    }
-    usbStartTransmitI(&USB_DRIVER, KBD_ENDPOINT, (uint8_t *)report, KBD_EPSIZE);
-    osalSysUnlock();
+    report_endpoint_send(&kbd_report_endpoint, report);
   }
   keyboard_report_sent = *report;
 }
@@ -1169,26 +1405,14 @@ void send_keyboard(report_keyboard_t *report) {
 
 /* mouse IN callback hander (a mouse report has made it IN) */
 void mouse_in_cb(USBDriver *usbp, usbep_t ep) {
-  (void)usbp;
   (void)ep;
+  osalSysLockFromISR();
+  report_endpoint_start_nextI(usbp, &mouse_report_endpoint);
+  osalSysUnlockFromISR();
 }
 
 void send_mouse(report_mouse_t *report) {
-  osalSysLock();
-  if(usbGetDriverStateI(&USB_DRIVER) != USB_ACTIVE) {
-    osalSysUnlock();
-    return;
-  }
-  osalSysUnlock();
-
-  /* TODO: LUFA manually waits for the endpoint to become ready
-   * for about 10ms for mouse, kbd, system; 1ms for nkro
-   * is this really needed?
-   */
-
-  osalSysLock();
-  usbStartTransmitI(&USB_DRIVER, MOUSE_ENDPOINT, (uint8_t *)report, sizeof(report_mouse_t));
-  osalSysUnlock();
+  report_endpoint_send(&mouse_report_endpoint, report);
 }
 
 #else /* MOUSE_ENABLE */
@@ -1206,25 +1430,19 @@ void send_mouse(report_mouse_t *report) {
 
 /* extrakey IN callback hander */
 void extra_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
   (void)ep;
+  osalSysLockFromISR();
+  report_endpoint_start_nextI(usbp, &extra_report_endpoint);
+  osalSysUnlockFromISR();
 }
 
 static void send_extra_report(uint8_t report_id, uint16_t data) {
-  osalSysLock();
-  if(usbGetDriverStateI(&USB_DRIVER) != USB_ACTIVE) {
-    osalSysUnlock();
-    return;
-  }
-
   report_extra_t report = {
     .report_id = report_id,
     .usage = data
   };
 
-  usbStartTransmitI(&USB_DRIVER, EXTRA_ENDPOINT, (uint8_t *)&report, sizeof(report_extra_t));
-  osalSysUnlock();
+  report_endpoint_send(&extra_report_endpoint, &report);
 }
 
 void send_system(uint16_t data) {
@@ -25,6 +25,9 @@
 #include "ch.h"
 #include "hal.h"
 
+#include "report_queue.h"
+#include "usb_polling.h"
+
 /* -------------------------
  * General USB driver header
  * -------------------------
@@ -39,6 +42,10 @@ void init_usb_driver(USBDriver *usbp);
 /* Send remote wakeup packet */
 void send_remote_wakeup(USBDriver *usbp);
 
+/* The report queue of an IN endpoint, for checking the overflow counters
+ * returns NULL for endpoints without one */
+report_queue_t *usb_get_report_queue(usbep_t ep);
+
 /* ---------------
  * Keyboard header
  * ---------------
@@ -71,6 +78,22 @@ void kbd_sof_cb(USBDriver *usbp);
 void nkro_in_cb(USBDriver *usbp, usbep_t ep);
 #endif /* NKRO_ENABLE */
 
+/* ------------
+ * Steno header
+ * ------------
+ */
+
+#ifdef STENO_HID_ENABLE
+
+#define STENO_INTERFACE         5
+#define STENO_ENDPOINT          6
+#define STENO_EPSIZE            16
+
+/* steno IN callback hander */
+void steno_in_cb(USBDriver *usbp, usbep_t ep);
+
+#endif /* STENO_HID_ENABLE */
+
 /* ------------
  * Mouse header
  * ------------
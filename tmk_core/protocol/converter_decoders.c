@@ -0,0 +1,166 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "converter_decoders.h"
+#include "next_kbd.h"
+#include "progmem.h"
+
+#define RULE_COUNT(rules)   (sizeof(rules) / sizeof((rules)[0]))
+
+
+/* PS/2 Scan Code Set 2 */
+static const converter_rule_t ps2_set2_rules[] PROGMEM = {
+    { 0x00, CONVERTER_NONE },       // key detection error or overrun
+    { 0x84, CONVERTER_KEY, CONVERTER_PS2_PRINT_SCREEN },   // Alt'd PrintScreen
+    { 0xAA, CONVERTER_NONE },       // self test passed
+    { 0xE0, CONVERTER_EXTEND },
+    // Pause: E1 14 77 E1 F0 14 F0 77, there is no break code
+    { 0xE1, CONVERTER_TAP, CONVERTER_PS2_PAUSE, 7 },
+    { 0xF0, CONVERTER_BREAK },
+    { 0xFA, CONVERTER_NONE },       // acknowledge
+    { 0xFC, CONVERTER_NONE },       // self test failed
+    { 0xFE, CONVERTER_NONE },       // resend
+    { 0xFF, CONVERTER_NONE },       // key detection error or overrun
+};
+
+static const converter_rule_t ps2_set2_extend_rules[] PROGMEM = {
+    // fake shifts around the navigation keys
+    { 0x12, CONVERTER_NONE },
+    { 0x59, CONVERTER_NONE },
+    // Ctrl'd Pause
+    { 0x7E, CONVERTER_KEY, CONVERTER_PS2_PAUSE },
+};
+
+const converter_decoder_t converter_ps2_set2 = {
+    .code_count = 0x84,
+    .extend_offset = 0x80,
+    .rule_count = RULE_COUNT(ps2_set2_rules),
+    .extend_rule_count = RULE_COUNT(ps2_set2_extend_rules),
+    .rules = ps2_set2_rules,
+    .extend_rules = ps2_set2_extend_rules,
+};
+
+
+/* PS/2 Scan Code Set 3, make/break mode */
+static const converter_rule_t ps2_set3_rules[] PROGMEM = {
+    { 0x00, CONVERTER_NONE },
+    { 0xF0, CONVERTER_BREAK },
+};
+
+const converter_decoder_t converter_ps2_set3 = {
+    .code_count = 0x88,
+    .rule_count = RULE_COUNT(ps2_set3_rules),
+    .rules = ps2_set3_rules,
+};
+
+
+/* ADB, the power key is 0x7F and 0xFF */
+const converter_decoder_t converter_adb = {
+    .break_bit = 0x80,
+    .code_count = 0x80,
+};
+
+void converter_adb_put(converter_t *conv, uint16_t codes)
+{
+    uint8_t key0 = codes >> 8;
+    uint8_t key1 = codes & 0xFF;
+
+    if (codes == 0) {
+        // no data
+        return;
+    }
+    converter_put(conv, key0);
+    // 0xFF is no key, except for the power key release 0xFFFF
+    if (key1 != 0xFF) {
+        converter_put(conv, key1);
+    }
+}
+
+
+/* IBM 4704 */
+const converter_decoder_t converter_ibm4704 = {
+    .break_bit = 0x80,
+    .code_count = 0x80,
+};
+
+
+/* M0110, keypad keys at 0x40 and calculator keys at 0x60 */
+static const converter_rule_t m0110_rules[] PROGMEM = {
+    { 0x7B, CONVERTER_NONE },       // M0110_NULL
+    { 0xFF, CONVERTER_NONE },       // M0110_ERROR
+};
+
+const converter_decoder_t converter_m0110 = {
+    .break_bit = 0x80,
+    .code_count = 0x80,
+    .rule_count = RULE_COUNT(m0110_rules),
+    .rules = m0110_rules,
+};
+
+
+/* NeXT */
+const converter_decoder_t converter_next = {
+    .break_bit = 0x80,
+    .code_count = 0x80,
+};
+
+void converter_next_put(converter_t *conv, uint32_t response)
+{
+    static const uint32_t modifiers[] = {
+        NEXT_KBD_LCTRL_MASK,
+        NEXT_KBD_LSHIFT_MASK,
+        NEXT_KBD_RSHIFT_MASK,
+        NEXT_KBD_LCMD_MASK,
+        NEXT_KBD_RCMD_MASK,
+        NEXT_KBD_LALT_MASK,
+        NEXT_KBD_RALT_MASK,
+    };
+
+    if (response == 0 || response == NEXT_KBD_KMBUS_IDLE) {
+        return;
+    }
+    // the engine skips the modifiers that didn't change
+    for (uint8_t i = 0; i < RULE_COUNT(modifiers); i++) {
+        converter_put(conv, (CONVERTER_NEXT_MODIFIERS + i) | ((response & modifiers[i]) ? 0 : 0x80));
+    }
+    uint8_t key = NEXT_KBD_KEYCODE(response);
+    if (key) {
+        converter_put(conv, key | (NEXT_KBD_PRESSED_KEYCODE(response) ? 0 : 0x80));
+    }
+}
+
+
+/* Sun */
+static const converter_rule_t sun_rules[] PROGMEM = {
+    { 0x7E, CONVERTER_NONE },       // self test failed
+    { 0x7F, CONVERTER_ALL_UP },     // idle, no key is down
+    { 0xFE, CONVERTER_SKIP, 0, 1 }, // layout response and the layout
+    { 0xFF, CONVERTER_SKIP, 0, 1 }, // reset response and the keyboard type
+};
+
+const converter_decoder_t converter_sun = {
+    .break_bit = 0x80,
+    .code_count = 0x80,
+    .rule_count = RULE_COUNT(sun_rules),
+    .rules = sun_rules,
+};
+
+
+/* SONY NEWS */
+const converter_decoder_t converter_news = {
+    .break_bit = 0x80,
+    .code_count = 0x80,
+};
@@ -0,0 +1,57 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONVERTER_DECODERS_H
+#define CONVERTER_DECODERS_H
+
+#include "converter_engine.h"
+
+/*
+ * Decoders of the keyboard protocols in tmk_core/protocol
+ *
+ * PS/2 Scan Code Set 2 keys are at their code, E0 keys at code|0x80. F7 is
+ * 0x83, Alt'd PrintScreen is PrintScreen at 0xFC, and Pause is tapped at
+ * 0xFE. Scan Code Set 3 keys are at their code, up to 0x87.
+ *
+ * ADB, IBM 4704, M0110, Sun and NEWS codes are keys with bit 7 set on
+ * release. M0110 codes are those of m0110_recv_key(), which sorts out the
+ * keypad sequences.
+ */
+extern const converter_decoder_t converter_ps2_set2;
+extern const converter_decoder_t converter_ps2_set3;
+extern const converter_decoder_t converter_adb;
+extern const converter_decoder_t converter_ibm4704;
+extern const converter_decoder_t converter_m0110;
+extern const converter_decoder_t converter_next;
+extern const converter_decoder_t converter_sun;
+extern const converter_decoder_t converter_news;
+
+#define CONVERTER_PS2_F7            0x83
+#define CONVERTER_PS2_PRINT_SCREEN  0xFC
+#define CONVERTER_PS2_PAUSE         0xFE
+
+/* The ADB keyboard register has up to two keys, as from adb_host_kbd_recv() */
+void converter_adb_put(converter_t *conv, uint16_t codes);
+
+/*
+ * A NeXT response, as from next_kbd_recv(), has a key and the state of all
+ * modifiers, which are keys 0x78 to 0x7E: Left Control, Left Shift, Right
+ * Shift, Left Command, Right Command, Left Alt and Right Alt.
+ */
+#define CONVERTER_NEXT_MODIFIERS    0x78
+void converter_next_put(converter_t *conv, uint32_t response);
+
+#endif
@@ -0,0 +1,146 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "converter_engine.h"
+#include "progmem.h"
+#include "debug.h"
+
+#define PREFIX_BREAK    (1<<0)
+#define PREFIX_EXTEND   (1<<1)
+
+
+void converter_init(converter_t *conv, const converter_decoder_t *decoder, converter_event_t event)
+{
+    memset(conv, 0, sizeof(*conv));
+    conv->decoder = decoder;
+    conv->event = event;
+}
+
+static void key_event(converter_t *conv, uint8_t pos, bool pressed)
+{
+    uint8_t row = pos >> 3;
+    uint8_t bit = 1 << (pos & 7);
+
+    if (!(conv->matrix[row] & bit) == !pressed) {
+        return;
+    }
+    conv->matrix[row] ^= bit;
+    conv->event(row, pos & 7, pressed);
+}
+
+void converter_clear(converter_t *conv)
+{
+    for (uint8_t row = 0; row < CONVERTER_MATRIX_ROWS; row++) {
+        for (uint8_t col = 0; conv->matrix[row]; col++) {
+            key_event(conv, row * 8 + col, false);
+        }
+    }
+}
+
+static bool find_rule(const converter_rule_t *rules, uint8_t count, uint8_t code, converter_rule_t *rule)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        if (pgm_read_byte(&rules[i].code) == code) {
+            rule->code = code;
+            rule->action = pgm_read_byte(&rules[i].action);
+            rule->pos = pgm_read_byte(&rules[i].pos);
+            rule->skip = pgm_read_byte(&rules[i].skip);
+            return true;
+        }
+    }
+    return false;
+}
+
+void converter_put(converter_t *conv, uint8_t code)
+{
+    const converter_decoder_t *decoder = conv->decoder;
+    converter_rule_t rule;
+
+    if (conv->skip) {
+        if (--conv->skip == 0 && conv->tapping) {
+            conv->tapping = false;
+            key_event(conv, conv->tap, false);
+        }
+        return;
+    }
+
+    if (!((conv->prefix & PREFIX_EXTEND) &&
+                find_rule(decoder->extend_rules, decoder->extend_rule_count, code, &rule)) &&
+            !find_rule(decoder->rules, decoder->rule_count, code, &rule)) {
+        // a key at its own position
+        uint8_t key = code & ~decoder->break_bit;
+        uint16_t pos = key + ((conv->prefix & PREFIX_EXTEND) ? decoder->extend_offset : 0);
+        if (key >= decoder->code_count || pos >= CONVERTER_MATRIX_ROWS * 8) {
+            dprintf("converter: unknown code %02X\n", code);
+            conv->prefix = 0;
+            return;
+        }
+        rule.action = CONVERTER_KEY;
+        rule.pos = pos;
+        if (code & decoder->break_bit) {
+            conv->prefix |= PREFIX_BREAK;
+        }
+    }
+
+    switch (rule.action) {
+        case CONVERTER_KEY:
+            key_event(conv, rule.pos, !(conv->prefix & PREFIX_BREAK));
+            conv->prefix = 0;
+            break;
+        case CONVERTER_BREAK:
+            conv->prefix |= PREFIX_BREAK;
+            break;
+        case CONVERTER_EXTEND:
+            conv->prefix |= PREFIX_EXTEND;
+            break;
+        case CONVERTER_TAP:
+            key_event(conv, rule.pos, true);
+            conv->tap = rule.pos;
+            conv->tapping = true;
+            conv->skip = rule.skip;
+            conv->prefix = 0;
+            if (!conv->skip) {
+                conv->tapping = false;
+                key_event(conv, rule.pos, false);
+            }
+            break;
+        case CONVERTER_SKIP:
+            conv->skip = rule.skip;
+            conv->prefix = 0;
+            break;
+        case CONVERTER_ALL_UP:
+            converter_clear(conv);
+            conv->prefix = 0;
+            break;
+        default:
+            conv->prefix = 0;
+            break;
+    }
+}
+
+uint8_t converter_task(converter_t *conv, converter_recv_t recv)
+{
+    uint8_t count = 0;
+    int16_t code;
+
+    // every queued code, so that a burst of keys isn't spread over scans
+    while (count < 0xFF && (code = recv()) >= 0) {
+        converter_put(conv, code);
+        count++;
+    }
+    return count;
+}
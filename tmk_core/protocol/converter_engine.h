@@ -0,0 +1,97 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONVERTER_ENGINE_H
+#define CONVERTER_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Scan code decoder for keyboard protocol converters
+ *
+ * A protocol is described by a converter_decoder_t, and the engine turns its
+ * scan codes into key events. Like the converters have always done, a key is
+ * at matrix position code, row code>>3 and column code&7, so the matrix has
+ * 8 columns and up to 32 rows.
+ *
+ * A code first goes through the rules of the decoder, the extended rules
+ * first after an extend prefix. A code without a rule is a key when it is
+ * below code_count, after taking off break_bit, and is ignored otherwise.
+ * Extended keys are moved by extend_offset.
+ */
+#define CONVERTER_MATRIX_ROWS   32
+
+enum converter_action {
+    CONVERTER_KEY,      /* the key at pos, for keys out of place */
+    CONVERTER_NONE,     /* ignored, like fake shifts and acknowledges */
+    CONVERTER_BREAK,    /* the next key is released */
+    CONVERTER_EXTEND,   /* the next key is extended */
+    CONVERTER_SKIP,     /* ignores the next skip codes */
+    CONVERTER_TAP,      /* presses pos, ignores the next skip codes and releases it */
+    CONVERTER_ALL_UP,   /* all keys are released */
+};
+
+typedef struct {
+    uint8_t code;
+    uint8_t action;
+    uint8_t pos;
+    uint8_t skip;
+} converter_rule_t;
+
+typedef struct {
+    uint8_t break_bit;          /* set in break codes, 0 with a break prefix */
+    uint8_t code_count;
+    uint8_t extend_offset;
+    uint8_t rule_count;
+    uint8_t extend_rule_count;
+    const converter_rule_t *rules;          /* in PROGMEM */
+    const converter_rule_t *extend_rules;
+} converter_decoder_t;
+
+/* The key events, keyboard_key_event() in the firmware */
+typedef void (*converter_event_t)(uint8_t row, uint8_t col, bool pressed);
+
+/* Reads a code from the protocol's queue, -1 when it is empty */
+typedef int16_t (*converter_recv_t)(void);
+
+typedef struct {
+    const converter_decoder_t *decoder;
+    converter_event_t event;
+    uint8_t prefix;
+    uint8_t skip;
+    uint8_t tap;        /* position of the key to release after skipping */
+    bool tapping;
+    uint8_t matrix[CONVERTER_MATRIX_ROWS];
+} converter_t;
+
+void converter_init(converter_t *conv, const converter_decoder_t *decoder, converter_event_t event);
+
+/* Decodes one code */
+void converter_put(converter_t *conv, uint8_t code);
+
+/* Decodes all the queued codes, returns how many there were */
+uint8_t converter_task(converter_t *conv, converter_recv_t recv);
+
+/* Releases all keys */
+void converter_clear(converter_t *conv);
+
+static inline uint8_t converter_get_row(const converter_t *conv, uint8_t row)
+{
+    return conv->matrix[row];
+}
+
+#endif
@@ -4,7 +4,7 @@ Copyright 2010,2011,2012,2013 Jun WAKO <wakojun@gmail.com>
 #include <stdbool.h>
 #include <util/delay.h>
 #include "debug.h"
-#include "ring_buffer.h"
+#include "spsc_ring.h"
 #include "ibm4704.h"
 
 
@@ -18,6 +18,11 @@ Copyright 2010,2011,2012,2013 Jun WAKO <wakojun@gmail.com>
 
 uint8_t ibm4704_error = 0;
 
+/* Ring buffer to store scan codes from keyboard */
+#define RBUF_SIZE 32
+SPSC_RING_DEFINE(rbuf_ring, uint8_t, RBUF_SIZE)
+static rbuf_ring_t rbuf;
+
 
 void ibm4704_init(void)
 {
@@ -99,16 +104,29 @@ ERROR:
 /* wait forever to receive data */
 uint8_t ibm4704_recv_response(void)
 {
-    while (!rbuf_has_data()) {
+    uint8_t data;
+    while (!rbuf_ring_pop(&rbuf, &data)) {
         _delay_ms(1);
     }
-    return rbuf_dequeue();
+    return data;
 }
 
 uint8_t ibm4704_recv(void)
 {
-    if (rbuf_has_data()) {
-        return rbuf_dequeue();
+    uint8_t data;
+    if (rbuf_ring_pop(&rbuf, &data)) {
+        return data;
+    } else {
+        return -1;
+    }
+}
+
+/* -1 when there is no data, for converter_task() */
+int16_t ibm4704_recv2(void)
+{
+    uint8_t data;
+    if (rbuf_ring_pop(&rbuf, &data)) {
+        return data;
     } else {
         return -1;
     }
@@ -167,7 +185,7 @@ ISR(IBM4704_INT_VECT)
         case STOP:
             // Data:Low
             WAIT(data_lo, 100, state);
-            rbuf_enqueue(data);
+            rbuf_ring_push(&rbuf, data);
             ibm4704_error = IBM4704_ERR_NONE;
             goto DONE;
             break;
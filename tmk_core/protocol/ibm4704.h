@@ -12,6 +12,7 @@ void ibm4704_init(void);
 uint8_t ibm4704_send(uint8_t data);
 uint8_t ibm4704_recv_response(void);
 uint8_t ibm4704_recv(void);
+int16_t ibm4704_recv2(void);
 
 
 /* Check pin configuration */
@@ -17,6 +17,7 @@ endif
 LUFA_SRC = lufa.c \
 	   descriptor.c \
 	   outputselect.c \
+	   pending_report.c \
 	   $(LUFA_SRC_USB)
 
 ifeq ($(strip $(MIDI_ENABLE)), yes)
@@ -29,7 +30,8 @@ ifeq ($(strip $(BLUETOOTH_ENABLE)), yes)
 endif
 
 ifeq ($(strip $(BLUETOOTH)), AdafruitBLE)
-		LUFA_SRC += $(LUFA_DIR)/adafruit_ble.cpp
+		LUFA_SRC += $(LUFA_DIR)/adafruit_ble.cpp \
+		$(LUFA_DIR)/adafruit_ble_sdep.cpp
 endif
 
 ifeq ($(strip $(BLUETOOTH)), AdafruitEZKey)
@@ -8,7 +8,7 @@
 #include "pincontrol.h"
 #include "timer.h"
 #include "action_util.h"
-#include "ringbuffer.hpp"
+#include "adafruit_ble_sdep.h"
 #include <string.h>
 
 // These are the pin assignments for the 32u4 boards.
@@ -46,77 +46,6 @@ static struct {
   uint16_t last_connection_update;
 } state;
 
-// Commands are encoded using SDEP and sent via SPI
-// https://github.com/adafruit/Adafruit_BluefruitLE_nRF51/blob/master/SDEP.md
-
-#define SdepMaxPayload 16
-struct sdep_msg {
-  uint8_t type;
-  uint8_t cmd_low;
-  uint8_t cmd_high;
-  struct __attribute__((packed)) {
-    uint8_t len:7;
-    uint8_t more:1;
-  };
-  uint8_t payload[SdepMaxPayload];
-} __attribute__((packed));
-
-// The recv latency is relatively high, so when we're hammering keys quickly,
-// we want to avoid waiting for the responses in the matrix loop.  We maintain
-// a short queue for that.  Since there is quite a lot of space overhead for
-// the AT command representation wrapped up in SDEP, we queue the minimal
-// information here.
-
-enum queue_type {
-  QTKeyReport, // 1-byte modifier + 6-byte key report
-  QTConsumer,  // 16-bit key code
-#ifdef MOUSE_ENABLE
-  QTMouseMove, // 4-byte mouse report
-#endif
-};
-
-struct queue_item {
-  enum queue_type queue_type;
-  uint16_t added;
-  union __attribute__((packed)) {
-    struct __attribute__((packed)) {
-      uint8_t modifier;
-      uint8_t keys[6];
-    } key;
-
-    uint16_t consumer;
-    struct __attribute__((packed)) {
-      int8_t x, y, scroll, pan;
-      uint8_t buttons;
-    } mousemove;
-  };
-};
-
-// Items that we wish to send
-static RingBuffer<queue_item, 40> send_buf;
-// Pending response; while pending, we can't send any more requests.
-// This records the time at which we sent the command for which we
-// are expecting a response.
-static RingBuffer<uint16_t, 2> resp_buf;
-
-static bool process_queue_item(struct queue_item *item, uint16_t timeout);
-
-enum sdep_type {
-  SdepCommand = 0x10,
-  SdepResponse = 0x20,
-  SdepAlert = 0x40,
-  SdepError = 0x80,
-  SdepSlaveNotReady = 0xfe, // Try again later
-  SdepSlaveOverflow = 0xff, // You read more data than is available
-};
-
-enum ble_cmd {
-  BleInitialize = 0xbeef,
-  BleAtWrapper = 0x0a00,
-  BleUartTx = 0x0a01,
-  BleUartRx = 0x0a02,
-};
-
 enum ble_system_event_bits {
   BleSystemConnected = 0,
   BleSystemDisconnected = 1,
@@ -128,13 +57,9 @@ enum ble_system_event_bits {
 // both use 4MHz
 #define SpiBusSpeed 4000000
 
-#define SdepTimeout 150 /* milliseconds */
-#define SdepShortTimeout 10 /* milliseconds */
 #define SdepBackOff 25 /* microseconds */
 #define BatteryUpdateInterval 10000 /* milliseconds */
 
-static bool at_command(const char *cmd, char *resp, uint16_t resplen,
-                       bool verbose, uint16_t timeout = SdepTimeout);
 static bool at_command_P(const char *cmd, char *resp, uint16_t resplen,
                          bool verbose = false);
 
@@ -222,7 +147,7 @@ static void dump_pkt(const struct sdep_msg *msg) {
 #endif
 
 // Send a single SDEP packet
-static bool sdep_send_pkt(const struct sdep_msg *msg, uint16_t timeout) {
+bool sdep_send_pkt(const struct sdep_msg *msg, uint16_t timeout) {
   SPI_begin(&spi);
 
   digitalWrite(AdafruitBleCSPin, PinLevelLow);
@@ -254,22 +179,8 @@ static bool sdep_send_pkt(const struct sdep_msg *msg, uint16_t timeout) {
   return success;
 }
 
-static inline void sdep_build_pkt(struct sdep_msg *msg, uint16_t command,
-                                  const uint8_t *payload, uint8_t len,
-                                  bool moredata) {
-  msg->type = SdepCommand;
-  msg->cmd_low = command & 0xff;
-  msg->cmd_high = command >> 8;
-  msg->len = len;
-  msg->more = (moredata && len == SdepMaxPayload) ? 1 : 0;
-
-  static_assert(sizeof(*msg) == 20, "msg is correctly packed");
-
-  memcpy(msg->payload, payload, len);
-}
-
 // Read a single SDEP packet
-static bool sdep_recv_pkt(struct sdep_msg *msg, uint16_t timeout) {
+bool sdep_recv_pkt(struct sdep_msg *msg, uint16_t timeout) {
   bool success = false;
   uint16_t timerStart = timer_read();
   bool ready = false;
@@ -314,68 +225,8 @@ static bool sdep_recv_pkt(struct sdep_msg *msg, uint16_t timeout) {
   return success;
 }
 
-static void resp_buf_read_one(bool greedy) {
-  uint16_t last_send;
-  if (!resp_buf.peek(last_send)) {
-    return;
-  }
-
-  if (digitalRead(AdafruitBleIRQPin)) {
-    struct sdep_msg msg;
-
-again:
-    if (sdep_recv_pkt(&msg, SdepTimeout)) {
-      if (!msg.more) {
-        // We got it; consume this entry
-        resp_buf.get(last_send);
-        dprintf("recv latency %dms\n", TIMER_DIFF_16(timer_read(), last_send));
-      }
-
-      if (greedy && resp_buf.peek(last_send) && digitalRead(AdafruitBleIRQPin)) {
-        goto again;
-      }
-    }
-
-  } else if (timer_elapsed(last_send) > SdepTimeout * 2) {
-    dprintf("waiting_for_result: timeout, resp_buf size %d\n",
-            (int)resp_buf.size());
-
-    // Timed out: consume this entry
-    resp_buf.get(last_send);
-  }
-}
-
-static void send_buf_send_one(uint16_t timeout = SdepTimeout) {
-  struct queue_item item;
-
-  // Don't send anything more until we get an ACK
-  if (!resp_buf.empty()) {
-    return;
-  }
-
-  if (!send_buf.peek(item)) {
-    return;
-  }
-  if (process_queue_item(&item, timeout)) {
-    // commit that peek
-    send_buf.get(item);
-    dprintf("send_buf_send_one: have %d remaining\n", (int)send_buf.size());
-  } else {
-    dprint("failed to send, will retry\n");
-    _delay_ms(SdepTimeout);
-    resp_buf_read_one(true);
-  }
-}
-
-static void resp_buf_wait(const char *cmd) {
-  bool didPrint = false;
-  while (!resp_buf.empty()) {
-    if (!didPrint) {
-      dprintf("wait on buf for %s\n", cmd);
-      didPrint = true;
-    }
-    resp_buf_read_one(true);
-  }
+bool sdep_irq(void) {
+  return digitalRead(AdafruitBleIRQPin);
 }
 
 static bool ble_init(void) {
@@ -388,6 +239,7 @@ static bool ble_init(void) {
   digitalWrite(AdafruitBleCSPin, PinLevelHigh);
 
   SPI_init(&spi);
+  sdep_reset();
 
   // Perform a hardware reset
   pinMode(AdafruitBleResetPin, PinDirectionOutput);
@@ -402,115 +254,6 @@ static bool ble_init(void) {
   return state.initialized;
 }
 
-static inline uint8_t min(uint8_t a, uint8_t b) {
-  return a < b ? a : b;
-}
-
-static bool read_response(char *resp, uint16_t resplen, bool verbose) {
-  char *dest = resp;
-  char *end = dest + resplen;
-
-  while (true) {
-    struct sdep_msg msg;
-
-    if (!sdep_recv_pkt(&msg, 2 * SdepTimeout)) {
-      dprint("sdep_recv_pkt failed\n");
-      return false;
-    }
-
-    if (msg.type != SdepResponse) {
-      *resp = 0;
-      return false;
-    }
-
-    uint8_t len = min(msg.len, end - dest);
-    if (len > 0) {
-      memcpy(dest, msg.payload, len);
-      dest += len;
-    }
-
-    if (!msg.more) {
-      // No more data is expected!
-      break;
-    }
-  }
-
-  // Ensure the response is NUL terminated
-  *dest = 0;
-
-  // "Parse" the result text; we want to snip off the trailing OK or ERROR line
-  // Rewind past the possible trailing CRLF so that we can strip it
-  --dest;
-  while (dest > resp && (dest[0] == '\n' || dest[0] == '\r')) {
-    *dest = 0;
-    --dest;
-  }
-
-  // Look back for start of preceeding line
-  char *last_line = strrchr(resp, '\n');
-  if (last_line) {
-    ++last_line;
-  } else {
-    last_line = resp;
-  }
-
-  bool success = false;
-  static const char kOK[] PROGMEM = "OK";
-
-  success = !strcmp_P(last_line, kOK );
-
-  if (verbose || !success) {
-    dprintf("result: %s\n", resp);
-  }
-  return success;
-}
-
-static bool at_command(const char *cmd, char *resp, uint16_t resplen,
-                       bool verbose, uint16_t timeout) {
-  const char *end = cmd + strlen(cmd);
-  struct sdep_msg msg;
-
-  if (verbose) {
-    dprintf("ble send: %s\n", cmd);
-  }
-
-  if (resp) {
-    // They want to decode the response, so we need to flush and wait
-    // for all pending I/O to finish before we start this one, so
-    // that we don't confuse the results
-    resp_buf_wait(cmd);
-    *resp = 0;
-  }
-
-  // Fragment the command into a series of SDEP packets
-  while (end - cmd > SdepMaxPayload) {
-    sdep_build_pkt(&msg, BleAtWrapper, (uint8_t *)cmd, SdepMaxPayload, true);
-    if (!sdep_send_pkt(&msg, timeout)) {
-      return false;
-    }
-    cmd += SdepMaxPayload;
-  }
-
-  sdep_build_pkt(&msg, BleAtWrapper, (uint8_t *)cmd, end - cmd, false);
-  if (!sdep_send_pkt(&msg, timeout)) {
-    return false;
-  }
-
-  if (resp == NULL) {
-    auto now = timer_read();
-    while (!resp_buf.enqueue(now)) {
-      resp_buf_read_one(false);
-    }
-    auto later = timer_read();
-    if (TIMER_DIFF_16(later, now) > 0) {
-      dprintf("waited %dms for resp_buf\n", TIMER_DIFF_16(later, now));
-    }
-    return true;
-  }
-
-  return read_response(resp, resplen, verbose);
-}
-
 bool at_command_P(const char *cmd, char *resp, uint16_t resplen, bool verbose) {
   auto cmdbuf = (char *)alloca(strlen_P(cmd) + 1);
   strcpy_P(cmdbuf, cmd);
@@ -600,16 +343,23 @@ static void set_connected(bool connected) {
   }
 }
 
+static void send_queued(uint16_t timeout = SdepTimeout) {
+  if (sdep_send_queued(timeout)) {
+    // Arrange to re-check connection after keys have settled
+    state.last_connection_update = timer_read();
+  }
+}
+
 void adafruit_ble_task(void) {
   char resbuf[48];
 
   if (!state.configured && !adafruit_ble_enable_keyboard()) {
     return;
   }
-  resp_buf_read_one(true);
-  send_buf_send_one(SdepShortTimeout);
+  sdep_read_responses(true);
+  send_queued(SdepShortTimeout);
 
-  if (resp_buf.empty() && (state.event_flags & UsingEvents) &&
+  if (!sdep_responses_pending() && (state.event_flags & UsingEvents) &&
       digitalRead(AdafruitBleIRQPin)) {
     // Must be an event update
     if (at_command_P(PSTR("AT+EVENTSTATUS"), resbuf, sizeof(resbuf))) {
@@ -657,7 +407,7 @@ void adafruit_ble_task(void) {
   // voltage level always seems to be around 3200mV.  We may want to just rip
   // this code out.
   if (timer_elapsed(state.last_battery_update) > BatteryUpdateInterval &&
-      resp_buf.empty()) {
+      !sdep_responses_pending()) {
     state.last_battery_update = timer_read();
 
     if (at_command_P(PSTR("AT+HWVBAT"), resbuf, sizeof(resbuf))) {
@@ -667,62 +417,6 @@ void adafruit_ble_task(void) {
 #endif
 }
 
-static bool process_queue_item(struct queue_item *item, uint16_t timeout) {
-  char cmdbuf[48];
-  char fmtbuf[64];
-
-  // Arrange to re-check connection after keys have settled
-  state.last_connection_update = timer_read();
-
-#if 1
-  if (TIMER_DIFF_16(state.last_connection_update, item->added) > 0) {
-    dprintf("send latency %dms\n",
-            TIMER_DIFF_16(state.last_connection_update, item->added));
-  }
-#endif
-
-  switch (item->queue_type) {
-    case QTKeyReport:
-      strcpy_P(fmtbuf,
-          PSTR("AT+BLEKEYBOARDCODE=%02x-00-%02x-%02x-%02x-%02x-%02x-%02x"));
-      snprintf(cmdbuf, sizeof(cmdbuf), fmtbuf, item->key.modifier,
-               item->key.keys[0], item->key.keys[1], item->key.keys[2],
-               item->key.keys[3], item->key.keys[4], item->key.keys[5]);
-      return at_command(cmdbuf, NULL, 0, true, timeout);
-
-    case QTConsumer:
-      strcpy_P(fmtbuf, PSTR("AT+BLEHIDCONTROLKEY=0x%04x"));
-      snprintf(cmdbuf, sizeof(cmdbuf), fmtbuf, item->consumer);
-      return at_command(cmdbuf, NULL, 0, true, timeout);
-
-#ifdef MOUSE_ENABLE
-    case QTMouseMove:
-      strcpy_P(fmtbuf, PSTR("AT+BLEHIDMOUSEMOVE=%d,%d,%d,%d"));
-      snprintf(cmdbuf, sizeof(cmdbuf), fmtbuf, item->mousemove.x,
-          item->mousemove.y, item->mousemove.scroll, item->mousemove.pan);
-      if (!at_command(cmdbuf, NULL, 0, true, timeout)) {
-        return false;
-      }
-      strcpy_P(cmdbuf, PSTR("AT+BLEHIDMOUSEBUTTON="));
-      if (item->mousemove.buttons & MOUSE_BTN1) {
-        strcat(cmdbuf, "L");
-      }
-      if (item->mousemove.buttons & MOUSE_BTN2) {
-        strcat(cmdbuf, "R");
-      }
-      if (item->mousemove.buttons & MOUSE_BTN3) {
-        strcat(cmdbuf, "M");
-      }
-      if (item->mousemove.buttons == 0) {
-        strcat(cmdbuf, "0");
-      }
-      return at_command(cmdbuf, NULL, 0, true, timeout);
-#endif
-    default:
-      return true;
-  }
-}
-
 bool adafruit_ble_send_keys(uint8_t hid_modifier_mask, uint8_t *keys,
                             uint8_t nkeys) {
   struct queue_item item;
@@ -740,12 +434,12 @@ bool adafruit_ble_send_keys(uint8_t hid_modifier_mask, uint8_t *keys,
     item.key.keys[4] = nkeys >= 4 ? keys[4] : 0;
     item.key.keys[5] = nkeys >= 5 ? keys[5] : 0;
 
-    if (!send_buf.enqueue(item)) {
+    if (!sdep_queue_item(&item)) {
       if (!didWait) {
         dprint("wait for buf space\n");
         didWait = true;
       }
-      send_buf_send_one();
+      send_queued();
       continue;
     }
 
@@ -765,9 +459,10 @@ bool adafruit_ble_send_consumer_key(uint16_t keycode, int hold_duration) {
 
   item.queue_type = QTConsumer;
   item.consumer = keycode;
+  item.added = timer_read();
 
-  while (!send_buf.enqueue(item)) {
-    send_buf_send_one();
+  while (!sdep_queue_item(&item)) {
+    send_queued();
   }
   return true;
 }
@@ -783,9 +478,10 @@ bool adafruit_ble_send_mouse_move(int8_t x, int8_t y, int8_t scroll,
   item.mousemove.scroll = scroll;
   item.mousemove.pan = pan;
   item.mousemove.buttons = buttons;
+  item.added = timer_read();
 
-  while (!send_buf.enqueue(item)) {
-    send_buf_send_one();
+  while (!sdep_queue_item(&item)) {
+    send_queued();
   }
   return true;
 }
@@ -0,0 +1,477 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "adafruit_ble_sdep.h"
+#include <string.h>
+#include "debug.h"
+#include "timer.h"
+#include "progmem.h"
+#include "spsc_ring.h"
+#ifdef MOUSE_ENABLE
+#include "report.h"
+#endif
+
+// Items that we wish to send
+static SpscRing<queue_item, 32> send_buf;
+
+// Sent commands waiting for a response; while AdafruitBlePipelineDepth of
+// them are waiting, we can't send any more requests. This records the
+// time at which we sent the command, and when its report was queued.
+struct pending_response {
+  uint16_t sent;
+  uint16_t added;
+  bool report;
+};
+static SpscRing<pending_response, 8> resp_buf;
+static_assert(AdafruitBlePipelineDepth >= 1 && AdafruitBlePipelineDepth <= 8,
+              "AdafruitBlePipelineDepth must be between 1 and 8");
+
+static struct sdep_latency latency;
+
+// The module didn't take the front of send_buf, wait a bit before retrying
+static bool retrying;
+static uint16_t retry_time;
+
+// The last two key reports that were queued, see sdep_queue_item
+static struct key_report last_key;
+static struct key_report before_last_key;
+
+void sdep_build_pkt(struct sdep_msg *msg, uint16_t command,
+                    const uint8_t *payload, uint8_t len, bool moredata) {
+  msg->type = SdepCommand;
+  msg->cmd_low = command & 0xff;
+  msg->cmd_high = command >> 8;
+  msg->len = len;
+  msg->more = (moredata && len == SdepMaxPayload) ? 1 : 0;
+
+  static_assert(sizeof(*msg) == 20, "msg is correctly packed");
+
+  memcpy(msg->payload, payload, len);
+}
+
+void sdep_read_responses(bool greedy) {
+  pending_response pending;
+  if (!resp_buf.peek(pending)) {
+    return;
+  }
+
+  if (sdep_irq()) {
+    struct sdep_msg msg;
+
+again:
+    if (sdep_recv_pkt(&msg, SdepTimeout)) {
+      if (!msg.more) {
+        // We got it; consume this entry
+        resp_buf.get(pending);
+        uint16_t now = timer_read();
+        dprintf("recv latency %dms\n", TIMER_DIFF_16(now, pending.sent));
+        if (pending.report) {
+          uint16_t report_latency = TIMER_DIFF_16(now, pending.added);
+          latency.reports++;
+          latency.total += report_latency;
+          if (report_latency > latency.max) {
+            latency.max = report_latency;
+          }
+        }
+      }
+
+      if (greedy && resp_buf.peek(pending) && sdep_irq()) {
+        goto again;
+      }
+    }
+
+  } else if (timer_elapsed(pending.sent) > SdepTimeout * 2) {
+    dprintf("waiting_for_result: timeout, resp_buf size %d\n",
+            (int)resp_buf.size());
+
+    // Timed out: consume this entry
+    resp_buf.get(pending);
+  }
+}
+
+void sdep_wait_responses(const char *cmd) {
+  bool didPrint = false;
+  while (!resp_buf.empty()) {
+    if (!didPrint) {
+      dprintf("wait on buf for %s\n", cmd);
+      didPrint = true;
+    }
+    sdep_read_responses(true);
+  }
+}
+
+static inline uint8_t min(uint8_t a, uint8_t b) {
+  return a < b ? a : b;
+}
+
+static bool read_response(char *resp, uint16_t resplen, bool verbose) {
+  char *dest = resp;
+  char *end = dest + resplen;
+
+  while (true) {
+    struct sdep_msg msg;
+
+    if (!sdep_recv_pkt(&msg, 2 * SdepTimeout)) {
+      dprint("sdep_recv_pkt failed\n");
+      return false;
+    }
+
+    if (msg.type != SdepResponse) {
+      *resp = 0;
+      return false;
+    }
+
+    uint8_t len = min(msg.len, end - dest);
+    if (len > 0) {
+      memcpy(dest, msg.payload, len);
+      dest += len;
+    }
+
+    if (!msg.more) {
+      // No more data is expected!
+      break;
+    }
+  }
+
+  // Ensure the response is NUL terminated
+  *dest = 0;
+
+  // "Parse" the result text; we want to snip off the trailing OK or ERROR line
+  // Rewind past the possible trailing CRLF so that we can strip it
+  --dest;
+  while (dest > resp && (dest[0] == '\n' || dest[0] == '\r')) {
+    *dest = 0;
+    --dest;
+  }
+
+  // Look back for start of preceeding line
+  char *last_line = strrchr(resp, '\n');
+  if (last_line) {
+    ++last_line;
+  } else {
+    last_line = resp;
+  }
+
+  bool success = !strcmp(last_line, "OK");
+
+  if (verbose || !success) {
+    dprintf("result: %s\n", resp);
+  }
+  return success;
+}
+
+// Fragment the command into a series of SDEP packets
+static bool send_command(const char *cmd, uint16_t timeout) {
+  const char *end = cmd + strlen(cmd);
+  struct sdep_msg msg;
+
+  while (end - cmd > SdepMaxPayload) {
+    sdep_build_pkt(&msg, BleAtWrapper, (uint8_t *)cmd, SdepMaxPayload, true);
+    if (!sdep_send_pkt(&msg, timeout)) {
+      return false;
+    }
+    cmd += SdepMaxPayload;
+  }
+
+  sdep_build_pkt(&msg, BleAtWrapper, (uint8_t *)cmd, end - cmd, false);
+  return sdep_send_pkt(&msg, timeout);
+}
+
+static void expect_response(uint16_t added, bool report) {
+  pending_response pending = {timer_read(), added, report};
+  while (resp_buf.size() >= AdafruitBlePipelineDepth) {
+    sdep_read_responses(false);
+  }
+  resp_buf.enqueue(pending);
+  auto later = timer_read();
+  if (TIMER_DIFF_16(later, pending.sent) > 0) {
+    dprintf("waited %dms for resp_buf\n", TIMER_DIFF_16(later, pending.sent));
+  }
+}
+
+bool at_command(const char *cmd, char *resp, uint16_t resplen,
+                bool verbose, uint16_t timeout) {
+  if (verbose) {
+    dprintf("ble send: %s\n", cmd);
+  }
+
+  if (resp) {
+    // They want to decode the response, so we need to flush and wait
+    // for all pending I/O to finish before we start this one, so
+    // that we don't confuse the results
+    sdep_wait_responses(cmd);
+    *resp = 0;
+  }
+
+  if (!send_command(cmd, timeout)) {
+    return false;
+  }
+
+  if (resp == NULL) {
+    expect_response(timer_read(), false);
+    return true;
+  }
+
+  return read_response(resp, resplen, verbose);
+}
+
+// The reports are formatted by hand, snprintf is slow, and the format
+// strings would have to be copied out of flash first
+static const char kHexDigits[] PROGMEM = "0123456789abcdef";
+
+static char *put_P(char *dest, const char *src) {
+  char c;
+  while ((c = pgm_read_byte(src++))) {
+    *dest++ = c;
+  }
+  return dest;
+}
+
+static char *put_hex8(char *dest, uint8_t value) {
+  *dest++ = pgm_read_byte(&kHexDigits[value >> 4]);
+  *dest++ = pgm_read_byte(&kHexDigits[value & 0xf]);
+  return dest;
+}
+
+#ifdef MOUSE_ENABLE
+static char *put_int8(char *dest, int8_t value) {
+  uint8_t magnitude = value < 0 ? -value : value;
+  if (value < 0) {
+    *dest++ = '-';
+  }
+  if (magnitude >= 100) {
+    *dest++ = '0' + magnitude / 100;
+  }
+  if (magnitude >= 10) {
+    *dest++ = '0' + magnitude / 10 % 10;
+  }
+  *dest++ = '0' + magnitude % 10;
+  return dest;
+}
+#endif
+
+uint8_t sdep_encode_item(const struct queue_item *item, char *cmd, uint8_t size) {
+  static const char kKeyboardCode[] PROGMEM = "AT+BLEKEYBOARDCODE=";
+  static const char kControlKey[] PROGMEM = "AT+BLEHIDCONTROLKEY=0x";
+#ifdef MOUSE_ENABLE
+  static const char kMouseMove[] PROGMEM = "AT+BLEHIDMOUSEMOVE=";
+  static const char kMouseButton[] PROGMEM = "AT+BLEHIDMOUSEBUTTON=";
+#endif
+  // The longest is the keyboard report, "AT+BLEKEYBOARDCODE=xx-00-xx-xx-xx-xx-xx-xx"
+  if (size < 48) {
+    return 0;
+  }
+
+  char *p = cmd;
+  switch (item->queue_type) {
+    case QTKeyReport:
+      p = put_P(p, kKeyboardCode);
+      p = put_hex8(p, item->key.modifier);
+      *p++ = '-';
+      *p++ = '0';
+      *p++ = '0';
+      for (uint8_t i = 0; i < 6; i++) {
+        *p++ = '-';
+        p = put_hex8(p, item->key.keys[i]);
+      }
+      *p = 0;
+      return 1;
+
+    case QTConsumer:
+      p = put_P(p, kControlKey);
+      p = put_hex8(p, item->consumer >> 8);
+      p = put_hex8(p, item->consumer & 0xff);
+      *p = 0;
+      return 1;
+
+#ifdef MOUSE_ENABLE
+    case QTMouseMove:
+      p = put_P(p, kMouseMove);
+      p = put_int8(p, item->mousemove.x);
+      *p++ = ',';
+      p = put_int8(p, item->mousemove.y);
+      *p++ = ',';
+      p = put_int8(p, item->mousemove.scroll);
+      *p++ = ',';
+      p = put_int8(p, item->mousemove.pan);
+      *p++ = 0;
+
+      p = put_P(p, kMouseButton);
+      if (item->mousemove.buttons & MOUSE_BTN1) {
+        *p++ = 'L';
+      }
+      if (item->mousemove.buttons & MOUSE_BTN2) {
+        *p++ = 'R';
+      }
+      if (item->mousemove.buttons & MOUSE_BTN3) {
+        *p++ = 'M';
+      }
+      if (item->mousemove.buttons == 0) {
+        *p++ = '0';
+      }
+      *p = 0;
+      return 2;
+#endif
+    default:
+      return 0;
+  }
+}
+
+static bool send_item(const struct queue_item *item, uint16_t timeout) {
+  char cmd[48];
+  uint16_t now = timer_read();
+
+  if (TIMER_DIFF_16(now, item->added) > 0) {
+    dprintf("send latency %dms\n", TIMER_DIFF_16(now, item->added));
+  }
+
+  uint8_t count = sdep_encode_item(item, cmd, sizeof(cmd));
+  const char *c = cmd;
+  for (uint8_t i = 0; i < count; i++) {
+    dprintf("ble send: %s\n", c);
+    if (!send_command(c, timeout)) {
+      return false;
+    }
+    expect_response(item->added, i == count - 1);
+    c += strlen(c) + 1;
+  }
+  return true;
+}
+
+uint8_t sdep_send_queued(uint16_t timeout) {
+  struct queue_item item;
+  uint8_t sent = 0;
+
+  // Don't send anything more until we get an ACK
+  while (resp_buf.size() < AdafruitBlePipelineDepth) {
+    if (retrying && timer_elapsed(retry_time) < SdepTimeout) {
+      break;
+    }
+    if (!send_buf.peek(item)) {
+      break;
+    }
+    if (!send_item(&item, timeout)) {
+      dprint("failed to send, will retry\n");
+      retrying = true;
+      retry_time = timer_read();
+      sdep_read_responses(true);
+      break;
+    }
+    // commit that peek
+    retrying = false;
+    send_buf.get(item);
+    sent++;
+    dprintf("sdep_send_queued: have %d remaining\n", (int)send_buf.size());
+  }
+  return sent;
+}
+
+// Every key of from is still pressed in to, in the same place
+static bool only_presses(const struct key_report *from, const struct key_report *to) {
+  if (from->modifier & ~to->modifier) {
+    return false;
+  }
+  for (uint8_t i = 0; i < sizeof(from->keys); i++) {
+    if (from->keys[i] && from->keys[i] != to->keys[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#ifdef MOUSE_ENABLE
+static bool add_motion(int8_t *total, int8_t motion) {
+  int16_t sum = *total + motion;
+  if (sum < -127 || sum > 127) {
+    return false;
+  }
+  *total = sum;
+  return true;
+}
+
+static bool merge_mouse(struct queue_item *last, const struct queue_item *item) {
+  auto merged = last->mousemove;
+  if (merged.buttons != item->mousemove.buttons ||
+      !add_motion(&merged.x, item->mousemove.x) ||
+      !add_motion(&merged.y, item->mousemove.y) ||
+      !add_motion(&merged.scroll, item->mousemove.scroll) ||
+      !add_motion(&merged.pan, item->mousemove.pan)) {
+    return false;
+  }
+  last->mousemove = merged;
+  return true;
+}
+#endif
+
+bool sdep_queue_item(const struct queue_item *item) {
+  // Nothing in send_buf has been sent yet, so its last report can still
+  // be changed. The time it was added is kept, for the latency.
+  if (!send_buf.empty()) {
+    struct queue_item &last = send_buf.back();
+
+    if (item->queue_type == QTKeyReport && last.queue_type == QTKeyReport) {
+      if (!memcmp(&last.key, &item->key, sizeof(last.key))) {
+        return true;
+      }
+      // A report that only pressed keys, followed by one that pressed
+      // more, is superseded by the second one
+      if (only_presses(&before_last_key, &last.key) &&
+          only_presses(&last.key, &item->key)) {
+        last.key = item->key;
+        last_key = item->key;
+        return true;
+      }
+    }
+
+#ifdef MOUSE_ENABLE
+    if (item->queue_type == QTMouseMove && last.queue_type == QTMouseMove &&
+        merge_mouse(&last, item)) {
+      return true;
+    }
+#endif
+  }
+
+  if (!send_buf.enqueue(*item)) {
+    return false;
+  }
+  if (item->queue_type == QTKeyReport) {
+    before_last_key = last_key;
+    last_key = item->key;
+  }
+  return true;
+}
+
+bool sdep_responses_pending(void) {
+  return !resp_buf.empty();
+}
+
+uint8_t sdep_queue_size(void) {
+  return send_buf.size();
+}
+
+const struct sdep_latency *sdep_report_latency(void) {
+  return &latency;
+}
+
+void sdep_reset(void) {
+  send_buf.clear();
+  resp_buf.clear();
+  memset(&latency, 0, sizeof(latency));
+  memset(&last_key, 0, sizeof(last_key));
+  memset(&before_last_key, 0, sizeof(before_last_key));
+  retrying = false;
+}
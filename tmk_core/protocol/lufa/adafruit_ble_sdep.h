@@ -0,0 +1,143 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+// The SDEP transport of the Adafruit BLE module, without the SPI and pin
+// handling of adafruit_ble.cpp, so that it can be tested on the host.
+//
+// Commands are encoded using SDEP and sent via SPI
+// https://github.com/adafruit/Adafruit_BluefruitLE_nRF51/blob/master/SDEP.md
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SdepMaxPayload 16
+struct sdep_msg {
+  uint8_t type;
+  uint8_t cmd_low;
+  uint8_t cmd_high;
+  struct __attribute__((packed)) {
+    uint8_t len:7;
+    uint8_t more:1;
+  };
+  uint8_t payload[SdepMaxPayload];
+} __attribute__((packed));
+
+enum sdep_type {
+  SdepCommand = 0x10,
+  SdepResponse = 0x20,
+  SdepAlert = 0x40,
+  SdepError = 0x80,
+  SdepSlaveNotReady = 0xfe, // Try again later
+  SdepSlaveOverflow = 0xff, // You read more data than is available
+};
+
+enum ble_cmd {
+  BleInitialize = 0xbeef,
+  BleAtWrapper = 0x0a00,
+  BleUartTx = 0x0a01,
+  BleUartRx = 0x0a02,
+};
+
+#define SdepTimeout 150 /* milliseconds */
+#define SdepShortTimeout 10 /* milliseconds */
+
+// How many commands can be sent before waiting for their responses.
+// You may define this in your config.h, 1 waits for every response.
+#ifndef AdafruitBlePipelineDepth
+#define AdafruitBlePipelineDepth 3
+#endif
+
+// The recv latency is relatively high, so when we're hammering keys quickly,
+// we want to avoid waiting for the responses in the matrix loop.  We maintain
+// a short queue for that.  Since there is quite a lot of space overhead for
+// the AT command representation wrapped up in SDEP, we queue the minimal
+// information here.
+
+enum queue_type {
+  QTKeyReport, // 1-byte modifier + 6-byte key report
+  QTConsumer,  // 16-bit key code
+#ifdef MOUSE_ENABLE
+  QTMouseMove, // 4-byte mouse report
+#endif
+};
+
+struct key_report {
+  uint8_t modifier;
+  uint8_t keys[6];
+} __attribute__((packed));
+
+struct queue_item {
+  enum queue_type queue_type;
+  uint16_t added;
+  union __attribute__((packed)) {
+    struct key_report key;
+
+    uint16_t consumer;
+    struct __attribute__((packed)) {
+      int8_t x, y, scroll, pan;
+      uint8_t buttons;
+    } mousemove;
+  };
+};
+
+// The time from queueing a report until the module acknowledged it
+struct sdep_latency {
+  uint16_t reports;
+  uint16_t max;
+  uint32_t total;
+};
+
+// These talk to the module, and are implemented by adafruit_ble.cpp
+bool sdep_send_pkt(const struct sdep_msg *msg, uint16_t timeout);
+bool sdep_recv_pkt(struct sdep_msg *msg, uint16_t timeout);
+// The module has something for us to read
+bool sdep_irq(void);
+
+void sdep_build_pkt(struct sdep_msg *msg, uint16_t command,
+                    const uint8_t *payload, uint8_t len, bool moredata);
+
+// Sends an AT command. Without resp, the response is only waited for
+// once AdafruitBlePipelineDepth commands are waiting.
+bool at_command(const char *cmd, char *resp, uint16_t resplen,
+                bool verbose, uint16_t timeout = SdepTimeout);
+
+// Writes the AT command(s) of a report to cmd, and returns the number of
+// commands, each of them is NUL terminated
+uint8_t sdep_encode_item(const struct queue_item *item, char *cmd, uint8_t size);
+
+// Queues a report, merging it with the reports still waiting in the queue
+// when no key press or release gets lost that way. Returns false when the
+// queue is full.
+bool sdep_queue_item(const struct queue_item *item);
+
+// Sends queued reports while the pipeline has room, returns how many
+uint8_t sdep_send_queued(uint16_t timeout = SdepTimeout);
+
+// Reads the responses of sent commands
+void sdep_read_responses(bool greedy);
+
+// Waits for all the sent commands to be acknowledged
+void sdep_wait_responses(const char *cmd);
+
+bool sdep_responses_pending(void);
+uint8_t sdep_queue_size(void);
+const struct sdep_latency *sdep_report_latency(void);
+
+// Forgets all the queued reports and pending responses
+void sdep_reset(void);
@@ -46,6 +46,7 @@
 
 #include <LUFA/Drivers/USB/USB.h>
 #include <avr/pgmspace.h>
+#include "usb_polling.h"
 
 
 typedef struct
@@ -57,14 +58,21 @@ typedef struct
     USB_HID_Descriptor_HID_t              Keyboard_HID;
     USB_Descriptor_Endpoint_t             Keyboard_INEndpoint;
 
-#ifdef MOUSE_ENABLE
+#ifdef SHARED_EP_ENABLE
+    // Shared HID Interface, for the mouse, extrakey and NKRO reports
+    USB_Descriptor_Interface_t            Shared_Interface;
+    USB_HID_Descriptor_HID_t              Shared_HID;
+    USB_Descriptor_Endpoint_t             Shared_INEndpoint;
+#endif
+
+#if defined(MOUSE_ENABLE) && !defined(SHARED_EP_ENABLE)
     // Mouse HID Interface
     USB_Descriptor_Interface_t            Mouse_Interface;
     USB_HID_Descriptor_HID_t              Mouse_HID;
     USB_Descriptor_Endpoint_t             Mouse_INEndpoint;
 #endif
 
-#ifdef EXTRAKEY_ENABLE
+#if defined(EXTRAKEY_ENABLE) && !defined(SHARED_EP_ENABLE)
     // Extrakey HID Interface
     USB_Descriptor_Interface_t            Extrakey_Interface;
     USB_HID_Descriptor_HID_t              Extrakey_HID;
@@ -87,13 +95,20 @@ typedef struct
     USB_Descriptor_Endpoint_t             Console_OUTEndpoint;
 #endif
 
-#ifdef NKRO_ENABLE
+#if defined(NKRO_ENABLE) && !defined(SHARED_EP_ENABLE)
     // NKRO HID Interface
     USB_Descriptor_Interface_t            NKRO_Interface;
     USB_HID_Descriptor_HID_t              NKRO_HID;
     USB_Descriptor_Endpoint_t             NKRO_INEndpoint;
 #endif
 
+#ifdef STENO_HID_ENABLE
+    // Steno HID Interface
+    USB_Descriptor_Interface_t            Steno_Interface;
+    USB_HID_Descriptor_HID_t              Steno_HID;
+    USB_Descriptor_Endpoint_t             Steno_INEndpoint;
+#endif
+
 #ifdef MIDI_ENABLE
       // MIDI Audio Control Interface
       USB_Descriptor_Interface_t                Audio_ControlInterface;
@@ -130,6 +145,13 @@ typedef struct
 } USB_Descriptor_Configuration_t;
 
 
+/* The shared endpoint carries the mouse, system, consumer and NKRO reports,
+ * prefixed by their report IDs, in place of their own endpoints. The boot
+ * keyboard always has an endpoint of its own. */
+#if defined(SHARED_EP_ENABLE) && !defined(MOUSE_ENABLE) && !defined(EXTRAKEY_ENABLE) && !defined(NKRO_ENABLE)
+# error "SHARED_EP_ENABLE needs at least one of MOUSE, EXTRAKEY or NKRO"
+#endif
+
 /* index of interface */
 #define KEYBOARD_INTERFACE          0
 
@@ -142,16 +164,21 @@ typedef struct
 #   define RAW_INTERFACE        	KEYBOARD_INTERFACE
 #endif
 
-#ifdef MOUSE_ENABLE
-#   define MOUSE_INTERFACE          (RAW_INTERFACE + 1)
-#else
-#   define MOUSE_INTERFACE          RAW_INTERFACE
-#endif
-
-#ifdef EXTRAKEY_ENABLE
-#   define EXTRAKEY_INTERFACE       (MOUSE_INTERFACE + 1)
+#ifdef SHARED_EP_ENABLE
+#   define SHARED_INTERFACE         (RAW_INTERFACE + 1)
+#   define MOUSE_INTERFACE          SHARED_INTERFACE
+#   define EXTRAKEY_INTERFACE       SHARED_INTERFACE
 #else
-#   define EXTRAKEY_INTERFACE       MOUSE_INTERFACE
+#   ifdef MOUSE_ENABLE
+#       define MOUSE_INTERFACE      (RAW_INTERFACE + 1)
+#   else
+#       define MOUSE_INTERFACE      RAW_INTERFACE
+#   endif
+#   ifdef EXTRAKEY_ENABLE
+#       define EXTRAKEY_INTERFACE   (MOUSE_INTERFACE + 1)
+#   else
+#       define EXTRAKEY_INTERFACE   MOUSE_INTERFACE
+#   endif
 #endif
 
 #ifdef CONSOLE_ENABLE
@@ -160,17 +187,28 @@ typedef struct
 #   define CONSOLE_INTERFACE        EXTRAKEY_INTERFACE
 #endif
 
-#ifdef NKRO_ENABLE
+#if defined(NKRO_ENABLE) && defined(SHARED_EP_ENABLE)
+#   define NKRO_INTERFACE           SHARED_INTERFACE
+#   define NKRO_LAST_INTERFACE      CONSOLE_INTERFACE
+#elif defined(NKRO_ENABLE)
 #   define NKRO_INTERFACE           (CONSOLE_INTERFACE + 1)
+#   define NKRO_LAST_INTERFACE      NKRO_INTERFACE
+#else
+#   define NKRO_LAST_INTERFACE      CONSOLE_INTERFACE
+#endif
+
+#ifdef STENO_HID_ENABLE
+#   define STENO_INTERFACE          (NKRO_LAST_INTERFACE + 1)
+#   define HID_LAST_INTERFACE       STENO_INTERFACE
 #else
-#   define NKRO_INTERFACE           CONSOLE_INTERFACE
+#   define HID_LAST_INTERFACE       NKRO_LAST_INTERFACE
 #endif
 
 #ifdef MIDI_ENABLE
-#   define AC_INTERFACE           (NKRO_INTERFACE + 1)
-#   define AS_INTERFACE           (NKRO_INTERFACE + 2)
+#   define AC_INTERFACE           (HID_LAST_INTERFACE + 1)
+#   define AS_INTERFACE           (HID_LAST_INTERFACE + 2)
 #else
-#   define AS_INTERFACE           NKRO_INTERFACE
+#   define AS_INTERFACE           HID_LAST_INTERFACE
 #endif
 
 #ifdef VIRTSER_ENABLE
@@ -187,16 +225,21 @@ typedef struct
 // Endopoint number and size
 #define KEYBOARD_IN_EPNUM           1
 
-#ifdef MOUSE_ENABLE
-#   define MOUSE_IN_EPNUM           (KEYBOARD_IN_EPNUM + 1)
-#else
-#   define MOUSE_IN_EPNUM           KEYBOARD_IN_EPNUM
-#endif
-
-#ifdef EXTRAKEY_ENABLE
-#   define EXTRAKEY_IN_EPNUM        (MOUSE_IN_EPNUM + 1)
+#ifdef SHARED_EP_ENABLE
+#   define SHARED_IN_EPNUM          (KEYBOARD_IN_EPNUM + 1)
+#   define MOUSE_IN_EPNUM           SHARED_IN_EPNUM
+#   define EXTRAKEY_IN_EPNUM        SHARED_IN_EPNUM
 #else
-#   define EXTRAKEY_IN_EPNUM        MOUSE_IN_EPNUM
+#   ifdef MOUSE_ENABLE
+#       define MOUSE_IN_EPNUM       (KEYBOARD_IN_EPNUM + 1)
+#   else
+#       define MOUSE_IN_EPNUM       KEYBOARD_IN_EPNUM
+#   endif
+#   ifdef EXTRAKEY_ENABLE
+#       define EXTRAKEY_IN_EPNUM    (MOUSE_IN_EPNUM + 1)
+#   else
+#       define EXTRAKEY_IN_EPNUM    MOUSE_IN_EPNUM
+#   endif
 #endif
 
 #ifdef RAW_ENABLE
@@ -214,20 +257,31 @@ typedef struct
 #   define CONSOLE_OUT_EPNUM        RAW_OUT_EPNUM
 #endif
 
-#ifdef NKRO_ENABLE
+#if defined(NKRO_ENABLE) && defined(SHARED_EP_ENABLE)
+#   define NKRO_IN_EPNUM            SHARED_IN_EPNUM
+#   define NKRO_LAST_EPNUM          CONSOLE_OUT_EPNUM
+#elif defined(NKRO_ENABLE)
 #   define NKRO_IN_EPNUM            (CONSOLE_OUT_EPNUM + 1)
+#   define NKRO_LAST_EPNUM          NKRO_IN_EPNUM
 #else
-#   define NKRO_IN_EPNUM            CONSOLE_OUT_EPNUM
+#   define NKRO_LAST_EPNUM          CONSOLE_OUT_EPNUM
+#endif
+
+#ifdef STENO_HID_ENABLE
+#   define STENO_IN_EPNUM           (NKRO_LAST_EPNUM + 1)
+#   define HID_LAST_EPNUM           STENO_IN_EPNUM
+#else
+#   define HID_LAST_EPNUM           NKRO_LAST_EPNUM
 #endif
 
 #ifdef MIDI_ENABLE
-#   define MIDI_STREAM_IN_EPNUM     (NKRO_IN_EPNUM + 1)
-// #   define MIDI_STREAM_OUT_EPNUM    (NKRO_IN_EPNUM + 1)
-#   define MIDI_STREAM_OUT_EPNUM    (NKRO_IN_EPNUM + 2)
+#   define MIDI_STREAM_IN_EPNUM     (HID_LAST_EPNUM + 1)
+// #   define MIDI_STREAM_OUT_EPNUM    (HID_LAST_EPNUM + 1)
+#   define MIDI_STREAM_OUT_EPNUM    (HID_LAST_EPNUM + 2)
 #   define MIDI_STREAM_IN_EPADDR    (ENDPOINT_DIR_IN | MIDI_STREAM_IN_EPNUM)
 #   define MIDI_STREAM_OUT_EPADDR   (ENDPOINT_DIR_OUT | MIDI_STREAM_OUT_EPNUM)
 #else
-#   define MIDI_STREAM_OUT_EPNUM     NKRO_IN_EPNUM
+#   define MIDI_STREAM_OUT_EPNUM     HID_LAST_EPNUM
 #endif
 
 #ifdef VIRTSER_ENABLE
@@ -255,6 +309,13 @@ typedef struct
 #define MIDI_STREAM_EPSIZE          64
 #define CDC_NOTIFICATION_EPSIZE     8
 #define CDC_EPSIZE                  16
+#define STENO_EPSIZE                16
+/* NKRO reports grow by the report ID byte */
+#ifdef NKRO_ENABLE
+#   define SHARED_EPSIZE            64
+#else
+#   define SHARED_EPSIZE            8
+#endif
 
 
 uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
@@ -66,6 +66,10 @@
     #include <audio.h>
 #endif
 
+#ifdef TRACE_ENABLE
+    #include "trace.h"
+#endif
+
 #ifdef BLUETOOTH_ENABLE
   #ifdef MODULE_ADAFRUIT_BLE
     #include "adafruit_ble.h"
@@ -84,12 +88,24 @@
 
 #ifdef MIDI_ENABLE
   #include "sysex_tools.h"
+  #include "midi_output.h"
 #endif
 
 #ifdef RAW_ENABLE
 	#include "raw_hid.h"
 #endif
 
+#ifdef STENO_HID_ENABLE
+	#include "steno_hid.h"
+#endif
+
+#ifdef RAW_TRANSFER_ENABLE
+	#include "raw_transfer.h"
+	#if RAW_EPSIZE != RAW_TRANSFER_PACKET_SIZE
+		#error "Raw transfers need RAW_EPSIZE packets of RAW_TRANSFER_PACKET_SIZE"
+	#endif
+#endif
+
 uint8_t keyboard_idle = 0;
 /* 0: Boot Protocol, 1: Report Protocol(default) */
 uint8_t keyboard_protocol = 1;
@@ -109,6 +125,7 @@ static void send_keyboard(report_keyboard_t *report);
 static void send_mouse(report_mouse_t *report);
 static void send_system(uint16_t data);
 static void send_consumer(uint16_t data);
+static void clear_pending_reports(void);
 host_driver_t lufa_driver = {
     keyboard_leds,
     send_keyboard,
@@ -187,22 +204,23 @@ USB_ClassInfo_CDC_Device_t cdc_device =
 
 #ifdef RAW_ENABLE
 
-void raw_hid_send( uint8_t *data, uint8_t length )
+bool raw_hid_try_send( const uint8_t *data, uint8_t length )
 {
 	// TODO: implement variable size packet
 	if ( length != RAW_EPSIZE )
 	{
-		return;
+		return false;
 	}
 
 	if (USB_DeviceState != DEVICE_STATE_Configured)
 	{
-		return;
+		return false;
 	}
 
 	// TODO: decide if we allow calls to raw_hid_send() in the middle
 	// of other endpoint usage.
 	uint8_t ep = Endpoint_GetCurrentEndpoint();
+	bool sent = false;
 
 	Endpoint_SelectEndpoint(RAW_IN_EPNUM);
 
@@ -213,9 +231,16 @@ void raw_hid_send( uint8_t *data, uint8_t length )
 		Endpoint_Write_Stream_LE(data, RAW_EPSIZE, NULL);
 		// Finalize the stream transfer to send the last packet
 		Endpoint_ClearIN();
+		sent = true;
 	}
 
 	Endpoint_SelectEndpoint(ep);
+	return sent;
+}
+
+void raw_hid_send( uint8_t *data, uint8_t length )
+{
+	raw_hid_try_send(data, length);
 }
 
 __attribute__ ((weak))
@@ -224,6 +249,9 @@ void raw_hid_receive( uint8_t *data, uint8_t length )
 	// Users should #include "raw_hid.h" in their own code
 	// and implement this function there. Leave this as weak linkage
 	// so users can opt to not handle data coming in.
+#ifdef RAW_TRANSFER_ENABLE
+	raw_transfer_hid_receive(data, length);
+#endif
 }
 
 static void raw_hid_task(void)
@@ -257,6 +285,36 @@ static void raw_hid_task(void)
 			raw_hid_receive( data, sizeof(data) );
 		}
 	}
+
+#ifdef RAW_TRANSFER_ENABLE
+	raw_transfer_device_task();
+#endif
+}
+#endif
+
+/*******************************************************************************
+ * Steno HID
+ ******************************************************************************/
+#ifdef STENO_HID_ENABLE
+bool steno_hid_try_send(const uint8_t *report)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return false;
+
+    uint8_t ep = Endpoint_GetCurrentEndpoint();
+    bool sent = false;
+
+    Endpoint_SelectEndpoint(STENO_IN_EPNUM);
+
+    /* The whole stroke goes in one packet, or waits for the next call */
+    if (Endpoint_IsINReady()) {
+        Endpoint_Write_Stream_LE(report, STENO_HID_REPORT_SIZE, NULL);
+        Endpoint_ClearIN();
+        sent = true;
+    }
+
+    Endpoint_SelectEndpoint(ep);
+    return sent;
 }
 #endif
 
@@ -315,6 +373,24 @@ static void Console_Task(void)
 
     Endpoint_SelectEndpoint(ep);
 }
+
+#ifdef TRACE_ENABLE
+// Trace records are only formatted into the room left in the console bank,
+// so that sendchar() doesn't have to wait for the host
+uint8_t trace_output_room(void)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return 0;
+
+    uint8_t ep = Endpoint_GetCurrentEndpoint();
+    Endpoint_SelectEndpoint(CONSOLE_IN_EPNUM);
+    uint8_t room = 0;
+    if (Endpoint_IsEnabled() && Endpoint_IsConfigured() && Endpoint_IsReadWriteAllowed())
+        room = CONSOLE_EPSIZE - Endpoint_BytesInEndpoint();
+    Endpoint_SelectEndpoint(ep);
+    return room;
+}
+#endif
 #endif
 
 
@@ -356,6 +432,11 @@ void EVENT_USB_Device_Disconnect(void)
 void EVENT_USB_Device_Reset(void)
 {
     print("[R]");
+    clear_pending_reports();
+#ifdef RAW_TRANSFER_ENABLE
+    // the host driver starts over, and so do its message ids
+    raw_transfer_reset_session();
+#endif
 }
 
 void EVENT_USB_Device_Suspend()
@@ -412,17 +493,25 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 {
     bool ConfigSuccess = true;
 
+    clear_pending_reports();
+
     /* Setup Keyboard HID Report Endpoints */
     ConfigSuccess &= ENDPOINT_CONFIG(KEYBOARD_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
                                      KEYBOARD_EPSIZE, ENDPOINT_BANK_SINGLE);
 
-#ifdef MOUSE_ENABLE
+#ifdef SHARED_EP_ENABLE
+    /* Setup Shared HID Report Endpoint */
+    ConfigSuccess &= ENDPOINT_CONFIG(SHARED_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
+                                     SHARED_EPSIZE, ENDPOINT_BANK_SINGLE);
+#endif
+
+#if defined(MOUSE_ENABLE) && !defined(SHARED_EP_ENABLE)
     /* Setup Mouse HID Report Endpoint */
     ConfigSuccess &= ENDPOINT_CONFIG(MOUSE_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
                                      MOUSE_EPSIZE, ENDPOINT_BANK_SINGLE);
 #endif
 
-#ifdef EXTRAKEY_ENABLE
+#if defined(EXTRAKEY_ENABLE) && !defined(SHARED_EP_ENABLE)
     /* Setup Extra HID Report Endpoint */
     ConfigSuccess &= ENDPOINT_CONFIG(EXTRAKEY_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
                                      EXTRAKEY_EPSIZE, ENDPOINT_BANK_SINGLE);
@@ -446,12 +535,18 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 #endif
 #endif
 
-#ifdef NKRO_ENABLE
+#if defined(NKRO_ENABLE) && !defined(SHARED_EP_ENABLE)
     /* Setup NKRO HID Report Endpoints */
     ConfigSuccess &= ENDPOINT_CONFIG(NKRO_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
                                      NKRO_EPSIZE, ENDPOINT_BANK_SINGLE);
 #endif
 
+#ifdef STENO_HID_ENABLE
+    /* Setup Steno HID Report Endpoint */
+    ConfigSuccess &= ENDPOINT_CONFIG(STENO_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
+                                     STENO_EPSIZE, ENDPOINT_BANK_SINGLE);
+#endif
+
 #ifdef MIDI_ENABLE
     ConfigSuccess &= Endpoint_ConfigureEndpoint(MIDI_STREAM_IN_EPADDR, EP_TYPE_BULK, MIDI_STREAM_EPSIZE, ENDPOINT_BANK_SINGLE);
     ConfigSuccess &= Endpoint_ConfigureEndpoint(MIDI_STREAM_OUT_EPADDR, EP_TYPE_BULK, MIDI_STREAM_EPSIZE, ENDPOINT_BANK_SINGLE);
@@ -524,6 +619,12 @@ void EVENT_USB_Device_ControlRequest(void)
                         if (USB_DeviceState == DEVICE_STATE_Unattached)
                           return;
                     }
+#ifdef SHARED_EP_ENABLE
+                    /* the NKRO LED report on the shared interface starts with its report ID */
+                    if (USB_ControlRequest.wLength == 2) {
+                        Endpoint_Read_8();
+                    }
+#endif
                     keyboard_led_stats = Endpoint_Read_8();
 
                     Endpoint_ClearOUT();
@@ -597,9 +698,105 @@ static uint8_t keyboard_leds(void)
     return keyboard_led_stats;
 }
 
+/*******************************************************************************
+ * Pending reports, see pending_report.h
+ ******************************************************************************/
+#ifdef SHARED_EP_ENABLE
+#define SHARED_REPORT_ID(id) (id)
+#else
+#define SHARED_REPORT_ID(id) 0
+#endif
+
+static uint8_t keyboard_pending_buffer[PENDING_REPORTS][KEYBOARD_EPSIZE];
+static pending_report_t keyboard_pending = {KEYBOARD_IN_EPNUM, 0, KEYBOARD_EPSIZE, 0, pending_report_same, keyboard_pending_buffer[0]};
+#ifdef NKRO_ENABLE
+static uint8_t nkro_pending_buffer[PENDING_REPORTS][NKRO_EPSIZE];
+static pending_report_t nkro_pending = {NKRO_IN_EPNUM, SHARED_REPORT_ID(REPORT_ID_NKRO), NKRO_EPSIZE, 0, pending_report_same, nkro_pending_buffer[0]};
+#endif
+
+#ifdef MOUSE_ENABLE
+static bool add_fits(int8_t *a, int8_t b)
+{
+    int16_t sum = *a + b;
+    if (sum > 127 || sum < -127) return false;
+    *a = sum;
+    return true;
+}
+
+/* the movement can be accumulated, as long as the buttons stay the same */
+static bool coalesce_mouse(uint8_t *pending, const uint8_t *report, uint8_t size)
+{
+    report_mouse_t *p = (report_mouse_t *)pending;
+    const report_mouse_t *r = (const report_mouse_t *)report;
+    report_mouse_t sum = *p;
+    if (p->buttons != r->buttons) return false;
+    if (!add_fits(&sum.x, r->x) || !add_fits(&sum.y, r->y) || !add_fits(&sum.v, r->v) || !add_fits(&sum.h, r->h)) return false;
+    *p = sum;
+    return true;
+}
+
+static uint8_t mouse_pending_buffer[PENDING_REPORTS][sizeof(report_mouse_t)];
+static pending_report_t mouse_pending = {MOUSE_IN_EPNUM, SHARED_REPORT_ID(REPORT_ID_MOUSE), sizeof(report_mouse_t), 0, coalesce_mouse, mouse_pending_buffer[0]};
+#endif
+
+#ifdef EXTRAKEY_ENABLE
+/* the report ID is already part of the report */
+static uint8_t extra_pending_buffer[PENDING_REPORTS][sizeof(report_extra_t)];
+static pending_report_t extra_pending = {EXTRAKEY_IN_EPNUM, 0, sizeof(report_extra_t), 0, pending_report_same, extra_pending_buffer[0]};
+#endif
+
+/* highest priority first */
+static pending_report_t *const pending_reports[] = {
+    &keyboard_pending,
+#ifdef NKRO_ENABLE
+    &nkro_pending,
+#endif
+#ifdef EXTRAKEY_ENABLE
+    &extra_pending,
+#endif
+#ifdef MOUSE_ENABLE
+    &mouse_pending,
+#endif
+};
+
+#define NUM_PENDING_REPORTS (sizeof(pending_reports) / sizeof(pending_reports[0]))
+
+bool pending_report_write(pending_report_t *slot, const void *report)
+{
+    Endpoint_SelectEndpoint(slot->epnum);
+    if (!Endpoint_IsReadWriteAllowed()) return false;
+    if (slot->report_id) {
+        Endpoint_Write_8(slot->report_id);
+    }
+    Endpoint_Write_Stream_LE(report, slot->size, NULL);
+    Endpoint_ClearIN();
+    return true;
+}
+
+static void send_report(pending_report_t *slot, const void *report)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured) {
+        slot->count = 0;
+        return;
+    }
+    pending_report_send(pending_reports, NUM_PENDING_REPORTS, slot, report);
+}
+
+/* called from the main loop */
+static void retry_pending_reports(void)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured) return;
+    pending_report_retry(pending_reports, NUM_PENDING_REPORTS);
+}
+
+/* the reports for the previous configuration are never sent */
+static void clear_pending_reports(void)
+{
+    pending_report_clear(pending_reports, NUM_PENDING_REPORTS);
+}
+
 static void send_keyboard(report_keyboard_t *report)
 {
-    uint8_t timeout = 255;
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -626,43 +823,24 @@ static void send_keyboard(report_keyboard_t *report)
       return;
     }
 
-    /* Select the Keyboard Report Endpoint */
 #ifdef NKRO_ENABLE
     if (keyboard_protocol && keymap_config.nkro) {
         /* Report protocol - NKRO */
-        Endpoint_SelectEndpoint(NKRO_IN_EPNUM);
-
-        /* Check if write ready for a polling interval around 1ms */
-        while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(4);
-        if (!Endpoint_IsReadWriteAllowed()) return;
-
-        /* Write Keyboard Report Data */
-        Endpoint_Write_Stream_LE(report, NKRO_EPSIZE, NULL);
+        send_report(&nkro_pending, report);
     }
     else
 #endif
     {
         /* Boot protocol */
-        Endpoint_SelectEndpoint(KEYBOARD_IN_EPNUM);
-
-        /* Check if write ready for a polling interval around 10ms */
-        while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-        if (!Endpoint_IsReadWriteAllowed()) return;
-
-        /* Write Keyboard Report Data */
-        Endpoint_Write_Stream_LE(report, KEYBOARD_EPSIZE, NULL);
+        send_report(&keyboard_pending, report);
     }
 
-    /* Finalize the stream transfer to send the last packet */
-    Endpoint_ClearIN();
-
     keyboard_report_sent = *report;
 }
 
 static void send_mouse(report_mouse_t *report)
 {
 #ifdef MOUSE_ENABLE
-    uint8_t timeout = 255;
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -688,45 +866,23 @@ static void send_mouse(report_mouse_t *report)
       return;
     }
 
-    /* Select the Mouse Report Endpoint */
-    Endpoint_SelectEndpoint(MOUSE_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    /* Write Mouse Report Data */
-    Endpoint_Write_Stream_LE(report, sizeof(report_mouse_t), NULL);
-
-    /* Finalize the stream transfer to send the last packet */
-    Endpoint_ClearIN();
+    send_report(&mouse_pending, report);
 #endif
 }
 
 static void send_system(uint16_t data)
 {
-    uint8_t timeout = 255;
-
-    if (USB_DeviceState != DEVICE_STATE_Configured)
-        return;
-
+#ifdef EXTRAKEY_ENABLE
     report_extra_t r = {
         .report_id = REPORT_ID_SYSTEM,
         .usage = data - SYSTEM_POWER_DOWN + 1
     };
-    Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
-    Endpoint_ClearIN();
+    send_report(&extra_pending, &r);
+#endif
 }
 
 static void send_consumer(uint16_t data)
 {
-    uint8_t timeout = 255;
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -765,18 +921,13 @@ static void send_consumer(uint16_t data)
       return;
     }
 
+#ifdef EXTRAKEY_ENABLE
     report_extra_t r = {
         .report_id = REPORT_ID_CONSUMER,
         .usage = data
     };
-    Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
-    Endpoint_ClearIN();
+    send_report(&extra_pending, &r);
+#endif
 }
 
 
@@ -853,68 +1004,40 @@ int8_t sendchar(uint8_t c)
  ******************************************************************************/
 
 #ifdef MIDI_ENABLE
-static void usb_send_func(MidiDevice * device, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
-  MIDI_EventPacket_t event;
-  event.Data1 = byte0;
-  event.Data2 = byte1;
-  event.Data3 = byte2;
-
-  uint8_t cable = 0;
-
-// Endpoint_SelectEndpoint(MIDI_STREAM_IN_EPNUM);
-
-  //if the length is undefined we assume it is a SYSEX message
-  if (midi_packet_length(byte0) == UNDEFINED) {
-    switch(cnt) {
-      case 3:
-        if (byte2 == SYSEX_END)
-          event.Event = MIDI_EVENT(cable, SYSEX_ENDS_IN_3);
-        else
-          event.Event = MIDI_EVENT(cable, SYSEX_START_OR_CONT);
-        break;
-      case 2:
-        if (byte1 == SYSEX_END)
-          event.Event = MIDI_EVENT(cable, SYSEX_ENDS_IN_2);
-        else
-          event.Event = MIDI_EVENT(cable, SYSEX_START_OR_CONT);
-        break;
-      case 1:
-        if (byte0 == SYSEX_END)
-          event.Event = MIDI_EVENT(cable, SYSEX_ENDS_IN_1);
-        else
-          event.Event = MIDI_EVENT(cable, SYSEX_START_OR_CONT);
-        break;
-      default:
-        return; //invalid cnt
-    }
-  } else {
-    //deal with 'system common' messages
-    //TODO are there any more?
-    switch(byte0 & 0xF0){
-      case MIDI_SONGPOSITION:
-        event.Event = MIDI_EVENT(cable, SYS_COMMON_3);
-        break;
-      case MIDI_SONGSELECT:
-      case MIDI_TC_QUARTERFRAME:
-        event.Event = MIDI_EVENT(cable, SYS_COMMON_2);
-        break;
-      default:
-        event.Event = MIDI_EVENT(cable, byte0);
-        break;
-    }
+/* Messages wait here until the main loop sends them all in one bulk packet */
+static midi_batch_t midi_batch;
+
+static void usb_send_midi_batch(void) {
+  if (midi_batch.count == 0)
+    return;
+
+  if (USB_DeviceState == DEVICE_STATE_Configured) {
+    uint8_t ep = Endpoint_GetCurrentEndpoint();
+    Endpoint_SelectEndpoint(MIDI_STREAM_IN_EPADDR);
+    Endpoint_Write_Stream_LE(midi_batch.events, midi_batch_bytes(&midi_batch), NULL);
+    Endpoint_ClearIN();
+    Endpoint_SelectEndpoint(ep);
   }
+  midi_batch_clear(&midi_batch);
+}
 
-// Endpoint_Write_Stream_LE(&event, sizeof(event), NULL);
-// Endpoint_ClearIN();
+static void usb_send_func(MidiDevice * device, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+  uint8_t event[MIDI_USB_EVENT_SIZE];
 
-  MIDI_Device_SendEventPacket(&USB_MIDI_Interface, &event);
-  MIDI_Device_Flush(&USB_MIDI_Interface);
-  MIDI_Device_USBTask(&USB_MIDI_Interface);
-  USB_USBTask();
+  if (!midi_usb_event(0, cnt, byte0, byte1, byte2, event))
+    return; //invalid cnt
+
+  if (midi_batch_full(&midi_batch))
+    usb_send_midi_batch();
+  midi_batch_add(&midi_batch, event);
 }
 
 static void usb_get_midi(MidiDevice * device) {
   MIDI_EventPacket_t event;
+
+  //called once per main loop, send what was queued since the last one
+  usb_send_midi_batch();
+
   while (MIDI_Device_ReceiveEventPacket(&USB_MIDI_Interface, &event)) {
 
     midi_packet_length_t length = midi_packet_length(event.Data1);
@@ -1191,6 +1314,7 @@ int main(void)
         #endif
 
         keyboard_task();
+        retry_pending_reports();
 
 #ifdef MIDI_ENABLE
         midi_device_process(&midi_device);
@@ -48,6 +48,7 @@
 #include <LUFA/Version.h>
 #include <LUFA/Drivers/USB/USB.h>
 #include "host.h"
+#include "pending_report.h"
 #ifdef MIDI_ENABLE
   #include "process_midi.h"
 #endif
@@ -0,0 +1,86 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "pending_report.h"
+#include "timer.h"
+
+usb_report_stats_t usb_report_stats;
+
+/* sends the waiting reports of slot, false if some are still waiting */
+static bool retry_slot(pending_report_t *slot)
+{
+    while (slot->count && pending_report_write(slot, slot->reports)) {
+        slot->count--;
+        memmove(slot->reports, slot->reports + slot->size, slot->count * slot->size);
+        usb_report_stats.retried++;
+    }
+    return !slot->count;
+}
+
+/* sends the waiting reports that go before a new report of slot */
+static bool retry_preceding(pending_report_t *const *slots, uint8_t num_slots, pending_report_t *slot)
+{
+    for (uint8_t i = 0; i < num_slots && slots[i] != slot; i++) {
+        if (slots[i]->epnum == slot->epnum && !retry_slot(slots[i])) {
+            return false;
+        }
+    }
+    /* the waiting reports of the slot itself have to go first too, to keep the order */
+    return retry_slot(slot);
+}
+
+void pending_report_send(pending_report_t *const *slots, uint8_t num_slots, pending_report_t *slot, const void *report)
+{
+    if (retry_preceding(slots, num_slots, slot) && pending_report_write(slot, report)) {
+        return;
+    }
+    if (slot->count && slot->coalesce(slot->reports + (slot->count - 1) * slot->size, report, slot->size)) {
+        usb_report_stats.coalesced++;
+        return;
+    }
+    if (slot->count == PENDING_REPORTS) {
+        /* all of them are state changes, so wait for the endpoint to take one */
+        uint16_t start = timer_read();
+        while (!retry_preceding(slots, num_slots, slot) && slot->count == PENDING_REPORTS) {
+            if (timer_elapsed(start) >= PENDING_REPORT_TIMEOUT) {
+                usb_report_stats.dropped++;
+                return;
+            }
+        }
+    }
+    memcpy(slot->reports + slot->count * slot->size, report, slot->size);
+    slot->count++;
+}
+
+void pending_report_retry(pending_report_t *const *slots, uint8_t num_slots)
+{
+    for (uint8_t i = 0; i < num_slots; i++) {
+        retry_slot(slots[i]);
+    }
+}
+
+void pending_report_clear(pending_report_t *const *slots, uint8_t num_slots)
+{
+    for (uint8_t i = 0; i < num_slots; i++) {
+        slots[i]->count = 0;
+    }
+}
+
+bool pending_report_same(uint8_t *pending, const uint8_t *report, uint8_t size)
+{
+    return memcmp(pending, report, size) == 0;
+}
@@ -0,0 +1,86 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PENDING_REPORT_H
+#define PENDING_REPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Reports waiting for a busy IN endpoint
+ *
+ * When an endpoint is still busy with the previous report, the new one waits
+ * in a small FIFO of its slot, and is retried from the main loop, instead of
+ * busy waiting for the host to poll the endpoint. A waiting report is only
+ * coalesced with a newer one when nothing is lost, like mouse motion with
+ * the same buttons, so a key tapped while the endpoint is busy still sends
+ * both the press and the release. Only when the FIFO is full does sending
+ * wait for the endpoint, up to PENDING_REPORT_TIMEOUT ms, before the report
+ * is dropped.
+ *
+ * Several slots can share an endpoint, like with SHARED_EP_ENABLE. Their
+ * reports are sent in the order of the slot list, highest priority first,
+ * so that keystrokes never wait behind mouse or media key reports.
+ */
+
+/* Number of reports that can wait in each slot */
+#ifndef PENDING_REPORTS
+#define PENDING_REPORTS 4
+#endif
+
+#ifndef PENDING_REPORT_TIMEOUT
+#define PENDING_REPORT_TIMEOUT 10
+#endif
+
+/* Reports that found their endpoint busy */
+typedef struct {
+    /* reports dropped because their slot stayed full */
+    uint16_t dropped;
+    /* waiting reports sent later, once the endpoint was free */
+    uint16_t retried;
+    /* reports combined with a waiting one */
+    uint16_t coalesced;
+} usb_report_stats_t;
+
+extern usb_report_stats_t usb_report_stats;
+
+typedef struct {
+    uint8_t epnum;
+    /* written before the report, 0 for reports that don't need one */
+    uint8_t report_id;
+    uint8_t size;
+    /* the number of waiting reports, the oldest first */
+    uint8_t count;
+    /* combines report into the newest waiting one, false if that would lose something */
+    bool (*coalesce)(uint8_t *pending, const uint8_t *report, uint8_t size);
+    /* room for PENDING_REPORTS reports */
+    uint8_t *reports;
+} pending_report_t;
+
+/* slots lists all the slots, highest priority first */
+void pending_report_send(pending_report_t *const *slots, uint8_t num_slots, pending_report_t *slot, const void *report);
+/* Sends what the endpoints have room for, called from the main loop */
+void pending_report_retry(pending_report_t *const *slots, uint8_t num_slots);
+void pending_report_clear(pending_report_t *const *slots, uint8_t num_slots);
+
+/* Coalescing function for state reports, which only drops repeated reports */
+bool pending_report_same(uint8_t *pending, const uint8_t *report, uint8_t size);
+
+/* Implemented by the USB driver, writes the report if the endpoint is free */
+bool pending_report_write(pending_report_t *slot, const void *report);
+
+#endif
@@ -48,8 +48,10 @@ extern "C" {
  */
 
 #include "midi_function_types.h"
-#include "bytequeue/bytequeue.h"
-#define MIDI_INPUT_QUEUE_LENGTH 192
+#include "spsc_ring.h"
+#define MIDI_INPUT_QUEUE_LENGTH 128
+
+SPSC_RING_DEFINE(midi_input_queue, uint8_t, MIDI_INPUT_QUEUE_LENGTH)
 
 typedef enum {
    IDLE, 
@@ -108,8 +110,7 @@ struct _midi_device {
    uint16_t input_count;
 
    //for queueing data between the input and the processing functions
-   uint8_t input_queue_data[MIDI_INPUT_QUEUE_LENGTH];
-   byteQueue_t input_queue;
+   midi_input_queue_t input_queue;
 };
 
 /**
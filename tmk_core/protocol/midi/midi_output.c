@@ -0,0 +1,152 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "midi_output.h"
+#include "midi.h"
+#include <string.h>
+
+/* USB-MIDI code index numbers */
+#define CIN_SYS_COMMON_2 0x2
+#define CIN_SYS_COMMON_3 0x3
+#define CIN_SYSEX_START_OR_CONT 0x4
+#define CIN_SYSEX_ENDS_IN_1 0x5
+#define CIN_SYSEX_ENDS_IN_2 0x6
+#define CIN_SYSEX_ENDS_IN_3 0x7
+
+bool midi_usb_event(uint8_t cable, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2, uint8_t *event) {
+  uint8_t cin;
+
+  //if the length is undefined we assume it is a SYSEX message
+  if (midi_packet_length(byte0) == UNDEFINED) {
+    switch (cnt) {
+      case 3:
+        cin = byte2 == SYSEX_END ? CIN_SYSEX_ENDS_IN_3 : CIN_SYSEX_START_OR_CONT;
+        break;
+      case 2:
+        cin = byte1 == SYSEX_END ? CIN_SYSEX_ENDS_IN_2 : CIN_SYSEX_START_OR_CONT;
+        break;
+      case 1:
+        cin = byte0 == SYSEX_END ? CIN_SYSEX_ENDS_IN_1 : CIN_SYSEX_START_OR_CONT;
+        break;
+      default:
+        return false;
+    }
+  } else {
+    switch (byte0) {
+      case MIDI_SONGPOSITION:
+        cin = CIN_SYS_COMMON_3;
+        break;
+      case MIDI_SONGSELECT:
+      case MIDI_TC_QUARTERFRAME:
+        cin = CIN_SYS_COMMON_2;
+        break;
+      default:
+        //channel messages, and single bytes
+        cin = byte0 >> 4;
+        break;
+    }
+  }
+
+  event[0] = (cable << 4) | cin;
+  event[1] = byte0;
+  event[2] = byte1;
+  event[3] = byte2;
+  return true;
+}
+
+void midi_batch_clear(midi_batch_t *batch) {
+  batch->count = 0;
+}
+
+bool midi_batch_add(midi_batch_t *batch, const uint8_t *event) {
+  if (midi_batch_full(batch))
+    return false;
+  memcpy(batch->events[batch->count++], event, MIDI_USB_EVENT_SIZE);
+  return true;
+}
+
+void midi_running_status_reset(midi_running_status_t *state) {
+  state->status = 0;
+}
+
+uint8_t midi_running_status_encode(midi_running_status_t *state, uint8_t cnt,
+    uint8_t byte0, uint8_t byte1, uint8_t byte2, uint8_t *out) {
+  uint8_t bytes[3] = {byte0, byte1, byte2};
+  uint8_t first = 0;
+
+  if (cnt > 3)
+    cnt = 3;
+  if (midi_is_realtime(byte0)) {
+    //can be sent in the middle of anything
+  } else if (byte0 >= SYSEX_BEGIN) {
+    state->status = 0;
+  } else if (midi_is_statusbyte(byte0)) {
+    if (byte0 == state->status)
+      first = 1;
+    state->status = byte0;
+  }
+  //data bytes are sysex fragments, and are sent as they are
+
+  for (uint8_t i = first; i < cnt; i++)
+    *out++ = bytes[i];
+  return cnt - first;
+}
+
+void midi_note_set_clear(midi_note_set_t *set) {
+  memset(set, 0, sizeof(*set));
+}
+
+bool midi_note_set_add(midi_note_set_t *set, uint8_t note) {
+  uint8_t mask = 1 << (note & 7);
+  uint8_t *bits = &set->bits[(note >> 3) & 15];
+  if (*bits & mask)
+    return false;
+  *bits |= mask;
+  set->count++;
+  return true;
+}
+
+bool midi_note_set_remove(midi_note_set_t *set, uint8_t note) {
+  uint8_t mask = 1 << (note & 7);
+  uint8_t *bits = &set->bits[(note >> 3) & 15];
+  if (!(*bits & mask))
+    return false;
+  *bits &= ~mask;
+  set->count--;
+  return true;
+}
+
+bool midi_note_set_contains(const midi_note_set_t *set, uint8_t note) {
+  return set->bits[(note >> 3) & 15] & (1 << (note & 7));
+}
+
+uint8_t midi_note_set_pop(midi_note_set_t *set) {
+  if (!set->count)
+    return MIDI_NOTE_NONE;
+  for (uint8_t i = 0; i < sizeof(set->bits); i++) {
+    uint8_t bits = set->bits[i];
+    if (!bits)
+      continue;
+    uint8_t bit = 0;
+    while (!(bits & (1 << bit)))
+      bit++;
+    set->bits[i] = bits & ~(1 << bit);
+    set->count--;
+    return i * 8 + bit;
+  }
+  return MIDI_NOTE_NONE;
+}
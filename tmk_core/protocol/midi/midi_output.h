@@ -0,0 +1,108 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MIDI_OUTPUT_H
+#define MIDI_OUTPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Scheduling of outgoing MIDI messages
+ *
+ * Messages are collected into USB-MIDI event packets, and sent together
+ * as one bulk packet per main loop iteration, instead of one bulk packet,
+ * and one USB frame, per message. A serial MIDI port can leave out status
+ * bytes that repeat the previous one (running status). The notes that are
+ * on are kept in a bitmap, so that turning them all off only touches the
+ * notes that are actually held.
+ */
+
+/* USB MIDI 1.0, section 4: cable and code index, followed by the message */
+#define MIDI_USB_EVENT_SIZE 4
+
+/* Events sent together, 16 fill a 64 byte bulk endpoint */
+#ifndef MIDI_BATCH_SIZE
+#define MIDI_BATCH_SIZE 16
+#endif
+
+/* Fills event with the USB-MIDI event packet of a message of cnt bytes,
+ * returns false for a sysex fragment with an invalid count */
+bool midi_usb_event(uint8_t cable, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2, uint8_t *event);
+
+typedef struct {
+  uint8_t count;
+  uint8_t events[MIDI_BATCH_SIZE][MIDI_USB_EVENT_SIZE];
+} midi_batch_t;
+
+void midi_batch_clear(midi_batch_t *batch);
+
+/* Returns false when the batch is full, and has to be sent first */
+bool midi_batch_add(midi_batch_t *batch, const uint8_t *event);
+
+static inline bool midi_batch_full(const midi_batch_t *batch) {
+  return batch->count == MIDI_BATCH_SIZE;
+}
+
+static inline uint16_t midi_batch_bytes(const midi_batch_t *batch) {
+  return batch->count * MIDI_USB_EVENT_SIZE;
+}
+
+/* The status byte of the last channel message sent, 0 if there's none */
+typedef struct {
+  uint8_t status;
+} midi_running_status_t;
+
+void midi_running_status_reset(midi_running_status_t *state);
+
+/* Writes the bytes of a message of cnt bytes for a serial MIDI port into
+ * out, without the status byte if it's the same as the previous one.
+ * System common messages and sysex cancel the running status, real time
+ * messages don't change it. Returns the number of bytes written. */
+uint8_t midi_running_status_encode(midi_running_status_t *state, uint8_t cnt,
+    uint8_t byte0, uint8_t byte1, uint8_t byte2, uint8_t *out);
+
+#define MIDI_NOTE_NONE 0xFF
+
+/* A bit for each of the 128 notes */
+typedef struct {
+  uint8_t bits[16];
+  uint8_t count;
+} midi_note_set_t;
+
+void midi_note_set_clear(midi_note_set_t *set);
+
+/* Returns false if the note was already in the set */
+bool midi_note_set_add(midi_note_set_t *set, uint8_t note);
+
+/* Returns false if the note wasn't in the set */
+bool midi_note_set_remove(midi_note_set_t *set, uint8_t note);
+
+bool midi_note_set_contains(const midi_note_set_t *set, uint8_t note);
+
+/* Removes and returns the lowest note, or MIDI_NOTE_NONE if the set is
+ * empty, skipping 8 notes at a time where none are held */
+uint8_t midi_note_set_pop(midi_note_set_t *set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -64,6 +64,19 @@ uint8_t news_recv(void)
     return data;
 }
 
+/* -1 when there is no data, for converter_task() */
+int16_t news_recv2(void)
+{
+    uint8_t data = 0;
+    if (rbuf_head == rbuf_tail) {
+        return -1;
+    }
+
+    data = rbuf[rbuf_tail];
+    rbuf_tail = (rbuf_tail + 1) % RBUF_SIZE;
+    return data;
+}
+
 // USART RX complete interrupt
 ISR(NEWS_KBD_RX_VECT)
 {
@@ -45,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 /* host role */
 void news_init(void);
 uint8_t news_recv(void);
+int16_t news_recv2(void);
 
 /* device role */
 
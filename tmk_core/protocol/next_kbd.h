@@ -45,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 */
 
+#include <stdint.h>
 #include <stdbool.h>
 
 #ifndef NEXT_KBD_H
@@ -53,6 +54,18 @@ POSSIBILITY OF SUCH DAMAGE.
 #define NEXT_KBD_KMBUS_IDLE 0x300600
 #define NEXT_KBD_TIMING     50
 
+/* response: key code in bits 1-7, the key is pressed when bits 8-11 are
+ * 0x4, and the modifiers are a bitmap from bit 12 */
+#define NEXT_KBD_KEYCODE(response)  ((uint8_t)(((response) & 0xFF) >> 1))
+#define NEXT_KBD_PRESSED_KEYCODE(response)  (((response) & 0xF00) == 0x400)
+#define NEXT_KBD_LCTRL_MASK     ((uint32_t)1 << 12)
+#define NEXT_KBD_LSHIFT_MASK    ((uint32_t)1 << 13)
+#define NEXT_KBD_RSHIFT_MASK    ((uint32_t)1 << 14)
+#define NEXT_KBD_LCMD_MASK      ((uint32_t)1 << 15)
+#define NEXT_KBD_RCMD_MASK      ((uint32_t)1 << 16)
+#define NEXT_KBD_LALT_MASK      ((uint32_t)1 << 17)
+#define NEXT_KBD_RALT_MASK      ((uint32_t)1 << 18)
+
 extern uint8_t next_kbd_error;
 
 /* host role */
@@ -90,8 +90,19 @@ void ps2_host_init(void);
 uint8_t ps2_host_send(uint8_t data);
 uint8_t ps2_host_recv_response(void);
 uint8_t ps2_host_recv(void);
+/* -1 when no data is queued, only the interrupt and USART versions */
+int16_t ps2_host_recv2(void);
 void ps2_host_set_led(uint8_t usb_led);
 
+#ifdef PS2_MOUSE_ENABLE
+#include "ps2_mouse_packet.h"
+/* Stream mode: the interrupt handler assembles packets of packet_size bytes
+ * instead of buffering the bytes, 0 turns it off. Only the interrupt and
+ * USART versions support it. */
+void ps2_host_mouse_stream(uint8_t packet_size);
+bool ps2_host_recv_mouse_packet(ps2_mouse_packet_t *packet);
+#endif
+
 
 /*--------------------------------------------------------------------
  * static functions
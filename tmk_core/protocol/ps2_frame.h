@@ -0,0 +1,97 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PS2_FRAME_H
+#define PS2_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Decodes the frames a PS/2 device sends, one bit per falling clock edge
+ *
+ * start bit(0), data bit0-7 LSB first, odd parity bit, stop bit(1)
+ *
+ * The clock runs at 10-16.7kHz, so a frame takes at most 1.1ms. When a frame
+ * hasn't finished PS2_FRAME_TIMEOUT ms after its start bit, a clock edge was
+ * lost, and the bit is taken as the start bit of the next frame instead of
+ * shifting every following frame by one bit.
+ */
+#ifndef PS2_FRAME_TIMEOUT
+#define PS2_FRAME_TIMEOUT   2
+#endif
+
+/* returned by ps2_frame_bit while the frame isn't complete */
+#define PS2_FRAME_MORE      -1
+/* returned by ps2_frame_bit when a bit is wrong, frame.error has the state */
+#define PS2_FRAME_ERROR     -2
+
+enum ps2_frame_state_e {
+    PS2_FRAME_INIT,
+    PS2_FRAME_START,
+    PS2_FRAME_BIT0,
+    PS2_FRAME_BIT7 = PS2_FRAME_BIT0 + 7,
+    PS2_FRAME_PARITY,
+    PS2_FRAME_STOP,
+};
+
+typedef struct {
+    uint8_t state;
+    uint8_t data;
+    uint8_t parity;
+    uint8_t time;   /* timer_read() of the start bit, truncated */
+    uint8_t error;  /* state of the last error */
+} ps2_frame_t;
+
+/* Takes the data line at a falling clock edge, and returns the byte when
+ * the frame is complete */
+static inline int16_t ps2_frame_bit(ps2_frame_t *frame, bool bit, uint8_t now)
+{
+    if (frame->state != PS2_FRAME_INIT && (uint8_t)(now - frame->time) > PS2_FRAME_TIMEOUT) {
+        frame->state = PS2_FRAME_INIT;
+    }
+
+    uint8_t state = ++frame->state;
+    if (state == PS2_FRAME_START) {
+        if (bit) goto ERROR;
+        frame->time = now;
+        frame->data = 0;
+        frame->parity = 1;
+        return PS2_FRAME_MORE;
+    }
+    if (state <= PS2_FRAME_BIT7) {
+        frame->data >>= 1;
+        if (bit) {
+            frame->data |= 0x80;
+            frame->parity++;
+        }
+        return PS2_FRAME_MORE;
+    }
+    if (state == PS2_FRAME_PARITY) {
+        if (bit != (frame->parity & 0x01)) goto ERROR;
+        return PS2_FRAME_MORE;
+    }
+    if (state == PS2_FRAME_STOP && bit) {
+        frame->state = PS2_FRAME_INIT;
+        return frame->data;
+    }
+ERROR:
+    frame->error = state;
+    frame->state = PS2_FRAME_INIT;
+    return PS2_FRAME_ERROR;
+}
+
+#endif
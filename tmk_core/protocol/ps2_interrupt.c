@@ -42,9 +42,13 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <stdbool.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
+#include <util/atomic.h>
 #include "ps2.h"
 #include "ps2_io.h"
 #include "print.h"
+#include "timer.h"
+#include "spsc_ring.h"
+#include "ps2_frame.h"
 
 
 #define WAIT(stat, us, err) do { \
@@ -63,6 +67,11 @@ static inline void pbuf_enqueue(uint8_t data);
 static inline bool pbuf_has_data(void);
 static inline void pbuf_clear(void);
 
+#ifdef PS2_MOUSE_ENABLE
+static ps2_mouse_framer_t mouse_framer;
+static ps2_mouse_packet_ring_t mouse_packets;
+#endif
+
 
 void ps2_host_init(void)
 {
@@ -151,74 +160,64 @@ uint8_t ps2_host_recv(void)
     }
 }
 
+/* the same, but -1 when there is no data, for converter_task() */
+int16_t ps2_host_recv2(void)
+{
+    if (pbuf_has_data()) {
+        ps2_error = PS2_ERR_NONE;
+        return pbuf_dequeue();
+    } else {
+        ps2_error = PS2_ERR_NODATA;
+        return -1;
+    }
+}
+
 ISR(PS2_INT_VECT)
 {
-    static enum {
-        INIT,
-        START,
-        BIT0, BIT1, BIT2, BIT3, BIT4, BIT5, BIT6, BIT7,
-        PARITY,
-        STOP,
-    } state = INIT;
-    static uint8_t data = 0;
-    static uint8_t parity = 1;
-
-    // TODO: abort if elapse 100us from previous interrupt
+    static ps2_frame_t frame;
 
     // return unless falling edge
     if (clock_in()) {
-        goto RETURN;
+        return;
     }
 
-    state++;
-    switch (state) {
-        case START:
-            if (data_in())
-                goto ERROR;
-            break;
-        case BIT0:
-        case BIT1:
-        case BIT2:
-        case BIT3:
-        case BIT4:
-        case BIT5:
-        case BIT6:
-        case BIT7:
-            data >>= 1;
-            if (data_in()) {
-                data |= 0x80;
-                parity++;
+    uint8_t now = timer_read();
+    int16_t data = ps2_frame_bit(&frame, data_in(), now);
+    if (data == PS2_FRAME_ERROR) {
+        ps2_error = frame.error;
+#ifdef PS2_MOUSE_ENABLE
+        ps2_mouse_framer_reset(&mouse_framer);
+#endif
+    } else if (data != PS2_FRAME_MORE) {
+#ifdef PS2_MOUSE_ENABLE
+        if (mouse_framer.size) {
+            if (ps2_mouse_framer_put(&mouse_framer, data, now)) {
+                ps2_mouse_packet_ring_push(&mouse_packets, mouse_framer.packet);
             }
-            break;
-        case PARITY:
-            if (data_in()) {
-                if (!(parity & 0x01))
-                    goto ERROR;
-            } else {
-                if (parity & 0x01)
-                    goto ERROR;
-            }
-            break;
-        case STOP:
-            if (!data_in())
-                goto ERROR;
-            pbuf_enqueue(data);
-            goto DONE;
-            break;
-        default:
-            goto ERROR;
+            return;
+        }
+#endif
+        pbuf_enqueue(data);
     }
-    goto RETURN;
-ERROR:
-    ps2_error = state;
-DONE:
-    state = INIT;
-    data = 0;
-    parity = 1;
-RETURN:
-    return;
 }
 
+#ifdef PS2_MOUSE_ENABLE
+void ps2_host_mouse_stream(uint8_t packet_size)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        mouse_framer.size = packet_size;
+        mouse_framer.count = 0;
+    }
+    ps2_mouse_packet_ring_clear(&mouse_packets);
+    pbuf_clear();
+}
+
+bool ps2_host_recv_mouse_packet(ps2_mouse_packet_t *packet)
+{
+    return ps2_mouse_packet_ring_pop(&mouse_packets, packet);
+}
+#endif
+
 /* send LED state to keyboard */
 void ps2_host_set_led(uint8_t led)
 {
@@ -231,49 +230,25 @@ void ps2_host_set_led(uint8_t led)
  * Ring buffer to store scan codes from keyboard
  *------------------------------------------------------------------*/
 #define PBUF_SIZE 32
-static uint8_t pbuf[PBUF_SIZE];
-static uint8_t pbuf_head = 0;
-static uint8_t pbuf_tail = 0;
+SPSC_RING_DEFINE(pbuf_ring, uint8_t, PBUF_SIZE)
+static pbuf_ring_t pbuf;
 static inline void pbuf_enqueue(uint8_t data)
 {
-    uint8_t sreg = SREG;
-    cli();
-    uint8_t next = (pbuf_head + 1) % PBUF_SIZE;
-    if (next != pbuf_tail) {
-        pbuf[pbuf_head] = data;
-        pbuf_head = next;
-    } else {
-        print("pbuf: full\n");
-    }
-    SREG = sreg;
+    // Called from the interrupt, a full buffer is counted in pbuf.ring.dropped
+    pbuf_ring_push(&pbuf, data);
 }
 static inline uint8_t pbuf_dequeue(void)
 {
     uint8_t val = 0;
-
-    uint8_t sreg = SREG;
-    cli();
-    if (pbuf_head != pbuf_tail) {
-        val = pbuf[pbuf_tail];
-        pbuf_tail = (pbuf_tail + 1) % PBUF_SIZE;
-    }
-    SREG = sreg;
-
+    pbuf_ring_pop(&pbuf, &val);
     return val;
 }
 static inline bool pbuf_has_data(void)
 {
-    uint8_t sreg = SREG;
-    cli();
-    bool has_data = (pbuf_head != pbuf_tail);
-    SREG = sreg;
-    return has_data;
+    return pbuf_ring_count(&pbuf);
 }
 static inline void pbuf_clear(void)
 {
-    uint8_t sreg = SREG;
-    cli();
-    pbuf_head = pbuf_tail = 0;
-    SREG = sreg;
+    pbuf_ring_clear(&pbuf);
 }
 
@@ -28,22 +28,26 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 /* ============================= MACROS ============================ */
 
-static report_mouse_t mouse_report = {};
-
 static inline void ps2_mouse_print_report(report_mouse_t *mouse_report);
 static inline void ps2_mouse_convert_report_to_hid(report_mouse_t *mouse_report);
-static inline void ps2_mouse_clear_report(report_mouse_t *mouse_report);
+static inline void ps2_mouse_read_packet(report_mouse_t *mouse_report, const ps2_mouse_packet_t *packet);
+static inline void ps2_mouse_send_report(report_mouse_t *mouse_report);
 static inline void ps2_mouse_enable_scrolling(void);
 static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report);
 
 /* ============================= IMPLEMENTATION ============================ */
 
+/* the mouse comes out of reset in stream mode, with data reporting off */
+static bool data_reporting = false;
+
 /* supports only 3 button mouse at this time */
 void ps2_mouse_init(void) {
     ps2_host_init();
 
     _delay_ms(PS2_MOUSE_INIT_DELAY);    // wait for powering up
 
+    data_reporting = false;
+    ps2_mouse_mode = PS2_MOUSE_STREAM_MODE;
     PS2_MOUSE_SEND(PS2_MOUSE_RESET, "ps2_mouse_init: sending reset");
 
     PS2_MOUSE_RECEIVE("ps2_mouse_init: read BAT");
@@ -51,8 +55,6 @@ void ps2_mouse_init(void) {
 
 #ifdef PS2_MOUSE_USE_REMOTE_MODE
     ps2_mouse_set_remote_mode();
-#else
-    ps2_mouse_enable_data_reporting();
 #endif
 
 #ifdef PS2_MOUSE_ENABLE_SCROLLING
@@ -64,6 +66,11 @@ void ps2_mouse_init(void) {
 #endif
 
     ps2_mouse_init_user();
+
+#ifndef PS2_MOUSE_USE_REMOTE_MODE
+    // the mouse only starts sending packets once everything is set up
+    ps2_mouse_enable_data_reporting();
+#endif
 }
 
 __attribute__((weak))
@@ -71,62 +78,89 @@ void ps2_mouse_init_user(void) {
 }
 
 void ps2_mouse_task(void) {
-    static uint8_t buttons_prev = 0;
-    extern int tp_buttons;
+    ps2_mouse_packet_t packet;
+    report_mouse_t mouse_report;
+
+#ifdef PS2_MOUSE_STREAM_PACKETS
+    if (PS2_MOUSE_STREAM_MODE == ps2_mouse_mode) {
+        report_mouse_t next_report;
+        bool pending = false;
+
+        /* the packets that came since the last scan are merged, and sent in as few reports as possible */
+        while (ps2_host_recv_mouse_packet(&packet)) {
+            ps2_mouse_read_packet(&next_report, &packet);
+            if (pending && ps2_mouse_merge_report(&mouse_report, &next_report)) {
+                continue;
+            }
+            if (pending) {
+                ps2_mouse_send_report(&mouse_report);
+            }
+            mouse_report = next_report;
+            pending = true;
+        }
+        if (pending) {
+            ps2_mouse_send_report(&mouse_report);
+        }
+        return;
+    }
+#endif
 
     /* receives packet from mouse */
     uint8_t rcv;
     rcv = ps2_host_send(PS2_MOUSE_READ_DATA);
     if (rcv == PS2_ACK) {
-        mouse_report.buttons = ps2_host_recv_response() | tp_buttons;
-        mouse_report.x = ps2_host_recv_response() * PS2_MOUSE_X_MULTIPLIER;
-        mouse_report.y = ps2_host_recv_response() * PS2_MOUSE_Y_MULTIPLIER;
+        packet.status = ps2_host_recv_response();
+        packet.x = ps2_host_recv_response();
+        packet.y = ps2_host_recv_response();
+        packet.z = 0;
 #ifdef PS2_MOUSE_ENABLE_SCROLLING
-        mouse_report.v = -(ps2_host_recv_response() & PS2_MOUSE_SCROLL_MASK) * PS2_MOUSE_V_MULTIPLIER;
+        packet.z = ps2_host_recv_response();
 #endif
     } else {
         if (debug_mouse) print("ps2_mouse: fail to get mouse packet\n");
         return;
     }
 
-    /* if mouse moves or buttons state changes */
-    if (mouse_report.x || mouse_report.y || mouse_report.v ||
-            ((mouse_report.buttons ^ buttons_prev) & PS2_MOUSE_BTN_MASK)) {
-#ifdef PS2_MOUSE_DEBUG_RAW
-        // Used to debug raw ps2 bytes from mouse
-        ps2_mouse_print_report(&mouse_report);
-#endif
-        buttons_prev = mouse_report.buttons;
-        ps2_mouse_convert_report_to_hid(&mouse_report);
-#if PS2_MOUSE_SCROLL_BTN_MASK
-        ps2_mouse_scroll_button_task(&mouse_report);
-#endif
-#ifdef PS2_MOUSE_DEBUG_HID
-        // Used to debug the bytes sent to the host
-        ps2_mouse_print_report(&mouse_report);
-#endif
-        host_mouse_send(&mouse_report);
-    }
-
-    ps2_mouse_clear_report(&mouse_report);
+    ps2_mouse_read_packet(&mouse_report, &packet);
+    ps2_mouse_send_report(&mouse_report);
 }
 
 void ps2_mouse_disable_data_reporting(void) {
+#ifdef PS2_MOUSE_STREAM_PACKETS
+    ps2_host_mouse_stream(0);
+#endif
     PS2_MOUSE_SEND(PS2_MOUSE_DISABLE_DATA_REPORTING, "ps2 mouse disable data reporting");
+    data_reporting = false;
 }
 
 void ps2_mouse_enable_data_reporting(void) {
     PS2_MOUSE_SEND(PS2_MOUSE_ENABLE_DATA_REPORTING, "ps2 mouse enable data reporting");
+    data_reporting = true;
+#ifdef PS2_MOUSE_STREAM_PACKETS
+    // the packets are only framed in stream mode, remote mode reads them itself
+    if (PS2_MOUSE_STREAM_MODE == ps2_mouse_mode) {
+        ps2_host_mouse_stream(PS2_MOUSE_PACKET_SIZE);
+    }
+#endif
+}
+
+bool ps2_mouse_data_reporting_enabled(void) {
+    return data_reporting;
 }
 
 void ps2_mouse_set_remote_mode(void) {
-    PS2_MOUSE_SEND_SAFE(PS2_MOUSE_SET_REMOTE_MODE, "ps2 mouse set remote mode");
+    // the packets are read with commands from now on, so reporting stays off
+    if (data_reporting) {
+        ps2_mouse_disable_data_reporting();
+    }
+    PS2_MOUSE_SEND(PS2_MOUSE_SET_REMOTE_MODE, "ps2 mouse set remote mode");
     ps2_mouse_mode = PS2_MOUSE_REMOTE_MODE;
 }
 
 void ps2_mouse_set_stream_mode(void) {
-    PS2_MOUSE_SEND_SAFE(PS2_MOUSE_SET_STREAM_MODE, "ps2 mouse set stream mode");
+    PS2_MOUSE_SEND(PS2_MOUSE_SET_STREAM_MODE, "ps2 mouse set stream mode");
     ps2_mouse_mode = PS2_MOUSE_STREAM_MODE;
+    ps2_mouse_enable_data_reporting();
 }
 
 void ps2_mouse_set_scaling_2_1(void) {
@@ -173,12 +207,40 @@ static inline void ps2_mouse_convert_report_to_hid(report_mouse_t *mouse_report)
     mouse_report->y = -mouse_report->y;
 }
 
-static inline void ps2_mouse_clear_report(report_mouse_t *mouse_report) {
-    mouse_report->x = 0;
-    mouse_report->y = 0;
+static inline void ps2_mouse_read_packet(report_mouse_t *mouse_report, const ps2_mouse_packet_t *packet) {
+    extern int tp_buttons;
+
+    mouse_report->buttons = packet->status | tp_buttons;
+    mouse_report->x = packet->x * PS2_MOUSE_X_MULTIPLIER;
+    mouse_report->y = packet->y * PS2_MOUSE_Y_MULTIPLIER;
     mouse_report->v = 0;
     mouse_report->h = 0;
-    mouse_report->buttons = 0;
+#ifdef PS2_MOUSE_ENABLE_SCROLLING
+    mouse_report->v = -(packet->z & PS2_MOUSE_SCROLL_MASK) * PS2_MOUSE_V_MULTIPLIER;
+#endif
+#ifdef PS2_MOUSE_DEBUG_RAW
+    // Used to debug raw ps2 bytes from mouse
+    ps2_mouse_print_report(mouse_report);
+#endif
+    ps2_mouse_convert_report_to_hid(mouse_report);
+}
+
+static inline void ps2_mouse_send_report(report_mouse_t *mouse_report) {
+    static uint8_t buttons_prev = 0;
+
+    /* if mouse moves or buttons state changes */
+    if (mouse_report->x || mouse_report->y || mouse_report->v ||
+            ((mouse_report->buttons ^ buttons_prev) & PS2_MOUSE_BTN_MASK)) {
+        buttons_prev = mouse_report->buttons;
+#if PS2_MOUSE_SCROLL_BTN_MASK
+        ps2_mouse_scroll_button_task(mouse_report);
+#endif
+#ifdef PS2_MOUSE_DEBUG_HID
+        // Used to debug the bytes sent to the host
+        ps2_mouse_print_report(mouse_report);
+#endif
+        host_mouse_send(mouse_report);
+    }
 }
 
 static inline void ps2_mouse_print_report(report_mouse_t *mouse_report) {
@@ -32,23 +32,25 @@ do { \
 
 #define PS2_MOUSE_SEND_SAFE(command, message) \
 do { \
-    if (PS2_MOUSE_STREAM_MODE == ps2_mouse_mode) { \
+    bool reporting = ps2_mouse_data_reporting_enabled(); \
+    if (reporting) { \
         ps2_mouse_disable_data_reporting(); \
     } \
     PS2_MOUSE_SEND(command, message); \
-    if (PS2_MOUSE_STREAM_MODE == ps2_mouse_mode) { \
+    if (reporting) { \
         ps2_mouse_enable_data_reporting(); \
     } \
 } while(0)
 
 #define PS2_MOUSE_SET_SAFE(command, value, message) \
 do { \
-    if (PS2_MOUSE_STREAM_MODE == ps2_mouse_mode) { \
+    bool reporting = ps2_mouse_data_reporting_enabled(); \
+    if (reporting) { \
         ps2_mouse_disable_data_reporting(); \
     } \
     PS2_MOUSE_SEND(command, message); \
     PS2_MOUSE_SEND(value, "Sending value"); \
-    if (PS2_MOUSE_STREAM_MODE == ps2_mouse_mode) { \
+    if (reporting) { \
         ps2_mouse_enable_data_reporting(); \
     } \
 } while(0)
@@ -118,6 +120,16 @@ static enum ps2_mouse_mode_e {
 #define PS2_MOUSE_INIT_DELAY            1000
 #endif
 
+/* in stream mode the interrupt and USART versions assemble the packets, and the task only takes them */
+#if !defined(PS2_MOUSE_USE_REMOTE_MODE) && (defined(PS2_USE_INT) || defined(PS2_USE_USART))
+#define PS2_MOUSE_STREAM_PACKETS
+#endif
+#ifdef PS2_MOUSE_ENABLE_SCROLLING
+#define PS2_MOUSE_PACKET_SIZE           4
+#else
+#define PS2_MOUSE_PACKET_SIZE           3
+#endif
+
 enum ps2_mouse_command_e {
     PS2_MOUSE_RESET = 0xFF,
     PS2_MOUSE_RESEND = 0xFE,
@@ -163,6 +175,10 @@ void ps2_mouse_disable_data_reporting(void);
 
 void ps2_mouse_enable_data_reporting(void);
 
+/* Commands only turn data reporting off and on again around themselves if
+ * it was on, so that it stays off until ps2_mouse_init is done */
+bool ps2_mouse_data_reporting_enabled(void);
+
 void ps2_mouse_set_remote_mode(void);
 
 void ps2_mouse_set_stream_mode(void);
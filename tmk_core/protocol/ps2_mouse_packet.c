@@ -0,0 +1,37 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ps2_mouse_packet.h"
+
+static inline bool add_fits(int8_t a, int8_t b)
+{
+    int16_t sum = (int16_t)a + b;
+    return sum >= -127 && sum <= 127;
+}
+
+bool ps2_mouse_merge_report(report_mouse_t *total, const report_mouse_t *report)
+{
+    if (total->buttons != report->buttons ||
+        !add_fits(total->x, report->x) || !add_fits(total->y, report->y) ||
+        !add_fits(total->v, report->v) || !add_fits(total->h, report->h)) {
+        return false;
+    }
+    total->x += report->x;
+    total->y += report->y;
+    total->v += report->v;
+    total->h += report->h;
+    return true;
+}
@@ -0,0 +1,108 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PS2_MOUSE_PACKET_H
+#define PS2_MOUSE_PACKET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "report.h"
+#include "spsc_ring.h"
+
+/*
+ * Stream mode mouse packets, assembled by the PS/2 interrupt handler
+ *
+ * Bit 3 of the first byte is always set, so a byte without it can't start a
+ * packet, and is dropped until the stream is in sync again. The mouse sends
+ * the bytes of a packet back to back, so when the next byte of a partial
+ * packet comes more than PS2_MOUSE_PACKET_TIMEOUT ms later, a byte was lost,
+ * and it starts a new packet.
+ */
+#define PS2_MOUSE_PACKET_SYNC   (1<<3)
+
+#ifndef PS2_MOUSE_PACKET_TIMEOUT
+#define PS2_MOUSE_PACKET_TIMEOUT    2
+#endif
+/* packets the main loop can fall behind */
+#ifndef PS2_MOUSE_PACKET_QUEUE_SIZE
+#define PS2_MOUSE_PACKET_QUEUE_SIZE 8
+#endif
+
+typedef struct {
+    uint8_t status;
+    uint8_t x;
+    uint8_t y;
+    uint8_t z;  /* 0 for 3 byte packets */
+} ps2_mouse_packet_t;
+
+SPSC_RING_DEFINE(ps2_mouse_packet_ring, ps2_mouse_packet_t, PS2_MOUSE_PACKET_QUEUE_SIZE)
+
+typedef struct {
+    ps2_mouse_packet_t packet;
+    uint8_t count;
+    uint8_t size;       /* 3, or 4 with a scroll wheel */
+    uint8_t time;       /* timer_read() of the last byte, truncated */
+    uint8_t resyncs;    /* packets that were thrown away */
+} ps2_mouse_framer_t;
+
+/* Throws the partial packet away, for example after a bit error */
+static inline void ps2_mouse_framer_reset(ps2_mouse_framer_t *framer)
+{
+    if (framer->count) {
+        framer->count = 0;
+        framer->resyncs++;
+    }
+}
+
+/* Adds a byte, and returns true when framer.packet is complete */
+static inline bool ps2_mouse_framer_put(ps2_mouse_framer_t *framer, uint8_t data, uint8_t now)
+{
+    if (framer->count && (uint8_t)(now - framer->time) > PS2_MOUSE_PACKET_TIMEOUT) {
+        ps2_mouse_framer_reset(framer);
+    }
+    framer->time = now;
+
+    switch (framer->count) {
+        case 0:
+            if (!(data & PS2_MOUSE_PACKET_SYNC)) {
+                framer->resyncs++;
+                return false;
+            }
+            framer->packet.status = data;
+            framer->packet.z = 0;
+            break;
+        case 1:
+            framer->packet.x = data;
+            break;
+        case 2:
+            framer->packet.y = data;
+            break;
+        default:
+            framer->packet.z = data;
+            break;
+    }
+    if (++framer->count < framer->size) {
+        return false;
+    }
+    framer->count = 0;
+    return true;
+}
+
+/* Adds the movement of report to total, when the buttons are the same and
+ * the sums fit in a report */
+bool ps2_mouse_merge_report(report_mouse_t *total, const report_mouse_t *report);
+
+#endif
@@ -0,0 +1,377 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include "adafruit_ble_sdep.h"
+extern "C" {
+#include "timer.h"
+#include "report.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+// A Bluefruit module that answers every AT command with OK, some time after
+// the command has been received
+static struct {
+    uint32_t latency;
+    bool busy;
+    std::string partial;
+    std::vector<std::string> commands;
+    std::deque<uint32_t> responses;
+    unsigned int send_attempts;
+    unsigned int max_outstanding;
+} peer;
+
+bool sdep_send_pkt(const struct sdep_msg *msg, uint16_t timeout) {
+    peer.send_attempts++;
+    if (peer.busy) {
+        advance_time(timeout);
+        return false;
+    }
+    EXPECT_EQ(SdepCommand, msg->type);
+    EXPECT_EQ(BleAtWrapper, msg->cmd_low | msg->cmd_high << 8);
+    peer.partial.append((const char*)msg->payload, msg->len);
+    if (!msg->more) {
+        peer.commands.push_back(peer.partial);
+        peer.partial.clear();
+        peer.responses.push_back(timer_read32() + peer.latency);
+        if (peer.responses.size() > peer.max_outstanding) {
+            peer.max_outstanding = peer.responses.size();
+        }
+    }
+    return true;
+}
+
+bool sdep_irq(void) {
+    if (!peer.responses.empty() && peer.responses.front() <= timer_read32()) {
+        return true;
+    }
+    // Let the time pass in the loops that wait for the module
+    advance_time(1);
+    return false;
+}
+
+bool sdep_recv_pkt(struct sdep_msg *msg, uint16_t timeout) {
+    if (peer.responses.empty() || peer.responses.front() > timer_read32()) {
+        if (peer.responses.empty() || peer.responses.front() - timer_read32() > timeout) {
+            advance_time(timeout);
+            return false;
+        }
+        set_time(peer.responses.front());
+    }
+    peer.responses.pop_front();
+    msg->type = SdepResponse;
+    msg->cmd_low = BleAtWrapper & 0xff;
+    msg->cmd_high = BleAtWrapper >> 8;
+    msg->len = 4;
+    msg->more = 0;
+    memcpy(msg->payload, "OK\r\n", 4);
+    return true;
+}
+
+class AdafruitBleSdep : public testing::Test {
+public:
+    AdafruitBleSdep() {
+        set_time(1000);
+        peer.latency = 20;
+        peer.busy = false;
+        peer.partial.clear();
+        peer.commands.clear();
+        peer.responses.clear();
+        peer.send_attempts = 0;
+        peer.max_outstanding = 0;
+        sdep_reset();
+    }
+
+    static queue_item key(uint8_t modifier, uint8_t k0 = 0, uint8_t k1 = 0) {
+        queue_item item = {};
+        item.queue_type = QTKeyReport;
+        item.added = timer_read();
+        item.key.modifier = modifier;
+        item.key.keys[0] = k0;
+        item.key.keys[1] = k1;
+        return item;
+    }
+
+    static queue_item consumer(uint16_t code) {
+        queue_item item = {};
+        item.queue_type = QTConsumer;
+        item.added = timer_read();
+        item.consumer = code;
+        return item;
+    }
+
+    static queue_item mouse(int8_t x, int8_t y, uint8_t buttons = 0) {
+        queue_item item = {};
+        item.queue_type = QTMouseMove;
+        item.added = timer_read();
+        item.mousemove.x = x;
+        item.mousemove.y = y;
+        item.mousemove.buttons = buttons;
+        return item;
+    }
+
+    static void queue(queue_item item) {
+        EXPECT_TRUE(sdep_queue_item(&item));
+    }
+
+    // Runs the main loop until everything has been acknowledged
+    static void run() {
+        for (int i = 0; i < 10000 && (sdep_queue_size() || sdep_responses_pending()); i++) {
+            sdep_read_responses(true);
+            sdep_send_queued(SdepShortTimeout);
+            advance_time(1);
+        }
+        EXPECT_EQ(0, sdep_queue_size());
+        EXPECT_FALSE(sdep_responses_pending());
+    }
+
+    static std::vector<std::string> encode(const queue_item& item) {
+        char cmd[64];
+        uint8_t count = sdep_encode_item(&item, cmd, sizeof(cmd));
+        std::vector<std::string> result;
+        const char *c = cmd;
+        for (uint8_t i = 0; i < count; i++) {
+            result.push_back(c);
+            c += strlen(c) + 1;
+        }
+        return result;
+    }
+};
+
+TEST_F(AdafruitBleSdep, EncodesKeyReportsLikeSnprintf) {
+    queue_item item = key(0xA5, 0x04, 0xFF);
+    item.key.keys[5] = 0x10;
+    char expected[64];
+    snprintf(expected, sizeof(expected), "AT+BLEKEYBOARDCODE=%02x-00-%02x-%02x-%02x-%02x-%02x-%02x",
+        0xA5, 0x04, 0xFF, 0, 0, 0, 0x10);
+    EXPECT_EQ(std::vector<std::string>{expected}, encode(item));
+}
+
+TEST_F(AdafruitBleSdep, EncodesConsumerKeysLikeSnprintf) {
+    for (uint16_t code : {0x0000, 0x00E9, 0x0223, 0xFFFF}) {
+        char expected[64];
+        snprintf(expected, sizeof(expected), "AT+BLEHIDCONTROLKEY=0x%04x", code);
+        EXPECT_EQ(std::vector<std::string>{expected}, encode(consumer(code)));
+    }
+}
+
+TEST_F(AdafruitBleSdep, EncodesMouseReportsLikeSnprintf) {
+    for (int v : {-128, -127, -100, -99, -10, -9, -1, 0, 1, 9, 10, 99, 100, 127}) {
+        queue_item item = mouse(v, -v);
+        item.mousemove.scroll = v / 2;
+        item.mousemove.pan = 7;
+        char expected[64];
+        snprintf(expected, sizeof(expected), "AT+BLEHIDMOUSEMOVE=%d,%d,%d,%d",
+            item.mousemove.x, item.mousemove.y, item.mousemove.scroll, item.mousemove.pan);
+        EXPECT_EQ((std::vector<std::string>{expected, "AT+BLEHIDMOUSEBUTTON=0"}), encode(item));
+    }
+    EXPECT_EQ("AT+BLEHIDMOUSEBUTTON=LRM", encode(mouse(0, 0, MOUSE_BTN1 | MOUSE_BTN2 | MOUSE_BTN3))[1]);
+    EXPECT_EQ("AT+BLEHIDMOUSEBUTTON=R", encode(mouse(0, 0, MOUSE_BTN2))[1]);
+}
+
+TEST_F(AdafruitBleSdep, RejectsATooSmallBuffer) {
+    char cmd[16];
+    queue_item item = key(0);
+    EXPECT_EQ(0, sdep_encode_item(&item, cmd, sizeof(cmd)));
+}
+
+TEST_F(AdafruitBleSdep, SendsReportsInOrder) {
+    queue(key(0, 0x04));
+    queue(consumer(0xE9));
+    queue(key(0));
+    run();
+    EXPECT_EQ((std::vector<std::string>{
+        "AT+BLEKEYBOARDCODE=00-00-04-00-00-00-00-00",
+        "AT+BLEHIDCONTROLKEY=0x00e9",
+        "AT+BLEKEYBOARDCODE=00-00-00-00-00-00-00-00"}), peer.commands);
+}
+
+TEST_F(AdafruitBleSdep, KeepsThePipelineDepth) {
+    for (uint16_t i = 0; i < 12; i++) {
+        queue(consumer(i));
+    }
+    run();
+    EXPECT_EQ(12, peer.commands.size());
+    EXPECT_EQ(AdafruitBlePipelineDepth, peer.max_outstanding);
+}
+
+TEST_F(AdafruitBleSdep, PipeliningIsFasterThanWaitingForEachResponse) {
+    for (uint16_t i = 0; i < 12; i++) {
+        queue(consumer(i));
+    }
+    uint32_t start = timer_read32();
+    run();
+    uint32_t elapsed = timer_read32() - start;
+    uint32_t serial = 12 * peer.latency;
+    EXPECT_LE(elapsed, serial / AdafruitBlePipelineDepth + 2 * peer.latency);
+}
+
+TEST_F(AdafruitBleSdep, WaitsForPendingResponsesBeforeACommandWithAResponse) {
+    queue(consumer(1));
+    queue(consumer(2));
+    sdep_send_queued();
+    EXPECT_TRUE(sdep_responses_pending());
+    char resp[16];
+    EXPECT_TRUE(at_command("AT+GAPGETCONN", resp, sizeof(resp), false));
+    EXPECT_STREQ("OK", resp);
+    EXPECT_FALSE(sdep_responses_pending());
+    EXPECT_EQ("AT+GAPGETCONN", peer.commands.back());
+}
+
+TEST_F(AdafruitBleSdep, FragmentsLongCommands) {
+    const char *cmd = "AT+GAPDEVNAME=A rather long keyboard name";
+    EXPECT_TRUE(at_command(cmd, NULL, 0, false));
+    run();
+    EXPECT_EQ(std::vector<std::string>{cmd}, peer.commands);
+}
+
+TEST_F(AdafruitBleSdep, MergesKeyPresses) {
+    queue(key(0, 0x04));
+    queue(key(0, 0x04, 0x05));
+    queue(key(0x02, 0x04, 0x05));
+    EXPECT_EQ(1, sdep_queue_size());
+    run();
+    EXPECT_EQ(std::vector<std::string>{"AT+BLEKEYBOARDCODE=02-00-04-05-00-00-00-00"}, peer.commands);
+}
+
+TEST_F(AdafruitBleSdep, DoesNotMergeReleases) {
+    queue(key(0, 0x04));
+    queue(key(0));
+    queue(key(0, 0x05));
+    EXPECT_EQ(3, sdep_queue_size());
+    run();
+    EXPECT_EQ((std::vector<std::string>{
+        "AT+BLEKEYBOARDCODE=00-00-04-00-00-00-00-00",
+        "AT+BLEKEYBOARDCODE=00-00-00-00-00-00-00-00",
+        "AT+BLEKEYBOARDCODE=00-00-05-00-00-00-00-00"}), peer.commands);
+}
+
+TEST_F(AdafruitBleSdep, DoesNotMergeAPressAfterARelease) {
+    queue(key(0x02, 0x04));
+    run();
+    // The queued report released shift, so a later press can't replace it
+    queue(key(0, 0x04));
+    queue(key(0, 0x04, 0x05));
+    EXPECT_EQ(2, sdep_queue_size());
+}
+
+TEST_F(AdafruitBleSdep, DoesNotMergeAKeyMovingInTheReport) {
+    queue(key(0, 0x04));
+    queue(key(0, 0x05, 0x04));
+    EXPECT_EQ(2, sdep_queue_size());
+}
+
+TEST_F(AdafruitBleSdep, DropsDuplicateKeyReports) {
+    queue(key(0, 0x04));
+    queue(key(0, 0x04));
+    queue(key(0));
+    queue(key(0));
+    EXPECT_EQ(2, sdep_queue_size());
+}
+
+TEST_F(AdafruitBleSdep, DoesNotMergeAcrossOtherReports) {
+    queue(key(0, 0x04));
+    queue(consumer(0xE9));
+    queue(key(0, 0x04, 0x05));
+    EXPECT_EQ(3, sdep_queue_size());
+}
+
+TEST_F(AdafruitBleSdep, NeverMergesConsumerKeys) {
+    queue(consumer(0xE9));
+    queue(consumer(0xE9));
+    EXPECT_EQ(2, sdep_queue_size());
+}
+
+TEST_F(AdafruitBleSdep, AccumulatesMouseMotion) {
+    queue(mouse(10, -5));
+    queue(mouse(20, -5));
+    queue(mouse(-3, 1));
+    EXPECT_EQ(1, sdep_queue_size());
+    run();
+    EXPECT_EQ((std::vector<std::string>{
+        "AT+BLEHIDMOUSEMOVE=27,-9,0,0",
+        "AT+BLEHIDMOUSEBUTTON=0"}), peer.commands);
+}
+
+TEST_F(AdafruitBleSdep, DoesNotAccumulatePastTheReportRange) {
+    queue(mouse(100, 0));
+    queue(mouse(100, 0));
+    queue(mouse(0, -100));
+    EXPECT_EQ(2, sdep_queue_size());
+}
+
+TEST_F(AdafruitBleSdep, DoesNotAccumulateButtonChanges) {
+    queue(mouse(1, 0));
+    queue(mouse(1, 0, MOUSE_BTN1));
+    queue(mouse(1, 0, MOUSE_BTN1));
+    queue(mouse(1, 0));
+    EXPECT_EQ(3, sdep_queue_size());
+}
+
+TEST_F(AdafruitBleSdep, MeasuresTheReportLatency) {
+    queue(key(0, 0x04));
+    advance_time(5);
+    queue(key(0));
+    run();
+    const sdep_latency *latency = sdep_report_latency();
+    EXPECT_EQ(2, latency->reports);
+    EXPECT_LE(peer.latency, latency->max);
+    EXPECT_GT(2 * peer.latency, latency->max);
+    EXPECT_LE(2 * peer.latency, latency->total);
+}
+
+TEST_F(AdafruitBleSdep, CountsTheMouseReportOnce) {
+    queue(mouse(1, 1));
+    run();
+    EXPECT_EQ(2, peer.commands.size());
+    EXPECT_EQ(1, sdep_report_latency()->reports);
+}
+
+TEST_F(AdafruitBleSdep, RefusesReportsWhenTheQueueIsFull) {
+    uint16_t code = 0;
+    queue_item item = consumer(code);
+    while (sdep_queue_item(&item)) {
+        item = consumer(++code);
+        ASSERT_LT(code, 100);
+    }
+    EXPECT_EQ(code, sdep_queue_size());
+    sdep_send_queued();
+    EXPECT_TRUE(sdep_queue_item(&item));
+}
+
+TEST_F(AdafruitBleSdep, DoesNotBlockWhileTheModuleIsBusy) {
+    peer.busy = true;
+    queue(key(0, 0x04));
+    uint32_t start = timer_read32();
+    EXPECT_EQ(0, sdep_send_queued(SdepShortTimeout));
+    EXPECT_EQ(start + SdepShortTimeout, timer_read32());
+    EXPECT_EQ(1, peer.send_attempts);
+    // It waits a while before trying again
+    EXPECT_EQ(0, sdep_send_queued(SdepShortTimeout));
+    EXPECT_EQ(1, peer.send_attempts);
+    peer.busy = false;
+    advance_time(SdepTimeout);
+    EXPECT_EQ(1, sdep_send_queued(SdepShortTimeout));
+    run();
+    EXPECT_EQ(std::vector<std::string>{"AT+BLEKEYBOARDCODE=00-00-04-00-00-00-00-00"}, peer.commands);
+}
@@ -0,0 +1,239 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <deque>
+#include <vector>
+extern "C" {
+#include "converter_decoders.h"
+#include "next_kbd.h"
+}
+
+// Scan code streams recorded from the keyboards, queued as the interrupt
+// handlers would queue them, and the key events the engine sends for them
+
+struct KeyEvent {
+    uint8_t pos;
+    bool pressed;
+    bool operator==(const KeyEvent& other) const {
+        return pos == other.pos && pressed == other.pressed;
+    }
+};
+
+static std::ostream& operator<<(std::ostream& os, const KeyEvent& event) {
+    return os << std::hex << "0x" << int(event.pos) << (event.pressed ? " down" : " up");
+}
+
+static std::deque<uint8_t> queue;
+static std::vector<KeyEvent> events;
+
+static int16_t recv(void) {
+    if (queue.empty()) {
+        return -1;
+    }
+    uint8_t code = queue.front();
+    queue.pop_front();
+    return code;
+}
+
+static void key_event(uint8_t row, uint8_t col, bool pressed) {
+    events.push_back({uint8_t(row * 8 + col), pressed});
+}
+
+class ConverterEngine : public testing::Test {
+public:
+    ConverterEngine() {
+        queue.clear();
+        events.clear();
+    }
+
+    void init(const converter_decoder_t& decoder) {
+        converter_init(&conv, &decoder, key_event);
+    }
+
+    // the whole stream is decoded in one scan
+    void replay(std::vector<uint8_t> stream) {
+        queue.assign(stream.begin(), stream.end());
+        EXPECT_EQ(converter_task(&conv, recv), stream.size());
+        EXPECT_TRUE(queue.empty());
+    }
+
+    converter_t conv;
+};
+
+TEST_F(ConverterEngine, Ps2Set2) {
+    init(converter_ps2_set2);
+    replay({
+        0xAA,                       // self test passed
+        0x12, 0x1C, 0xF0, 0x1C, 0xF0, 0x12, // Shift A
+        0xE0, 0x14, 0xE0, 0xF0, 0x14,       // Right Control
+        0xE0, 0x12, 0xE0, 0x7C, 0xE0, 0xF0, 0x7C, 0xE0, 0xF0, 0x12,    // PrintScreen
+        0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77,    // Pause
+        0x83, 0xF0, 0x83,           // F7
+        0x11, 0x84, 0xF0, 0x84, 0xF0, 0x11, // Alt PrintScreen
+        0x00,                       // overrun
+    });
+    std::vector<KeyEvent> expected = {
+        {0x12, true}, {0x1C, true}, {0x1C, false}, {0x12, false},
+        {0x94, true}, {0x94, false},
+        {0xFC, true}, {0xFC, false},
+        {0xFE, true}, {0xFE, false},
+        {0x83, true}, {0x83, false},
+        {0x11, true}, {0xFC, true}, {0xFC, false}, {0x11, false},
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(ConverterEngine, Ps2Set2CtrlPause) {
+    init(converter_ps2_set2);
+    replay({0x14, 0xE0, 0x7E, 0xE0, 0xF0, 0x7E, 0xF0, 0x14});
+    std::vector<KeyEvent> expected = {
+        {0x14, true}, {0xFE, true}, {0xFE, false}, {0x14, false},
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(ConverterEngine, Ps2Set3) {
+    init(converter_ps2_set3);
+    replay({
+        0x12, 0x1C, 0xF0, 0x1C, 0xF0, 0x12, // Shift A
+        0x00,
+        0x84, 0xF0, 0x84,           // the highest key
+        0x88,                       // unknown
+        0x39, 0xF0, 0x39,           // Right Alt
+    });
+    std::vector<KeyEvent> expected = {
+        {0x12, true}, {0x1C, true}, {0x1C, false}, {0x12, false},
+        {0x84, true}, {0x84, false},
+        {0x39, true}, {0x39, false},
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(ConverterEngine, Adb) {
+    init(converter_adb);
+    for (uint16_t codes : {0x38FF, 0x0000, 0x00FF, 0x80B8, 0x7F7F, 0xFFFF, 0x0102, 0x8182}) {
+        converter_adb_put(&conv, codes);
+    }
+    std::vector<KeyEvent> expected = {
+        {0x38, true}, {0x00, true}, {0x00, false}, {0x38, false},
+        {0x7F, true}, {0x7F, false},
+        {0x01, true}, {0x02, true}, {0x01, false}, {0x02, false},
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(ConverterEngine, Ibm4704) {
+    init(converter_ibm4704);
+    replay({0x3E, 0x10, 0x90, 0xBE});
+    std::vector<KeyEvent> expected = {
+        {0x3E, true}, {0x10, true}, {0x10, false}, {0x3E, false},
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(ConverterEngine, M0110) {
+    init(converter_m0110);
+    replay({
+        0x7B,                       // null
+        0x38, 0x00, 0x80, 0xB8,     // Shift A
+        0x4D, 0xCD, 0xED,           // Arrow, and Calc up from an arrow sequence
+        0xFF,                       // error
+    });
+    std::vector<KeyEvent> expected = {
+        {0x38, true}, {0x00, true}, {0x00, false}, {0x38, false},
+        {0x4D, true}, {0x4D, false},
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(ConverterEngine, Next) {
+    init(converter_next);
+    uint32_t a = 0x39 << 1;
+    for (uint32_t response : {
+            (uint32_t)0,            // no keyboard
+            (uint32_t)NEXT_KBD_KMBUS_IDLE,
+            NEXT_KBD_LSHIFT_MASK | 0x400,
+            NEXT_KBD_LSHIFT_MASK | 0x400 | a,
+            NEXT_KBD_LSHIFT_MASK | NEXT_KBD_RALT_MASK | 0x500 | a,
+            (uint32_t)0x500}) {
+        converter_next_put(&conv, response);
+    }
+    std::vector<KeyEvent> expected = {
+        {0x79, true}, {0x39, true},
+        {0x7E, true}, {0x39, false},
+        {0x79, false}, {0x7E, false},
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(ConverterEngine, Sun) {
+    init(converter_sun);
+    replay({
+        0xFF, 0x04, 0x7F,           // reset response
+        0x4D, 0x63,                 // A and Shift
+        0x7F,                       // idle, both are up
+        0xFE, 0x00,                 // layout response
+        0x4D, 0xCD,
+    });
+    std::vector<KeyEvent> expected = {
+        {0x4D, true}, {0x63, true}, {0x4D, false}, {0x63, false},
+        {0x4D, true}, {0x4D, false},
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(ConverterEngine, News) {
+    init(converter_news);
+    replay({0x51, 0x21, 0xA1, 0xD1});
+    std::vector<KeyEvent> expected = {
+        {0x51, true}, {0x21, true}, {0x21, false}, {0x51, false},
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(ConverterEngine, RepeatsAreIgnored) {
+    init(converter_ps2_set3);
+    replay({0x1C, 0x1C, 0x1C, 0xF0, 0x1C, 0xF0, 0x1C});
+    std::vector<KeyEvent> expected = {{0x1C, true}, {0x1C, false}};
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(ConverterEngine, UnknownCodeDropsThePrefix) {
+    init(converter_ps2_set2);
+    replay({0xF0, 0x90, 0x1C, 0xE0, 0xF0, 0x85, 0x1C});
+    std::vector<KeyEvent> expected = {{0x1C, true}};
+    EXPECT_EQ(events, expected);
+    EXPECT_EQ(converter_get_row(&conv, 0x1C >> 3), 1 << (0x1C & 7));
+}
+
+TEST_F(ConverterEngine, Clear) {
+    init(converter_ps2_set2);
+    replay({0x12, 0xE0, 0x75});
+    events.clear();
+    converter_clear(&conv);
+    std::vector<KeyEvent> expected = {{0x12, false}, {0xF5, false}};
+    EXPECT_EQ(events, expected);
+    for (uint8_t row = 0; row < CONVERTER_MATRIX_ROWS; row++) {
+        EXPECT_EQ(converter_get_row(&conv, row), 0);
+    }
+}
+
+TEST_F(ConverterEngine, EmptyQueue) {
+    init(converter_ps2_set2);
+    EXPECT_EQ(converter_task(&conv, recv), 0);
+    EXPECT_TRUE(events.empty());
+}
@@ -0,0 +1,301 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "hid_kbd.h"
+
+typedef std::pair<uint8_t, bool> Event;
+typedef std::vector<Event> Events;
+
+static Events events;
+
+static void record_event(uint8_t code, bool pressed) {
+    events.push_back(Event(code, pressed));
+}
+
+static const Event down(uint8_t code) { return Event(code, true); }
+static const Event up(uint8_t code) { return Event(code, false); }
+
+// The keyboard report descriptor of tmk_core/protocol/lufa/descriptor.c
+static const uint8_t boot_descriptor[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x95, 0x08, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01,
+    0x05, 0x08, 0x19, 0x01, 0x29, 0x05, 0x95, 0x05, 0x75, 0x01, 0x91, 0x82,
+    0x95, 0x01, 0x75, 0x03, 0x91, 0x01,
+    0x05, 0x07, 0x19, 0x00, 0x29, 0xFF, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x95, 0x06, 0x75, 0x08, 0x81, 0x00,
+    0xC0,
+};
+
+// Its shared endpoint with mouse, system, consumer and NKRO reports
+static const uint8_t shared_descriptor[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x05, 0x15, 0x00, 0x25, 0x01, 0x95, 0x05, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x03, 0x81, 0x01,
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7F, 0x95, 0x02, 0x75, 0x08, 0x81, 0x06,
+    0x09, 0x38, 0x15, 0x81, 0x25, 0x7F, 0x95, 0x01, 0x75, 0x08, 0x81, 0x06,
+    0x05, 0x0C, 0x0A, 0x38, 0x02, 0x15, 0x81, 0x25, 0x7F, 0x95, 0x01, 0x75, 0x08, 0x81, 0x06,
+    0xC0, 0xC0,
+    0x05, 0x01, 0x09, 0x80, 0xA1, 0x01, 0x85, 0x02, 0x16, 0x01, 0x00, 0x26, 0x03, 0x00,
+    0x1A, 0x81, 0x00, 0x2A, 0x83, 0x00, 0x75, 0x10, 0x95, 0x01, 0x81, 0x00, 0xC0,
+    0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x03, 0x16, 0x01, 0x00, 0x26, 0x9C, 0x02,
+    0x1A, 0x01, 0x00, 0x2A, 0x9C, 0x02, 0x75, 0x10, 0x95, 0x01, 0x81, 0x00, 0xC0,
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x04,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x95, 0x08, 0x75, 0x01, 0x81, 0x02,
+    0x05, 0x08, 0x19, 0x01, 0x29, 0x05, 0x95, 0x05, 0x75, 0x01, 0x91, 0x82,
+    0x95, 0x01, 0x75, 0x03, 0x91, 0x01,
+    0x05, 0x07, 0x19, 0x00, 0x29, 0xF7, 0x15, 0x00, 0x25, 0x01, 0x95, 0xF8, 0x75, 0x01, 0x81, 0x02,
+    0xC0,
+};
+
+class HidKbd : public testing::Test {
+public:
+    HidKbd() : prev() {
+        events.clear();
+    }
+
+    void parse(const uint8_t* descriptor, size_t len) {
+        hid_kbd_parser_t parser;
+        hid_kbd_parser_init(&parser, &layout);
+        for (size_t i = 0; i < len; i++) {
+            hid_kbd_parser_put(&parser, descriptor[i]);
+        }
+    }
+
+    // Feeds a report, and returns the events it caused
+    Events feed(const std::vector<uint8_t>& report) {
+        hid_kbd_state_t state = prev;
+        hid_kbd_read_report(&layout, &state, report.data(), report.size());
+        events.clear();
+        hid_kbd_diff(&prev, &state, record_event);
+        return events;
+    }
+
+    std::vector<uint8_t> nkro_report(uint8_t mods, std::vector<uint8_t> keys) {
+        std::vector<uint8_t> report(33);
+        report[0] = 4;
+        report[1] = mods;
+        for (uint8_t key : keys) {
+            report[2 + key / 8] |= 1 << (key % 8);
+        }
+        return report;
+    }
+
+    hid_kbd_layout_t layout;
+    hid_kbd_state_t prev;
+};
+
+TEST_F(HidKbd, BootDescriptorGivesBootLayout) {
+    parse(boot_descriptor, sizeof(boot_descriptor));
+    EXPECT_EQ(0, layout.report_id);
+    EXPECT_EQ(8, layout.length);
+    ASSERT_EQ(2, layout.field_count);
+    for (int i = 0; i < 2; i++) {
+        EXPECT_EQ(hid_kbd_boot_layout.fields[i].offset, layout.fields[i].offset);
+        EXPECT_EQ(hid_kbd_boot_layout.fields[i].count, layout.fields[i].count);
+        EXPECT_EQ(hid_kbd_boot_layout.fields[i].size, layout.fields[i].size);
+        EXPECT_EQ(hid_kbd_boot_layout.fields[i].usage_min, layout.fields[i].usage_min);
+    }
+}
+
+TEST_F(HidKbd, SharedDescriptorFindsNkroReport) {
+    parse(shared_descriptor, sizeof(shared_descriptor));
+    EXPECT_EQ(4, layout.report_id);
+    EXPECT_EQ(33, layout.length);
+    ASSERT_EQ(2, layout.field_count);
+    EXPECT_EQ(0, layout.fields[0].offset);
+    EXPECT_EQ(8, layout.fields[0].count);
+    EXPECT_EQ(0xE0, layout.fields[0].usage_min);
+    EXPECT_EQ(8, layout.fields[1].offset);
+    EXPECT_EQ(248, layout.fields[1].count);
+    EXPECT_EQ(1, layout.fields[1].size);
+    EXPECT_EQ(0, layout.fields[1].usage_min);
+}
+
+TEST_F(HidKbd, LongItemsAreSkipped) {
+    std::vector<uint8_t> descriptor = {0xFE, 0x03, 0x10, 0x05, 0x07, 0x95};
+    descriptor.insert(descriptor.end(), boot_descriptor, boot_descriptor + sizeof(boot_descriptor));
+    parse(descriptor.data(), descriptor.size());
+    EXPECT_EQ(8, layout.length);
+    EXPECT_EQ(2, layout.field_count);
+}
+
+TEST_F(HidKbd, DescriptorWithoutKeys) {
+    // only the mouse collection
+    parse(shared_descriptor, 79);
+    EXPECT_EQ(0, layout.field_count);
+    hid_kbd_state_t state = {};
+    uint8_t mouse[] = {1, 0, 5, 5, 0, 0};
+    EXPECT_FALSE(hid_kbd_read_report(&layout, &state, mouse, sizeof(mouse)));
+}
+
+TEST_F(HidKbd, LongReportLengthDoesNotWrap) {
+    // a 250 byte vendor field after the keys, in the same report
+    std::vector<uint8_t> descriptor(boot_descriptor, boot_descriptor + sizeof(boot_descriptor) - 1);
+    descriptor.insert(descriptor.end(), {0x06, 0x00, 0xFF, 0x09, 0x01, 0x95, 0xFA, 0x75, 0x08, 0x81, 0x02, 0xC0});
+    parse(descriptor.data(), descriptor.size());
+    EXPECT_EQ(258, layout.length);
+    EXPECT_EQ(2, layout.field_count);
+    hid_kbd_state_t state = {};
+    uint8_t report[8] = {0, 0, 0x04};
+    EXPECT_FALSE(hid_kbd_read_report(&layout, &state, report, sizeof(report)));
+}
+
+TEST_F(HidKbd, HugeReportCountSaturates) {
+    std::vector<uint8_t> descriptor(boot_descriptor, boot_descriptor + sizeof(boot_descriptor) - 1);
+    descriptor.insert(descriptor.end(), {0x95, 0xFF, 0x75, 0xFF, 0x81, 0x01, 0x96, 0xFF, 0xFF, 0x75, 0xFF, 0x81, 0x01, 0xC0});
+    parse(descriptor.data(), descriptor.size());
+    EXPECT_GT(layout.length, 255);
+    hid_kbd_state_t state = {};
+    uint8_t report[255] = {0, 0, 0x04};
+    EXPECT_FALSE(hid_kbd_read_report(&layout, &state, report, sizeof(report)));
+}
+
+TEST_F(HidKbd, FieldPastTheReportIsRejected) {
+    layout = hid_kbd_boot_layout;
+    layout.length = 4;
+    hid_kbd_state_t state = {};
+    uint8_t report[4] = {0, 0, 0x04, 0x05};
+    EXPECT_FALSE(hid_kbd_read_report(&layout, &state, report, sizeof(report)));
+    layout.fields[1].count = 2;
+    EXPECT_TRUE(hid_kbd_read_report(&layout, &state, report, sizeof(report)));
+}
+
+TEST_F(HidKbd, BootStream) {
+    layout = hid_kbd_boot_layout;
+    // Shift-h, i, rolled over from the h
+    EXPECT_EQ(Events({down(0xE1)}), feed({0x02, 0, 0, 0, 0, 0, 0, 0}));
+    EXPECT_EQ(Events({down(0x0B)}), feed({0x02, 0, 0x0B, 0, 0, 0, 0, 0}));
+    EXPECT_EQ(Events({up(0xE1)}), feed({0x00, 0, 0x0B, 0, 0, 0, 0, 0}));
+    EXPECT_EQ(Events({down(0x0C)}), feed({0x00, 0, 0x0B, 0x0C, 0, 0, 0, 0}));
+    EXPECT_EQ(Events({up(0x0B)}), feed({0x00, 0, 0x0C, 0, 0, 0, 0, 0}));
+    // The releases come before the presses
+    EXPECT_EQ(Events({up(0x0C), down(0x2C)}), feed({0x00, 0, 0x2C, 0, 0, 0, 0, 0}));
+    EXPECT_EQ(Events({up(0x2C)}), feed({0x00, 0, 0, 0, 0, 0, 0, 0}));
+    EXPECT_EQ(Events(), feed({0x00, 0, 0, 0, 0, 0, 0, 0}));
+}
+
+TEST_F(HidKbd, RollOverKeepsTheKeys) {
+    layout = hid_kbd_boot_layout;
+    feed({0x00, 0, 4, 5, 6, 7, 8, 9});
+    EXPECT_EQ(Events(), feed({0x00, 0, 1, 1, 1, 1, 1, 1}));
+    EXPECT_EQ(Events({up(4), up(5), up(6), up(7), up(8), down(10)}), feed({0x00, 0, 9, 10, 0, 0, 0, 0}));
+}
+
+TEST_F(HidKbd, ShortReportIsIgnored) {
+    layout = hid_kbd_boot_layout;
+    EXPECT_EQ(Events(), feed({0x00, 0, 4}));
+}
+
+TEST_F(HidKbd, NkroStream) {
+    parse(shared_descriptor, sizeof(shared_descriptor));
+    // A chord of ten keys comes in one report, and all of it in one diff
+    std::vector<uint8_t> chord = {0x04, 0x07, 0x09, 0x0D, 0x0E, 0x0F, 0x33, 0x2C, 0x64, 0x87};
+    Events expected;
+    for (uint8_t key : chord) {
+        expected.push_back(down(key));
+    }
+    expected.push_back(down(0xE0));
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(expected, feed(nkro_report(0x01, chord)));
+
+    // A mouse report on the same endpoint changes nothing
+    EXPECT_EQ(Events(), feed({1, 0, 5, 5, 0, 0}));
+
+    EXPECT_EQ(Events({up(0x04), up(0x87), down(0x05)}),
+              feed(nkro_report(0x01, {0x05, 0x07, 0x09, 0x0D, 0x0E, 0x0F, 0x33, 0x2C, 0x64})));
+    EXPECT_EQ(Events({up(0x05), up(0x07), up(0x09), up(0x0D), up(0x0E), up(0x0F), up(0x2C), up(0x33), up(0x64), up(0xE0)}),
+              feed(nkro_report(0, {})));
+}
+
+TEST_F(HidKbd, NkroReservedUsagesAreIgnored) {
+    parse(shared_descriptor, sizeof(shared_descriptor));
+    EXPECT_EQ(Events({down(0x04)}), feed(nkro_report(0, {0, 1, 2, 3, 4})));
+}
+
+TEST_F(HidKbd, Merge) {
+    hid_kbd_state_t state = {};
+    hid_kbd_state_t other = {};
+    state.bits[0] = 0x10;
+    other.bits[0] = 0x20;
+    other.bits[31] = 0x01;
+    hid_kbd_merge(&state, &other);
+    EXPECT_EQ(0x30, state.bits[0]);
+    EXPECT_EQ(0x01, state.bits[31]);
+}
+
+class HidKbdDevice : public HidKbd {
+public:
+    HidKbdDevice() {
+        // a boot keyboard on interface 0, and NKRO on the shared interface 1
+        hid_kbd_device_init(&device);
+        hid_kbd_device_set_layout(&device, 0, &hid_kbd_boot_layout);
+        parse(shared_descriptor, sizeof(shared_descriptor));
+        hid_kbd_device_set_layout(&device, 1, &layout);
+    }
+
+    // Feeds a report to an interface, and returns the events it caused
+    Events feed_iface(uint8_t iface, const std::vector<uint8_t>& report) {
+        hid_kbd_state_t state;
+        hid_kbd_device_read_report(&device, iface, report.data(), report.size());
+        hid_kbd_device_get_state(&device, &state);
+        events.clear();
+        hid_kbd_diff(&prev, &state, record_event);
+        return events;
+    }
+
+    hid_kbd_device_t device;
+};
+
+TEST_F(HidKbdDevice, InterfacesKeepTheirOwnKeys) {
+    EXPECT_EQ(Events({down(0x04)}), feed_iface(0, {0x00, 0, 0x04, 0, 0, 0, 0, 0}));
+    // The empty report of the other interface doesn't release the key
+    EXPECT_EQ(Events({down(0x05), down(0x87)}), feed_iface(1, nkro_report(0, {0x05, 0x87})));
+    EXPECT_EQ(Events(), feed_iface(0, {0x00, 0, 0x04, 0, 0, 0, 0, 0}));
+    EXPECT_EQ(Events({up(0x05), up(0x87)}), feed_iface(1, nkro_report(0, {})));
+    EXPECT_EQ(Events({down(0x06)}), feed_iface(1, nkro_report(0, {0x06})));
+    EXPECT_EQ(Events({up(0x04)}), feed_iface(0, {0x00, 0, 0, 0, 0, 0, 0, 0}));
+}
+
+TEST_F(HidKbdDevice, KeysOnBothInterfacesAreCombined) {
+    feed_iface(0, {0x02, 0, 0x04, 0, 0, 0, 0, 0});
+    feed_iface(1, nkro_report(0x02, {0x04, 0x05}));
+    hid_kbd_state_t state;
+    hid_kbd_device_get_state(&device, &state);
+    EXPECT_EQ(0x30, state.bits[0]);
+    EXPECT_EQ(0x02, state.bits[0xE1 / 8]);
+    // A key stays down until both interfaces release it
+    EXPECT_EQ(Events({up(0x05)}), feed_iface(1, nkro_report(0, {})));
+    EXPECT_EQ(Events({up(0x04), up(0xE1)}), feed_iface(0, {0x00, 0, 0, 0, 0, 0, 0, 0}));
+}
+
+TEST_F(HidKbdDevice, ReportOfAnotherLayoutIsIgnored) {
+    uint8_t report[8] = {0, 0, 0x04};
+    // A boot report doesn't fit the NKRO interface, and interface 2 has none
+    EXPECT_FALSE(hid_kbd_device_read_report(&device, 1, report, sizeof(report)));
+    EXPECT_FALSE(hid_kbd_device_read_report(&device, 2, report, sizeof(report)));
+    EXPECT_FALSE(hid_kbd_device_read_report(&device, HID_KBD_MAX_INTERFACES, report, sizeof(report)));
+}
+
+TEST_F(HidKbdDevice, SetLayoutReleasesTheKeys) {
+    feed_iface(0, {0x00, 0, 0x04, 0, 0, 0, 0, 0});
+    hid_kbd_device_set_layout(&device, 0, &hid_kbd_boot_layout);
+    EXPECT_EQ(Events({up(0x04)}), feed_iface(1, nkro_report(0, {})));
+}
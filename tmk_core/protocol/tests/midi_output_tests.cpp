@@ -0,0 +1,176 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "midi.h"
+#include "midi_output.h"
+}
+
+typedef std::vector<uint8_t> Bytes;
+
+static Bytes event(uint16_t cnt, uint8_t byte0, uint8_t byte1 = 0, uint8_t byte2 = 0) {
+    uint8_t e[MIDI_USB_EVENT_SIZE];
+    EXPECT_TRUE(midi_usb_event(0, cnt, byte0, byte1, byte2, e));
+    return Bytes(e, e + MIDI_USB_EVENT_SIZE);
+}
+
+TEST(MidiUsbEvent, ChannelMessagesUseTheStatusAsCodeIndex) {
+    EXPECT_EQ((Bytes{0x09, 0x93, 60, 100}), event(3, 0x93, 60, 100));
+    EXPECT_EQ((Bytes{0x08, 0x80, 60, 0}), event(3, 0x80, 60, 0));
+    EXPECT_EQ((Bytes{0x0B, 0xB0, 0x7B, 0}), event(3, 0xB0, 0x7B, 0));
+    EXPECT_EQ((Bytes{0x0C, 0xC1, 5, 0}), event(2, 0xC1, 5));
+    uint8_t e[MIDI_USB_EVENT_SIZE];
+    midi_usb_event(2, 3, 0x90, 1, 2, e);
+    EXPECT_EQ(0x29, e[0]);
+}
+
+TEST(MidiUsbEvent, SystemCommonMessages) {
+    EXPECT_EQ((Bytes{0x03, MIDI_SONGPOSITION, 1, 2}), event(3, MIDI_SONGPOSITION, 1, 2));
+    EXPECT_EQ((Bytes{0x02, MIDI_SONGSELECT, 1, 0}), event(2, MIDI_SONGSELECT, 1));
+    EXPECT_EQ((Bytes{0x02, MIDI_TC_QUARTERFRAME, 1, 0}), event(2, MIDI_TC_QUARTERFRAME, 1));
+    EXPECT_EQ((Bytes{0x0F, MIDI_CLOCK, 0, 0}), event(1, MIDI_CLOCK));
+}
+
+TEST(MidiUsbEvent, SysexFragments) {
+    EXPECT_EQ((Bytes{0x04, SYSEX_BEGIN, 1, 2}), event(3, SYSEX_BEGIN, 1, 2));
+    EXPECT_EQ((Bytes{0x07, 3, 4, SYSEX_END}), event(3, 3, 4, SYSEX_END));
+    EXPECT_EQ((Bytes{0x06, 3, SYSEX_END, 0}), event(2, 3, SYSEX_END));
+    EXPECT_EQ((Bytes{0x05, SYSEX_END, 0, 0}), event(1, SYSEX_END));
+    uint8_t e[MIDI_USB_EVENT_SIZE];
+    EXPECT_FALSE(midi_usb_event(0, 4, SYSEX_BEGIN, 1, 2, e));
+}
+
+TEST(MidiBatch, HoldsOneBulkPacket) {
+    midi_batch_t batch;
+    midi_batch_clear(&batch);
+    Bytes e = event(3, 0x90, 60, 100);
+    for (int i = 0; i < MIDI_BATCH_SIZE; i++) {
+        EXPECT_FALSE(midi_batch_full(&batch));
+        EXPECT_TRUE(midi_batch_add(&batch, e.data()));
+    }
+    EXPECT_TRUE(midi_batch_full(&batch));
+    EXPECT_FALSE(midi_batch_add(&batch, e.data()));
+    EXPECT_EQ(64, midi_batch_bytes(&batch));
+    midi_batch_clear(&batch);
+    EXPECT_EQ(0, midi_batch_bytes(&batch));
+}
+
+// The host polls the bulk endpoint once per millisecond, and a chord of
+// notes is played faster than that. One bulk packet per message was one
+// message per millisecond.
+TEST(MidiBatch, EventsPerMillisecond) {
+    const unsigned message_count = 1600;
+    midi_batch_t batch;
+    midi_batch_clear(&batch);
+    Bytes received;
+    unsigned ms = 0;
+    unsigned sent = 0;
+    while (sent < message_count || batch.count) {
+        // everything the keyboard has to send, until the batch is full
+        while (sent < message_count) {
+            uint8_t e[MIDI_USB_EVENT_SIZE];
+            ASSERT_TRUE(midi_usb_event(0, 3, 0x90, sent % 128, 100, e));
+            if (!midi_batch_add(&batch, e)) {
+                break;
+            }
+            sent++;
+        }
+        // one packet per frame
+        received.insert(received.end(), batch.events[0], batch.events[0] + midi_batch_bytes(&batch));
+        midi_batch_clear(&batch);
+        ms++;
+    }
+    ASSERT_EQ(message_count * MIDI_USB_EVENT_SIZE, received.size());
+    for (unsigned i = 0; i < message_count; i++) {
+        EXPECT_EQ(i % 128, received[i * MIDI_USB_EVENT_SIZE + 2]);
+    }
+    double events_per_ms = (double)message_count / ms;
+    std::cout << "[          ] " << events_per_ms << " events per ms" << std::endl;
+    EXPECT_EQ(MIDI_BATCH_SIZE, events_per_ms);
+}
+
+class MidiRunningStatus : public testing::Test {
+public:
+    MidiRunningStatus() {
+        midi_running_status_reset(&state);
+    }
+
+    Bytes encode(uint8_t cnt, uint8_t byte0, uint8_t byte1 = 0, uint8_t byte2 = 0) {
+        uint8_t out[3];
+        uint8_t length = midi_running_status_encode(&state, cnt, byte0, byte1, byte2, out);
+        return Bytes(out, out + length);
+    }
+
+    midi_running_status_t state;
+};
+
+TEST_F(MidiRunningStatus, RepeatedStatusIsLeftOut) {
+    EXPECT_EQ((Bytes{0x90, 60, 100}), encode(3, 0x90, 60, 100));
+    EXPECT_EQ((Bytes{64, 100}), encode(3, 0x90, 64, 100));
+    EXPECT_EQ((Bytes{67, 100}), encode(3, 0x90, 67, 100));
+    EXPECT_EQ((Bytes{0x91, 60, 100}), encode(3, 0x91, 60, 100));
+    EXPECT_EQ((Bytes{0xC1, 5}), encode(2, 0xC1, 5));
+    EXPECT_EQ((Bytes{6}), encode(2, 0xC1, 6));
+}
+
+TEST_F(MidiRunningStatus, RealTimeKeepsTheRunningStatus) {
+    encode(3, 0x90, 60, 100);
+    EXPECT_EQ((Bytes{MIDI_CLOCK}), encode(1, MIDI_CLOCK));
+    EXPECT_EQ((Bytes{64, 100}), encode(3, 0x90, 64, 100));
+}
+
+TEST_F(MidiRunningStatus, SystemCommonAndSysexCancelIt) {
+    encode(3, 0x90, 60, 100);
+    EXPECT_EQ((Bytes{MIDI_SONGSELECT, 1}), encode(2, MIDI_SONGSELECT, 1));
+    EXPECT_EQ((Bytes{0x90, 64, 100}), encode(3, 0x90, 64, 100));
+    EXPECT_EQ((Bytes{SYSEX_BEGIN, 1, 2}), encode(3, SYSEX_BEGIN, 1, 2));
+    EXPECT_EQ((Bytes{3, SYSEX_END}), encode(2, 3, SYSEX_END));
+    EXPECT_EQ((Bytes{0x90, 64, 100}), encode(3, 0x90, 64, 100));
+}
+
+TEST(MidiNoteSet, AddsAndRemovesNotes) {
+    midi_note_set_t set;
+    midi_note_set_clear(&set);
+    EXPECT_TRUE(midi_note_set_add(&set, 0));
+    EXPECT_TRUE(midi_note_set_add(&set, 127));
+    EXPECT_FALSE(midi_note_set_add(&set, 127));
+    EXPECT_TRUE(midi_note_set_contains(&set, 127));
+    EXPECT_FALSE(midi_note_set_contains(&set, 126));
+    EXPECT_EQ(2, set.count);
+    EXPECT_TRUE(midi_note_set_remove(&set, 0));
+    EXPECT_FALSE(midi_note_set_remove(&set, 0));
+    EXPECT_EQ(1, set.count);
+}
+
+TEST(MidiNoteSet, PopsTheHeldNotesInOrder) {
+    midi_note_set_t set;
+    midi_note_set_clear(&set);
+    EXPECT_EQ(MIDI_NOTE_NONE, midi_note_set_pop(&set));
+    std::vector<uint8_t> notes = {3, 9, 60, 64, 67, 127};
+    for (auto it = notes.rbegin(); it != notes.rend(); ++it) {
+        midi_note_set_add(&set, *it);
+    }
+    std::vector<uint8_t> popped;
+    uint8_t note;
+    while ((note = midi_note_set_pop(&set)) != MIDI_NOTE_NONE) {
+        popped.push_back(note);
+    }
+    EXPECT_EQ(notes, popped);
+    EXPECT_EQ(0, set.count);
+}
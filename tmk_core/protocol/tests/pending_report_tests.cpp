@@ -0,0 +1,217 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+extern "C" {
+#include "pending_report.h"
+void advance_time(uint32_t ms);
+}
+
+using testing::ElementsAre;
+using testing::ElementsAreArray;
+
+// The host only polls the endpoints when it's not busy
+static bool endpoint_busy;
+static std::vector<std::vector<uint8_t>> sent;
+
+extern "C" bool pending_report_write(pending_report_t *slot, const void *report) {
+    if (endpoint_busy) {
+        // Until the host polls, time passes
+        advance_time(1);
+        return false;
+    }
+    std::vector<uint8_t> packet;
+    if (slot->report_id) {
+        packet.push_back(slot->report_id);
+    }
+    const uint8_t *data = (const uint8_t *)report;
+    packet.insert(packet.end(), data, data + slot->size);
+    sent.push_back(packet);
+    // A report keeps the endpoint busy until the next poll
+    endpoint_busy = true;
+    return true;
+}
+
+// Buttons and movement, which is only merged while it fits
+static bool coalesce_motion(uint8_t *pending, const uint8_t *report, uint8_t size) {
+    int sum = (int8_t)pending[1] + (int8_t)report[1];
+    if (pending[0] != report[0] || sum > 127 || sum < -127) {
+        return false;
+    }
+    pending[1] = sum;
+    return true;
+}
+
+static uint8_t keyboard_buffer[PENDING_REPORTS][2];
+static uint8_t extra_buffer[PENDING_REPORTS][2];
+static uint8_t mouse_buffer[PENDING_REPORTS][2];
+
+class PendingReport : public testing::Test {
+public:
+    PendingReport() :
+        keyboard{1, 0, 2, 0, pending_report_same, keyboard_buffer[0]},
+        extra{2, 0, 2, 0, pending_report_same, extra_buffer[0]},
+        mouse{3, 0, 2, 0, coalesce_motion, mouse_buffer[0]},
+        slots{&keyboard, &extra, &mouse}
+    {
+        endpoint_busy = false;
+        sent.clear();
+        usb_report_stats = {};
+    }
+
+    void send(pending_report_t *slot, uint8_t a, uint8_t b) {
+        uint8_t report[2] = {a, b};
+        pending_report_send(slots, 3, slot, report);
+    }
+
+    // The host polls, and takes one report from every endpoint that has one
+    void poll() {
+        endpoint_busy = false;
+        pending_report_retry(slots, 3);
+    }
+
+    // Polls until there's nothing left
+    void poll_all() {
+        for (int i = 0; i < 20; i++) {
+            poll();
+        }
+    }
+
+    pending_report_t keyboard;
+    pending_report_t extra;
+    pending_report_t mouse;
+    pending_report_t *slots[3];
+};
+
+TEST_F(PendingReport, SendsRightAwayWhenTheEndpointIsFree) {
+    send(&keyboard, 0, 4);
+    EXPECT_THAT(sent, ElementsAre(ElementsAre(0, 4)));
+    EXPECT_EQ(keyboard.count, 0);
+}
+
+TEST_F(PendingReport, SendsBothThePressAndReleaseOfATapWhileBusy) {
+    endpoint_busy = true;
+    send(&keyboard, 0, 4);
+    send(&keyboard, 0, 0);
+    poll_all();
+    EXPECT_THAT(sent, ElementsAre(ElementsAre(0, 4), ElementsAre(0, 0)));
+    EXPECT_EQ(usb_report_stats.retried, 2);
+    EXPECT_EQ(usb_report_stats.dropped, 0);
+}
+
+TEST_F(PendingReport, RepeatedStateReportsAreCoalesced) {
+    endpoint_busy = true;
+    send(&keyboard, 0, 4);
+    send(&keyboard, 0, 4);
+    poll_all();
+    EXPECT_THAT(sent, ElementsAre(ElementsAre(0, 4)));
+    EXPECT_EQ(usb_report_stats.coalesced, 1);
+}
+
+TEST_F(PendingReport, SendsMouseButtonPressAndReleaseWhileBusy) {
+    endpoint_busy = true;
+    send(&mouse, 1, 0);
+    send(&mouse, 0, 0);
+    poll_all();
+    EXPECT_THAT(sent, ElementsAre(ElementsAre(1, 0), ElementsAre(0, 0)));
+}
+
+TEST_F(PendingReport, MergesMouseMotionWhileTheButtonsStayTheSame) {
+    endpoint_busy = true;
+    send(&mouse, 0, 10);
+    send(&mouse, 0, 20);
+    send(&mouse, 1, 5);
+    send(&mouse, 1, 5);
+    poll_all();
+    EXPECT_THAT(sent, ElementsAre(ElementsAre(0, 30), ElementsAre(1, 10)));
+}
+
+TEST_F(PendingReport, NewReportsGoAfterTheWaitingOnes) {
+    endpoint_busy = true;
+    send(&keyboard, 0, 4);
+    // The host polled, but the main loop hasn't retried yet
+    endpoint_busy = false;
+    send(&keyboard, 0, 0);
+    EXPECT_THAT(sent, ElementsAre(ElementsAre(0, 4)));
+    poll_all();
+    EXPECT_THAT(sent, ElementsAre(ElementsAre(0, 4), ElementsAre(0, 0)));
+}
+
+TEST_F(PendingReport, WaitsForTheEndpointWhenFullAndDropsAfterTheTimeout) {
+    endpoint_busy = true;
+    for (int i = 0; i < PENDING_REPORTS; i++) {
+        send(&keyboard, 0, i);
+    }
+    EXPECT_EQ(keyboard.count, PENDING_REPORTS);
+    send(&keyboard, 0, 100);
+    EXPECT_EQ(usb_report_stats.dropped, 1);
+    poll_all();
+    ASSERT_EQ(sent.size(), PENDING_REPORTS);
+    for (int i = 0; i < PENDING_REPORTS; i++) {
+        EXPECT_THAT(sent[i], ElementsAre(0, i));
+    }
+}
+
+TEST_F(PendingReport, ClearDropsTheWaitingReports) {
+    endpoint_busy = true;
+    send(&keyboard, 0, 4);
+    send(&mouse, 1, 0);
+    pending_report_clear(slots, 3);
+    poll_all();
+    EXPECT_TRUE(sent.empty());
+}
+
+class SharedEndpoint : public PendingReport {
+public:
+    SharedEndpoint() {
+        // Like SHARED_EP_ENABLE, with report IDs
+        extra.epnum = keyboard.epnum;
+        mouse.epnum = keyboard.epnum;
+        mouse.report_id = 1;
+    }
+};
+
+TEST_F(SharedEndpoint, SendsEveryStateChangeOfEveryReportWhileBusy) {
+    endpoint_busy = true;
+    send(&mouse, 1, 0);
+    send(&extra, 3, 0xE9);
+    send(&keyboard, 0, 4);
+    send(&mouse, 0, 0);
+    send(&extra, 3, 0);
+    send(&keyboard, 0, 0);
+    poll_all();
+    // Keystrokes first, then media keys and the mouse, each in order
+    EXPECT_THAT(sent, ElementsAre(
+        ElementsAre(0, 4),
+        ElementsAre(0, 0),
+        ElementsAre(3, 0xE9),
+        ElementsAre(3, 0),
+        ElementsAre(1, 1, 0),
+        ElementsAre(1, 0, 0)));
+}
+
+TEST_F(SharedEndpoint, ALowerPriorityReportWaitsBehindTheHigherOnes) {
+    endpoint_busy = true;
+    send(&keyboard, 0, 4);
+    endpoint_busy = false;
+    // The endpoint is free, but the keystroke goes first
+    send(&mouse, 0, 10);
+    EXPECT_THAT(sent, ElementsAre(ElementsAre(0, 4)));
+    poll_all();
+    EXPECT_THAT(sent, ElementsAre(ElementsAre(0, 4), ElementsAre(1, 0, 10)));
+}
@@ -0,0 +1,286 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "ps2_frame.h"
+#include "ps2_mouse_packet.h"
+}
+
+// A PS/2 line with a mouse in stream mode, as falling clock edges, and the
+// host side of ps2_interrupt.c, which decodes the edges into bytes and the
+// bytes into packets
+static const uint32_t BIT_US = 80;
+static const uint32_t BYTE_GAP_US = 100;
+static const uint32_t PACKET_US = 10000;
+
+struct Edge {
+    uint32_t time_us;
+    bool data;
+};
+
+class Ps2MouseStream : public testing::Test {
+public:
+    Ps2MouseStream() : frame(), framer(), packets(), errors(0) {
+        framer.size = 3;
+    }
+
+    static ps2_mouse_packet_t make_packet(int i) {
+        ps2_mouse_packet_t packet;
+        packet.status = PS2_MOUSE_PACKET_SYNC | (i % 8) | (i % 3 ? 0x10 : 0x20);
+        packet.x = i * 7;
+        packet.y = 0xFF - i * 3;
+        packet.z = i % 16;
+        return packet;
+    }
+
+    static void append_byte(std::vector<Edge>& edges, uint32_t& time, uint8_t data) {
+        bool parity = true;
+        edges.push_back({time, false});
+        for (int i = 0; i < 8; i++) {
+            bool bit = data & (1 << i);
+            parity ^= bit;
+            time += BIT_US;
+            edges.push_back({time, bit});
+        }
+        time += BIT_US;
+        edges.push_back({time, parity});
+        time += BIT_US;
+        edges.push_back({time, true});
+        time += BYTE_GAP_US;
+    }
+
+    // The edges of each packet, starting PACKET_US apart
+    std::vector<std::vector<Edge>> stream(int count) {
+        std::vector<std::vector<Edge>> result;
+        for (int i = 0; i < count; i++) {
+            uint32_t time = i * PACKET_US;
+            ps2_mouse_packet_t packet = make_packet(i);
+            uint8_t bytes[] = {packet.status, packet.x, packet.y, packet.z};
+            std::vector<Edge> edges;
+            for (int b = 0; b < framer.size; b++) {
+                append_byte(edges, time, bytes[b]);
+            }
+            result.push_back(edges);
+        }
+        return result;
+    }
+
+    void feed(const std::vector<Edge>& edges) {
+        for (auto& edge : edges) {
+            uint8_t now = edge.time_us / 1000;
+            int16_t data = ps2_frame_bit(&frame, edge.data, now);
+            if (data == PS2_FRAME_ERROR) {
+                errors++;
+                ps2_mouse_framer_reset(&framer);
+            } else if (data != PS2_FRAME_MORE) {
+                if (ps2_mouse_framer_put(&framer, data, now)) {
+                    ps2_mouse_packet_ring_push(&packets, framer.packet);
+                }
+            }
+        }
+    }
+
+    void feed(const std::vector<std::vector<Edge>>& packet_edges) {
+        for (auto& edges : packet_edges) {
+            feed(edges);
+        }
+    }
+
+    // Checks that the packets came in order, and returns their numbers
+    std::vector<int> received() {
+        std::vector<int> result;
+        ps2_mouse_packet_t packet;
+        while (ps2_mouse_packet_ring_pop(&packets, &packet)) {
+            int i = packet.x / 7;
+            ps2_mouse_packet_t expected = make_packet(i);
+            EXPECT_EQ(expected.status, packet.status);
+            EXPECT_EQ(expected.x, packet.x);
+            EXPECT_EQ(expected.y, packet.y);
+            EXPECT_EQ(framer.size == 4 ? expected.z : 0, packet.z);
+            result.push_back(i);
+        }
+        return result;
+    }
+
+    static std::vector<int> all_but(int count, int missing) {
+        std::vector<int> result;
+        for (int i = 0; i < count; i++) {
+            if (i != missing) {
+                result.push_back(i);
+            }
+        }
+        return result;
+    }
+
+    ps2_frame_t frame;
+    ps2_mouse_framer_t framer;
+    ps2_mouse_packet_ring_t packets;
+    int errors;
+};
+
+TEST_F(Ps2MouseStream, CleanStreamIsReceived) {
+    feed(stream(6));
+    EXPECT_EQ(all_but(6, -1), received());
+    EXPECT_EQ(0, errors);
+    EXPECT_EQ(0, framer.resyncs);
+}
+
+TEST_F(Ps2MouseStream, FourBytePacketsAreReceived) {
+    framer.size = 4;
+    feed(stream(6));
+    EXPECT_EQ(all_but(6, -1), received());
+    EXPECT_EQ(0, framer.resyncs);
+}
+
+TEST_F(Ps2MouseStream, ByteAcrossTimerTickIsReceived) {
+    // The first byte starts just before a millisecond tick
+    std::vector<Edge> edges;
+    uint32_t time = 999;
+    append_byte(edges, time, 0x08);
+    append_byte(edges, time, 0x12);
+    append_byte(edges, time, 0x34);
+    feed(edges);
+    ps2_mouse_packet_t packet;
+    ASSERT_TRUE(ps2_mouse_packet_ring_pop(&packets, &packet));
+    EXPECT_EQ(0x08, packet.status);
+    EXPECT_EQ(0x12, packet.x);
+    EXPECT_EQ(0x34, packet.y);
+}
+
+TEST_F(Ps2MouseStream, LostClockEdgeOnlyLosesThatPacket) {
+    for (uint8_t size = 3; size <= 4; size++) {
+        framer.size = size;
+        auto packet_edges = stream(4);
+        for (size_t lost = 0; lost < packet_edges[1].size(); lost++) {
+            auto damaged = packet_edges;
+            damaged[1].erase(damaged[1].begin() + lost);
+            feed(damaged);
+            EXPECT_EQ(all_but(4, 1), received()) << "size " << (int)size << " edge " << lost;
+            frame = ps2_frame_t();
+            framer.count = 0;
+        }
+    }
+}
+
+TEST_F(Ps2MouseStream, ExtraClockEdgeDoesntAffectTheNextPacket) {
+    auto packet_edges = stream(4);
+    for (size_t extra = 0; extra < packet_edges[2].size(); extra++) {
+        auto damaged = packet_edges;
+        Edge glitch = damaged[2][extra];
+        glitch.time_us += BIT_US / 2;
+        glitch.data = !glitch.data;
+        damaged[2].insert(damaged[2].begin() + extra + 1, glitch);
+        feed(damaged);
+        // Parity can't catch every shifted frame, so the damaged packet
+        // may still come through, but the stream is in sync again after it
+        std::vector<ps2_mouse_packet_t> got;
+        ps2_mouse_packet_t packet;
+        while (ps2_mouse_packet_ring_pop(&packets, &packet)) {
+            got.push_back(packet);
+        }
+        ASSERT_GE(got.size(), 3) << "edge " << extra;
+        ASSERT_LE(got.size(), 4) << "edge " << extra;
+        EXPECT_EQ(make_packet(0).x, got.front().x) << "edge " << extra;
+        EXPECT_EQ(make_packet(1).x, got[1].x) << "edge " << extra;
+        EXPECT_EQ(make_packet(3).status, got.back().status) << "edge " << extra;
+        EXPECT_EQ(make_packet(3).x, got.back().x) << "edge " << extra;
+        EXPECT_EQ(make_packet(3).y, got.back().y) << "edge " << extra;
+        frame = ps2_frame_t();
+        framer.count = 0;
+    }
+}
+
+TEST_F(Ps2MouseStream, ParityErrorLosesThePacket) {
+    auto packet_edges = stream(3);
+    // parity bit of the second byte
+    packet_edges[1][11 + 9].data = !packet_edges[1][11 + 9].data;
+    feed(packet_edges);
+    EXPECT_EQ(all_but(3, 1), received());
+    // The stop bit of the frame is then taken as a wrong start bit
+    EXPECT_EQ(2, errors);
+    EXPECT_EQ(PS2_FRAME_START, frame.error);
+    EXPECT_GE(framer.resyncs, 1);
+}
+
+TEST_F(Ps2MouseStream, LostByteLosesThePacket) {
+    auto packet_edges = stream(3);
+    packet_edges[1].erase(packet_edges[1].begin() + 11, packet_edges[1].begin() + 22);
+    feed(packet_edges);
+    EXPECT_EQ(all_but(3, 1), received());
+    EXPECT_EQ(0, errors);
+    EXPECT_EQ(1, framer.resyncs);
+}
+
+TEST_F(Ps2MouseStream, StartingInTheMiddleOfAPacketResyncs) {
+    auto packet_edges = stream(3);
+    packet_edges[0].erase(packet_edges[0].begin(), packet_edges[0].begin() + 11);
+    feed(packet_edges);
+    EXPECT_EQ(all_but(3, 0), received());
+}
+
+TEST_F(Ps2MouseStream, BytesWithoutSyncBitAreSkipped) {
+    uint8_t bytes[] = {0x00, 0x17, 0x09, 0x01, 0x02};
+    bool complete = false;
+    for (uint8_t data : bytes) {
+        complete = ps2_mouse_framer_put(&framer, data, 0);
+    }
+    EXPECT_TRUE(complete);
+    EXPECT_EQ(0x09, framer.packet.status);
+    EXPECT_EQ(0x01, framer.packet.x);
+    EXPECT_EQ(0x02, framer.packet.y);
+    EXPECT_EQ(2, framer.resyncs);
+}
+
+TEST_F(Ps2MouseStream, FullQueueDropsPackets) {
+    feed(stream(PS2_MOUSE_PACKET_QUEUE_SIZE + 2));
+    EXPECT_EQ(PS2_MOUSE_PACKET_QUEUE_SIZE, received().size());
+    EXPECT_EQ(2, packets.ring.dropped);
+}
+
+TEST(Ps2MouseMerge, AddsMovement) {
+    report_mouse_t total = {1, 10, -20, 1, 0};
+    report_mouse_t report = {1, 5, -5, 1, 2};
+    EXPECT_TRUE(ps2_mouse_merge_report(&total, &report));
+    EXPECT_EQ(1, total.buttons);
+    EXPECT_EQ(15, total.x);
+    EXPECT_EQ(-25, total.y);
+    EXPECT_EQ(2, total.v);
+    EXPECT_EQ(2, total.h);
+}
+
+TEST(Ps2MouseMerge, KeepsButtonChanges) {
+    report_mouse_t total = {0, 10, 0, 0, 0};
+    report_mouse_t report = {1, 5, 0, 0, 0};
+    EXPECT_FALSE(ps2_mouse_merge_report(&total, &report));
+    EXPECT_EQ(10, total.x);
+}
+
+TEST(Ps2MouseMerge, StopsBeforeOverflow) {
+    report_mouse_t total = {0, 100, 0, 0, 0};
+    report_mouse_t report = {0, 27, 0, 0, 0};
+    EXPECT_TRUE(ps2_mouse_merge_report(&total, &report));
+    EXPECT_EQ(127, total.x);
+    report.x = 1;
+    EXPECT_FALSE(ps2_mouse_merge_report(&total, &report));
+    total.y = -100;
+    report = {0, 0, -28, 0, 0};
+    total.x = 0;
+    EXPECT_FALSE(ps2_mouse_merge_report(&total, &report));
+    EXPECT_EQ(-100, total.y);
+}
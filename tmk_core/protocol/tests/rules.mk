@@ -0,0 +1,68 @@
+usb_polling_lufa_SRC := $(TMK_PATH)/protocol/tests/usb_polling_tests.cpp
+usb_polling_lufa_INC := $(TMK_PATH)/protocol
+usb_polling_lufa_DEFS := -DPROTOCOL_LUFA -DUSB_POLLING_TEST_LUFA
+
+usb_polling_chibios_SRC := $(usb_polling_lufa_SRC)
+usb_polling_chibios_INC := $(usb_polling_lufa_INC)
+usb_polling_chibios_DEFS := -DPROTOCOL_CHIBIOS -DUSB_POLLING_TEST_CHIBIOS
+
+usb_polling_1ms_SRC := $(usb_polling_lufa_SRC)
+usb_polling_1ms_INC := $(usb_polling_lufa_INC)
+usb_polling_1ms_DEFS :=\
+	-DPROTOCOL_LUFA\
+	-DUSB_POLLING_INTERVAL_MS=1\
+	-DUSB_POLLING_TEST_1MS
+
+usb_polling_override_SRC := $(usb_polling_lufa_SRC)
+usb_polling_override_INC := $(usb_polling_lufa_INC)
+usb_polling_override_DEFS :=\
+	-DPROTOCOL_CHIBIOS\
+	-DUSB_POLLING_INTERVAL_MS=4\
+	-DMOUSE_POLLING_INTERVAL_MS=1\
+	-DUSB_POLLING_TEST_OVERRIDE
+
+usb_polling_high_speed_SRC := $(usb_polling_lufa_SRC)
+usb_polling_high_speed_INC := $(usb_polling_lufa_INC)
+usb_polling_high_speed_DEFS :=\
+	-DPROTOCOL_CHIBIOS\
+	-DUSB_HIGH_SPEED\
+	-DUSB_POLLING_INTERVAL_MS=8\
+	-DMOUSE_POLLING_INTERVAL_MS=1\
+	-DNKRO_POLLING_INTERVAL_MS=3\
+	-DUSB_POLLING_TEST_HIGH_SPEED
+
+midi_output_SRC :=\
+	$(TMK_PATH)/protocol/tests/midi_output_tests.cpp \
+	$(TMK_PATH)/protocol/midi/midi_output.c \
+	$(TMK_PATH)/protocol/midi/midi.c
+midi_output_INC := $(TMK_PATH)/protocol/midi
+
+adafruit_ble_sdep_SRC :=\
+	$(TMK_PATH)/protocol/tests/adafruit_ble_sdep_tests.cpp \
+	$(TMK_PATH)/protocol/lufa/adafruit_ble_sdep.cpp \
+	$(TMK_PATH)/common/test/timer.c
+adafruit_ble_sdep_INC := $(TMK_PATH)/protocol/lufa
+adafruit_ble_sdep_DEFS := -DNO_DEBUG -DMOUSE_ENABLE
+
+ps2_mouse_stream_SRC :=\
+	$(TMK_PATH)/protocol/tests/ps2_mouse_stream_tests.cpp \
+	$(TMK_PATH)/protocol/ps2_mouse_packet.c
+ps2_mouse_stream_INC := $(TMK_PATH)/protocol $(TMK_PATH)/common
+
+hid_kbd_SRC :=\
+	$(TMK_PATH)/protocol/tests/hid_kbd_tests.cpp \
+	$(TMK_PATH)/protocol/usb_hid/hid_kbd.c
+hid_kbd_INC := $(TMK_PATH)/protocol/usb_hid
+
+converter_engine_SRC :=\
+	$(TMK_PATH)/protocol/tests/converter_engine_tests.cpp \
+	$(TMK_PATH)/protocol/converter_engine.c \
+	$(TMK_PATH)/protocol/converter_decoders.c
+converter_engine_INC := $(TMK_PATH)/protocol $(TMK_PATH)/common
+converter_engine_DEFS := -DNO_DEBUG
+
+pending_report_SRC :=\
+	$(TMK_PATH)/protocol/tests/pending_report_tests.cpp \
+	$(TMK_PATH)/protocol/lufa/pending_report.c \
+	$(TMK_PATH)/common/test/timer.c
+pending_report_INC := $(TMK_PATH)/protocol/lufa
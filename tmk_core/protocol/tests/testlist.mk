@@ -0,0 +1,12 @@
+TEST_LIST +=\
+	usb_polling_lufa\
+	usb_polling_chibios\
+	usb_polling_1ms\
+	usb_polling_override\
+	usb_polling_high_speed\
+	midi_output\
+	adafruit_ble_sdep\
+	ps2_mouse_stream\
+	hid_kbd\
+	converter_engine\
+	pending_report
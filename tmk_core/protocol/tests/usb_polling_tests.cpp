@@ -0,0 +1,89 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <stdint.h>
+extern "C" {
+#include "usb_polling.h"
+}
+
+// The same tests are built once per configuration, see rules.mk, and check
+// the bInterval every endpoint descriptor is initialized with against the
+// value the host should see with that configuration.
+
+// The bInterval fields, initialized like in lufa/descriptor.c and
+// chibios/usb_main.c
+static const uint8_t keyboard_binterval = KEYBOARD_POLLING_BINTERVAL;
+static const uint8_t mouse_binterval = MOUSE_POLLING_BINTERVAL;
+static const uint8_t extrakey_binterval = EXTRAKEY_POLLING_BINTERVAL;
+static const uint8_t nkro_binterval = NKRO_POLLING_BINTERVAL;
+static const uint8_t shared_binterval = SHARED_POLLING_BINTERVAL;
+static const uint8_t steno_binterval = STENO_POLLING_BINTERVAL;
+
+#if defined(USB_POLLING_TEST_LUFA)
+// no options, the LUFA defaults
+static const uint8_t expected[] = {10, 10, 10, 1, 1, 1};
+#elif defined(USB_POLLING_TEST_CHIBIOS)
+// no options, the ChibiOS defaults
+static const uint8_t expected[] = {10, 1, 10, 1, 1, 1};
+#elif defined(USB_POLLING_TEST_1MS)
+// USB_POLLING_INTERVAL_MS=1
+static const uint8_t expected[] = {1, 1, 1, 1, 1, 1};
+#elif defined(USB_POLLING_TEST_OVERRIDE)
+// USB_POLLING_INTERVAL_MS=4 and MOUSE_POLLING_INTERVAL_MS=1
+static const uint8_t expected[] = {4, 1, 4, 4, 4, 4};
+#elif defined(USB_POLLING_TEST_HIGH_SPEED)
+// USB_POLLING_INTERVAL_MS=8, MOUSE_POLLING_INTERVAL_MS=1 and
+// NKRO_POLLING_INTERVAL_MS=3, in 2^(bInterval-1) microframes
+static const uint8_t expected[] = {7, 4, 7, 5, 7, 7};
+#else
+#error "No configuration to test"
+#endif
+
+TEST(UsbPolling, KeyboardInterval) {
+    EXPECT_EQ(keyboard_binterval, expected[0]);
+}
+
+TEST(UsbPolling, MouseInterval) {
+    EXPECT_EQ(mouse_binterval, expected[1]);
+}
+
+TEST(UsbPolling, ExtrakeyInterval) {
+    EXPECT_EQ(extrakey_binterval, expected[2]);
+}
+
+TEST(UsbPolling, NkroInterval) {
+    EXPECT_EQ(nkro_binterval, expected[3]);
+}
+
+TEST(UsbPolling, SharedInterval) {
+    EXPECT_EQ(shared_binterval, expected[4]);
+}
+
+TEST(UsbPolling, StenoInterval) {
+    EXPECT_EQ(steno_binterval, expected[5]);
+}
+
+#ifdef USB_HIGH_SPEED
+TEST(UsbPolling, HighSpeedIntervalsAreRoundedDownToPowersOfTwo) {
+    EXPECT_EQ(USB_POLLING_BINTERVAL(1), 4);
+    EXPECT_EQ(USB_POLLING_BINTERVAL(2), 5);
+    EXPECT_EQ(USB_POLLING_BINTERVAL(3), 5);
+    EXPECT_EQ(USB_POLLING_BINTERVAL(10), 7);
+    EXPECT_EQ(USB_POLLING_BINTERVAL(16), 8);
+    EXPECT_EQ(USB_POLLING_BINTERVAL(255), 11);
+}
+#endif
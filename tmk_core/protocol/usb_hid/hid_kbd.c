@@ -0,0 +1,321 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "hid_kbd.h"
+
+
+#define USAGE_PAGE_KEYBOARD 0x07
+#define USAGE_ROLL_OVER     0x01
+#define USAGE_FIRST_KEY     0x04    /* Keyboard a and A */
+
+#define INPUT_CONSTANT      0x01
+#define INPUT_VARIABLE      0x02
+
+/* long items are skipped, their data size comes after the prefix */
+#define ITEM_LONG           0xFE
+#define ITEM_SKIP           0xFF
+
+enum { ITEM_MAIN, ITEM_GLOBAL, ITEM_LOCAL };
+enum { MAIN_INPUT = 8, MAIN_OUTPUT, MAIN_COLLECTION, MAIN_FEATURE, MAIN_END_COLLECTION };
+enum { GLOBAL_USAGE_PAGE, GLOBAL_LOGICAL_MIN, GLOBAL_REPORT_SIZE = 7, GLOBAL_REPORT_ID, GLOBAL_REPORT_COUNT };
+enum { LOCAL_USAGE, LOCAL_USAGE_MIN, LOCAL_USAGE_MAX };
+
+const hid_kbd_layout_t hid_kbd_boot_layout = {
+    .report_id = 0,
+    .length = 8,
+    .field_count = 2,
+    .fields = {
+        { .offset = 0, .count = 8, .size = 1, .usage_min = 0xE0 },
+        { .offset = 16, .count = 6, .size = 8, .usage_min = 0 },
+    },
+};
+
+
+void hid_kbd_parser_init(hid_kbd_parser_t *parser, hid_kbd_layout_t *layout)
+{
+    memset(parser, 0, sizeof(*parser));
+    memset(layout, 0, sizeof(*layout));
+    parser->layout = layout;
+}
+
+static void add_input(hid_kbd_parser_t *p, uint8_t flags)
+{
+    hid_kbd_layout_t *layout = p->layout;
+    uint32_t bits = (uint32_t)p->report_size * p->report_count;
+    // the offsets stop at 0xFFFF bits, which no report is as long as
+    uint32_t end = p->offset + bits;
+    if (end > 0xFFFF) {
+        end = 0xFFFF;
+    }
+
+    if (p->usage_page == USAGE_PAGE_KEYBOARD && !(flags & INPUT_CONSTANT) && bits && !p->locked) {
+        p->locked = true;
+        layout->report_id = p->report_id;
+    }
+    if (p->locked && p->report_id == layout->report_id) {
+        if (p->usage_page == USAGE_PAGE_KEYBOARD && !(flags & INPUT_CONSTANT) &&
+                layout->field_count < HID_KBD_MAX_FIELDS && p->usage_min <= 0xFF) {
+            hid_kbd_field_t *field = &layout->fields[layout->field_count];
+            field->offset = p->offset;
+            field->count = p->report_count;
+            field->usage_min = p->usage_min;
+            field->logical_min = p->logical_min;
+            if (flags & INPUT_VARIABLE) {
+                // one bit per usage, as many as there are usages
+                uint16_t usages = p->usage_max >= p->usage_min ? p->usage_max - p->usage_min + 1 : 0;
+                if (field->count > usages) {
+                    field->count = usages;
+                }
+                field->size = 1;
+                if (p->report_size == 1 && field->count) {
+                    layout->field_count++;
+                }
+            } else {
+                field->size = 8;
+                if (p->report_size == 8 && !(p->offset & 7)) {
+                    layout->field_count++;
+                }
+            }
+        }
+        layout->length = (end + 7) / 8 + (layout->report_id ? 1 : 0);
+    }
+    p->offset = end;
+}
+
+static void parse_item(hid_kbd_parser_t *p)
+{
+    uint8_t type = (p->item >> 2) & 0x03;
+    uint8_t tag = p->item >> 4;
+    uint32_t value = p->value;
+
+    switch (type) {
+        case ITEM_MAIN:
+            if (tag == MAIN_INPUT) {
+                add_input(p, value);
+            }
+            // the local items only apply to the next main item
+            p->usage_min = 0;
+            p->usage_max = 0;
+            p->usages = 0;
+            break;
+        case ITEM_GLOBAL:
+            switch (tag) {
+                case GLOBAL_USAGE_PAGE:
+                    p->usage_page = value;
+                    break;
+                case GLOBAL_LOGICAL_MIN:
+                    // sign extend
+                    if (p->shift && p->shift < 32 && (value & ((uint32_t)1 << (p->shift - 1)))) {
+                        value |= ~(uint32_t)0 << p->shift;
+                    }
+                    p->logical_min = value;
+                    break;
+                case GLOBAL_REPORT_SIZE:
+                    p->report_size = value;
+                    break;
+                case GLOBAL_REPORT_ID:
+                    if (p->report_id != value) {
+                        p->report_id = value;
+                        p->offset = 0;
+                    }
+                    break;
+                case GLOBAL_REPORT_COUNT:
+                    p->report_count = value;
+                    break;
+            }
+            break;
+        case ITEM_LOCAL:
+            switch (tag) {
+                case LOCAL_USAGE:
+                    // consecutive usages are taken as a range
+                    if (!p->usages) {
+                        p->usage_min = value;
+                        p->usage_max = value;
+                    } else if (value == (uint32_t)p->usage_max + 1) {
+                        p->usage_max = value;
+                    }
+                    p->usages++;
+                    break;
+                case LOCAL_USAGE_MIN:
+                    p->usage_min = value;
+                    break;
+                case LOCAL_USAGE_MAX:
+                    p->usage_max = value;
+                    break;
+            }
+            break;
+    }
+}
+
+void hid_kbd_parser_put(hid_kbd_parser_t *p, uint8_t data)
+{
+    if (p->remaining) {
+        if (p->item == ITEM_LONG) {
+            // the tag and the data are skipped
+            p->item = ITEM_SKIP;
+            p->remaining = data + 1;
+            return;
+        }
+        p->value |= (uint32_t)data << p->shift;
+        p->shift += 8;
+        if (--p->remaining == 0 && p->item != ITEM_SKIP) {
+            parse_item(p);
+        }
+        return;
+    }
+
+    p->item = data;
+    p->value = 0;
+    p->shift = 0;
+    if (data == ITEM_LONG) {
+        p->remaining = 1;
+        return;
+    }
+    p->remaining = (data & 0x03) == 3 ? 4 : (data & 0x03);
+    if (!p->remaining) {
+        parse_item(p);
+    }
+}
+
+
+static inline void set_key(hid_kbd_state_t *state, uint16_t usage)
+{
+    if (USAGE_FIRST_KEY <= usage && usage <= 0xFF) {
+        state->bits[usage >> 3] |= 1 << (usage & 7);
+    }
+}
+
+bool hid_kbd_is_report(const hid_kbd_layout_t *layout, const uint8_t *report, uint8_t len)
+{
+    return layout->field_count && len && len >= layout->length &&
+        (!layout->report_id || report[0] == layout->report_id);
+}
+
+bool hid_kbd_read_report(const hid_kbd_layout_t *layout, hid_kbd_state_t *state, const uint8_t *report, uint8_t len)
+{
+    hid_kbd_state_t next;
+
+    if (!hid_kbd_is_report(layout, report, len)) {
+        return false;
+    }
+    if (layout->report_id) {
+        report++;
+    }
+
+    // the layout comes from the device, so it isn't trusted to fit the report
+    uint16_t report_bits = (len - (layout->report_id ? 1 : 0)) * 8;
+    for (uint8_t f = 0; f < layout->field_count; f++) {
+        const hid_kbd_field_t *field = &layout->fields[f];
+        if ((uint32_t)field->offset + (uint32_t)field->count * field->size > report_bits) {
+            return false;
+        }
+    }
+
+    memset(&next, 0, sizeof(next));
+    for (uint8_t f = 0; f < layout->field_count; f++) {
+        const hid_kbd_field_t *field = &layout->fields[f];
+        if (field->size == 1) {
+            uint16_t i = 0;
+            if (!(field->offset & 7) && !(field->usage_min & 7)) {
+                // byte aligned, which NKRO bitmaps are
+                for (; i + 8 <= field->count && field->usage_min + i <= 0xFF; i += 8) {
+                    next.bits[(field->usage_min + i) >> 3] |= report[(field->offset + i) >> 3];
+                }
+            }
+            for (; i < field->count; i++) {
+                uint16_t bit = field->offset + i;
+                if (report[bit >> 3] & (1 << (bit & 7))) {
+                    set_key(&next, field->usage_min + i);
+                }
+            }
+        } else {
+            const uint8_t *codes = report + (field->offset >> 3);
+            for (uint16_t i = 0; i < field->count; i++) {
+                if (codes[i] < field->logical_min) {
+                    continue;
+                }
+                uint16_t usage = codes[i] - field->logical_min + field->usage_min;
+                if (usage == USAGE_ROLL_OVER) {
+                    // too many keys, the keys are as they were
+                    return false;
+                }
+                set_key(&next, usage);
+            }
+        }
+    }
+    // the reserved usages of a bitmap
+    next.bits[0] &= ~((1 << USAGE_FIRST_KEY) - 1);
+
+    *state = next;
+    return true;
+}
+
+void hid_kbd_merge(hid_kbd_state_t *state, const hid_kbd_state_t *other)
+{
+    for (uint8_t i = 0; i < sizeof(state->bits); i++) {
+        state->bits[i] |= other->bits[i];
+    }
+}
+
+void hid_kbd_device_init(hid_kbd_device_t *device)
+{
+    memset(device, 0, sizeof(*device));
+}
+
+void hid_kbd_device_set_layout(hid_kbd_device_t *device, uint8_t iface, const hid_kbd_layout_t *layout)
+{
+    if (iface < HID_KBD_MAX_INTERFACES) {
+        device->layouts[iface] = *layout;
+        memset(&device->states[iface], 0, sizeof(device->states[iface]));
+    }
+}
+
+bool hid_kbd_device_read_report(hid_kbd_device_t *device, uint8_t iface, const uint8_t *report, uint8_t len)
+{
+    if (iface >= HID_KBD_MAX_INTERFACES) {
+        return false;
+    }
+    return hid_kbd_read_report(&device->layouts[iface], &device->states[iface], report, len);
+}
+
+void hid_kbd_device_get_state(const hid_kbd_device_t *device, hid_kbd_state_t *state)
+{
+    memset(state, 0, sizeof(*state));
+    for (uint8_t i = 0; i < HID_KBD_MAX_INTERFACES; i++) {
+        hid_kbd_merge(state, &device->states[i]);
+    }
+}
+
+uint8_t hid_kbd_diff(hid_kbd_state_t *prev, const hid_kbd_state_t *next, hid_kbd_event_t event)
+{
+    uint8_t changes = 0;
+
+    for (uint8_t pressed = 0; pressed < 2; pressed++) {
+        for (uint8_t i = 0; i < sizeof(prev->bits); i++) {
+            uint8_t change = prev->bits[i] ^ next->bits[i];
+            change &= pressed ? next->bits[i] : prev->bits[i];
+            for (uint8_t b = 0; change; b++, change >>= 1) {
+                if (change & 1) {
+                    event(i * 8 + b, pressed);
+                    changes++;
+                }
+            }
+        }
+    }
+    *prev = *next;
+    return changes;
+}
@@ -0,0 +1,132 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HID_KBD_H
+#define HID_KBD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * HID keyboard reports, boot protocol and report protocol
+ *
+ * The keys are kept as one bit per usage of the Keyboard page, modifiers are
+ * usages 0xE0-0xE7. Comparing two states gives the key events directly, for
+ * any number of keys.
+ */
+typedef struct {
+    uint8_t bits[32];
+} hid_kbd_state_t;
+
+/* Where the keys are in the input report */
+typedef struct {
+    uint16_t offset;        /* in bits, after the report ID */
+    uint16_t count;
+    uint8_t size;           /* 1 for a bitmap, 8 for an array of usages */
+    uint8_t usage_min;
+    uint8_t logical_min;    /* of the array values */
+} hid_kbd_field_t;
+
+#define HID_KBD_MAX_FIELDS  4
+
+typedef struct {
+    uint8_t report_id;      /* 0 when the reports have no ID */
+    uint16_t length;        /* of the report in bytes, with the ID */
+    uint8_t field_count;    /* 0 when the descriptor has no keys */
+    hid_kbd_field_t fields[HID_KBD_MAX_FIELDS];
+} hid_kbd_layout_t;
+
+/* modifier bitmap, reserved byte, six key codes */
+extern const hid_kbd_layout_t hid_kbd_boot_layout;
+
+/*
+ * Report descriptor parser, fed one byte at a time, so that the descriptor
+ * doesn't have to be stored. It takes the first report that has keys.
+ *
+ * Push and pop aren't supported, and the items of that report have to come
+ * together, which all keyboards seen so far do.
+ */
+typedef struct {
+    hid_kbd_layout_t *layout;
+    uint8_t item;           /* prefix of the item being read */
+    uint8_t remaining;      /* data bytes left of it */
+    uint8_t shift;
+    uint32_t value;
+    bool locked;            /* the report ID has been picked */
+    uint8_t report_id;
+    uint16_t offset;
+    uint16_t usage_page;
+    int32_t logical_min;
+    uint8_t report_size;
+    uint16_t report_count;
+    uint16_t usage_min;
+    uint16_t usage_max;
+    uint8_t usages;         /* Usage items since the last main item */
+} hid_kbd_parser_t;
+
+void hid_kbd_parser_init(hid_kbd_parser_t *parser, hid_kbd_layout_t *layout);
+void hid_kbd_parser_put(hid_kbd_parser_t *parser, uint8_t data);
+
+/* Whether the report has the ID and the length of the layout */
+bool hid_kbd_is_report(const hid_kbd_layout_t *layout, const uint8_t *report, uint8_t len);
+
+/* Reads the keys of a report into state. Returns false, and leaves state
+ * alone, when it isn't a report of this layout, a field of the layout ends
+ * after the report, or it is a rollover error. */
+bool hid_kbd_read_report(const hid_kbd_layout_t *layout, hid_kbd_state_t *state, const uint8_t *report, uint8_t len);
+
+/* Adds the keys of other to state */
+void hid_kbd_merge(hid_kbd_state_t *state, const hid_kbd_state_t *other);
+
+/*
+ * A keyboard with several interfaces, like a boot keyboard next to an NKRO
+ * one. Every interface has its own layout and keys, and the keys of the
+ * keyboard are those of all of them, so that the reports of one interface
+ * don't release the keys held on another.
+ */
+#define HID_KBD_MAX_INTERFACES  3
+
+typedef struct {
+    hid_kbd_layout_t layouts[HID_KBD_MAX_INTERFACES];
+    hid_kbd_state_t states[HID_KBD_MAX_INTERFACES];
+} hid_kbd_device_t;
+
+/* No interface has keys */
+void hid_kbd_device_init(hid_kbd_device_t *device);
+void hid_kbd_device_set_layout(hid_kbd_device_t *device, uint8_t iface, const hid_kbd_layout_t *layout);
+
+/* Reads a report of an interface into its keys, returns false when it
+ * isn't a report with keys */
+bool hid_kbd_device_read_report(hid_kbd_device_t *device, uint8_t iface, const uint8_t *report, uint8_t len);
+
+/* The keys of all the interfaces */
+void hid_kbd_device_get_state(const hid_kbd_device_t *device, hid_kbd_state_t *state);
+
+typedef void (*hid_kbd_event_t)(uint8_t code, bool pressed);
+
+/* Calls event for every key that changed from prev to next, releases
+ * first, then sets prev to next. Returns the number of changes. */
+uint8_t hid_kbd_diff(hid_kbd_state_t *prev, const hid_kbd_state_t *next, hid_kbd_event_t event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
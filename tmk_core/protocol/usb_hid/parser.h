@@ -3,11 +3,15 @@
 
 #include "hid.h"
 #include "report.h"
+#include "hid_kbd.h"
 
 class KBDReportParser : public HIDReportParser
 {
 public:
-    report_keyboard_t report;
+    KBDReportParser() : layout(&hid_kbd_boot_layout), state(), time_stamp(0) {}
+    // boot protocol, unless the keyboard reads its report descriptor
+    const hid_kbd_layout_t *layout;
+    hid_kbd_state_t state;
     uint16_t time_stamp;
     virtual void Parse(HID *hid, bool is_rpt_id, uint8_t len, uint8_t *buf);
 };
@@ -0,0 +1,109 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "report_keyboard.h"
+
+#include "debug.h"
+
+
+/* report descriptors longer than this are cut off */
+#ifndef REPORT_KEYBOARD_DESCRIPTOR_SIZE
+#define REPORT_KEYBOARD_DESCRIPTOR_SIZE 512
+#endif
+
+class DescriptorParser : public USBReadParser
+{
+public:
+    hid_kbd_parser_t parser;
+    virtual void Parse(const uint16_t len, const uint8_t *pbuf, const uint16_t &offset) {
+        for (uint16_t i = 0; i < len; i++) {
+            hid_kbd_parser_put(&parser, pbuf[i]);
+        }
+    }
+};
+
+uint8_t HIDReportKeyboard::OnInitSuccessful()
+{
+    hid_kbd_device_init(&device);
+    for (uint8_t i = 0; i < maxHidInterfaces; i++) {
+        if (hidInterfaces[i].epIndex[epInterruptInIndex] == 0) {
+            continue;
+        }
+        uint8_t iface = hidInterfaces[i].bmInterface;
+
+        hid_kbd_layout_t layout;
+        DescriptorParser descriptor;
+        hid_kbd_parser_init(&descriptor.parser, &layout);
+        uint8_t buf[64];
+        uint8_t rcode = pUsb->ctrlReq(bAddress, 0x00, bmREQ_HID_REPORT, USB_REQUEST_GET_DESCRIPTOR, 0x00,
+                HID_DESCRIPTOR_REPORT, iface, REPORT_KEYBOARD_DESCRIPTOR_SIZE, sizeof(buf), buf, &descriptor);
+        dprintf("report keyboard: iface %d rcode %02X id %d len %d fields %d\n",
+                iface, rcode, layout.report_id, layout.length, layout.field_count);
+
+        if (!rcode && layout.field_count) {
+            hid_kbd_device_set_layout(&device, i, &layout);
+        } else if (hidInterfaces[i].bmProtocol == HID_PROTOCOL_KEYBOARD) {
+            if (!SetProtocol(iface, HID_BOOT_PROTOCOL)) {
+                hid_kbd_device_set_layout(&device, i, &hid_kbd_boot_layout);
+            }
+        }
+    }
+    return 0;
+}
+
+uint8_t HIDReportKeyboard::Poll()
+{
+    if (!isReady() || !parser) {
+        return 0;
+    }
+    // The reports only replace the keys of their own interface, so the same
+    // report twice changes nothing, and a NAK only means there's nothing new
+    for (uint8_t i = 0; i < maxHidInterfaces; i++) {
+        uint8_t index = hidInterfaces[i].epIndex[epInterruptInIndex];
+        if (index == 0) {
+            continue;
+        }
+        uint8_t buf[64];
+        uint16_t read = epInfo[index].maxPktSize;
+        if (read > sizeof(buf)) {
+            read = sizeof(buf);
+        }
+        if (pUsb->inTransfer(bAddress, epInfo[index].epAddr, &read, buf)) {
+            continue;
+        }
+        if (!hid_kbd_device_read_report(&device, i, buf, read)) {
+            continue;
+        }
+        hid_kbd_device_get_state(&device, &parser->state);
+        parser->time_stamp = millis();
+        dprintf("input %d/%d:", bAddress, i);
+        for (uint8_t j = 0; j < read; j++) {
+            dprintf(" %02X", buf[j]);
+        }
+        dprint("\r\n");
+    }
+    return 0;
+}
+
+uint8_t HIDReportKeyboard::Release()
+{
+    // the keys of an unplugged keyboard are released
+    hid_kbd_device_init(&device);
+    if (parser) {
+        hid_kbd_device_get_state(&device, &parser->state);
+    }
+    return HIDUniversal::Release();
+}
@@ -0,0 +1,53 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPORT_KEYBOARD_H
+#define REPORT_KEYBOARD_H
+
+#include "hiduniversal.h"
+#include "parser.h"
+
+/*
+ * A keyboard in report protocol, for NKRO keyboards, which only report six
+ * keys in boot protocol
+ *
+ * The layout of the keys is read from the report descriptor of each
+ * interface, and each interface keeps its own keys, see hid_kbd_device_t.
+ * An interface whose descriptor can't be read, but which supports the boot
+ * protocol, is switched to it.
+ *
+ * HIDUniversal::Poll stops at the first interface that has nothing new, and
+ * compares every report with the last one of any interface, so Poll is
+ * replaced by one that reads every interface on every call.
+ */
+class HIDReportKeyboard : public HIDUniversal
+{
+public:
+    HIDReportKeyboard(USB *p) : HIDUniversal(p), parser(NULL) { hid_kbd_device_init(&device); }
+    void SetKeyboardParser(KBDReportParser *prs) { parser = prs; }
+    uint8_t Poll();
+    uint8_t Release();
+
+protected:
+    virtual uint8_t OnInitSuccessful();
+
+private:
+    KBDReportParser *parser;
+    hid_kbd_device_t device;
+    static_assert(maxHidInterfaces <= HID_KBD_MAX_INTERFACES, "hid_kbd_device_t has too few interfaces");
+};
+
+#endif
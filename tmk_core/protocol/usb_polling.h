@@ -0,0 +1,123 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TMK_CORE_PROTOCOL_USB_POLLING_H_
+#define TMK_CORE_PROTOCOL_USB_POLLING_H_
+
+/* Polling intervals of the interrupt IN endpoints, the bInterval field of
+ * their endpoint descriptors, in milliseconds
+ *
+ * USB_POLLING_INTERVAL_MS sets all the HID endpoints at once, and each of
+ * them can also be overridden on its own. 1 ms is the fastest a full speed
+ * device can be polled. Whatever isn't set keeps the default of the
+ * protocol, which is what it used before these options existed, 10 ms
+ * for the keyboard and extra keys, 1 ms for NKRO, the shared endpoint and
+ * steno HID, and for the mouse 1 ms on ChibiOS and 10 ms on LUFA.
+ *
+ * Every report is still sent as soon as it changes, the interval only
+ * limits how often the host asks for one.
+ */
+
+#ifdef USB_POLLING_INTERVAL_MS
+#  if USB_POLLING_INTERVAL_MS < 1 || USB_POLLING_INTERVAL_MS > 255
+#    error "USB_POLLING_INTERVAL_MS must be between 1 and 255"
+#  endif
+#  ifndef KEYBOARD_POLLING_INTERVAL_MS
+#    define KEYBOARD_POLLING_INTERVAL_MS USB_POLLING_INTERVAL_MS
+#  endif
+#  ifndef MOUSE_POLLING_INTERVAL_MS
+#    define MOUSE_POLLING_INTERVAL_MS USB_POLLING_INTERVAL_MS
+#  endif
+#  ifndef EXTRAKEY_POLLING_INTERVAL_MS
+#    define EXTRAKEY_POLLING_INTERVAL_MS USB_POLLING_INTERVAL_MS
+#  endif
+#  ifndef NKRO_POLLING_INTERVAL_MS
+#    define NKRO_POLLING_INTERVAL_MS USB_POLLING_INTERVAL_MS
+#  endif
+#  ifndef SHARED_POLLING_INTERVAL_MS
+#    define SHARED_POLLING_INTERVAL_MS USB_POLLING_INTERVAL_MS
+#  endif
+#  ifndef STENO_POLLING_INTERVAL_MS
+#    define STENO_POLLING_INTERVAL_MS USB_POLLING_INTERVAL_MS
+#  endif
+#endif
+
+/* The defaults of the protocols */
+#ifdef PROTOCOL_CHIBIOS
+#  define USB_POLLING_DEFAULT_MOUSE 1
+#else
+#  define USB_POLLING_DEFAULT_MOUSE 10
+#endif
+#ifndef KEYBOARD_POLLING_INTERVAL_MS
+#  define KEYBOARD_POLLING_INTERVAL_MS 10
+#endif
+#ifndef MOUSE_POLLING_INTERVAL_MS
+#  define MOUSE_POLLING_INTERVAL_MS USB_POLLING_DEFAULT_MOUSE
+#endif
+#ifndef EXTRAKEY_POLLING_INTERVAL_MS
+#  define EXTRAKEY_POLLING_INTERVAL_MS 10
+#endif
+#ifndef NKRO_POLLING_INTERVAL_MS
+#  define NKRO_POLLING_INTERVAL_MS 1
+#endif
+#ifndef SHARED_POLLING_INTERVAL_MS
+#  define SHARED_POLLING_INTERVAL_MS 1
+#endif
+#ifndef STENO_POLLING_INTERVAL_MS
+#  define STENO_POLLING_INTERVAL_MS 1
+#endif
+
+#if KEYBOARD_POLLING_INTERVAL_MS < 1 || KEYBOARD_POLLING_INTERVAL_MS > 255
+#  error "KEYBOARD_POLLING_INTERVAL_MS must be between 1 and 255"
+#endif
+#if MOUSE_POLLING_INTERVAL_MS < 1 || MOUSE_POLLING_INTERVAL_MS > 255
+#  error "MOUSE_POLLING_INTERVAL_MS must be between 1 and 255"
+#endif
+#if EXTRAKEY_POLLING_INTERVAL_MS < 1 || EXTRAKEY_POLLING_INTERVAL_MS > 255
+#  error "EXTRAKEY_POLLING_INTERVAL_MS must be between 1 and 255"
+#endif
+#if NKRO_POLLING_INTERVAL_MS < 1 || NKRO_POLLING_INTERVAL_MS > 255
+#  error "NKRO_POLLING_INTERVAL_MS must be between 1 and 255"
+#endif
+#if SHARED_POLLING_INTERVAL_MS < 1 || SHARED_POLLING_INTERVAL_MS > 255
+#  error "SHARED_POLLING_INTERVAL_MS must be between 1 and 255"
+#endif
+#if STENO_POLLING_INTERVAL_MS < 1 || STENO_POLLING_INTERVAL_MS > 255
+#  error "STENO_POLLING_INTERVAL_MS must be between 1 and 255"
+#endif
+
+/* The bInterval of an endpoint polled every ms milliseconds
+ * Full speed devices give it in frames of 1 ms. High speed ones, with
+ * USB_HIGH_SPEED defined, give it as 2^(bInterval-1) microframes of 125 us,
+ * so the interval is rounded down to a power of two there.
+ */
+#ifdef USB_HIGH_SPEED
+#  define USB_POLLING_BINTERVAL(ms) \
+    ((ms) >= 128 ? 11 : (ms) >= 64 ? 10 : (ms) >= 32 ? 9 : (ms) >= 16 ? 8 : \
+     (ms) >= 8 ? 7 : (ms) >= 4 ? 6 : (ms) >= 2 ? 5 : 4)
+#else
+#  define USB_POLLING_BINTERVAL(ms) (ms)
+#endif
+
+/* The bInterval initializers of the endpoint descriptors */
+#define KEYBOARD_POLLING_BINTERVAL USB_POLLING_BINTERVAL(KEYBOARD_POLLING_INTERVAL_MS)
+#define MOUSE_POLLING_BINTERVAL USB_POLLING_BINTERVAL(MOUSE_POLLING_INTERVAL_MS)
+#define EXTRAKEY_POLLING_BINTERVAL USB_POLLING_BINTERVAL(EXTRAKEY_POLLING_INTERVAL_MS)
+#define NKRO_POLLING_BINTERVAL USB_POLLING_BINTERVAL(NKRO_POLLING_INTERVAL_MS)
+#define SHARED_POLLING_BINTERVAL USB_POLLING_BINTERVAL(SHARED_POLLING_INTERVAL_MS)
+#define STENO_POLLING_BINTERVAL USB_POLLING_BINTERVAL(STENO_POLLING_INTERVAL_MS)
+
+#endif /* TMK_CORE_PROTOCOL_USB_POLLING_H_ */
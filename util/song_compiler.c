@@ -0,0 +1,64 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+// Compiles a float song into a compact song (see audio_engine.h), which
+// takes a quarter of the flash, and prints it as C. The song is given as
+// defines, so the macros of song_list.h, or a keymap's own, can be used
+//
+//   cc -I quantum/audio -I tmk_core/common -o song_compiler
+//      -DSONG_NAME=ode_to_joy -DSONG_NOTES='SONG(ODE_TO_JOY)'
+//      util/song_compiler.c quantum/audio/song_compiler.c -lm
+//   ./song_compiler > ode_to_joy.h
+//
+// Then play it with PLAY_COMPACT_SONG(ode_to_joy). For a song defined in a
+// keymap, add -include keyboards/<keyboard>/keymaps/<keymap>/config.h.
+
+#include <stdio.h>
+#include <stdint.h>
+#include "song_list.h"
+#include "song_compiler.h"
+#include "audio_engine.h"
+
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+static const float notes[][2] = SONG_NOTES;
+
+int main(void) {
+    uint16_t count = sizeof(notes) / sizeof(notes[0]);
+    static uint8_t out[2 * sizeof(notes) / sizeof(notes[0])];
+    int32_t size = song_compile(notes, count, out, sizeof(out));
+    if (size < 0) {
+        fprintf(stderr, "song_compiler: %s has a note that can't be compiled\n", XSTR(SONG_NAME));
+        return 1;
+    }
+
+    printf("// %u notes, %u bytes, compiled from %u bytes\n", count, (unsigned)size, (unsigned)sizeof(notes));
+    printf("const uint8_t %s[] PROGMEM = {\n", XSTR(SONG_NAME));
+    for (int32_t i = 0; i < size; i += 2) {
+        if (out[i] == AUDIO_SONG_REPEAT) {
+            printf("    AUDIO_SONG_REPEAT, %u,\n", out[i + 1]);
+        } else if (out[i] == AUDIO_SONG_REST) {
+            printf("    AUDIO_SONG_REST, %u,\n", out[i + 1]);
+        } else {
+            printf("    %u, %u,\n", out[i], out[i + 1]);
+        }
+    }
+    printf("};\n");
+    return 0;
+}
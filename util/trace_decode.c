@@ -0,0 +1,72 @@
+/* Copyright 2017 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Turns the output of a keyboard built with TRACE_BINARY_OUTPUT back into
+// text, reads the console output, from hid_listen for example, on stdin
+//
+//   cc -I tmk_core/common -o trace_decode util/trace_decode.c tmk_core/common/trace.c
+//   hid_listen | ./trace_decode
+//
+// Keymaps with their own formats need them here too, add
+// -include keyboards/<keyboard>/keymaps/<keymap>/config.h to the command.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "trace.h"
+
+// trace.c outputs through sendchar on the keyboard
+int8_t sendchar(uint8_t c) {
+    return putchar(c) == EOF ? -1 : 0;
+}
+
+static void put_stdout(char c) {
+    putchar(c);
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = toupper((unsigned char)c);
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+int main(void) {
+    char line[512];
+    uint8_t record[sizeof(line) / 2];
+    while (fgets(line, sizeof(line), stdin)) {
+        if (line[0] != '~') {
+            fputs(line, stdout);
+            continue;
+        }
+        uint16_t size = 0;
+        const char* p = line + 1;
+        int high, low;
+        while ((high = hex_value(p[0])) >= 0 && (low = hex_value(p[1])) >= 0) {
+            record[size++] = high << 4 | low;
+            p += 2;
+        }
+        if (trace_decode(record, size, put_stdout) != size) {
+            printf("trace_decode: bad record %s", line);
+        }
+    }
+    return 0;
+}